@@ -0,0 +1,181 @@
+/*
+ * Standalone check that every SIMD kernel set of format-conversion.c that
+ * the CPU supports is bit-exact with the C reference kernels, for every
+ * row width up to MAX_WIDTH and with unaligned rows.  The output buffers
+ * have guard bytes on both sides that must come back untouched.
+ *
+ * It includes format-conversion.c to get at the kernel tables, so it only
+ * needs blog and os_get_cpu_features from libobs, e.g.:
+ *
+ *   cc -O2 -I.. format-conversion-test.c -lobs -o format-conversion-test
+ *
+ * Returns 0 if all kernels match.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "format-conversion.c"
+
+#define MAX_WIDTH 1920
+#define GUARD 64
+#define GUARD_BYTE 0xA5
+
+struct test_buffers {
+	uint8_t* in[3];
+	uint8_t* ref[3];
+	uint8_t* out[3];
+};
+
+static uint32_t rand_state = 1;
+
+static inline uint8_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (uint8_t)(rand_state >> 16);
+}
+
+static void fill_random(uint8_t* data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = next_rand();
+}
+
+/* buffers are large enough for a row of any kernel, with guards */
+static void reset_outputs(struct test_buffers* buf)
+{
+	const size_t size = MAX_WIDTH * 4 + GUARD * 2;
+
+	for (size_t i = 0; i < 3; i++) {
+		memset(buf->ref[i], GUARD_BYTE, size);
+		memset(buf->out[i], GUARD_BYTE, size);
+	}
+}
+
+static bool outputs_match(const struct test_buffers* buf)
+{
+	const size_t size = MAX_WIDTH * 4 + GUARD * 2;
+
+	for (size_t i = 0; i < 3; i++) {
+		if (memcmp(buf->ref[i], buf->out[i], size) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/* row pointers start `offset` bytes past the guard to catch kernels that
+ * assume aligned rows */
+static inline uint8_t* row(uint8_t* base, uint32_t offset)
+{
+	return base + GUARD + offset;
+}
+
+static int test_width(const struct conversion_kernels* k,
+	struct test_buffers* buf, uint32_t width, uint32_t offset)
+{
+	const struct conversion_kernels* c = &kernels_c;
+	const uint8_t* in = row(buf->in[0], offset);
+	const uint8_t* y = row(buf->in[0], offset);
+	const uint8_t* u = row(buf->in[1], offset);
+	const uint8_t* v = row(buf->in[2], offset);
+	uint8_t* ref[3];
+	uint8_t* out[3];
+	int failed = 0;
+
+	for (size_t i = 0; i < 3; i++) {
+		ref[i] = row(buf->ref[i], offset);
+		out[i] = row(buf->out[i], offset);
+	}
+
+#define CHECK(kernel, ref_call, out_call)                                     \
+	do {                                                                  \
+		reset_outputs(buf);                                           \
+		c->ref_call;                                                  \
+		k->out_call;                                                  \
+		if (!outputs_match(buf)) {                                    \
+			printf("%s %s: mismatch at width %u, offset %u\n",    \
+			       k->name, kernel, width, offset);               \
+			failed++;                                             \
+		}                                                             \
+	} while (false)
+
+	CHECK("pack_y", pack_y(ref[0], in, width), pack_y(out[0], in, width));
+	CHECK("pack_uv", pack_uv(ref[1], ref[2], in, width),
+		pack_uv(out[1], out[2], in, width));
+	CHECK("pack_uv_nv12", pack_uv_nv12(ref[1], in, width),
+		pack_uv_nv12(out[1], in, width));
+	CHECK("split_444", split_444(ref[0], ref[1], ref[2], in, width),
+		split_444(out[0], out[1], out[2], in, width));
+	CHECK("merge_nv12", merge_nv12(ref[0], y, u, width),
+		merge_nv12(out[0], y, u, width));
+	CHECK("merge_420", merge_420(ref[0], y, u, v, width),
+		merge_420(out[0], y, u, v, width));
+	CHECK("merge_422", merge_422(ref[0], in, width, false),
+		merge_422(out[0], in, width, false));
+	CHECK("merge_422 leading lum", merge_422(ref[0], in, width, true),
+		merge_422(out[0], in, width, true));
+
+#undef CHECK
+	return failed;
+}
+
+static int test_kernels(const struct conversion_kernels* k,
+	struct test_buffers* buf)
+{
+	int failed = 0;
+
+	for (uint32_t width = 1; width <= MAX_WIDTH; width++) {
+		const uint32_t offset = width % 4;
+
+		fill_random(buf->in[0], MAX_WIDTH * 4 + GUARD * 2);
+		fill_random(buf->in[1], MAX_WIDTH * 4 + GUARD * 2);
+		fill_random(buf->in[2], MAX_WIDTH * 4 + GUARD * 2);
+
+		failed += test_width(k, buf, width, offset);
+	}
+
+	printf("%s: %s\n", k->name, failed ? "FAILED" : "ok");
+	return failed;
+}
+
+int main(void)
+{
+	const struct conversion_kernels* tests[4];
+	size_t num_tests = 0;
+	uint32_t features = os_get_cpu_features();
+	struct test_buffers buf;
+	int failed = 0;
+
+#if defined(CONVERSION_X86)
+	if (features & OS_CPU_SSSE3)
+		tests[num_tests++] = &kernels_ssse3;
+	if (features & OS_CPU_AVX2)
+		tests[num_tests++] = &kernels_avx2;
+#elif defined(CONVERSION_NEON)
+	if (features & OS_CPU_NEON)
+		tests[num_tests++] = &kernels_neon;
+#endif
+	UNUSED_PARAMETER(features);
+
+	if (!num_tests) {
+		printf("no SIMD kernels supported, nothing to check\n");
+		return 0;
+	}
+
+	for (size_t i = 0; i < 3; i++) {
+		buf.in[i] = malloc(MAX_WIDTH * 4 + GUARD * 2);
+		buf.ref[i] = malloc(MAX_WIDTH * 4 + GUARD * 2);
+		buf.out[i] = malloc(MAX_WIDTH * 4 + GUARD * 2);
+	}
+
+	for (size_t i = 0; i < num_tests; i++)
+		failed += test_kernels(tests[i], &buf);
+
+	for (size_t i = 0; i < 3; i++) {
+		free(buf.in[i]);
+		free(buf.ref[i]);
+		free(buf.out[i]);
+	}
+
+	return failed ? 1 : 0;
+}
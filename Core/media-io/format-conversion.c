@@ -0,0 +1,741 @@
+#include <string.h>
+#include "../util/base.h"
+#include "../util/platform.h"
+#include "../util/simde/simde-arch.h"
+#include "format-conversion.h"
+
+#if defined(SIMDE_ARCH_X86) || defined(SIMDE_ARCH_AMD64)
+#define CONVERSION_X86
+#include <immintrin.h>
+#elif defined(SIMDE_ARCH_ARM_NEON)
+#define CONVERSION_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+/*
+ * Packed 444 YUV is stored as four bytes per pixel in u, y, v, x order.  When
+ * compressing to 420, chroma is taken from the top-left pixel of each 2x2
+ * block, the same as the GPU conversion shaders do.  When decompressing, the
+ * x byte is always written as zero.
+ *
+ * Every kernel works on a single row of `width` pixels.  The SIMD kernels
+ * process whole blocks and hand the remainder of the row to the C kernel, so
+ * all variants produce identical output.
+ */
+
+struct conversion_kernels {
+	const char* name;
+	void (*pack_y)(uint8_t* y, const uint8_t* in, uint32_t width);
+	void (*pack_uv)(uint8_t* u, uint8_t* v, const uint8_t* in,
+		uint32_t width);
+	void (*pack_uv_nv12)(uint8_t* uv, const uint8_t* in, uint32_t width);
+	void (*split_444)(uint8_t* y, uint8_t* u, uint8_t* v,
+		const uint8_t* in, uint32_t width);
+	void (*merge_nv12)(uint8_t* out, const uint8_t* y, const uint8_t* uv,
+		uint32_t width);
+	void (*merge_420)(uint8_t* out, const uint8_t* y, const uint8_t* u,
+		const uint8_t* v, uint32_t width);
+	void (*merge_422)(uint8_t* out, const uint8_t* in, uint32_t width,
+		bool leading_lum);
+};
+
+/* ------------------------------------------------------------------------- */
+/* reference kernels */
+
+static void pack_y_c(uint8_t* y, const uint8_t* in, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+		y[x] = in[x * 4 + 1];
+}
+
+static void pack_uv_c(uint8_t* u, uint8_t* v, const uint8_t* in,
+	uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x += 2) {
+		*(u++) = in[x * 4];
+		*(v++) = in[x * 4 + 2];
+	}
+}
+
+static void pack_uv_nv12_c(uint8_t* uv, const uint8_t* in, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x += 2) {
+		*(uv++) = in[x * 4];
+		*(uv++) = in[x * 4 + 2];
+	}
+}
+
+static void split_444_c(uint8_t* y, uint8_t* u, uint8_t* v,
+	const uint8_t* in, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++) {
+		u[x] = in[x * 4];
+		y[x] = in[x * 4 + 1];
+		v[x] = in[x * 4 + 2];
+	}
+}
+
+static void merge_nv12_c(uint8_t* out, const uint8_t* y, const uint8_t* uv,
+	uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++) {
+		*(out++) = uv[(x / 2) * 2];
+		*(out++) = y[x];
+		*(out++) = uv[(x / 2) * 2 + 1];
+		*(out++) = 0;
+	}
+}
+
+static void merge_420_c(uint8_t* out, const uint8_t* y, const uint8_t* u,
+	const uint8_t* v, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++) {
+		*(out++) = u[x / 2];
+		*(out++) = y[x];
+		*(out++) = v[x / 2];
+		*(out++) = 0;
+	}
+}
+
+static void merge_422_c(uint8_t* out, const uint8_t* in, uint32_t width,
+	bool leading_lum)
+{
+	const uint32_t lum = leading_lum ? 0 : 1;
+	const uint32_t chroma = leading_lum ? 1 : 0;
+
+	for (uint32_t x = 0; x < width; x++) {
+		const uint8_t* pair = in + (x / 2) * 4;
+
+		*(out++) = pair[chroma];
+		*(out++) = pair[lum + (x & 1) * 2];
+		*(out++) = pair[chroma + 2];
+		*(out++) = 0;
+	}
+}
+
+static const struct conversion_kernels kernels_c = {
+	"C", pack_y_c, pack_uv_c, pack_uv_nv12_c, split_444_c,
+	merge_nv12_c, merge_420_c, merge_422_c
+};
+
+/* ------------------------------------------------------------------------- */
+/* SSSE3 / AVX2 kernels */
+
+#ifdef CONVERSION_X86
+/* groups one register of four pixels into u0-3, y0-3, v0-3, x0-3 */
+#define GROUP_PLANES 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+
+/* takes u and v of pixels 0 and 2 */
+#define GROUP_UV_PLANAR 0, 8, 2, 10, -1, -1, -1, -1, \
+	-1, -1, -1, -1, -1, -1, -1, -1
+#define GROUP_UV_NV12 0, 2, 8, 10, -1, -1, -1, -1, \
+	-1, -1, -1, -1, -1, -1, -1, -1
+
+/* expands two packed 422 pairs into four uyvx pixels */
+#define EXPAND_YUYV 1, 0, 3, -1, 1, 2, 3, -1, 5, 4, 7, -1, 5, 6, 7, -1
+#define EXPAND_UYVY 0, 1, 2, -1, 0, 3, 2, -1, 4, 5, 6, -1, 4, 7, 6, -1
+
+TARGET_SSSE3
+static inline void split_16_ssse3(const uint8_t* in, __m128i* u, __m128i* y,
+	__m128i* v)
+{
+	const __m128i group = _mm_setr_epi8(GROUP_PLANES);
+	__m128i a, b, c, d, ab_lo, ab_hi, cd_lo, cd_hi;
+
+	a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), group);
+	b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in + 1), group);
+	c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in + 2), group);
+	d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in + 3), group);
+
+	ab_lo = _mm_unpacklo_epi32(a, b);
+	ab_hi = _mm_unpackhi_epi32(a, b);
+	cd_lo = _mm_unpacklo_epi32(c, d);
+	cd_hi = _mm_unpackhi_epi32(c, d);
+
+	*u = _mm_unpacklo_epi64(ab_lo, cd_lo);
+	*y = _mm_unpackhi_epi64(ab_lo, cd_lo);
+	*v = _mm_unpacklo_epi64(ab_hi, cd_hi);
+}
+
+TARGET_SSSE3
+static void pack_y_ssse3(uint8_t* y, const uint8_t* in, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i u16, y16, v16;
+		split_16_ssse3(in + x * 4, &u16, &y16, &v16);
+		_mm_storeu_si128((__m128i*)(y + x), y16);
+	}
+
+	pack_y_c(y + x, in + x * 4, width - x);
+}
+
+TARGET_SSSE3
+static void split_444_ssse3(uint8_t* y, uint8_t* u, uint8_t* v,
+	const uint8_t* in, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i u16, y16, v16;
+		split_16_ssse3(in + x * 4, &u16, &y16, &v16);
+		_mm_storeu_si128((__m128i*)(y + x), y16);
+		_mm_storeu_si128((__m128i*)(u + x), u16);
+		_mm_storeu_si128((__m128i*)(v + x), v16);
+	}
+
+	split_444_c(y + x, u + x, v + x, in + x * 4, width - x);
+}
+
+TARGET_SSSE3
+static void pack_uv_ssse3(uint8_t* u, uint8_t* v, const uint8_t* in,
+	uint32_t width)
+{
+	const __m128i group = _mm_setr_epi8(GROUP_UV_PLANAR);
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		const __m128i* src = (const __m128i*)(in + x * 4);
+		__m128i a, b, c, d, uv;
+
+		a = _mm_shuffle_epi8(_mm_loadu_si128(src), group);
+		b = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), group);
+		c = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), group);
+		d = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), group);
+
+		uv = _mm_unpacklo_epi32(_mm_unpacklo_epi16(a, b),
+			_mm_unpacklo_epi16(c, d));
+
+		_mm_storel_epi64((__m128i*)(u + x / 2), uv);
+		_mm_storel_epi64((__m128i*)(v + x / 2),
+			_mm_srli_si128(uv, 8));
+	}
+
+	pack_uv_c(u + x / 2, v + x / 2, in + x * 4, width - x);
+}
+
+TARGET_SSSE3
+static void pack_uv_nv12_ssse3(uint8_t* uv, const uint8_t* in,
+	uint32_t width)
+{
+	const __m128i group = _mm_setr_epi8(GROUP_UV_NV12);
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		const __m128i* src = (const __m128i*)(in + x * 4);
+		__m128i a, b, c, d;
+
+		a = _mm_shuffle_epi8(_mm_loadu_si128(src), group);
+		b = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), group);
+		c = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), group);
+		d = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), group);
+
+		_mm_storeu_si128((__m128i*)(uv + x),
+			_mm_unpacklo_epi64(_mm_unpacklo_epi32(a, b),
+				_mm_unpacklo_epi32(c, d)));
+	}
+
+	pack_uv_nv12_c(uv + x, in + x * 4, width - x);
+}
+
+/* writes 16 uyvx pixels from 16 luma bytes and 8 interleaved uv pairs */
+TARGET_SSSE3
+static inline void merge_16_ssse3(uint8_t* out, __m128i y16, __m128i uv8)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i y_lo = _mm_unpacklo_epi8(y16, zero);
+	__m128i y_hi = _mm_unpackhi_epi8(y16, zero);
+	__m128i uv_lo = _mm_unpacklo_epi16(uv8, uv8);
+	__m128i uv_hi = _mm_unpackhi_epi16(uv8, uv8);
+	__m128i* dst = (__m128i*)out;
+
+	_mm_storeu_si128(dst, _mm_unpacklo_epi8(uv_lo, y_lo));
+	_mm_storeu_si128(dst + 1, _mm_unpackhi_epi8(uv_lo, y_lo));
+	_mm_storeu_si128(dst + 2, _mm_unpacklo_epi8(uv_hi, y_hi));
+	_mm_storeu_si128(dst + 3, _mm_unpackhi_epi8(uv_hi, y_hi));
+}
+
+TARGET_SSSE3
+static void merge_nv12_ssse3(uint8_t* out, const uint8_t* y,
+	const uint8_t* uv, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16)
+		merge_16_ssse3(out + x * 4,
+			_mm_loadu_si128((const __m128i*)(y + x)),
+			_mm_loadu_si128((const __m128i*)(uv + x)));
+
+	merge_nv12_c(out + x * 4, y + x, uv + x, width - x);
+}
+
+TARGET_SSSE3
+static void merge_420_ssse3(uint8_t* out, const uint8_t* y,
+	const uint8_t* u, const uint8_t* v, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i u8 = _mm_loadl_epi64((const __m128i*)(u + x / 2));
+		__m128i v8 = _mm_loadl_epi64((const __m128i*)(v + x / 2));
+
+		merge_16_ssse3(out + x * 4,
+			_mm_loadu_si128((const __m128i*)(y + x)),
+			_mm_unpacklo_epi8(u8, v8));
+	}
+
+	merge_420_c(out + x * 4, y + x, u + x / 2, v + x / 2, width - x);
+}
+
+TARGET_SSSE3
+static void merge_422_ssse3(uint8_t* out, const uint8_t* in, uint32_t width,
+	bool leading_lum)
+{
+	const __m128i expand = leading_lum ? _mm_setr_epi8(EXPAND_YUYV)
+					   : _mm_setr_epi8(EXPAND_UYVY);
+	uint32_t x = 0;
+
+	for (; x + 8 <= width; x += 8) {
+		__m128i pairs = _mm_loadu_si128((const __m128i*)(in + x * 2));
+		__m128i* dst = (__m128i*)(out + x * 4);
+
+		_mm_storeu_si128(dst, _mm_shuffle_epi8(pairs, expand));
+		_mm_storeu_si128(dst + 1, _mm_shuffle_epi8(
+			_mm_srli_si128(pairs, 8), expand));
+	}
+
+	merge_422_c(out + x * 4, in + x * 2, width - x, leading_lum);
+}
+
+/* the AVX2 kernels work in-lane and then fix up the lane order */
+TARGET_AVX2
+static inline void split_32_avx2(const uint8_t* in, __m256i* u, __m256i* y,
+	__m256i* v)
+{
+	const __m256i group = _mm256_setr_epi8(GROUP_PLANES, GROUP_PLANES);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256i* src = (const __m256i*)in;
+	__m256i a, b, c, d, ab_lo, ab_hi, cd_lo, cd_hi;
+
+	a = _mm256_shuffle_epi8(_mm256_loadu_si256(src), group);
+	b = _mm256_shuffle_epi8(_mm256_loadu_si256(src + 1), group);
+	c = _mm256_shuffle_epi8(_mm256_loadu_si256(src + 2), group);
+	d = _mm256_shuffle_epi8(_mm256_loadu_si256(src + 3), group);
+
+	ab_lo = _mm256_unpacklo_epi32(a, b);
+	ab_hi = _mm256_unpackhi_epi32(a, b);
+	cd_lo = _mm256_unpacklo_epi32(c, d);
+	cd_hi = _mm256_unpackhi_epi32(c, d);
+
+	*u = _mm256_permutevar8x32_epi32(
+		_mm256_unpacklo_epi64(ab_lo, cd_lo), order);
+	*y = _mm256_permutevar8x32_epi32(
+		_mm256_unpackhi_epi64(ab_lo, cd_lo), order);
+	*v = _mm256_permutevar8x32_epi32(
+		_mm256_unpacklo_epi64(ab_hi, cd_hi), order);
+}
+
+TARGET_AVX2
+static void pack_y_avx2(uint8_t* y, const uint8_t* in, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m256i u32, y32, v32;
+		split_32_avx2(in + x * 4, &u32, &y32, &v32);
+		_mm256_storeu_si256((__m256i*)(y + x), y32);
+	}
+
+	pack_y_ssse3(y + x, in + x * 4, width - x);
+}
+
+TARGET_AVX2
+static void split_444_avx2(uint8_t* y, uint8_t* u, uint8_t* v,
+	const uint8_t* in, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m256i u32, y32, v32;
+		split_32_avx2(in + x * 4, &u32, &y32, &v32);
+		_mm256_storeu_si256((__m256i*)(y + x), y32);
+		_mm256_storeu_si256((__m256i*)(u + x), u32);
+		_mm256_storeu_si256((__m256i*)(v + x), v32);
+	}
+
+	split_444_ssse3(y + x, u + x, v + x, in + x * 4, width - x);
+}
+
+/* writes 32 uyvx pixels from 32 luma bytes and 16 interleaved uv pairs */
+TARGET_AVX2
+static inline void merge_32_avx2(uint8_t* out, __m256i y32, __m256i uv16)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i y_lo, y_hi, uv_lo, uv_hi, lo, hi;
+	__m256i* dst = (__m256i*)out;
+
+	/* after this, in-lane unpacks produce pixels in order */
+	y32 = _mm256_permute4x64_epi64(y32, _MM_SHUFFLE(3, 1, 2, 0));
+	uv16 = _mm256_permute4x64_epi64(uv16, _MM_SHUFFLE(3, 1, 2, 0));
+
+	y_lo = _mm256_unpacklo_epi8(y32, zero);
+	y_hi = _mm256_unpackhi_epi8(y32, zero);
+	uv_lo = _mm256_unpacklo_epi16(uv16, uv16);
+	uv_hi = _mm256_unpackhi_epi16(uv16, uv16);
+
+	lo = _mm256_unpacklo_epi8(uv_lo, y_lo);
+	hi = _mm256_unpackhi_epi8(uv_lo, y_lo);
+	_mm256_storeu_si256(dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+
+	lo = _mm256_unpacklo_epi8(uv_hi, y_hi);
+	hi = _mm256_unpackhi_epi8(uv_hi, y_hi);
+	_mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+TARGET_AVX2
+static void merge_nv12_avx2(uint8_t* out, const uint8_t* y,
+	const uint8_t* uv, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 32 <= width; x += 32)
+		merge_32_avx2(out + x * 4,
+			_mm256_loadu_si256((const __m256i*)(y + x)),
+			_mm256_loadu_si256((const __m256i*)(uv + x)));
+
+	merge_nv12_ssse3(out + x * 4, y + x, uv + x, width - x);
+}
+
+TARGET_AVX2
+static void merge_420_avx2(uint8_t* out, const uint8_t* y,
+	const uint8_t* u, const uint8_t* v, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m128i u16 = _mm_loadu_si128((const __m128i*)(u + x / 2));
+		__m128i v16 = _mm_loadu_si128((const __m128i*)(v + x / 2));
+		__m256i uv16 = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_unpacklo_epi8(u16, v16)),
+			_mm_unpackhi_epi8(u16, v16), 1);
+
+		merge_32_avx2(out + x * 4,
+			_mm256_loadu_si256((const __m256i*)(y + x)), uv16);
+	}
+
+	merge_420_ssse3(out + x * 4, y + x, u + x / 2, v + x / 2, width - x);
+}
+
+TARGET_AVX2
+static void merge_422_avx2(uint8_t* out, const uint8_t* in, uint32_t width,
+	bool leading_lum)
+{
+	const __m256i expand =
+		leading_lum ? _mm256_setr_epi8(EXPAND_YUYV, EXPAND_YUYV)
+			    : _mm256_setr_epi8(EXPAND_UYVY, EXPAND_UYVY);
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m256i pairs = _mm256_permute4x64_epi64(
+			_mm256_loadu_si256((const __m256i*)(in + x * 2)),
+			_MM_SHUFFLE(3, 1, 2, 0));
+		__m256i* dst = (__m256i*)(out + x * 4);
+
+		_mm256_storeu_si256(dst, _mm256_shuffle_epi8(pairs, expand));
+		_mm256_storeu_si256(dst + 1, _mm256_shuffle_epi8(
+			_mm256_srli_si256(pairs, 8), expand));
+	}
+
+	merge_422_ssse3(out + x * 4, in + x * 2, width - x, leading_lum);
+}
+
+static const struct conversion_kernels kernels_ssse3 = {
+	"SSSE3", pack_y_ssse3, pack_uv_ssse3, pack_uv_nv12_ssse3,
+	split_444_ssse3, merge_nv12_ssse3, merge_420_ssse3, merge_422_ssse3
+};
+
+/* chroma subsampling is a quarter of the work and gains nothing from the
+ * wider registers, so the SSSE3 versions are used for it */
+static const struct conversion_kernels kernels_avx2 = {
+	"AVX2", pack_y_avx2, pack_uv_ssse3, pack_uv_nv12_ssse3,
+	split_444_avx2, merge_nv12_avx2, merge_420_avx2, merge_422_avx2
+};
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* NEON kernels */
+
+#ifdef CONVERSION_NEON
+static void pack_y_neon(uint8_t* y, const uint8_t* in, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16)
+		vst1q_u8(y + x, vld4q_u8(in + x * 4).val[1]);
+
+	pack_y_c(y + x, in + x * 4, width - x);
+}
+
+static void split_444_neon(uint8_t* y, uint8_t* u, uint8_t* v,
+	const uint8_t* in, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t px = vld4q_u8(in + x * 4);
+		vst1q_u8(u + x, px.val[0]);
+		vst1q_u8(y + x, px.val[1]);
+		vst1q_u8(v + x, px.val[2]);
+	}
+
+	split_444_c(y + x, u + x, v + x, in + x * 4, width - x);
+}
+
+/* even-indexed bytes of a register */
+static inline uint8x8_t even_bytes(uint8x16_t val)
+{
+	return vmovn_u16(vreinterpretq_u16_u8(val));
+}
+
+static void pack_uv_neon(uint8_t* u, uint8_t* v, const uint8_t* in,
+	uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t px = vld4q_u8(in + x * 4);
+		vst1_u8(u + x / 2, even_bytes(px.val[0]));
+		vst1_u8(v + x / 2, even_bytes(px.val[2]));
+	}
+
+	pack_uv_c(u + x / 2, v + x / 2, in + x * 4, width - x);
+}
+
+static void pack_uv_nv12_neon(uint8_t* uv, const uint8_t* in,
+	uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t px = vld4q_u8(in + x * 4);
+		uint8x8x2_t out;
+
+		out.val[0] = even_bytes(px.val[0]);
+		out.val[1] = even_bytes(px.val[2]);
+		vst2_u8(uv + x, out);
+	}
+
+	pack_uv_nv12_c(uv + x, in + x * 4, width - x);
+}
+
+static inline void merge_16_neon(uint8_t* out, uint8x16_t y16, uint8x8_t u8,
+	uint8x8_t v8)
+{
+	uint8x16x4_t px;
+
+	px.val[0] = vcombine_u8(vzip_u8(u8, u8).val[0], vzip_u8(u8, u8).val[1]);
+	px.val[1] = y16;
+	px.val[2] = vcombine_u8(vzip_u8(v8, v8).val[0], vzip_u8(v8, v8).val[1]);
+	px.val[3] = vdupq_n_u8(0);
+	vst4q_u8(out, px);
+}
+
+static void merge_nv12_neon(uint8_t* out, const uint8_t* y,
+	const uint8_t* uv, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x8x2_t chroma = vld2_u8(uv + x);
+		merge_16_neon(out + x * 4, vld1q_u8(y + x), chroma.val[0],
+			chroma.val[1]);
+	}
+
+	merge_nv12_c(out + x * 4, y + x, uv + x, width - x);
+}
+
+static void merge_420_neon(uint8_t* out, const uint8_t* y,
+	const uint8_t* u, const uint8_t* v, uint32_t width)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16)
+		merge_16_neon(out + x * 4, vld1q_u8(y + x),
+			vld1_u8(u + x / 2), vld1_u8(v + x / 2));
+
+	merge_420_c(out + x * 4, y + x, u + x / 2, v + x / 2, width - x);
+}
+
+static void merge_422_neon(uint8_t* out, const uint8_t* in, uint32_t width,
+	bool leading_lum)
+{
+	const int lum = leading_lum ? 0 : 1;
+	const int chroma = leading_lum ? 1 : 0;
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x8x4_t pairs = vld4_u8(in + x * 2);
+		uint8x8x2_t y = vzip_u8(pairs.val[lum], pairs.val[lum + 2]);
+
+		merge_16_neon(out + x * 4, vcombine_u8(y.val[0], y.val[1]),
+			pairs.val[chroma], pairs.val[chroma + 2]);
+	}
+
+	merge_422_c(out + x * 4, in + x * 2, width - x, leading_lum);
+}
+
+static const struct conversion_kernels kernels_neon = {
+	"NEON", pack_y_neon, pack_uv_neon, pack_uv_nv12_neon,
+	split_444_neon, merge_nv12_neon, merge_420_neon, merge_422_neon
+};
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static const struct conversion_kernels* select_kernels(void)
+{
+	uint32_t features = os_get_cpu_features();
+
+#if defined(CONVERSION_X86)
+	if (features & OS_CPU_AVX2)
+		return &kernels_avx2;
+	if (features & OS_CPU_SSSE3)
+		return &kernels_ssse3;
+#elif defined(CONVERSION_NEON)
+	if (features & OS_CPU_NEON)
+		return &kernels_neon;
+#endif
+
+	UNUSED_PARAMETER(features);
+	return &kernels_c;
+}
+
+static const struct conversion_kernels* get_kernels(void)
+{
+	/* every thread selects the same table, so racing here is harmless */
+	static const struct conversion_kernels* volatile kernels = NULL;
+	const struct conversion_kernels* cur = kernels;
+
+	if (!cur) {
+		cur = select_kernels();
+		kernels = cur;
+		blog(LOG_DEBUG, "format-conversion: using %s kernels",
+			cur->name);
+	}
+
+	return cur;
+}
+
+static inline uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void compress_uyvx_to_i420(const uint8_t* input, uint32_t in_linesize,
+	uint32_t start_y, uint32_t end_y,
+	uint8_t* output[],
+	const uint32_t out_linesize[])
+{
+	const struct conversion_kernels* k = get_kernels();
+	uint32_t width = min_uint32(in_linesize / 4, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		const uint8_t* row = input + (size_t)y * in_linesize;
+
+		k->pack_y(output[0] + (size_t)y * out_linesize[0], row, width);
+
+		if ((y & 1) == 0)
+			k->pack_uv(output[1] + (size_t)(y / 2) * out_linesize[1],
+				output[2] + (size_t)(y / 2) * out_linesize[2],
+				row, width);
+	}
+}
+
+void compress_uyvx_to_nv12(const uint8_t* input, uint32_t in_linesize,
+	uint32_t start_y, uint32_t end_y,
+	uint8_t* output[],
+	const uint32_t out_linesize[])
+{
+	const struct conversion_kernels* k = get_kernels();
+	uint32_t width = min_uint32(in_linesize / 4, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		const uint8_t* row = input + (size_t)y * in_linesize;
+
+		k->pack_y(output[0] + (size_t)y * out_linesize[0], row, width);
+
+		if ((y & 1) == 0)
+			k->pack_uv_nv12(
+				output[1] + (size_t)(y / 2) * out_linesize[1],
+				row, width);
+	}
+}
+
+void convert_uyvx_to_i444(const uint8_t* input, uint32_t in_linesize,
+	uint32_t start_y, uint32_t end_y,
+	uint8_t* output[],
+	const uint32_t out_linesize[])
+{
+	const struct conversion_kernels* k = get_kernels();
+	uint32_t width = min_uint32(in_linesize / 4, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y++)
+		k->split_444(output[0] + (size_t)y * out_linesize[0],
+			output[1] + (size_t)y * out_linesize[1],
+			output[2] + (size_t)y * out_linesize[2],
+			input + (size_t)y * in_linesize, width);
+}
+
+void decompress_nv12(const uint8_t* const input[],
+	const uint32_t in_linesize[], uint32_t start_y,
+	uint32_t end_y, uint8_t* output,
+	uint32_t out_linesize)
+{
+	const struct conversion_kernels* k = get_kernels();
+	uint32_t width = min_uint32(out_linesize / 4, in_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y++)
+		k->merge_nv12(output + (size_t)y * out_linesize,
+			input[0] + (size_t)y * in_linesize[0],
+			input[1] + (size_t)(y / 2) * in_linesize[1], width);
+}
+
+void decompress_420(const uint8_t* const input[],
+	const uint32_t in_linesize[], uint32_t start_y,
+	uint32_t end_y, uint8_t* output,
+	uint32_t out_linesize)
+{
+	const struct conversion_kernels* k = get_kernels();
+	uint32_t width = min_uint32(out_linesize / 4, in_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y++)
+		k->merge_420(output + (size_t)y * out_linesize,
+			input[0] + (size_t)y * in_linesize[0],
+			input[1] + (size_t)(y / 2) * in_linesize[1],
+			input[2] + (size_t)(y / 2) * in_linesize[2], width);
+}
+
+void decompress_422(const uint8_t* input, uint32_t in_linesize,
+	uint32_t start_y, uint32_t end_y, uint8_t* output,
+	uint32_t out_linesize, bool leading_lum)
+{
+	const struct conversion_kernels* k = get_kernels();
+	uint32_t width = min_uint32(out_linesize / 4, in_linesize / 2);
+
+	for (uint32_t y = start_y; y < end_y; y++)
+		k->merge_422(output + (size_t)y * out_linesize,
+			input + (size_t)y * in_linesize, width, leading_lum);
+}
@@ -0,0 +1,330 @@
+#include <inttypes.h>
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "video-buffer.h"
+
+/* pools without users that are kept for reuse, oldest are freed first */
+#define MAX_IDLE_POOLS 2
+
+struct video_buffer_pool {
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+	enum video_buffer_pages pages;
+
+	size_t size;
+	uint32_t linesize[MAX_AV_PLANES];
+	size_t offsets[MAX_AV_PLANES];
+
+	/* the free list has its own lock so that frames of one pool never
+	 * wait on another pool or on pools_mutex */
+	pthread_mutex_t mutex;
+	DARRAY(struct video_frame_buffer*) free_buffers;
+	size_t num_buffers;
+
+	/* held by every user and by every buffer currently out of the pool.
+	 * it only reaches or leaves 0 with pools_mutex held. */
+	volatile long refs;
+	uint64_t idle_seq; /* protected by pools_mutex */
+};
+
+static pthread_mutex_t pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct video_buffer_pool*) pools;
+static uint64_t idle_counter = 0;
+
+static inline enum os_page_type get_page_type(enum video_buffer_pages pages)
+{
+	switch (pages) {
+	case VIDEO_BUFFER_PAGES_DEFAULT:
+		return OS_PAGES_NORMAL;
+	case VIDEO_BUFFER_PAGES_HUGE:
+		return OS_PAGES_HUGE;
+	case VIDEO_BUFFER_PAGES_HUGE_EXPLICIT:
+		return OS_PAGES_HUGE_EXPLICIT;
+	}
+
+	return OS_PAGES_NORMAL;
+}
+
+static struct video_frame_buffer*
+buffer_create(struct video_buffer_pool* pool)
+{
+	struct video_frame_buffer* buffer;
+	size_t size = pool->size;
+	uint8_t* data;
+
+	data = os_alloc_pages(&size, get_page_type(pool->pages));
+	if (!data) {
+		blog(LOG_ERROR, "video-io: Failed to allocate %" PRIu64
+			" byte frame buffer", (uint64_t)pool->size);
+		return NULL;
+	}
+
+	/* fault the pages in now rather than on the first frame */
+	os_prefault_pages(data, size);
+
+	buffer = bzalloc(sizeof(*buffer));
+	buffer->pool = pool;
+	buffer->alloc_size = size;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (!pool->linesize[i])
+			break;
+		buffer->frame.data[i] = data + pool->offsets[i];
+		buffer->frame.linesize[i] = pool->linesize[i];
+	}
+
+	return buffer;
+}
+
+static inline void buffer_destroy(struct video_frame_buffer* buffer)
+{
+	os_free_pages(buffer->frame.data[0], buffer->alloc_size);
+	bfree(buffer);
+}
+
+static void pool_destroy(struct video_buffer_pool* pool)
+{
+	for (size_t i = 0; i < pool->free_buffers.num; i++)
+		buffer_destroy(pool->free_buffers.array[i]);
+
+	da_free(pool->free_buffers);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool);
+}
+
+/* frees the oldest idle pools past the limit.  pools_mutex must be held. */
+static void trim_idle_pools(size_t max_idle)
+{
+	for (;;) {
+		struct video_buffer_pool* oldest = NULL;
+		size_t oldest_idx = 0;
+		size_t idle = 0;
+
+		for (size_t i = 0; i < pools.num; i++) {
+			struct video_buffer_pool* pool = pools.array[i];
+			if (os_atomic_load_long(&pool->refs))
+				continue;
+
+			if (!oldest || pool->idle_seq < oldest->idle_seq) {
+				oldest = pool;
+				oldest_idx = i;
+			}
+			idle++;
+		}
+
+		if (idle <= max_idle)
+			break;
+
+		da_erase(pools, oldest_idx);
+		pool_destroy(oldest);
+	}
+}
+
+/* only the last reference takes pools_mutex, the others are dropped
+ * without touching any lock */
+static void pool_unref(struct video_buffer_pool* pool)
+{
+	for (;;) {
+		long refs = os_atomic_load_long(&pool->refs);
+		if (refs <= 1)
+			break;
+		if (os_atomic_compare_swap_long(&pool->refs, refs, refs - 1))
+			return;
+	}
+
+	pthread_mutex_lock(&pools_mutex);
+	if (os_atomic_dec_long(&pool->refs) == 0) {
+		pool->idle_seq = ++idle_counter;
+		trim_idle_pools(MAX_IDLE_POOLS);
+	}
+	pthread_mutex_unlock(&pools_mutex);
+}
+
+static inline void pool_push_free(struct video_buffer_pool* pool,
+	struct video_frame_buffer* buffer)
+{
+	pthread_mutex_lock(&pool->mutex);
+	da_push_back(pool->free_buffers, &buffer);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/* tops the pool up to reserve buffers.  the buffers are allocated and
+ * prefaulted outside of any lock so other pools keep running meanwhile. */
+static void pool_reserve(struct video_buffer_pool* pool, size_t reserve)
+{
+	for (;;) {
+		struct video_frame_buffer* buffer;
+		bool enough;
+
+		pthread_mutex_lock(&pool->mutex);
+		enough = pool->num_buffers >= reserve;
+		if (!enough)
+			pool->num_buffers++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (enough)
+			return;
+
+		buffer = buffer_create(pool);
+		if (!buffer) {
+			pthread_mutex_lock(&pool->mutex);
+			pool->num_buffers--;
+			pthread_mutex_unlock(&pool->mutex);
+			return;
+		}
+
+		pool_push_free(pool, buffer);
+	}
+}
+
+static struct video_buffer_pool* pool_create(enum video_format format,
+	uint32_t width, uint32_t height, enum video_buffer_pages pages)
+{
+	struct video_buffer_pool* pool = bzalloc(sizeof(*pool));
+
+	pthread_mutex_init_value(&pool->mutex);
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	pool->format = format;
+	pool->width = width;
+	pool->height = height;
+	pool->pages = pages;
+	pool->size = video_frame_get_layout(format, width, height,
+		pool->linesize, pool->offsets);
+	return pool;
+}
+
+static struct video_buffer_pool* find_pool(enum video_format format,
+	uint32_t width, uint32_t height, enum video_buffer_pages pages)
+{
+	for (size_t i = 0; i < pools.num; i++) {
+		struct video_buffer_pool* pool = pools.array[i];
+		if (pool->format == format && pool->width == width &&
+			pool->height == height && pool->pages == pages)
+			return pool;
+	}
+
+	return NULL;
+}
+
+struct video_buffer_pool* video_buffer_pool_get(enum video_format format,
+	uint32_t width, uint32_t height, enum video_buffer_pages pages,
+	size_t reserve)
+{
+	struct video_buffer_pool* pool;
+
+	pthread_mutex_lock(&pools_mutex);
+
+	pool = find_pool(format, width, height, pages);
+	if (!pool) {
+		pool = pool_create(format, width, height, pages);
+		if (pool)
+			da_push_back(pools, &pool);
+	}
+	if (pool)
+		os_atomic_inc_long(&pool->refs);
+
+	pthread_mutex_unlock(&pools_mutex);
+
+	/* the reference keeps the pool alive, so the reserve can be
+	 * allocated here once rather than frame by frame on acquire */
+	if (pool)
+		pool_reserve(pool, reserve);
+	return pool;
+}
+
+void video_buffer_pool_release(struct video_buffer_pool* pool)
+{
+	if (pool)
+		pool_unref(pool);
+}
+
+struct video_frame_buffer*
+video_buffer_pool_acquire(struct video_buffer_pool* pool)
+{
+	struct video_frame_buffer* buffer = NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->free_buffers.num) {
+		buffer = pool->free_buffers.array[pool->free_buffers.num - 1];
+		da_pop_back(pool->free_buffers);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	/* the caller holds a reference, so this never revives an idle pool */
+	os_atomic_inc_long(&pool->refs);
+
+	if (!buffer) {
+		/* only when more frames are out than the users reserved */
+		buffer = buffer_create(pool);
+		if (!buffer) {
+			pool_unref(pool);
+			return NULL;
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->num_buffers++;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	buffer->refs = 1;
+	return buffer;
+}
+
+struct video_frame_buffer* video_frame_buffer_create_external(
+	const struct video_data* data, void (*release)(void* param),
+	void* param)
+{
+	struct video_frame_buffer* buffer = bzalloc(sizeof(*buffer));
+
+	memcpy(buffer->frame.data, data->data, sizeof(buffer->frame.data));
+	memcpy(buffer->frame.linesize, data->linesize,
+		sizeof(buffer->frame.linesize));
+	buffer->refs = 1;
+	buffer->release = release;
+	buffer->param = param;
+	return buffer;
+}
+
+void video_frame_buffer_release(video_frame_buffer_t* buffer)
+{
+	struct video_buffer_pool* pool;
+
+	if (!buffer || os_atomic_dec_long(&buffer->refs) != 0)
+		return;
+
+	pool = buffer->pool;
+	if (!pool) {
+		if (buffer->release)
+			buffer->release(buffer->param);
+		bfree(buffer);
+		return;
+	}
+
+	pool_push_free(pool, buffer);
+	pool_unref(pool);
+}
+
+video_frame_buffer_t* video_data_retain(const struct video_data* frame)
+{
+	if (!frame || !frame->buffer)
+		return NULL;
+
+	os_atomic_inc_long(&frame->buffer->refs);
+	return frame->buffer;
+}
+
+void video_output_free_unused_buffers(void)
+{
+	pthread_mutex_lock(&pools_mutex);
+	trim_idle_pools(0);
+	if (!pools.num)
+		da_free(pools);
+	pthread_mutex_unlock(&pools_mutex);
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+	Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "video-io.h"
+#include "video-frame.h"
+
+/*
+ * Reference counted frame memory used internally by video-io.
+ *
+ * Pooled buffers go back to their pool when the last reference is released,
+ * external ones are handed back to their owner through the release callback.
+ * Pools are shared by format, size and page type, and a few pools that no
+ * longer have users are kept around so that resetting video reuses the
+ * already faulted-in buffers instead of allocating them again.
+ */
+
+struct video_buffer_pool;
+
+struct video_frame_buffer {
+	struct video_frame frame;
+	volatile long refs;
+	struct video_buffer_pool* pool;
+	size_t alloc_size;
+
+	void (*release)(void* param);
+	void* param;
+};
+
+/* returns a reference to the pool for the given frame type, making sure it
+ * holds at least reserve preallocated, prefaulted buffers */
+extern struct video_buffer_pool* video_buffer_pool_get(
+	enum video_format format, uint32_t width, uint32_t height,
+	enum video_buffer_pages pages, size_t reserve);
+extern void video_buffer_pool_release(struct video_buffer_pool* pool);
+
+/* returns a buffer with one reference, allocating one if none are free */
+extern struct video_frame_buffer* video_buffer_pool_acquire(
+	struct video_buffer_pool* pool);
+
+/* wraps caller-owned memory, release is called once the last reference is
+ * released */
+extern struct video_frame_buffer* video_frame_buffer_create_external(
+	const struct video_data* data, void (*release)(void* param),
+	void* param);
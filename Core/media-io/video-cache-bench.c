@@ -0,0 +1,315 @@
+/*
+ * Standalone benchmark of the frame cache of video-io.c: a producer thread
+ * hands FRAME_COUNT frames to a consumer thread, once through the
+ * single-producer/single-consumer ring of video_output and once through a
+ * copy of the data_mutex based cache it replaced.  Frames locked while the
+ * cache is full are repeats of the newest frame, like with video_output.
+ * Reports the new frames handed over per second and the average and worst
+ * time from locking a new frame to the video thread taking it.
+ *
+ * Only the cache bookkeeping is measured: frames carry no buffers and there
+ * are no inputs, so each frame costs what the video thread pays per frame
+ * before converting anything.  It includes video-io.c to get at the ring,
+ * so it only needs libobs, e.g.:
+ *
+ *   cc -O2 -I.. video-cache-bench.c -lobs -lpthread -o video-cache-bench
+ *
+ * Pass the cache size as the first argument, 4 by default.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "video-io.c"
+
+#define FRAME_COUNT 1000000
+
+struct handoff_stats {
+	uint64_t delivered;
+	uint64_t repeated;
+	uint64_t latency_total;
+	uint64_t latency_max;
+};
+
+/* only the first delivery of a frame counts, the lock time is cleared so
+ * that repeats of it are skipped */
+static inline void add_latency(struct handoff_stats* stats,
+	uint64_t* locked)
+{
+	uint64_t latency;
+
+	if (!*locked)
+		return;
+
+	latency = os_gettime_ns() - *locked;
+	*locked = 0;
+
+	stats->latency_total += latency;
+	if (latency > stats->latency_max)
+		stats->latency_max = latency;
+	stats->delivered++;
+}
+
+/* ------------------------------------------------------------------------- */
+/* the cache as it was, every access under the recursive data_mutex */
+
+struct mutex_cache {
+	pthread_mutex_t data_mutex;
+	pthread_mutex_t input_mutex;
+	os_sem_t* update_semaphore;
+	volatile bool stop;
+
+	struct {
+		uint64_t timestamp;
+		int count;
+		int skipped;
+	} cache[MAX_CACHE_SIZE];
+	size_t cache_size;
+	size_t available_frames;
+	size_t first_added;
+	size_t last_added;
+
+	struct handoff_stats stats;
+};
+
+static bool mutex_cache_lock(struct mutex_cache* mc, uint64_t timestamp)
+{
+	bool locked;
+
+	pthread_mutex_lock(&mc->data_mutex);
+
+	if (mc->available_frames == 0) {
+		mc->cache[mc->last_added].count++;
+		mc->cache[mc->last_added].skipped++;
+		locked = false;
+	} else {
+		if (mc->available_frames != mc->cache_size) {
+			if (++mc->last_added == mc->cache_size)
+				mc->last_added = 0;
+		}
+
+		mc->cache[mc->last_added].timestamp = timestamp;
+		mc->cache[mc->last_added].count = 1;
+		mc->cache[mc->last_added].skipped = 0;
+		locked = true;
+	}
+
+	pthread_mutex_unlock(&mc->data_mutex);
+	return locked;
+}
+
+static void mutex_cache_unlock(struct mutex_cache* mc)
+{
+	pthread_mutex_lock(&mc->data_mutex);
+	mc->available_frames--;
+	os_sem_post(mc->update_semaphore);
+	pthread_mutex_unlock(&mc->data_mutex);
+}
+
+static bool mutex_cache_cur_frame(struct mutex_cache* mc)
+{
+	size_t idx;
+	bool complete;
+
+	pthread_mutex_lock(&mc->data_mutex);
+	idx = mc->first_added;
+	pthread_mutex_unlock(&mc->data_mutex);
+
+	/* where the inputs would get the frame */
+	pthread_mutex_lock(&mc->input_mutex);
+	add_latency(&mc->stats, &mc->cache[idx].timestamp);
+	pthread_mutex_unlock(&mc->input_mutex);
+
+	pthread_mutex_lock(&mc->data_mutex);
+
+	complete = --mc->cache[idx].count == 0;
+	if (complete) {
+		if (++mc->first_added == mc->cache_size)
+			mc->first_added = 0;
+		if (++mc->available_frames == mc->cache_size)
+			mc->last_added = mc->first_added;
+	} else if (mc->cache[idx].skipped > 0) {
+		--mc->cache[idx].skipped;
+	}
+
+	pthread_mutex_unlock(&mc->data_mutex);
+	return complete;
+}
+
+static void* mutex_cache_thread(void* param)
+{
+	struct mutex_cache* mc = param;
+
+	while (os_sem_wait(mc->update_semaphore) == 0) {
+		if (mc->stop)
+			break;
+
+		while (!mc->stop && !mutex_cache_cur_frame(mc))
+			;
+	}
+
+	return NULL;
+}
+
+static bool mutex_cache_drained(struct mutex_cache* mc)
+{
+	bool drained;
+
+	pthread_mutex_lock(&mc->data_mutex);
+	drained = mc->available_frames == mc->cache_size;
+	pthread_mutex_unlock(&mc->data_mutex);
+	return drained;
+}
+
+static void run_mutex_cache(size_t cache_size, struct handoff_stats* stats)
+{
+	struct mutex_cache* mc = bzalloc(sizeof(struct mutex_cache));
+	pthread_mutexattr_t attr;
+	pthread_t thread;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&mc->data_mutex, &attr);
+	pthread_mutex_init(&mc->input_mutex, &attr);
+	os_sem_init(&mc->update_semaphore, 0);
+
+	mc->cache_size = cache_size;
+	mc->available_frames = cache_size;
+	pthread_create(&thread, NULL, mutex_cache_thread, mc);
+
+	for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+		if (mutex_cache_lock(mc, os_gettime_ns()))
+			mutex_cache_unlock(mc);
+		else
+			stats->repeated++;
+	}
+
+	while (!mutex_cache_drained(mc))
+		os_sleep_ms(1);
+
+	mc->stop = true;
+	os_sem_post(mc->update_semaphore);
+	pthread_join(thread, NULL);
+
+	stats->delivered = mc->stats.delivered;
+	stats->latency_total = mc->stats.latency_total;
+	stats->latency_max = mc->stats.latency_max;
+
+	os_sem_destroy(mc->update_semaphore);
+	pthread_mutex_destroy(&mc->input_mutex);
+	pthread_mutex_destroy(&mc->data_mutex);
+	pthread_mutexattr_destroy(&attr);
+	bfree(mc);
+}
+
+/* ------------------------------------------------------------------------- */
+/* the ring of video_output, driven through its own functions */
+
+struct ring_cache {
+	struct video_output* video;
+	struct handoff_stats stats;
+};
+
+static void* ring_cache_thread(void* param)
+{
+	struct ring_cache* rc = param;
+	struct video_output* video = rc->video;
+
+	while (os_sem_wait(video->update_semaphore) == 0) {
+		if (video->stop)
+			break;
+
+		for (;;) {
+			const long read_idx = video->read_idx;
+			bool complete;
+
+			if (read_idx == os_atomic_load_long_acquire(
+				&video->write_idx))
+				break;
+
+			add_latency(&rc->stats, &video->cache[cache_slot(video,
+				read_idx)].frame.timestamp);
+
+			complete = video_output_cur_frame(video);
+			if (video->stop || complete)
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+static void run_ring_cache(size_t cache_size, struct handoff_stats* stats)
+{
+	struct video_output* video = bzalloc(sizeof(struct video_output));
+	struct ring_cache rc = {video};
+	pthread_mutexattr_t attr;
+	pthread_t thread;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&video->input_mutex, &attr);
+	os_sem_init(&video->update_semaphore, 0);
+
+	video->info.cache_size = cache_size;
+	pthread_create(&thread, NULL, ring_cache_thread, &rc);
+
+	for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+		if (lock_cache_slot(video, 1, os_gettime_ns()))
+			publish_frame(video);
+		else
+			stats->repeated++;
+	}
+
+	while (os_atomic_load_long_acquire(&video->read_idx) !=
+		video->write_idx)
+		os_sleep_ms(1);
+
+	video->stop = true;
+	os_sem_post(video->update_semaphore);
+	pthread_join(thread, NULL);
+
+	stats->delivered = rc.stats.delivered;
+	stats->latency_total = rc.stats.latency_total;
+	stats->latency_max = rc.stats.latency_max;
+
+	os_sem_destroy(video->update_semaphore);
+	pthread_mutex_destroy(&video->input_mutex);
+	pthread_mutexattr_destroy(&attr);
+	bfree(video);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void run_bench(const char* name, size_t cache_size,
+	void (*run)(size_t cache_size, struct handoff_stats* stats))
+{
+	struct handoff_stats stats = {0};
+	uint64_t start = os_gettime_ns();
+	double seconds;
+
+	run(cache_size, &stats);
+	seconds = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+	printf("%-12s %8.3f Mframes/s, %8" PRIu64 " new, %8" PRIu64
+		" repeated, latency avg %7.2f us, max %9.2f us\n",
+		name, (double)stats.delivered / seconds / 1000000.0,
+		stats.delivered, stats.repeated,
+		stats.delivered ? (double)stats.latency_total /
+			(double)stats.delivered / 1000.0 : 0.0,
+		(double)stats.latency_max / 1000.0);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t cache_size = argc > 1 ? strtoul(argv[1], NULL, 10) : 4;
+
+	if (cache_size < 2 || cache_size > MAX_CACHE_SIZE) {
+		printf("cache size must be 2 to %d\n", MAX_CACHE_SIZE);
+		return 1;
+	}
+
+	printf("%d frames, cache size %zu\n", FRAME_COUNT, cache_size);
+	run_bench("data_mutex", cache_size, run_mutex_cache);
+	run_bench("spsc ring", cache_size, run_ring_cache);
+	return 0;
+}
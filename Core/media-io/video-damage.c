@@ -0,0 +1,358 @@
+#include <string.h>
+#include "../util/bmem.h"
+#include "../util/sse-intrin.h"
+#include "video-damage.h"
+
+#define NUM_HASH_KEYS 8
+
+/* keeps the tile counts and plane sizes well within 32 bits */
+#define MAX_SIZE 16384
+
+/*
+ * Tiles are hashed with the 64-bit lane multiply-accumulate of XXH3: every
+ * 16 bytes are mixed with a key depending on their position in the tile
+ * row, and the accumulator is scrambled after each row so that moving rows
+ * around within a tile changes its hash too.  Only SSE2 is needed, which is
+ * available everywhere through sse-intrin.h.
+ */
+
+static const uint64_t hash_keys[NUM_HASH_KEYS * 2] = {
+	0x2CB0F69F4ABEA221ULL, 0x9417034723148989ULL,
+	0xDD555950609DFE03ULL, 0xDBAFB150DEB12800ULL,
+	0x7E789B2E6C442CB6ULL, 0xF41E5636C7E4F8C4ULL,
+	0x0959D150F8FBA7E4ULL, 0xA97316F13CDB9EEAULL,
+	0x74CD8258F9520068ULL, 0x55C74A62E116868BULL,
+	0xD2F4C799A2023CBDULL, 0xDF98CB79A37B51B9ULL,
+	0x396F5885524F3905ULL, 0xAF1D56386CA3B276ULL,
+	0xA9FFBE6B5104E85AULL, 0x6BD0C51B9FD533B3ULL,
+};
+
+struct video_damage {
+	struct video_damage_plane planes[MAX_AV_PLANES];
+	size_t num_planes;
+	size_t frame_size;
+	uint32_t height;
+	uint32_t tile_size;
+	uint32_t cols;
+	uint32_t rows;
+
+	__m128i* acc;
+	uint64_t* hashes;
+	uint8_t* map;
+	bool valid; /* hashes hold the previous frame */
+
+	const struct video_data* frame; /* during an update */
+};
+
+struct plane_layout {
+	struct video_damage_plane* planes;
+	size_t num_planes;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tile_size;
+};
+
+/* planes are described in groups of pixels so that subsampled and packed
+ * 4:2:2 planes line up with the luma tiles */
+static inline void add_plane(struct plane_layout* layout, uint32_t group,
+	uint32_t group_bytes, uint32_t row_shift)
+{
+	struct video_damage_plane* plane =
+		&layout->planes[layout->num_planes++];
+
+	plane->row_bytes = (layout->width + group - 1) / group * group_bytes;
+	plane->rows = (layout->height + (1 << row_shift) - 1) >> row_shift;
+	plane->tile_bytes = layout->tile_size / group * group_bytes;
+	plane->tile_rows = layout->tile_size >> row_shift;
+	plane->pixel_bytes = group_bytes;
+}
+
+static bool add_planes(struct plane_layout* layout, enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I40A:
+		add_plane(layout, 1, 1, 0);
+		add_plane(layout, 2, 1, 1);
+		add_plane(layout, 2, 1, 1);
+		if (format == VIDEO_FORMAT_I40A)
+			add_plane(layout, 1, 1, 0);
+		return true;
+
+	case VIDEO_FORMAT_NV12:
+		add_plane(layout, 1, 1, 0);
+		add_plane(layout, 2, 2, 1);
+		return true;
+
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I42A:
+		add_plane(layout, 1, 1, 0);
+		add_plane(layout, 2, 1, 0);
+		add_plane(layout, 2, 1, 0);
+		if (format == VIDEO_FORMAT_I42A)
+			add_plane(layout, 1, 1, 0);
+		return true;
+
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_YUVA:
+		for (size_t i = 0; i < (format == VIDEO_FORMAT_YUVA ? 4 : 3);
+			i++)
+			add_plane(layout, 1, 1, 0);
+		return true;
+
+	case VIDEO_FORMAT_Y800:
+		add_plane(layout, 1, 1, 0);
+		return true;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		add_plane(layout, 2, 4, 0);
+		return true;
+
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_AYUV:
+		add_plane(layout, 1, 4, 0);
+		return true;
+
+	case VIDEO_FORMAT_BGR3:
+		add_plane(layout, 1, 3, 0);
+		return true;
+
+	case VIDEO_FORMAT_NONE:
+		break;
+	}
+
+	return false;
+}
+
+size_t video_damage_get_layout(enum video_format format, uint32_t width,
+	uint32_t height, uint32_t tile_size,
+	struct video_damage_plane planes[MAX_AV_PLANES])
+{
+	struct plane_layout layout = { planes, 0, width, height, tile_size };
+
+	if (!width || !height || !tile_size || tile_size % 32 != 0)
+		return 0;
+	if (width > MAX_SIZE || height > MAX_SIZE || tile_size > MAX_SIZE)
+		return 0;
+
+	return add_planes(&layout, format) ? layout.num_planes : 0;
+}
+
+video_damage_t* video_damage_create(enum video_format format, uint32_t width,
+	uint32_t height, uint32_t tile_size)
+{
+	struct video_damage_plane planes[MAX_AV_PLANES];
+	struct video_damage* damage;
+	size_t num_planes;
+	size_t num_tiles;
+
+	num_planes = video_damage_get_layout(format, width, height, tile_size,
+		planes);
+	if (!num_planes)
+		return NULL;
+
+	damage = bzalloc(sizeof(struct video_damage));
+	memcpy(damage->planes, planes, sizeof(planes));
+	damage->num_planes = num_planes;
+	damage->height = height;
+	damage->tile_size = tile_size;
+	damage->cols = (width + tile_size - 1) / tile_size;
+	damage->rows = (height + tile_size - 1) / tile_size;
+
+	for (size_t p = 0; p < num_planes; p++)
+		damage->frame_size += (size_t)planes[p].row_bytes *
+			planes[p].rows;
+
+	num_tiles = (size_t)damage->cols * damage->rows;
+	damage->acc = bmalloc(num_tiles * sizeof(__m128i));
+	damage->hashes = bzalloc(num_tiles * sizeof(uint64_t));
+	damage->map = bzalloc(num_tiles);
+	return damage;
+}
+
+void video_damage_destroy(video_damage_t* damage)
+{
+	if (!damage)
+		return;
+
+	bfree(damage->acc);
+	bfree(damage->hashes);
+	bfree(damage->map);
+	bfree(damage);
+}
+
+void video_damage_reset(video_damage_t* damage)
+{
+	if (damage)
+		damage->valid = false;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline __m128i accumulate(__m128i acc, __m128i data, __m128i key)
+{
+	const __m128i data_key = _mm_xor_si128(data, key);
+	const __m128i data_key_hi =
+		_mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+	const __m128i product = _mm_mul_epu32(data_key, data_key_hi);
+	const __m128i data_swap =
+		_mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+	return _mm_add_epi64(acc, _mm_add_epi64(data_swap, product));
+}
+
+static inline __m128i scramble(__m128i acc, __m128i key)
+{
+	const __m128i prime = _mm_set1_epi32((int)0x9E3779B1);
+	__m128i acc_hi;
+
+	acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+	acc = _mm_xor_si128(acc, key);
+	acc_hi = _mm_shuffle_epi32(acc, _MM_SHUFFLE(0, 3, 0, 1));
+
+	return _mm_add_epi64(_mm_mul_epu32(acc, prime),
+		_mm_slli_epi64(_mm_mul_epu32(acc_hi, prime), 32));
+}
+
+static inline __m128i hash_span(__m128i acc, const uint8_t* data,
+	uint32_t size, const __m128i* keys)
+{
+	uint32_t i = 0;
+	uint32_t k = 0;
+
+	for (; i + 16 <= size; i += 16, k++) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+		acc = accumulate(acc, chunk, keys[k % NUM_HASH_KEYS]);
+	}
+
+	if (i < size) {
+		uint8_t tail[16] = { 0 };
+		memcpy(tail, data + i, size - i);
+		acc = accumulate(acc, _mm_loadu_si128((const __m128i*)tail),
+			keys[k % NUM_HASH_KEYS]);
+	}
+
+	return scramble(acc, keys[0]);
+}
+
+static inline uint64_t finalize_hash(__m128i acc)
+{
+	uint64_t lanes[2];
+	uint64_t hi;
+
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	hi = lanes[1] * 0x9E3779B185EBCA87ULL;
+	return lanes[0] ^ ((hi << 31) | (hi >> 33));
+}
+
+static inline uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+static void hash_tile_rows(void* param, uint32_t slice, uint32_t start_y,
+	uint32_t end_y)
+{
+	struct video_damage* damage = param;
+	const struct video_data* frame = damage->frame;
+	const uint32_t first = start_y / damage->tile_size;
+	const uint32_t last = (end_y + damage->tile_size - 1) /
+		damage->tile_size;
+	const uint32_t cols = damage->cols;
+	__m128i keys[NUM_HASH_KEYS];
+
+	for (size_t i = 0; i < NUM_HASH_KEYS; i++)
+		keys[i] = _mm_loadu_si128((const __m128i*)hash_keys + i);
+
+	for (uint32_t ty = first; ty < last; ty++) {
+		__m128i* acc = damage->acc + (size_t)ty * cols;
+		uint64_t* hashes = damage->hashes + (size_t)ty * cols;
+		uint8_t* map = damage->map + (size_t)ty * cols;
+
+		for (uint32_t tx = 0; tx < cols; tx++)
+			acc[tx] = _mm_setzero_si128();
+
+		for (size_t p = 0; p < damage->num_planes; p++) {
+			const struct video_damage_plane* plane =
+				&damage->planes[p];
+			const uint32_t y0 = ty * plane->tile_rows;
+			const uint32_t y1 = min_uint32(y0 + plane->tile_rows,
+				plane->rows);
+
+			for (uint32_t y = y0; y < y1; y++) {
+				const uint8_t* row = frame->data[p] +
+					(size_t)y * frame->linesize[p];
+
+				for (uint32_t tx = 0; tx < cols; tx++) {
+					uint32_t x = tx * plane->tile_bytes;
+					uint32_t size = min_uint32(
+						plane->tile_bytes,
+						plane->row_bytes - x);
+
+					acc[tx] = hash_span(acc[tx], row + x,
+						size, keys);
+				}
+			}
+		}
+
+		for (uint32_t tx = 0; tx < cols; tx++) {
+			uint64_t hash = finalize_hash(acc[tx]);
+
+			map[tx] = !damage->valid || hash != hashes[tx];
+			hashes[tx] = hash;
+		}
+	}
+
+	UNUSED_PARAMETER(slice);
+}
+
+uint32_t video_damage_update(video_damage_t* damage,
+	const struct video_data* frame, video_slice_pool_t* pool)
+{
+	size_t num_tiles;
+	uint32_t changed = 0;
+
+	if (!damage || !frame)
+		return 0;
+
+	num_tiles = (size_t)damage->cols * damage->rows;
+	for (size_t p = 0; p < damage->num_planes; p++) {
+		if (!frame->data[p]) {
+			memset(damage->map, 1, num_tiles);
+			damage->valid = false;
+			return (uint32_t)num_tiles;
+		}
+	}
+
+	damage->frame = frame;
+	video_slice_pool_run(pool, damage->height, damage->tile_size,
+		damage->frame_size, hash_tile_rows, damage);
+	damage->frame = NULL;
+	damage->valid = true;
+
+	for (size_t i = 0; i < num_tiles; i++)
+		changed += damage->map[i];
+	return changed;
+}
+
+const uint8_t* video_damage_get_map(const video_damage_t* damage,
+	uint32_t* cols, uint32_t* rows)
+{
+	if (!damage)
+		return NULL;
+
+	if (cols)
+		*cols = damage->cols;
+	if (rows)
+		*rows = damage->rows;
+	return damage->map;
+}
+
+uint32_t video_damage_get_tile_size(const video_damage_t* damage)
+{
+	return damage ? damage->tile_size : 0;
+}
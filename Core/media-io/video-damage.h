@@ -0,0 +1,80 @@
+/******************************************************************************
+	Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "video-io.h"
+#include "video-slice.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/*
+	 * Detects which parts of a raw frame changed since the previous one.
+	 * The frame is split into square tiles, sized in luma pixels, and the
+	 * rows of every plane that fall into a tile are hashed together.  A
+	 * tile changed if its hash differs from the one of the previous
+	 * update.  Hashing reads each plane once and is split into row slices
+	 * like the frame copies, so it costs a fraction of converting the
+	 * frame.
+	 */
+
+	struct video_damage;
+	typedef struct video_damage video_damage_t;
+
+	/* tile_size must be a multiple of 32, and neither it nor the width
+	 * or height may exceed 16384; returns NULL for formats it cannot
+	 * split into tiles */
+	EXPORT video_damage_t* video_damage_create(enum video_format format,
+		uint32_t width, uint32_t height, uint32_t tile_size);
+	EXPORT void video_damage_destroy(video_damage_t* damage);
+
+	/* makes the next update report every tile as changed */
+	EXPORT void video_damage_reset(video_damage_t* damage);
+
+	/* hashes the frame and returns the number of tiles that changed since
+	 * the previous update.  pool may be NULL. */
+	EXPORT uint32_t video_damage_update(video_damage_t* damage,
+		const struct video_data* frame, video_slice_pool_t* pool);
+
+	/* one byte per tile, row by row, nonzero for tiles that changed in the
+	 * last update */
+	EXPORT const uint8_t* video_damage_get_map(
+		const video_damage_t* damage, uint32_t* cols, uint32_t* rows);
+	EXPORT uint32_t video_damage_get_tile_size(
+		const video_damage_t* damage);
+
+	/* layout of a plane in tiles, tile (x, y) covers rows y * tile_rows
+	 * and bytes x * tile_bytes of each row, clipped to the plane */
+	struct video_damage_plane {
+		uint32_t row_bytes;
+		uint32_t rows;
+		uint32_t tile_bytes;
+		uint32_t tile_rows;
+		uint32_t pixel_bytes; /* distance of horizontal neighbours */
+	};
+
+	/* returns the number of planes, 0 if the format or sizes are not
+	 * supported */
+	EXPORT size_t video_damage_get_layout(enum video_format format,
+		uint32_t width, uint32_t height, uint32_t tile_size,
+		struct video_damage_plane planes[MAX_AV_PLANES]);
+
+#ifdef __cplusplus
+}
+#endif
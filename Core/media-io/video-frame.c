@@ -0,0 +1,163 @@
+#include <string.h>
+#include "../util/bmem.h"
+#include "video-frame.h"
+
+#define ALIGN_SIZE(size, align) (((size) + ((align)-1)) & ~((size_t)(align)-1))
+
+/* fills in the line size and row count of each plane and returns the number
+ * of planes */
+static size_t get_planes(enum video_format format, uint32_t width,
+	uint32_t height, uint32_t linesize[MAX_AV_PLANES],
+	uint32_t rows[MAX_AV_PLANES])
+{
+	const uint32_t half_width = (width + 1) / 2;
+	const uint32_t half_height = (height + 1) / 2;
+
+	memset(linesize, 0, sizeof(uint32_t) * MAX_AV_PLANES);
+	memset(rows, 0, sizeof(uint32_t) * MAX_AV_PLANES);
+
+	switch (format) {
+	case VIDEO_FORMAT_NONE:
+		return 0;
+
+	case VIDEO_FORMAT_I420:
+		linesize[0] = width;
+		linesize[1] = linesize[2] = half_width;
+		rows[0] = height;
+		rows[1] = rows[2] = half_height;
+		return 3;
+
+	case VIDEO_FORMAT_NV12:
+		linesize[0] = width;
+		linesize[1] = half_width * 2;
+		rows[0] = height;
+		rows[1] = half_height;
+		return 2;
+
+	case VIDEO_FORMAT_Y800:
+		linesize[0] = width;
+		rows[0] = height;
+		return 1;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		linesize[0] = half_width * 4;
+		rows[0] = height;
+		return 1;
+
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_AYUV:
+		linesize[0] = width * 4;
+		rows[0] = height;
+		return 1;
+
+	case VIDEO_FORMAT_BGR3:
+		linesize[0] = width * 3;
+		rows[0] = height;
+		return 1;
+
+	case VIDEO_FORMAT_I444:
+		linesize[0] = linesize[1] = linesize[2] = width;
+		rows[0] = rows[1] = rows[2] = height;
+		return 3;
+
+	case VIDEO_FORMAT_I422:
+		linesize[0] = width;
+		linesize[1] = linesize[2] = half_width;
+		rows[0] = rows[1] = rows[2] = height;
+		return 3;
+
+	case VIDEO_FORMAT_I40A:
+		linesize[0] = linesize[3] = width;
+		linesize[1] = linesize[2] = half_width;
+		rows[0] = rows[3] = height;
+		rows[1] = rows[2] = half_height;
+		return 4;
+
+	case VIDEO_FORMAT_I42A:
+		linesize[0] = linesize[3] = width;
+		linesize[1] = linesize[2] = half_width;
+		rows[0] = rows[1] = rows[2] = rows[3] = height;
+		return 4;
+
+	case VIDEO_FORMAT_YUVA:
+		linesize[0] = linesize[1] = linesize[2] = linesize[3] = width;
+		rows[0] = rows[1] = rows[2] = rows[3] = height;
+		return 4;
+	}
+
+	return 0;
+}
+
+size_t video_frame_get_layout(enum video_format format, uint32_t width,
+	uint32_t height, uint32_t linesize[MAX_AV_PLANES],
+	size_t offsets[MAX_AV_PLANES])
+{
+	const size_t alignment = (size_t)base_get_alignment();
+	uint32_t rows[MAX_AV_PLANES];
+	size_t planes;
+	size_t size = 0;
+
+	planes = get_planes(format, width, height, linesize, rows);
+	memset(offsets, 0, sizeof(size_t) * MAX_AV_PLANES);
+
+	for (size_t i = 0; i < planes; i++) {
+		offsets[i] = size;
+		size += (size_t)linesize[i] * rows[i];
+		size = ALIGN_SIZE(size, alignment);
+	}
+
+	return size;
+}
+
+void video_frame_init(struct video_frame* frame, enum video_format format,
+	uint32_t width, uint32_t height)
+{
+	size_t offsets[MAX_AV_PLANES];
+	size_t size;
+
+	if (!frame)
+		return;
+
+	memset(frame, 0, sizeof(struct video_frame));
+
+	size = video_frame_get_layout(format, width, height, frame->linesize,
+		offsets);
+	if (!size)
+		return;
+
+	frame->data[0] = bmalloc(size);
+	for (size_t i = 1; i < MAX_AV_PLANES; i++) {
+		if (frame->linesize[i])
+			frame->data[i] = frame->data[0] + offsets[i];
+	}
+}
+
+void video_frame_copy(struct video_frame* dst, const struct video_frame* src,
+	enum video_format format, uint32_t cy)
+{
+	uint32_t linesize[MAX_AV_PLANES];
+	uint32_t rows[MAX_AV_PLANES];
+	size_t planes = get_planes(format, 0, cy, linesize, rows);
+
+	for (size_t i = 0; i < planes; i++) {
+		const uint32_t dst_linesize = dst->linesize[i];
+		const uint32_t src_linesize = src->linesize[i];
+
+		if (dst_linesize == src_linesize) {
+			memcpy(dst->data[i], src->data[i],
+				(size_t)src_linesize * rows[i]);
+			continue;
+		}
+
+		for (uint32_t y = 0; y < rows[i]; y++) {
+			memcpy(dst->data[i] + (size_t)y * dst_linesize,
+				src->data[i] + (size_t)y * src_linesize,
+				dst_linesize < src_linesize ? dst_linesize
+				: src_linesize);
+		}
+	}
+}
@@ -25,6 +25,12 @@ struct video_frame {
 	uint32_t linesize[MAX_AV_PLANES];
 };
 
+/* computes the plane layout video_frame_init uses for a single allocation:
+ * each plane's line size and byte offset.  returns the total size. */
+EXPORT size_t video_frame_get_layout(enum video_format format,
+	uint32_t width, uint32_t height, uint32_t linesize[MAX_AV_PLANES],
+	size_t offsets[MAX_AV_PLANES]);
+
 EXPORT void video_frame_init(struct video_frame* frame,
 	enum video_format format, uint32_t width,
 	uint32_t height);
@@ -5,29 +5,108 @@
 #include "../util/profiler.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
 #include "../util/util_uint64.h"
 
 #include "format-conversion.h"
 #include "video-io.h"
-#include "video-frame.h"
+#include "video-buffer.h"
 #include "video-scaler.h"
 
 extern profiler_name_store_t* obs_get_profiler_name_store(void);
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_LADDER_LEVELS 8
 
 struct cached_frame_info {
 	struct video_data frame;
-	int skipped;
-	int count;
+	struct video_frame_buffer* buffer; /* NULL while the slot is free */
+	volatile long skipped;
+	volatile long count;
+	bool repeat; /* published by video_output_repeat_frame */
+	bool delivered; /* video thread only */
+};
+
+struct video_input_frame {
+	struct video_data data;
+	uint64_t queued_ts;
+	bool in_use;
+};
+
+/* each input is fed through its own bounded queue and worker thread so that
+ * a slow consumer only ever drops its own frames.  kept in a separate
+ * allocation because the worker must not see the inputs array move. */
+struct video_input_queue {
+	pthread_t thread;
+	bool thread_initialized;
+	os_sem_t* semaphore;
+	pthread_mutex_t mutex;
+	volatile bool stop;
+
+	enum video_input_drop_policy drop_policy;
+	struct video_input_frame frames[MAX_CONVERT_BUFFERS];
+	struct video_buffer_pool* pool; /* NULL when frames are passed through */
+	struct circlebuf queued; /* size_t indices into frames */
+	uint64_t frame_time;
+
+	void (*callback)(void* param, struct video_data* frame);
+	void* param;
+
+	volatile long total_frames;
+	volatile long skipped_frames;
+	volatile long lagged_frames;
+};
+
+/* downscale pyramid shared by the inputs of one ladder.  each level is
+ * scaled from the level above it rather than from the full-size frame, and
+ * converted to its own format in the same pass, which also keeps the
+ * scaled rows in the output's packed RGB format as the source of the next
+ * level.  levels are built on demand while a frame is handed to the inputs
+ * and released once all of them hold their own references.  only used on
+ * the video thread or with input_mutex held. */
+struct video_ladder {
+	long refs;
+	size_t num_levels;
+	size_t built_levels;
+
+	struct video_ladder_step {
+		uint32_t width;
+		uint32_t height;
+		enum video_format format;
+
+		/* NULL if the level is the level above as-is */
+		video_scaler_t* scaler;
+		struct video_buffer_pool* pool;
+		/* NULL if the next level can use frame or the source */
+		struct video_buffer_pool* rgb_pool;
+		bool source_is_rgb;
+
+		struct video_data frame; /* delivered to the level's input */
+		struct video_data rgb;   /* source of the next level */
+	} levels[MAX_LADDER_LEVELS];
 };
 
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t* scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+
+	struct video_ladder* ladder;
+	size_t ladder_level;
+
+	/* inputs that take repeat events get duplicates of the previous
+	 * frame as the frame they last received, without converting it
+	 * again.  last holds a reference, NULL if there is nothing to
+	 * repeat. */
+	bool repeat_events;
+	bool crop_moved;
+	struct video_data last;
+
+	/* source rectangle, the size is fixed once connected but the
+	 * position may change between frames.  protected by input_mutex. */
+	struct video_crop crop;
+	bool cropped;
+	struct video_input_queue* queue;
 
 	void (*callback)(void* param, struct video_data* frame);
 	void* param;
@@ -38,7 +117,6 @@ struct video_output {
 	struct video_output_info info;
 
 	pthread_t thread;
-	pthread_mutex_t data_mutex;
 	bool stop;
 
 	os_sem_t* update_semaphore;
@@ -51,98 +129,635 @@ struct video_output {
 	pthread_mutex_t input_mutex;
 	DARRAY(struct video_input) inputs;
 
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
+	/* row-slice workers shared by the input scalers and by the producer
+	 * filling locked frames; concurrent runs take turns */
+	video_slice_pool_t* slice_pool;
+
+	/* single-producer/single-consumer frame ring.  write_idx is only
+	 * written by the thread locking frames, read_idx only by the video
+	 * thread.  both count up to 2 * cache_size so that a full ring can be
+	 * told apart from an empty one without sharing a counter. */
+	volatile long write_idx;
+	volatile long read_idx;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
+	struct video_buffer_pool* cache_pool;
+	uint32_t linesize[MAX_AV_PLANES];
+
+	/* reference to the newest published frame for
+	 * video_output_repeat_frame, producer side only.  NULL after frames
+	 * that cannot be kept or that were dropped. */
+	struct video_data last_frame;
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
 }; 
 /* ------------------------------------------------------------------------- */
 
+static inline size_t cache_slot(const struct video_output* video, long idx)
+{
+	return (size_t)idx % video->info.cache_size;
+}
+
+static inline long cache_next(const struct video_output* video, long idx)
+{
+	return (size_t)idx + 1 == video->info.cache_size * 2 ? 0 : idx + 1;
+}
+
+static inline long cache_prev(const struct video_output* video, long idx)
+{
+	return idx == 0 ? (long)(video->info.cache_size * 2 - 1) : idx - 1;
+}
+
+static inline size_t cache_pending(const struct video_output* video,
+	long write_idx, long read_idx)
+{
+	const size_t range = video->info.cache_size * 2;
+	return ((size_t)write_idx + range - (size_t)read_idx) % range;
+}
+
+/* adds to a counter the video thread may be decrementing concurrently.  if
+ * only_pending is set, fails once the counter has dropped to zero, because at
+ * that point the video thread has retired the frame. */
+static inline bool cache_add_count(volatile long* val, long add,
+	bool only_pending)
+{
+	long cur = os_atomic_load_long(val);
+
+	while (!only_pending || cur > 0) {
+		if (os_atomic_compare_swap_long(val, cur, cur + add))
+			return true;
+		cur = os_atomic_load_long(val);
+	}
+
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void set_frame_buffer(struct video_data* data,
+	struct video_frame_buffer* buffer)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		data->data[i] = buffer->frame.data[i];
+		data->linesize[i] = buffer->frame.linesize[i];
+	}
+
+	data->buffer = buffer;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void get_subsampling(enum video_format format,
+	uint32_t* h_shift, uint32_t* v_shift)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_I40A:
+		*h_shift = 1;
+		*v_shift = 1;
+		break;
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		*h_shift = 1;
+		*v_shift = 0;
+		break;
+	default:
+		*h_shift = 0;
+		*v_shift = 0;
+	}
+}
+
+/* byte offset of pixel (x, y) within a plane.  x and y must be multiples of
+ * the format's chroma subsampling. */
+static size_t crop_plane_offset(enum video_format format, size_t plane,
+	uint32_t x, uint32_t y, uint32_t linesize)
+{
+	size_t px = x;
+	size_t py = y;
+	bool chroma = plane == 1 || plane == 2;
+
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I40A:
+		if (chroma) {
+			px /= 2;
+			py /= 2;
+		}
+		break;
+	case VIDEO_FORMAT_NV12:
+		/* interleaved half-width chroma is as wide as luma */
+		if (plane == 1)
+			py /= 2;
+		break;
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I42A:
+		if (chroma)
+			px /= 2;
+		break;
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		px *= 2;
+		break;
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_AYUV:
+		px *= 4;
+		break;
+	case VIDEO_FORMAT_BGR3:
+		px *= 3;
+		break;
+	default:
+		break;
+	}
+
+	return py * linesize + px;
+}
+
+/* points data at the input's crop rectangle without copying anything */
+static inline void crop_video_data(const struct video_output* video,
+	const struct video_input* input, struct video_data* data)
+{
+	if (!input->cropped)
+		return;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (!data->data[i])
+			break;
+
+		data->data[i] += crop_plane_offset(video->info.format, i,
+			input->crop.x, input->crop.y, data->linesize[i]);
+	}
+}
+
+/* aligns the crop to the output format's chroma subsampling and keeps it
+ * inside the frame.  the size is only adjusted when connecting. */
+static void fit_crop(const struct video_output* video, struct video_crop* crop,
+	bool fit_size)
+{
+	uint32_t h_shift, v_shift;
+
+	get_subsampling(video->info.format, &h_shift, &v_shift);
+
+	if (fit_size) {
+		if (crop->width > video->info.width)
+			crop->width = video->info.width;
+		if (crop->height > video->info.height)
+			crop->height = video->info.height;
+		crop->width &= ~((1U << h_shift) - 1);
+		crop->height &= ~((1U << v_shift) - 1);
+	}
+
+	if (crop->x > video->info.width - crop->width)
+		crop->x = video->info.width - crop->width;
+	if (crop->y > video->info.height - crop->height)
+		crop->y = video->info.height - crop->height;
+	crop->x &= ~((1U << h_shift) - 1);
+	crop->y &= ~((1U << v_shift) - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void video_ladder_reset_frames(struct video_ladder* ladder)
+{
+	for (size_t i = 0; i < ladder->built_levels; i++) {
+		struct video_ladder_step* step = &ladder->levels[i];
+
+		video_frame_buffer_release(step->frame.buffer);
+		video_frame_buffer_release(step->rgb.buffer);
+		memset(&step->frame, 0, sizeof(struct video_data));
+		memset(&step->rgb, 0, sizeof(struct video_data));
+	}
+
+	ladder->built_levels = 0;
+}
+
+static void video_ladder_release(struct video_ladder* ladder)
+{
+	if (!ladder || --ladder->refs != 0)
+		return;
+
+	video_ladder_reset_frames(ladder);
+
+	for (size_t i = 0; i < ladder->num_levels; i++) {
+		video_scaler_destroy(ladder->levels[i].scaler);
+		video_buffer_pool_release(ladder->levels[i].pool);
+		video_buffer_pool_release(ladder->levels[i].rgb_pool);
+	}
+
+	bfree(ladder);
+}
+
+static bool video_ladder_init_step(struct video_output* video,
+	struct video_ladder_step* step, uint32_t src_width,
+	uint32_t src_height, bool last)
+{
+	const bool same_size =
+		step->width == src_width && step->height == src_height;
+	struct video_scale_info from = { .format = video->info.format,
+					.width = src_width,
+					.height = src_height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace };
+	struct video_scale_info to = from;
+	int ret;
+
+	if (same_size && step->format == video->info.format)
+		return true;
+
+	to.format = step->format;
+	to.width = step->width;
+	to.height = step->height;
+
+	ret = video_scaler_create(&step->scaler, &to, &from,
+		same_size ? VIDEO_SCALE_POINT : VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS)
+		return false;
+
+	video_scaler_set_slice_pool(step->scaler, video->slice_pool);
+
+	step->pool = video_buffer_pool_get(step->format, step->width,
+		step->height, video->info.buffer_pages, 2);
+	if (!step->pool)
+		return false;
+
+	/* a conversion at the same size leaves the source as the RGB
+	 * version of this level */
+	step->source_is_rgb = same_size;
+
+	if (!last && !same_size && step->format != video->info.format) {
+		step->rgb_pool = video_buffer_pool_get(video->info.format,
+			step->width, step->height, video->info.buffer_pages,
+			2);
+		if (!step->rgb_pool)
+			return false;
+	}
+
+	return true;
+}
+
+static struct video_ladder* video_ladder_create(struct video_output* video,
+	const struct video_ladder_level* levels, size_t num_levels)
+{
+	struct video_ladder* ladder = bzalloc(sizeof(*ladder));
+	uint32_t width = video->info.width;
+	uint32_t height = video->info.height;
+
+	ladder->refs = 1;
+	ladder->num_levels = num_levels;
+
+	for (size_t i = 0; i < num_levels; i++) {
+		const struct video_scale_info* conversion =
+			&levels[i].conversion;
+		struct video_ladder_step* step = &ladder->levels[i];
+
+		step->width = conversion->width ? conversion->width : width;
+		step->height = conversion->height ? conversion->height
+			: height;
+		step->format = conversion->format != VIDEO_FORMAT_NONE
+			? conversion->format
+			: video->info.format;
+
+		if (step->width > width || step->height > height) {
+			blog(LOG_ERROR, "video_ladder_create: Level %zu is "
+				"larger than the level above it", i);
+			goto fail;
+		}
+
+		if (!video_ladder_init_step(video, step, width, height,
+			i + 1 == num_levels)) {
+			blog(LOG_ERROR, "video_ladder_create: Failed to "
+				"create level %zu", i);
+			goto fail;
+		}
+
+		width = step->width;
+		height = step->height;
+	}
+
+	return ladder;
+
+fail:
+	video_ladder_release(ladder);
+	return NULL;
+}
+
+static bool video_ladder_build_step(struct video_ladder_step* step,
+	const struct video_data* src)
+{
+	struct video_frame_buffer* buffer;
+	struct video_frame_buffer* rgb = NULL;
+
+	if (!step->scaler) {
+		step->frame = *src;
+		step->rgb = *src;
+		video_data_retain(&step->frame);
+		video_data_retain(&step->rgb);
+		return true;
+	}
+
+	buffer = video_buffer_pool_acquire(step->pool);
+	if (!buffer)
+		return false;
+
+	if (step->rgb_pool) {
+		rgb = video_buffer_pool_acquire(step->rgb_pool);
+		if (!rgb) {
+			video_frame_buffer_release(buffer);
+			return false;
+		}
+	}
+
+	if (!video_scaler_scale_with_rgb(step->scaler, buffer->frame.data,
+		buffer->frame.linesize,
+		(const uint8_t* const*)src->data, src->linesize,
+		rgb ? rgb->frame.data[0] : NULL,
+		rgb ? rgb->frame.linesize[0] : 0)) {
+		blog(LOG_WARNING, "video-io: Could not scale ladder level!");
+		video_frame_buffer_release(buffer);
+		video_frame_buffer_release(rgb);
+		return false;
+	}
+
+	set_frame_buffer(&step->frame, buffer);
+	step->frame.timestamp = src->timestamp;
+
+	/* levels in the output's own format are their own RGB source */
+	if (rgb) {
+		set_frame_buffer(&step->rgb, rgb);
+	}
+	else {
+		step->rgb = step->source_is_rgb ? *src : step->frame;
+		video_data_retain(&step->rgb);
+	}
+
+	step->rgb.timestamp = src->timestamp;
+	return true;
+}
+
+/* builds the pyramid down to the input's level if that has not happened for
+ * this frame yet, and points data at the level.  the ladder keeps the
+ * level's reference. */
+static bool video_ladder_get_level(struct video_input* input,
+	struct video_data* data)
+{
+	struct video_ladder* ladder = input->ladder;
+
+	if (!ladder)
+		return true;
+
+	while (ladder->built_levels <= input->ladder_level) {
+		const size_t level = ladder->built_levels;
+		const struct video_data* src =
+			level ? &ladder->levels[level - 1].rgb : data;
+
+		if (!video_ladder_build_step(&ladder->levels[level], src)) {
+			data->buffer = NULL;
+			return false;
+		}
+
+		ladder->built_levels++;
+	}
+
+	*data = ladder->levels[input->ladder_level].frame;
+	return true;
+}
+
+/* on success, data holds a reference the caller has to release.  inputs
+ * without a scaler share the cached frame instead of copying it. */
 static inline bool scale_video_output(struct video_input* input,
 	struct video_data* data)
 {
-	bool success = true;
+	struct video_frame_buffer* buffer;
 
-	if (input->scaler) {
-		struct video_frame* frame;
+	if (!input->scaler) {
+		video_data_retain(data);
+		return true;
+	}
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	buffer = video_buffer_pool_acquire(input->queue->pool);
+	if (!buffer) {
+		data->buffer = NULL;
+		return false;
+	}
 
-		frame = &input->frame[input->cur_frame];
+	if (!video_scaler_scale(input->scaler, buffer->frame.data,
+		buffer->frame.linesize,
+		(const uint8_t* const*)data->data, data->linesize)) {
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
+		video_frame_buffer_release(buffer);
+		data->buffer = NULL;
+		return false;
+	}
 
-		success = video_scaler_scale(input->scaler, frame->data,
-			frame->linesize,
-			(const uint8_t* const*)data->data,
-			data->linesize);
+	set_frame_buffer(data, buffer);
+	return true;
+}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
+static struct video_input_frame*
+video_input_get_frame(struct video_input_queue* queue)
+{
+	struct video_input_frame* frame = NULL;
+	bool dropped = false;
+
+	pthread_mutex_lock(&queue->mutex);
+
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++) {
+		if (!queue->frames[i].in_use) {
+			frame = &queue->frames[i];
+			break;
 		}
-		else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
+	}
+
+	if (!frame && queue->drop_policy == VIDEO_INPUT_DROP_OLDEST &&
+		queue->queued.size) {
+		size_t idx;
+		circlebuf_pop_front(&queue->queued, &idx, sizeof(idx));
+		frame = &queue->frames[idx];
+		dropped = true;
+	}
+
+	if (frame)
+		frame->in_use = true;
+
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (dropped) {
+		video_frame_buffer_release(frame->data.buffer);
+		frame->data.buffer = NULL;
+	}
+
+	if (!frame || dropped)
+		os_atomic_inc_long(&queue->skipped_frames);
+
+	return frame;
+}
+
+static inline void video_input_clear_last(struct video_input* input)
+{
+	video_frame_buffer_release(input->last.buffer);
+	memset(&input->last, 0, sizeof(input->last));
+}
+
+static inline bool video_input_repeat_last(struct video_input* input,
+	const struct video_data* data, struct video_data* out)
+{
+	if (!input->last.buffer || input->crop_moved)
+		return false;
+
+	*out = input->last;
+	out->timestamp = data->timestamp;
+	out->repeat = true;
+	video_data_retain(out);
+	return true;
+}
+
+static void video_input_queue_frame(const struct video_output* video,
+	struct video_input* input, const struct video_data* data, bool repeat)
+{
+	struct video_input_queue* queue = input->queue;
+	struct video_input_frame* frame;
+	size_t idx;
+
+	/* a new frame makes the previous one unsuitable for repeating,
+	 * even if this input ends up dropping it */
+	if (input->repeat_events && !repeat)
+		video_input_clear_last(input);
+
+	frame = video_input_get_frame(queue);
+	if (!frame)
+		return;
+
+	idx = frame - queue->frames;
+
+	if (!repeat || !input->repeat_events ||
+		!video_input_repeat_last(input, data, &frame->data)) {
+		frame->data = *data;
+		frame->data.repeat = false;
+		crop_video_data(video, input, &frame->data);
+
+		if (!video_ladder_get_level(input, &frame->data) ||
+			!scale_video_output(input, &frame->data)) {
+			pthread_mutex_lock(&queue->mutex);
+			frame->in_use = false;
+			pthread_mutex_unlock(&queue->mutex);
+			return;
+		}
+
+		if (input->repeat_events) {
+			video_input_clear_last(input);
+			input->last = frame->data;
+			input->crop_moved = false;
+			video_data_retain(&input->last);
 		}
 	}
 
-	return success;
+	frame->queued_ts = os_gettime_ns();
+
+	pthread_mutex_lock(&queue->mutex);
+	circlebuf_push_back(&queue->queued, &idx, sizeof(idx));
+	pthread_mutex_unlock(&queue->mutex);
+
+	os_sem_post(queue->semaphore);
+}
+
+static void* video_input_thread(void* param)
+{
+	struct video_input_queue* queue = param;
+
+	os_set_thread_name("video-io: input thread");
+
+	while (os_sem_wait(queue->semaphore) == 0) {
+		struct video_input_frame* frame = NULL;
+
+		if (queue->stop)
+			break;
+
+		pthread_mutex_lock(&queue->mutex);
+		if (queue->queued.size) {
+			size_t idx;
+			circlebuf_pop_front(&queue->queued, &idx, sizeof(idx));
+			frame = &queue->frames[idx];
+		}
+		pthread_mutex_unlock(&queue->mutex);
+
+		/* the frame this was posted for was dropped as the oldest */
+		if (!frame)
+			continue;
+
+		if (os_gettime_ns() - frame->queued_ts > queue->frame_time)
+			os_atomic_inc_long(&queue->lagged_frames);
+
+		queue->callback(queue->param, &frame->data);
+		os_atomic_inc_long(&queue->total_frames);
+
+		video_frame_buffer_release(frame->data.buffer);
+		frame->data.buffer = NULL;
+
+		pthread_mutex_lock(&queue->mutex);
+		frame->in_use = false;
+		pthread_mutex_unlock(&queue->mutex);
+	}
+
+	return NULL;
 }
 
 static inline bool video_output_cur_frame(struct video_output* video)
 {
 	struct cached_frame_info* frame_info;
+	long read_idx = video->read_idx;
 	bool complete;
-	bool skipped;
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	frame_info = &video->cache[video->first_added];
+	if (read_idx == os_atomic_load_long_acquire(&video->write_idx))
+		return true;
 
-	pthread_mutex_unlock(&video->data_mutex);
+	frame_info = &video->cache[cache_slot(video, read_idx)];
 
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->input_mutex);
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input* input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
+	for (size_t i = 0; i < video->inputs.num; i++)
+		video_input_queue_frame(video, video->inputs.array + i,
+			&frame_info->frame,
+			frame_info->delivered || frame_info->repeat);
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+	/* every ladder input holds its own reference by now */
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		if (video->inputs.array[i].ladder)
+			video_ladder_reset_frames(video->inputs.array[i].ladder);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
 	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+	frame_info->delivered = true;
+	complete = os_atomic_dec_long(&frame_info->count) == 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
-
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		/* inputs hold their own references to the frame by now */
+		struct video_frame_buffer* buffer = frame_info->buffer;
+		frame_info->buffer = NULL;
+		frame_info->delivered = false;
+
+		os_atomic_store_long_release(&video->read_idx,
+			cache_next(video, read_idx));
+		video_frame_buffer_release(buffer);
 	}
-	else if (skipped) {
-		--frame_info->skipped;
+	else if (os_atomic_load_long(&frame_info->skipped) > 0) {
+		os_atomic_dec_long(&frame_info->skipped);
 		os_atomic_inc_long(&video->skipped_frames);
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	/* -------------------------------- */
 
 	return complete;
@@ -177,6 +792,97 @@ static void* video_thread(void* param)
 } 
 /* ------------------------------------------------------------------------- */
 
+static void video_input_queue_destroy(struct video_input_queue* queue)
+{
+	if (!queue)
+		return;
+
+	if (queue->thread_initialized) {
+		queue->stop = true;
+		os_sem_post(queue->semaphore);
+		pthread_join(queue->thread, NULL);
+	}
+
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
+		video_frame_buffer_release(queue->frames[i].data.buffer);
+
+	video_buffer_pool_release(queue->pool);
+	circlebuf_free(&queue->queued);
+	os_sem_destroy(queue->semaphore);
+	pthread_mutex_destroy(&queue->mutex);
+	bfree(queue);
+}
+
+static struct video_input_queue*
+video_input_queue_create(struct video_input* input, struct video_output* video)
+{
+	struct video_input_queue* queue = bzalloc(sizeof(*queue));
+
+	queue->drop_policy = VIDEO_INPUT_DROP_OLDEST;
+	queue->frame_time = video->frame_time;
+	queue->callback = input->callback;
+	queue->param = input->param;
+
+	pthread_mutex_init_value(&queue->mutex);
+	if (pthread_mutex_init(&queue->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&queue->semaphore, 0) != 0)
+		goto fail;
+
+	if (input->scaler) {
+		queue->pool = video_buffer_pool_get(input->conversion.format,
+			input->conversion.width, input->conversion.height,
+			video->info.buffer_pages, MAX_CONVERT_BUFFERS);
+		if (!queue->pool)
+			goto fail;
+	}
+
+	if (pthread_create(&queue->thread, NULL, video_input_thread, queue) !=
+		0)
+		goto fail;
+
+	queue->thread_initialized = true;
+	return queue;
+
+fail:
+	video_input_queue_destroy(queue);
+	return NULL;
+}
+
+static inline void video_input_free(struct video_input* input)
+{
+	video_input_queue_destroy(input->queue);
+	video_scaler_destroy(input->scaler);
+	video_ladder_release(input->ladder);
+	video_input_clear_last(input);
+	input->queue = NULL;
+	input->scaler = NULL;
+	input->ladder = NULL;
+}
+
+static inline bool init_cache(struct video_output* video)
+{
+	size_t offsets[MAX_AV_PLANES];
+
+	if (video->info.cache_size > MAX_CACHE_SIZE)
+		video->info.cache_size = MAX_CACHE_SIZE;
+
+	/* slots take buffers from the pool as frames are locked, so have
+	 * enough ready for a full cache before the first frame */
+	video->cache_pool = video_buffer_pool_get(video->info.format,
+		video->info.width, video->info.height, video->info.buffer_pages,
+		video->info.cache_size);
+	if (!video->cache_pool)
+		return false;
+
+	video_frame_get_layout(video->info.format, video->info.width,
+		video->info.height, video->linesize, offsets);
+
+	video->write_idx = 0;
+	video->read_idx = 0;
+	return true;
+}
+
 int video_output_open(video_t** video, struct video_output_info* info)
 {
 	struct video_output* out;
@@ -198,16 +904,17 @@ int video_output_open(video_t** video, struct video_output_info* info)
 		goto fail;
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		goto fail;
-	if (pthread_mutex_init(&out->data_mutex, &attr) != 0)
-		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+	if (!init_cache(out))
 		goto fail;
 
-	init_cache(out);
+	out->slice_pool = video_slice_pool_create(info->conversion_threads);
+
+	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+		goto fail;
 
 	out->initialized = true;
 	*video = out;
@@ -229,32 +936,200 @@ void video_output_close(video_t* video)
 		video_input_free(&video->inputs.array[i]);
 	da_free(video->inputs);
 
+	video_slice_pool_destroy(video->slice_pool);
+
 	for (size_t i = 0; i < video->info.cache_size; i++)
-		video_frame_free((struct video_frame*)&video->cache[i]);
+		video_frame_buffer_release(video->cache[i].buffer);
+	video_frame_buffer_release(video->last_frame.buffer);
+	video_buffer_pool_release(video->cache_pool);
 
 	os_sem_destroy(video->update_semaphore);
-	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 	bfree(video);
 }
 
+/* returns the next free cache slot, or NULL if the cache is full and the
+ * frame was counted as a repeat of the newest frame instead */
+static struct cached_frame_info* lock_cache_slot(struct video_output* video,
+	int count, uint64_t timestamp)
+{
+	struct cached_frame_info* cfi;
+	long write_idx = video->write_idx;
+
+	for (;;) {
+		long read_idx = os_atomic_load_long_acquire(&video->read_idx);
+		if (cache_pending(video, write_idx, read_idx) <
+			video->info.cache_size)
+			break;
+
+		/* no free slot: have the video thread repeat the newest frame
+		 * instead.  if it retired that frame in the meantime, a slot
+		 * is about to be freed, so look again. */
+		cfi = &video->cache[cache_slot(video,
+			cache_prev(video, write_idx))];
+		if (cache_add_count(&cfi->count, count, true)) {
+			cache_add_count(&cfi->skipped, count, false);
+			return NULL;
+		}
+	}
+
+	cfi = &video->cache[cache_slot(video, write_idx)];
+	cfi->frame.timestamp = timestamp;
+	cfi->count = count;
+	cfi->skipped = 0;
+	cfi->repeat = false;
+	return cfi;
+}
+
+/* keeps a reference to the frame about to be published for repeating it.
+ * frames handed over by video_output_submit_frame are not kept, because
+ * their planes have to go back to the caller as soon as possible. */
+static void set_last_frame(struct video_output* video,
+	const struct cached_frame_info* cfi)
+{
+	video_frame_buffer_release(video->last_frame.buffer);
+	memset(&video->last_frame, 0, sizeof(video->last_frame));
+
+	if (cfi && cfi->buffer && cfi->buffer->pool) {
+		video->last_frame = cfi->frame;
+		video_data_retain(&video->last_frame);
+	}
+}
+
+static inline void publish_frame(struct video_output* video)
+{
+	os_atomic_store_long_release(&video->write_idx,
+		cache_next(video, video->write_idx));
+	os_sem_post(video->update_semaphore);
+}
+
+bool video_output_lock_frame(video_t* video, struct video_frame* frame,
+	int count, uint64_t timestamp)
+{
+	struct cached_frame_info* cfi;
+
+	if (!video)
+		return false;
+
+	cfi = lock_cache_slot(video, count, timestamp);
+	if (!cfi) {
+		set_last_frame(video, NULL);
+		return false;
+	}
+
+	cfi->buffer = video_buffer_pool_acquire(video->cache_pool);
+	if (!cfi->buffer) {
+		set_last_frame(video, NULL);
+		return false; /* the slot is only published on unlock */
+	}
+
+	set_frame_buffer(&cfi->frame, cfi->buffer);
+
+	memcpy(frame, &cfi->frame, sizeof(*frame));
+	return true;
+}
+
+bool video_output_submit_frame(video_t* video, const struct video_data* frame,
+	int count, void (*release)(void* param), void* param)
+{
+	struct cached_frame_info* cfi;
+	struct video_frame_buffer* buffer;
+
+	if (!video || !frame || !release)
+		return false;
+
+	/* consumers rely on the output's own plane layout */
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (frame->linesize[i] != video->linesize[i])
+			return false;
+	}
+
+	set_last_frame(video, NULL);
+
+	cfi = lock_cache_slot(video, count, frame->timestamp);
+	if (!cfi) {
+		release(param);
+		return true;
+	}
+
+	buffer = video_frame_buffer_create_external(frame, release, param);
+	cfi->buffer = buffer;
+	set_frame_buffer(&cfi->frame, buffer);
+
+	publish_frame(video);
+	return true;
+}
+
+void video_output_unlock_frame(video_t* video)
+{
+	if (!video)
+		return;
+
+	set_last_frame(video, &video->cache[cache_slot(video,
+		video->write_idx)]);
+	publish_frame(video);
+}
+
+bool video_output_repeat_frame(video_t* video, int count, uint64_t timestamp)
+{
+	struct cached_frame_info* cfi;
+
+	if (!video || !video->last_frame.buffer)
+		return false;
+
+	/* with the cache full, the newest frame is repeated instead, which
+	 * is the same frame */
+	cfi = lock_cache_slot(video, count, timestamp);
+	if (!cfi)
+		return true;
+
+	cfi->buffer = video_data_retain(&video->last_frame);
+	cfi->repeat = true;
+	set_frame_buffer(&cfi->frame, cfi->buffer);
+
+	publish_frame(video);
+	return true;
+}
 
 static inline bool video_input_init(struct video_input* input,
 	struct video_output* video)
 {
-	if (input->conversion.width != video->info.width ||
-		input->conversion.height != video->info.height ||
-		input->conversion.format != video->info.format) {
+	enum video_format format = video->info.format;
+	uint32_t width = video->info.width;
+	uint32_t height = video->info.height;
+
+	if (input->ladder) {
+		/* ladder levels arrive already converted */
+		format = input->conversion.format;
+		width = input->conversion.width;
+		height = input->conversion.height;
+	}
+	else if (input->cropped) {
+		width = input->crop.width;
+		height = input->crop.height;
+	}
+
+	/* a cropped input that needs no conversion gets a view into the
+	 * shared frame; otherwise only the crop rectangle is scaled */
+	if (input->conversion.width != width ||
+		input->conversion.height != height ||
+		input->conversion.format != format) {
 		struct video_scale_info from = { .format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
+						.width = width,
+						.height = height,
 						.range = video->info.range,
 						.colorspace =
 							video->info.colorspace };
 
+		/* conversion alone needs no filtering */
+		enum video_scale_type type =
+			input->conversion.width == width &&
+			input->conversion.height == height
+			? VIDEO_SCALE_POINT
+			: VIDEO_SCALE_FAST_BILINEAR;
+
 		int ret = video_scaler_create(&input->scaler,
-			&input->conversion, &from,
-			VIDEO_SCALE_FAST_BILINEAR);
+			&input->conversion, &from, type);
 		if (ret != VIDEO_SCALER_SUCCESS) {
 			if (ret == VIDEO_SCALER_BAD_CONVERSION)
 				blog(LOG_ERROR, "video_input_init: Bad "
@@ -266,19 +1141,44 @@ static inline bool video_input_init(struct video_input* input,
 			return false;
 		}
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-				input->conversion.format,
-				input->conversion.width,
-				input->conversion.height);
+		video_scaler_set_slice_pool(input->scaler, video->slice_pool);
+	}
+
+	input->queue = video_input_queue_create(input, video);
+	if (!input->queue) {
+		blog(LOG_ERROR, "video_input_init: Failed to create input "
+			"queue");
+		video_input_free(input);
+		return false;
 	}
 
 	return true;
 }
 
+static void video_add_input(struct video_output* video,
+	const struct video_input* input)
+{
+	if (video->inputs.num == 0) {
+		if (!os_atomic_load_long(&video->gpu_refs)) {
+			reset_frames(video);
+		}
+		os_atomic_set_bool(&video->raw_active, true);
+	}
+	da_push_back(video->inputs, input);
+}
+
 bool video_output_connect(
 	video_t* video, const struct video_scale_info* conversion,
 	void (*callback)(void* param, struct video_data* frame), void* param)
+{
+	return video_output_connect_crop(video, conversion, NULL, callback,
+		param);
+}
+
+bool video_output_connect_crop(
+	video_t* video, const struct video_scale_info* conversion,
+	const struct video_crop* crop,
+	void (*callback)(void* param, struct video_data* frame), void* param)
 {
 	bool success = false;
 
@@ -291,33 +1191,44 @@ bool video_output_connect(
 		struct video_input input;
 		memset(&input, 0, sizeof(input));
 
+		uint32_t width = video->info.width;
+		uint32_t height = video->info.height;
+
 		input.callback = callback;
 		input.param = param;
 
+		if (crop) {
+			input.crop = *crop;
+			fit_crop(video, &input.crop, true);
+			input.cropped = true;
+			width = input.crop.width;
+			height = input.crop.height;
+		}
+
 		if (conversion) {
 			input.conversion = *conversion;
 		}
 		else {
 			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input.conversion.width = width;
+			input.conversion.height = height;
 		}
 
 		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
+			input.conversion.width = width;
 		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
-
-		success = video_input_init(&input, video);
-		if (success) {
-			if (video->inputs.num == 0) {
-				if (!os_atomic_load_long(&video->gpu_refs)) {
-					reset_frames(video);
-				}
-				os_atomic_set_bool(&video->raw_active, true);
-			}
-			da_push_back(video->inputs, &input);
+			input.conversion.height = height;
+
+		if (input.cropped && (!width || !height)) {
+			blog(LOG_ERROR, "video_output_connect_crop: Empty "
+				"crop rectangle");
+			success = false;
 		}
+		else {
+			success = video_input_init(&input, video);
+		}
+		if (success)
+			video_add_input(video, &input);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -326,6 +1237,188 @@ bool video_output_connect(
 }
 
 
+static inline struct video_input_queue* video_get_input_queue(
+	const video_t* video,
+	void (*callback)(void* param, struct video_data* frame), void* param)
+{
+	size_t idx = video_get_input_idx((video_t*)video, callback, param);
+	return idx != DARRAY_INVALID ? video->inputs.array[idx].queue : NULL;
+}
+
+bool video_output_set_input_drop_policy(
+	video_t* video, void (*callback)(void* param, struct video_data* frame),
+	void* param, enum video_input_drop_policy policy)
+{
+	struct video_input_queue* queue;
+
+	if (!video || !callback)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	queue = video_get_input_queue(video, callback, param);
+	if (queue) {
+		pthread_mutex_lock(&queue->mutex);
+		queue->drop_policy = policy;
+		pthread_mutex_unlock(&queue->mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return !!queue;
+}
+
+static bool valid_ladder_levels(video_t* video,
+	const struct video_ladder_level* levels, size_t num_levels)
+{
+	if (!levels || !num_levels || num_levels > MAX_LADDER_LEVELS)
+		return false;
+
+	for (size_t i = 0; i < num_levels; i++) {
+		if (!levels[i].callback)
+			return false;
+		if (video_get_input_idx(video, levels[i].callback,
+			levels[i].param) != DARRAY_INVALID)
+			return false;
+	}
+
+	return true;
+}
+
+bool video_output_connect_ladder(video_t* video,
+	const struct video_ladder_level* levels, size_t num_levels)
+{
+	struct video_input inputs[MAX_LADDER_LEVELS];
+	struct video_ladder* ladder = NULL;
+	size_t count = 0;
+
+	if (!video)
+		return false;
+
+	memset(inputs, 0, sizeof(inputs));
+	pthread_mutex_lock(&video->input_mutex);
+
+	if (!valid_ladder_levels(video, levels, num_levels))
+		goto fail;
+
+	ladder = video_ladder_create(video, levels, num_levels);
+	if (!ladder)
+		goto fail;
+
+	for (; count < num_levels; count++) {
+		struct video_input* input = &inputs[count];
+		const struct video_ladder_step* step = &ladder->levels[count];
+
+		input->callback = levels[count].callback;
+		input->param = levels[count].param;
+		input->conversion = levels[count].conversion;
+		input->conversion.format = step->format;
+		input->conversion.width = step->width;
+		input->conversion.height = step->height;
+		input->ladder = ladder;
+		input->ladder_level = count;
+		ladder->refs++;
+
+		if (!video_input_init(input, video)) {
+			video_input_free(input);
+			goto fail;
+		}
+	}
+
+	for (size_t i = 0; i < num_levels; i++)
+		video_add_input(video, &inputs[i]);
+
+	video_ladder_release(ladder);
+	pthread_mutex_unlock(&video->input_mutex);
+	return true;
+
+fail:
+	for (size_t i = 0; i < count; i++)
+		video_input_free(&inputs[i]);
+	video_ladder_release(ladder);
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return false;
+}
+
+bool video_output_set_crop(video_t* video,
+	void (*callback)(void* param, struct video_data* frame), void* param,
+	uint32_t x, uint32_t y)
+{
+	struct video_input* input = NULL;
+	size_t idx;
+
+	if (!video || !callback)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID && video->inputs.array[idx].cropped) {
+		input = &video->inputs.array[idx];
+		input->crop.x = x;
+		input->crop.y = y;
+		fit_crop(video, &input->crop, false);
+		input->crop_moved = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return !!input;
+}
+
+bool video_output_set_input_repeat_events(video_t* video,
+	void (*callback)(void* param, struct video_data* frame), void* param,
+	bool enable)
+{
+	struct video_input* input = NULL;
+	size_t idx;
+
+	if (!video || !callback)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		input = &video->inputs.array[idx];
+		input->repeat_events = enable;
+		if (!enable)
+			video_input_clear_last(input);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return !!input;
+}
+
+bool video_output_get_input_stats(
+	const video_t* video,
+	void (*callback)(void* param, struct video_data* frame), void* param,
+	struct video_input_stats* stats)
+{
+	struct video_input_queue* queue;
+
+	if (!video || !callback || !stats)
+		return false;
+
+	pthread_mutex_lock((pthread_mutex_t*)&video->input_mutex);
+
+	queue = video_get_input_queue(video, callback, param);
+	if (queue) {
+		stats->total_frames =
+			(uint32_t)os_atomic_load_long(&queue->total_frames);
+		stats->skipped_frames =
+			(uint32_t)os_atomic_load_long(&queue->skipped_frames);
+		stats->lagged_frames =
+			(uint32_t)os_atomic_load_long(&queue->lagged_frames);
+	}
+
+	pthread_mutex_unlock((pthread_mutex_t*)&video->input_mutex);
+
+	return !!queue;
+}
+
 bool video_output_active(const video_t* video)
 {
 	if (!video)
@@ -338,6 +1431,11 @@ const struct video_output_info* video_output_get_info(const video_t* video)
 	return video ? &video->info : NULL;
 }
 
+video_slice_pool_t* video_output_get_slice_pool(const video_t* video)
+{
+	return video ? video->slice_pool : NULL;
+}
+
 uint64_t video_output_get_frame_time(const video_t* video)
 {
 	return video ? video->frame_time : 0;
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "media-io-defs.h"
+#include "video-slice.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -83,10 +84,29 @@ extern "C" {
 		VIDEO_RANGE_FULL
 	};
 
+	/* memory backing video-io's frame buffers.  buffers are pooled per
+	 * format and size either way; huge pages cut TLB misses when
+	 * touching large frames. */
+	enum video_buffer_pages {
+		VIDEO_BUFFER_PAGES_DEFAULT,
+		VIDEO_BUFFER_PAGES_HUGE,          /* transparent huge pages */
+		VIDEO_BUFFER_PAGES_HUGE_EXPLICIT, /* reserved huge pages */
+	};
+
+	struct video_frame_buffer;
+	typedef struct video_frame_buffer video_frame_buffer_t;
+
 	struct video_data {
 		uint8_t* data[MAX_AV_PLANES];
 		uint32_t linesize[MAX_AV_PLANES];
 		uint64_t timestamp;
+
+		/* memory backing the planes, NULL if not reference counted */
+		video_frame_buffer_t* buffer;
+
+		/* repeat of the previous frame at a new timestamp, see
+		 * video_output_set_input_repeat_events */
+		bool repeat;
 	};
 
 	struct video_output_info {
@@ -101,6 +121,12 @@ extern "C" {
 
 		enum video_colorspace colorspace;
 		enum video_range_type range;
+
+		/* threads used for slice-parallel scaling/conversion,
+		 * 0 for automatic, 1 to disable */
+		uint32_t conversion_threads;
+
+		enum video_buffer_pages buffer_pages;
 	};
 
 	static inline bool format_is_yuv(enum video_format format)
@@ -209,6 +235,7 @@ extern "C" {
 		VIDEO_SCALE_FAST_BILINEAR,
 		VIDEO_SCALE_BILINEAR,
 		VIDEO_SCALE_BICUBIC,
+		VIDEO_SCALE_AREA,
 	};
 
 	struct video_scale_info {
@@ -237,6 +264,49 @@ extern "C" {
 		video_output_connect(video_t* video, const struct video_scale_info* conversion,
 			void (*callback)(void* param, struct video_data* frame),
 			void* param);
+
+	/* rectangle of the output frame, in pixels */
+	struct video_crop {
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	/*
+	 * Like video_output_connect, but the input only receives the crop
+	 * rectangle, which conversion then applies to.  Inputs that need no
+	 * conversion receive a view into the shared frame without a copy.
+	 * The rectangle is aligned to the chroma subsampling of the output
+	 * format.  Its size is fixed, but it can be moved at any time with
+	 * video_output_set_crop, taking effect from the next frame.
+	 */
+	EXPORT bool video_output_connect_crop(video_t* video,
+		const struct video_scale_info* conversion,
+		const struct video_crop* crop,
+		void (*callback)(void* param, struct video_data* frame),
+		void* param);
+	EXPORT bool video_output_set_crop(video_t* video,
+		void (*callback)(void* param, struct video_data* frame),
+		void* param, uint32_t x, uint32_t y);
+
+	/*
+	 * Connects several renditions of the output at once, largest first.
+	 * Each level is downscaled from the level above it rather than from
+	 * the full-size frame, then converted to the level's format, and is
+	 * delivered to its own callback exactly as if it had been connected
+	 * with video_output_connect.  A width or height of 0 keeps the size
+	 * of the level above.  Levels are disconnected individually.
+	 */
+	struct video_ladder_level {
+		struct video_scale_info conversion;
+		void (*callback)(void* param, struct video_data* frame);
+		void* param;
+	};
+
+	EXPORT bool video_output_connect_ladder(video_t* video,
+		const struct video_ladder_level* levels, size_t num_levels);
+
 	EXPORT void video_output_disconnect(video_t* video,
 		void (*callback)(void* param,
 			struct video_data* frame),
@@ -244,12 +314,94 @@ extern "C" {
 
 	EXPORT bool video_output_active(const video_t* video);
 
+	/*
+	 * Every connected input receives frames on its own thread through a
+	 * small bounded queue.  When a consumer falls behind and its queue is
+	 * full, only that input drops frames, according to its drop policy.
+	 */
+
+	enum video_input_drop_policy {
+		/* replace the oldest queued frame (default, lowest latency) */
+		VIDEO_INPUT_DROP_OLDEST,
+		/* discard new frames until the consumer catches up */
+		VIDEO_INPUT_DROP_NEWEST,
+	};
+
+	struct video_input_stats {
+		uint32_t total_frames;   /* frames delivered to the callback */
+		uint32_t skipped_frames; /* frames dropped by the queue */
+		uint32_t lagged_frames;  /* frames delivered later than one
+					    frame interval after queueing */
+	};
+
+	EXPORT bool video_output_set_input_drop_policy(
+		video_t* video,
+		void (*callback)(void* param, struct video_data* frame),
+		void* param, enum video_input_drop_policy policy);
+	/*
+	 * When the output falls behind, or the producer repeats an unchanged
+	 * frame, the same frame is delivered several times with increasing
+	 * timestamps.  By default every duplicate is converted and delivered
+	 * like a new frame.  Inputs with repeat events enabled instead get
+	 * each duplicate as the frame they last received, with repeat set and
+	 * nothing converted again, so they can handle it cheaply (e.g. encode
+	 * a skip frame).
+	 */
+	EXPORT bool video_output_set_input_repeat_events(
+		video_t* video,
+		void (*callback)(void* param, struct video_data* frame),
+		void* param, bool enable);
+
+	EXPORT bool video_output_get_input_stats(
+		const video_t* video,
+		void (*callback)(void* param, struct video_data* frame),
+		void* param, struct video_input_stats* stats);
+
 	EXPORT const struct video_output_info*
 		video_output_get_info(const video_t* video);
 	EXPORT bool video_output_lock_frame(video_t* video, struct video_frame* frame,
 		int count, uint64_t timestamp);
 	EXPORT void video_output_unlock_frame(video_t* video);
+
+	/*
+	 * Queues the previous frame again at a new timestamp, for producers
+	 * that know their frame did not change.  It is delivered as a repeat
+	 * (see video_output_set_input_repeat_events), so nothing is copied,
+	 * and inputs with repeat events do not convert it again either.
+	 * Returns false if there is no frame to repeat, which is the case
+	 * after frames queued with video_output_submit_frame or frames the
+	 * output had to drop; the frame must then be queued normally.
+	 */
+	EXPORT bool video_output_repeat_frame(video_t* video, int count,
+		uint64_t timestamp);
+
+	/*
+	 * Queues a frame whose planes stay owned by the caller instead of
+	 * copying it into the cache.  Only possible when the plane line sizes
+	 * match the output's own layout; returns false otherwise, in which
+	 * case the frame should be copied through video_output_lock_frame.
+	 * When it returns true, release(param) is called from any thread once
+	 * the video thread and every input are done with the planes.
+	 */
+	EXPORT bool video_output_submit_frame(video_t* video,
+		const struct video_data* frame, int count,
+		void (*release)(void* param), void* param);
+
+	/*
+	 * Frames handed to input callbacks are reference counted.  A callback
+	 * that needs a frame after returning can retain it instead of copying
+	 * it, and release it later from any thread.  Returns NULL for frames
+	 * that are not reference counted.
+	 */
+	EXPORT video_frame_buffer_t*
+		video_data_retain(const struct video_data* frame);
+	EXPORT void video_frame_buffer_release(video_frame_buffer_t* buffer);
+
+	/* frees frame buffers kept for reuse after their outputs were closed */
+	EXPORT void video_output_free_unused_buffers(void);
 	EXPORT uint64_t video_output_get_frame_time(const video_t* video);
+	EXPORT video_slice_pool_t*
+		video_output_get_slice_pool(const video_t* video);
 	EXPORT void video_output_stop(video_t* video);
 	EXPORT bool video_output_stopped(video_t* video);
 
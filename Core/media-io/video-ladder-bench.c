@@ -0,0 +1,141 @@
+/*
+ * Standalone benchmark of video_output_connect_ladder: delivers a 1080p BGRA
+ * video_output as 1080p, 720p and 540p NV12, once through a ladder and once
+ * through three independent inputs that each scale the full frame, and
+ * reports the time per frame until every rendition has been delivered.
+ *
+ * Frames are fed one at a time, so nothing is dropped and the time covers
+ * the video thread scaling and converting every rendition.  It only uses
+ * the public video-io API, e.g.:
+ *
+ *   cc -O2 -I.. video-ladder-bench.c -lobs -o video-ladder-bench
+ *
+ * Pass the number of conversion threads as the first argument, 1 by
+ * default so that the numbers are per core.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "video-io.h"
+#include "video-frame.h"
+
+#define FRAME_COUNT 200
+#define NUM_LEVELS 3
+
+static const uint32_t level_sizes[NUM_LEVELS][2] = {
+	{1920, 1080},
+	{1280, 720},
+	{960, 540},
+};
+
+static os_sem_t* delivered;
+
+static void receive_frame(void* param, struct video_data* frame)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(frame);
+	os_sem_post(delivered);
+}
+
+static inline struct video_scale_info level_info(size_t level)
+{
+	struct video_scale_info info = {VIDEO_FORMAT_NV12,
+		level_sizes[level][0], level_sizes[level][1],
+		VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	return info;
+}
+
+static bool connect_inputs(video_t* video, bool ladder)
+{
+	struct video_ladder_level levels[NUM_LEVELS];
+
+	for (size_t i = 0; i < NUM_LEVELS; i++) {
+		const struct video_scale_info info = level_info(i);
+
+		if (!ladder && !video_output_connect(video, &info,
+			receive_frame, (void*)i))
+			return false;
+
+		levels[i].conversion = info;
+		levels[i].callback = receive_frame;
+		levels[i].param = (void*)i;
+	}
+
+	return !ladder ||
+		video_output_connect_ladder(video, levels, NUM_LEVELS);
+}
+
+/* returns milliseconds per frame, or 0 on failure */
+static double run_bench(uint32_t threads, bool ladder)
+{
+	struct video_output_info info = {0};
+	video_t* video;
+	uint64_t start;
+	double ms;
+
+	info.name = "ladder bench";
+	info.format = VIDEO_FORMAT_BGRA;
+	info.fps_num = 60;
+	info.fps_den = 1;
+	info.width = level_sizes[0][0];
+	info.height = level_sizes[0][1];
+	info.cache_size = 4;
+	info.colorspace = VIDEO_CS_709;
+	info.range = VIDEO_RANGE_PARTIAL;
+	info.conversion_threads = threads;
+
+	if (video_output_open(&video, &info) != VIDEO_OUTPUT_SUCCESS)
+		return 0.0;
+	if (!connect_inputs(video, ladder)) {
+		video_output_close(video);
+		return 0.0;
+	}
+
+	start = os_gettime_ns();
+
+	for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+		struct video_frame frame;
+
+		if (!video_output_lock_frame(video, &frame, 1,
+			(uint64_t)i * 16666667ULL))
+			continue;
+
+		/* a changing frame, so nothing is served from the caches */
+		memset(frame.data[0], (int)i,
+			(size_t)frame.linesize[0] * info.height);
+		video_output_unlock_frame(video);
+
+		for (size_t level = 0; level < NUM_LEVELS; level++)
+			os_sem_wait(delivered);
+	}
+
+	ms = (double)(os_gettime_ns() - start) / 1000000.0 / FRAME_COUNT;
+
+	video_output_close(video);
+	return ms;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t threads = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1;
+	double independent;
+	double ladder;
+
+	if (os_sem_init(&delivered, 0) != 0)
+		return 1;
+
+	independent = run_bench(threads, false);
+	ladder = run_bench(threads, true);
+
+	printf("1080p BGRA to 1080p, 720p and 540p NV12, %u thread(s)\n",
+		threads);
+	printf("independent scalers: %7.2f ms/frame\n", independent);
+	printf("ladder:              %7.2f ms/frame\n", ladder);
+
+	os_sem_destroy(delivered);
+	video_output_free_unused_buffers();
+	return independent && ladder ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/*
+ * Standalone benchmark of the kernel sets of video-scaler.c: scales a
+ * 1920x1080 BGRA frame to 1280x720 with every scale type and output format,
+ * once with each kernel set the CPU supports, and reports the throughput in
+ * source megapixels per second.  Scaling runs on the calling thread only,
+ * without a slice pool, so the numbers are per core.
+ *
+ * It includes video-scaler.c to get at the kernel tables, so it only needs
+ * libobs, e.g.:
+ *
+ *   cc -O2 -I.. video-scaler-bench.c -lobs -lm -o video-scaler-bench
+ *
+ * Pass the source and output size as arguments to measure other sizes,
+ * e.g. "video-scaler-bench 3840 2160 1920 1080".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "video-scaler.c"
+#include "video-frame.h"
+
+#define BENCH_TIME_NS 500000000ULL
+
+struct bench_case {
+	enum video_scale_type type;
+	enum video_format format;
+	const char* name;
+};
+
+static const struct bench_case cases[] = {
+	{VIDEO_SCALE_FAST_BILINEAR, VIDEO_FORMAT_NV12, "fast bilinear NV12"},
+	{VIDEO_SCALE_BILINEAR, VIDEO_FORMAT_NV12, "bilinear NV12"},
+	{VIDEO_SCALE_BICUBIC, VIDEO_FORMAT_NV12, "bicubic NV12"},
+	{VIDEO_SCALE_AREA, VIDEO_FORMAT_NV12, "area NV12"},
+	{VIDEO_SCALE_BILINEAR, VIDEO_FORMAT_I420, "bilinear I420"},
+	{VIDEO_SCALE_BILINEAR, VIDEO_FORMAT_I444, "bilinear I444"},
+	{VIDEO_SCALE_BILINEAR, VIDEO_FORMAT_BGRA, "bilinear BGRA"},
+};
+
+struct bench_frame {
+	uint8_t* data[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+};
+
+static void alloc_output(struct bench_frame* out, enum video_format format,
+	uint32_t width, uint32_t height)
+{
+	size_t offsets[MAX_AV_PLANES];
+	size_t size = video_frame_get_layout(format, width, height,
+		out->linesize, offsets);
+	uint8_t* data = bmalloc(size);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		out->data[i] = out->linesize[i] ? data + offsets[i] : NULL;
+}
+
+/* returns source megapixels per second, or 0 if the scaler failed */
+static double bench_kernels(const struct scaler_kernels* kernels,
+	const struct bench_case* c, const uint8_t* src, uint32_t src_width,
+	uint32_t src_height, uint32_t dst_width, uint32_t dst_height)
+{
+	struct video_scale_info from = {VIDEO_FORMAT_BGRA, src_width,
+		src_height, VIDEO_RANGE_DEFAULT, VIDEO_CS_709};
+	struct video_scale_info to = {c->format, dst_width, dst_height,
+		VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	const uint8_t* in[1] = {src};
+	const uint32_t in_linesize[1] = {src_width * 4};
+	struct bench_frame out;
+	video_scaler_t* scaler;
+	uint64_t frames = 0;
+	uint64_t start;
+	uint64_t elapsed;
+
+	if (video_scaler_create(&scaler, &to, &from, c->type) !=
+		VIDEO_SCALER_SUCCESS)
+		return 0.0;
+
+	scaler->kernels = kernels;
+	alloc_output(&out, c->format, dst_width, dst_height);
+
+	/* once to warm up the caches and fault the output in */
+	video_scaler_scale(scaler, out.data, out.linesize, in, in_linesize);
+
+	start = os_gettime_ns();
+	do {
+		video_scaler_scale(scaler, out.data, out.linesize, in,
+			in_linesize);
+		frames++;
+		elapsed = os_gettime_ns() - start;
+	} while (elapsed < BENCH_TIME_NS);
+
+	bfree(out.data[0]);
+	video_scaler_destroy(scaler);
+
+	return (double)frames * src_width * src_height * 1000.0 /
+		(double)elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+	const struct scaler_kernels* tests[4];
+	size_t num_tests = 0;
+	uint32_t features = os_get_cpu_features();
+	uint32_t src_width = 1920, src_height = 1080;
+	uint32_t dst_width = 1280, dst_height = 720;
+	uint8_t* src;
+
+	if (argc == 5) {
+		src_width = (uint32_t)strtoul(argv[1], NULL, 10);
+		src_height = (uint32_t)strtoul(argv[2], NULL, 10);
+		dst_width = (uint32_t)strtoul(argv[3], NULL, 10);
+		dst_height = (uint32_t)strtoul(argv[4], NULL, 10);
+	}
+	if (!src_width || !src_height || !dst_width || !dst_height) {
+		printf("usage: %s [src_width src_height dst_width "
+			"dst_height]\n", argv[0]);
+		return 1;
+	}
+
+	tests[num_tests++] = &kernels_c;
+#if defined(SCALER_X86)
+	if (features & OS_CPU_SSE2)
+		tests[num_tests++] = &kernels_sse2;
+	if (features & OS_CPU_AVX2)
+		tests[num_tests++] = &kernels_avx2;
+#elif defined(SCALER_NEON)
+	if (features & OS_CPU_NEON)
+		tests[num_tests++] = &kernels_neon;
+#endif
+	UNUSED_PARAMETER(features);
+
+	src = bmalloc((size_t)src_width * src_height * 4);
+	for (size_t i = 0; i < (size_t)src_width * src_height * 4; i++)
+		src[i] = (uint8_t)(i * 7 + i / 8192);
+
+	printf("%ux%u BGRA to %ux%u, source MPix/s\n", src_width, src_height,
+		dst_width, dst_height);
+
+	printf("%-20s", "");
+	for (size_t k = 0; k < num_tests; k++)
+		printf("%10s", tests[k]->name);
+	printf("\n");
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		printf("%-20s", cases[i].name);
+		for (size_t k = 0; k < num_tests; k++) {
+			printf("%10.1f", bench_kernels(tests[k], &cases[i],
+				src, src_width, src_height, dst_width,
+				dst_height));
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+
+	bfree(src);
+	return 0;
+}
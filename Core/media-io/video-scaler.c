@@ -0,0 +1,1337 @@
+#include <math.h>
+#include "../util/bmem.h"
+#include "../util/platform.h"
+#include "../util/simde/simde-arch.h"
+#include "video-scaler.h"
+#include "video-slice.h"
+
+#if defined(SIMDE_ARCH_X86) || defined(SIMDE_ARCH_AMD64)
+#define SCALER_X86
+#include <immintrin.h>
+#elif defined(SIMDE_ARCH_ARM_NEON)
+#define SCALER_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+/*
+ * Native scaler for packed RGB sources.  Each source row is filtered
+ * horizontally exactly once into a small ring of rows, the ring is filtered
+ * vertically into a single output-width RGB row, and that row is converted
+ * to the destination format while it is still in cache.  The full-size
+ * source is therefore read once per frame and nothing full-size is written
+ * besides the destination planes.
+ *
+ * Coefficients are 14-bit fixed point, and 6 extra bits of precision are
+ * kept in the int16 rows between the horizontal and vertical passes.
+ */
+
+#define FILTER_BITS 14
+#define INTER_BITS 6
+#define FILTER_ONE (1 << FILTER_BITS)
+
+/* sources smaller than the filter still get every tap: the window starts
+ * at 0, and the taps past the edge have zero coefficients */
+struct scale_filter {
+	uint32_t taps; /* always even so kernels can work on tap pairs */
+	uint32_t count;
+	int32_t* pos;
+	int16_t* coefs;
+};
+
+struct scale_row {
+	int16_t* data;
+	int32_t src_row;
+};
+
+/* scratch state for scaling one run of output rows */
+struct scale_context {
+	struct scale_row* ring;
+	const int16_t** row_ptrs;
+	uint8_t* rgb[2];
+	uint8_t* padded; /* source row, if narrower than hfilter.taps */
+};
+
+struct video_scaler;
+
+/* every kernel starts at column start, so that vector kernels can leave
+ * the last columns to a narrower kernel */
+struct scaler_kernels {
+	const char* name;
+	void (*hscale)(int16_t* dst, const uint8_t* src,
+		const struct scale_filter* filter, uint32_t start);
+	void (*vscale)(uint8_t* dst, const int16_t* const* rows,
+		const int16_t* coefs, uint32_t taps, size_t start,
+		size_t count);
+	void (*convert_y)(const struct video_scaler* scaler, uint8_t* y_out,
+		const uint8_t* rgb, uint32_t start);
+	void (*convert_444)(const struct video_scaler* scaler,
+		uint8_t* const planes[3], const uint8_t* rgb, uint32_t start);
+	void (*convert_420)(const struct video_scaler* scaler,
+		uint8_t* u_out, uint8_t* v_out, size_t uv_step,
+		const uint8_t* rgb0, const uint8_t* rgb1, uint32_t start);
+};
+
+struct video_scaler {
+	struct video_scale_info src;
+	struct video_scale_info dst;
+	const struct scaler_kernels* kernels;
+
+	struct scale_filter hfilter;
+	struct scale_filter vfilter;
+
+	/* one context per slice that can run at the same time */
+	struct scale_context* contexts;
+	uint32_t num_contexts;
+	video_slice_pool_t* pool;
+
+	/* RGB to YUV in 1.15 fixed point, ordered like the channels of a
+	 * source pixel */
+	int16_t y_coefs[4];
+	int16_t u_coefs[4];
+	int16_t v_coefs[4];
+	int32_t y_offset;
+	int32_t uv_offset;
+};
+
+/* ------------------------------------------------------------------------- */
+/* filter construction */
+
+static inline double filter_weight(enum video_scale_type type, double x)
+{
+	x = fabs(x);
+
+	if (type == VIDEO_SCALE_BICUBIC) {
+		const double a = -0.5;
+		if (x < 1.0)
+			return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+		if (x < 2.0)
+			return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+		return 0.0;
+	}
+
+	return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static inline double area_overlap(double a0, double a1, double b0, double b1)
+{
+	double lo = a0 > b0 ? a0 : b0;
+	double hi = a1 < b1 ? a1 : b1;
+	return hi > lo ? hi - lo : 0.0;
+}
+
+static inline int32_t clamp_i32(int32_t val, int32_t lo, int32_t hi)
+{
+	return val < lo ? lo : (val > hi ? hi : val);
+}
+
+static bool init_filter(struct scale_filter* filter,
+	enum video_scale_type type, uint32_t src_size,
+	uint32_t dst_size)
+{
+	const double scale = (double)src_size / (double)dst_size;
+	double widen = 1.0;
+	double support;
+	double* weights;
+
+	if (type == VIDEO_SCALE_AREA && scale <= 1.0)
+		type = VIDEO_SCALE_BILINEAR;
+
+	switch (type) {
+	case VIDEO_SCALE_POINT:
+		support = 0.5;
+		break;
+	case VIDEO_SCALE_FAST_BILINEAR:
+		support = 1.0;
+		break;
+	case VIDEO_SCALE_BICUBIC:
+		widen = scale > 1.0 ? scale : 1.0;
+		support = 2.0 * widen;
+		break;
+	case VIDEO_SCALE_AREA:
+		support = scale * 0.5 + 0.5;
+		break;
+	default:
+		widen = scale > 1.0 ? scale : 1.0;
+		support = widen;
+	}
+
+	if (!src_size || !dst_size)
+		return false;
+
+	filter->taps = ((uint32_t)ceil(support * 2.0) + 2) & ~1;
+
+	filter->count = dst_size;
+	filter->pos = bmalloc(sizeof(int32_t) * dst_size);
+	filter->coefs = bzalloc(sizeof(int16_t) * dst_size * filter->taps);
+	weights = bmalloc(sizeof(double) * filter->taps);
+
+	for (uint32_t i = 0; i < dst_size; i++) {
+		const double center = ((double)i + 0.5) * scale - 0.5;
+		int16_t* coefs = filter->coefs + (size_t)i * filter->taps;
+		int32_t start, window;
+		double sum = 0.0;
+		int32_t total = 0;
+		uint32_t best = 0;
+
+		if (type == VIDEO_SCALE_POINT)
+			start = (int32_t)floor(center + 0.5);
+		else if (type == VIDEO_SCALE_AREA)
+			start = (int32_t)floor((double)i * scale);
+		else
+			start = (int32_t)floor(center - support) + 1;
+
+		window = filter->taps < src_size ? clamp_i32(start, 0,
+			(int32_t)(src_size - filter->taps)) : 0;
+		memset(weights, 0, sizeof(double) * filter->taps);
+
+		for (uint32_t k = 0; k < filter->taps; k++) {
+			const int32_t j = start + (int32_t)k;
+			int32_t idx;
+			double w;
+
+			if (type == VIDEO_SCALE_POINT)
+				w = k == 0 ? 1.0 : 0.0;
+			else if (type == VIDEO_SCALE_AREA)
+				w = area_overlap(j, j + 1.0, i * scale,
+					(i + 1.0) * scale);
+			else
+				w = filter_weight(type, (j - center) / widen);
+
+			/* samples past the edges repeat the edge pixel */
+			idx = clamp_i32(j, 0, (int32_t)src_size - 1) - window;
+			idx = clamp_i32(idx, 0, (int32_t)filter->taps - 1);
+			weights[idx] += w;
+			sum += w;
+		}
+
+		for (uint32_t k = 0; k < filter->taps; k++) {
+			const double w = weights[k] / sum;
+			coefs[k] = (int16_t)floor(w * FILTER_ONE + 0.5);
+			total += coefs[k];
+
+			if (fabs(weights[k]) > fabs(weights[best]))
+				best = k;
+		}
+
+		coefs[best] += (int16_t)(FILTER_ONE - total);
+		filter->pos[i] = window;
+	}
+
+	bfree(weights);
+	return true;
+}
+
+static inline void free_filter(struct scale_filter* filter)
+{
+	bfree(filter->pos);
+	bfree(filter->coefs);
+}
+
+/* ------------------------------------------------------------------------- */
+/* scaling kernels */
+
+static inline uint8_t clamp_u8(int32_t val)
+{
+	return (uint8_t)(val < 0 ? 0 : (val > 255 ? 255 : val));
+}
+
+static void hscale_c(int16_t* dst, const uint8_t* src,
+	const struct scale_filter* filter, uint32_t start)
+{
+	const int32_t round = 1 << (FILTER_BITS - INTER_BITS - 1);
+	const int16_t* coefs = filter->coefs + (size_t)start * filter->taps;
+
+	for (uint32_t x = start; x < filter->count; x++) {
+		const uint8_t* p = src + (size_t)filter->pos[x] * 4;
+		int32_t sum[4] = { round, round, round, round };
+
+		for (uint32_t k = 0; k < filter->taps; k++) {
+			const int32_t c = coefs[k];
+			sum[0] += p[k * 4 + 0] * c;
+			sum[1] += p[k * 4 + 1] * c;
+			sum[2] += p[k * 4 + 2] * c;
+			sum[3] += p[k * 4 + 3] * c;
+		}
+
+		for (size_t c = 0; c < 4; c++)
+			dst[x * 4 + c] =
+			(int16_t)(sum[c] >> (FILTER_BITS - INTER_BITS));
+
+		coefs += filter->taps;
+	}
+}
+
+static void vscale_c(uint8_t* dst, const int16_t* const* rows,
+	const int16_t* coefs, uint32_t taps, size_t start,
+	size_t count)
+{
+	const int32_t round = 1 << (FILTER_BITS + INTER_BITS - 1);
+
+	for (size_t i = start; i < count; i++) {
+		int32_t sum = round;
+		for (uint32_t k = 0; k < taps; k++)
+			sum += rows[k][i] * coefs[k];
+
+		dst[i] = clamp_u8(sum >> (FILTER_BITS + INTER_BITS));
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* color conversion of the scaled rows */
+
+static inline void set_pixel_coefs(int16_t coefs[4], size_t r_idx,
+	size_t b_idx, double r, double g, double b)
+{
+	coefs[r_idx] = (int16_t)floor(r + 0.5);
+	coefs[1] = (int16_t)floor(g + 0.5);
+	coefs[b_idx] = (int16_t)floor(b + 0.5);
+	coefs[3] = 0;
+}
+
+static void init_yuv_coefs(struct video_scaler* scaler)
+{
+	const bool full = resolve_video_range(scaler->dst.format,
+		scaler->dst.range) == VIDEO_RANGE_FULL;
+	const double kr = scaler->dst.colorspace == VIDEO_CS_601 ? 0.299
+		: 0.2126;
+	const double kb = scaler->dst.colorspace == VIDEO_CS_601 ? 0.114
+		: 0.0722;
+	const double kg = 1.0 - kr - kb;
+	const double ys = (full ? 1.0 : 219.0 / 255.0) * 32768.0;
+	const double cs = (full ? 1.0 : 224.0 / 255.0) * 32768.0;
+	const size_t r = scaler->src.format == VIDEO_FORMAT_RGBA ? 0 : 2;
+	const size_t b = 2 - r;
+
+	set_pixel_coefs(scaler->y_coefs, r, b, kr * ys, kg * ys, kb * ys);
+	set_pixel_coefs(scaler->u_coefs, r, b, -kr / (2.0 - 2.0 * kb) * cs,
+		-kg / (2.0 - 2.0 * kb) * cs, 0.5 * cs);
+	set_pixel_coefs(scaler->v_coefs, r, b, 0.5 * cs,
+		-kg / (2.0 - 2.0 * kr) * cs, -kb / (2.0 - 2.0 * kr) * cs);
+
+	scaler->y_offset = ((full ? 0 : 16) << 15) + (1 << 14);
+	scaler->uv_offset = (128 << 15) + (1 << 14);
+}
+
+static inline uint8_t pixel_to_comp(const int16_t coefs[4], int32_t offset,
+	int32_t c0, int32_t c1, int32_t c2)
+{
+	return clamp_u8((coefs[0] * c0 + coefs[1] * c1 + coefs[2] * c2 +
+		offset) >> 15);
+}
+
+static void convert_y_c(const struct video_scaler* scaler, uint8_t* y_out,
+	const uint8_t* rgb, uint32_t start)
+{
+	for (uint32_t x = start; x < scaler->dst.width; x++) {
+		const uint8_t* p = rgb + (size_t)x * 4;
+		y_out[x] = pixel_to_comp(scaler->y_coefs, scaler->y_offset,
+			p[0], p[1], p[2]);
+	}
+}
+
+static void convert_444_c(const struct video_scaler* scaler,
+	uint8_t* const planes[3], const uint8_t* rgb, uint32_t start)
+{
+	for (uint32_t x = start; x < scaler->dst.width; x++) {
+		const uint8_t* p = rgb + (size_t)x * 4;
+
+		planes[0][x] = pixel_to_comp(scaler->y_coefs,
+			scaler->y_offset, p[0], p[1], p[2]);
+		planes[1][x] = pixel_to_comp(scaler->u_coefs,
+			scaler->uv_offset, p[0], p[1], p[2]);
+		planes[2][x] = pixel_to_comp(scaler->v_coefs,
+			scaler->uv_offset, p[0], p[1], p[2]);
+	}
+}
+
+/* chroma of a 2x2 block is computed from the averaged RGB of the block.
+ * start is an even column of the scaled rows, u_out and v_out point to
+ * the start of the chroma rows. */
+static void convert_420_c(const struct video_scaler* scaler, uint8_t* u_out,
+	uint8_t* v_out, size_t uv_step, const uint8_t* rgb0,
+	const uint8_t* rgb1, uint32_t start)
+{
+	const uint32_t width = scaler->dst.width;
+
+	for (uint32_t x = start; x < width; x += 2) {
+		const size_t x1 = x + 1 < width ? x + 1 : x;
+		const uint8_t* p[4] = { rgb0 + (size_t)x * 4, rgb0 + x1 * 4,
+				       rgb1 + (size_t)x * 4, rgb1 + x1 * 4 };
+		const size_t out = (size_t)(x / 2) * uv_step;
+		int32_t c[3] = { 2, 2, 2 };
+
+		for (size_t i = 0; i < 4; i++) {
+			c[0] += p[i][0];
+			c[1] += p[i][1];
+			c[2] += p[i][2];
+		}
+
+		u_out[out] = pixel_to_comp(scaler->u_coefs, scaler->uv_offset,
+			c[0] >> 2, c[1] >> 2, c[2] >> 2);
+		v_out[out] = pixel_to_comp(scaler->v_coefs, scaler->uv_offset,
+			c[0] >> 2, c[1] >> 2, c[2] >> 2);
+	}
+}
+
+static const struct scaler_kernels kernels_c = { "C", hscale_c, vscale_c,
+						convert_y_c, convert_444_c,
+						convert_420_c };
+
+/* ------------------------------------------------------------------------- */
+/* x86 kernels */
+
+#ifdef SCALER_X86
+static inline int32_t coef_pair(const int16_t* coefs)
+{
+	return (int32_t)((uint32_t)(uint16_t)coefs[0] |
+		((uint32_t)(uint16_t)coefs[1] << 16));
+}
+
+TARGET_SSE2 static void hscale_sse2(int16_t* dst, const uint8_t* src,
+	const struct scale_filter* filter, uint32_t start)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round =
+		_mm_set1_epi32(1 << (FILTER_BITS - INTER_BITS - 1));
+	const int16_t* coefs = filter->coefs + (size_t)start * filter->taps;
+
+	for (uint32_t x = start; x < filter->count; x++) {
+		const uint8_t* p = src + (size_t)filter->pos[x] * 4;
+		__m128i sum = round;
+
+		for (uint32_t k = 0; k < filter->taps; k += 2) {
+			/* interleave the channels of two neighbouring pixels
+			 * so that madd yields a * c0 + b * c1 per channel */
+			__m128i px = _mm_loadl_epi64(
+				(const __m128i*)(p + (size_t)k * 4));
+			px = _mm_unpacklo_epi8(px, zero);
+			px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+
+			sum = _mm_add_epi32(sum,
+				_mm_madd_epi16(px, _mm_set1_epi32(coef_pair(
+					coefs + k))));
+		}
+
+		sum = _mm_srai_epi32(sum, FILTER_BITS - INTER_BITS);
+		_mm_storel_epi64((__m128i*)(dst + (size_t)x * 4),
+			_mm_packs_epi32(sum, sum));
+
+		coefs += filter->taps;
+	}
+}
+
+TARGET_SSE2 static void vscale_sse2(uint8_t* dst, const int16_t* const* rows,
+	const int16_t* coefs, uint32_t taps,
+	size_t start, size_t count)
+{
+	const __m128i round =
+		_mm_set1_epi32(1 << (FILTER_BITS + INTER_BITS - 1));
+	size_t i = start;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = round;
+		__m128i hi = round;
+
+		for (uint32_t k = 0; k < taps; k += 2) {
+			__m128i a = _mm_loadu_si128(
+				(const __m128i*)(rows[k] + i));
+			__m128i b = _mm_loadu_si128(
+				(const __m128i*)(rows[k + 1] + i));
+			__m128i c = _mm_set1_epi32(coef_pair(coefs + k));
+
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(
+				_mm_unpacklo_epi16(a, b), c));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(
+				_mm_unpackhi_epi16(a, b), c));
+		}
+
+		lo = _mm_srai_epi32(lo, FILTER_BITS + INTER_BITS);
+		hi = _mm_srai_epi32(hi, FILTER_BITS + INTER_BITS);
+		lo = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)(dst + i),
+			_mm_packus_epi16(lo, lo));
+	}
+
+	vscale_c(dst, rows, coefs, taps, i, count);
+}
+
+TARGET_SSE2 static inline __m128i load_pixel_coefs_sse2(
+	const int16_t coefs[4])
+{
+	const __m128i c = _mm_loadl_epi64((const __m128i*)coefs);
+	return _mm_unpacklo_epi64(c, c);
+}
+
+/* lo and hi hold 16-bit pixels 0-1 and 2-3, the two halves of the dot
+ * product of each pixel are added up by picking the even and odd dwords */
+TARGET_SSE2 static inline __m128i pixels_to_comp_sse2(__m128i lo, __m128i hi,
+	__m128i coefs, __m128i offset)
+{
+	const __m128 a = _mm_castsi128_ps(_mm_madd_epi16(lo, coefs));
+	const __m128 b = _mm_castsi128_ps(_mm_madd_epi16(hi, coefs));
+	const __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+	const __m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+	__m128i sum = _mm_add_epi32(_mm_castps_si128(even),
+		_mm_castps_si128(odd));
+
+	return _mm_srai_epi32(_mm_add_epi32(sum, offset), 15);
+}
+
+TARGET_SSE2 static void convert_y_sse2(const struct video_scaler* scaler,
+	uint8_t* y_out, const uint8_t* rgb, uint32_t start)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i coefs = load_pixel_coefs_sse2(scaler->y_coefs);
+	const __m128i offset = _mm_set1_epi32(scaler->y_offset);
+	uint32_t x = start;
+
+	for (; x + 8 <= scaler->dst.width; x += 8) {
+		const __m128i* p = (const __m128i*)(rgb + (size_t)x * 4);
+		const __m128i p0 = _mm_loadu_si128(p);
+		const __m128i p1 = _mm_loadu_si128(p + 1);
+		__m128i y;
+
+		y = _mm_packs_epi32(
+			pixels_to_comp_sse2(_mm_unpacklo_epi8(p0, zero),
+				_mm_unpackhi_epi8(p0, zero), coefs, offset),
+			pixels_to_comp_sse2(_mm_unpacklo_epi8(p1, zero),
+				_mm_unpackhi_epi8(p1, zero), coefs, offset));
+		_mm_storel_epi64((__m128i*)(y_out + x),
+			_mm_packus_epi16(y, y));
+	}
+
+	convert_y_c(scaler, y_out, rgb, x);
+}
+
+TARGET_SSE2 static void convert_444_sse2(const struct video_scaler* scaler,
+	uint8_t* const planes[3], const uint8_t* rgb, uint32_t start)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i coefs[3] = { load_pixel_coefs_sse2(scaler->y_coefs),
+				  load_pixel_coefs_sse2(scaler->u_coefs),
+				  load_pixel_coefs_sse2(scaler->v_coefs) };
+	const __m128i y_offset = _mm_set1_epi32(scaler->y_offset);
+	const __m128i uv_offset = _mm_set1_epi32(scaler->uv_offset);
+	uint32_t x = start;
+
+	for (; x + 8 <= scaler->dst.width; x += 8) {
+		const __m128i* p = (const __m128i*)(rgb + (size_t)x * 4);
+		const __m128i p0 = _mm_loadu_si128(p);
+		const __m128i p1 = _mm_loadu_si128(p + 1);
+		const __m128i px[4] = { _mm_unpacklo_epi8(p0, zero),
+				       _mm_unpackhi_epi8(p0, zero),
+				       _mm_unpacklo_epi8(p1, zero),
+				       _mm_unpackhi_epi8(p1, zero) };
+
+		for (size_t i = 0; i < 3; i++) {
+			const __m128i offset = i ? uv_offset : y_offset;
+			__m128i c = _mm_packs_epi32(
+				pixels_to_comp_sse2(px[0], px[1], coefs[i],
+					offset),
+				pixels_to_comp_sse2(px[2], px[3], coefs[i],
+					offset));
+			_mm_storel_epi64((__m128i*)(planes[i] + x),
+				_mm_packus_epi16(c, c));
+		}
+	}
+
+	convert_444_c(scaler, planes, rgb, x);
+}
+
+/* averages the 2x2 blocks of 4 pixels of two rows, giving 16-bit blocks
+ * 0-1 */
+TARGET_SSE2 static inline __m128i average_blocks_sse2(const uint8_t* rgb0,
+	const uint8_t* rgb1)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i r0 = _mm_loadu_si128((const __m128i*)rgb0);
+	const __m128i r1 = _mm_loadu_si128((const __m128i*)rgb1);
+	__m128i a = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero),
+		_mm_unpacklo_epi8(r1, zero));
+	__m128i b = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero),
+		_mm_unpackhi_epi8(r1, zero));
+
+	a = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+	return _mm_srli_epi16(_mm_add_epi16(a, _mm_set1_epi16(2)), 2);
+}
+
+/* uv holds 8 u samples followed by 8 v samples */
+TARGET_SSE2 static inline void store_chroma_sse2(uint8_t* u_out,
+	uint8_t* v_out, size_t uv_step, size_t idx, __m128i uv)
+{
+	if (uv_step == 2) {
+		_mm_storeu_si128((__m128i*)(u_out + idx * 2),
+			_mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 8)));
+	} else {
+		_mm_storel_epi64((__m128i*)(u_out + idx), uv);
+		_mm_storel_epi64((__m128i*)(v_out + idx),
+			_mm_srli_si128(uv, 8));
+	}
+}
+
+TARGET_SSE2 static void convert_420_sse2(const struct video_scaler* scaler,
+	uint8_t* u_out, uint8_t* v_out, size_t uv_step,
+	const uint8_t* rgb0, const uint8_t* rgb1, uint32_t start)
+{
+	const __m128i u_coefs = load_pixel_coefs_sse2(scaler->u_coefs);
+	const __m128i v_coefs = load_pixel_coefs_sse2(scaler->v_coefs);
+	const __m128i offset = _mm_set1_epi32(scaler->uv_offset);
+	uint32_t x = start;
+
+	for (; x + 16 <= scaler->dst.width; x += 16) {
+		const uint8_t* p0 = rgb0 + (size_t)x * 4;
+		const uint8_t* p1 = rgb1 + (size_t)x * 4;
+		const __m128i blocks[4] = {
+			average_blocks_sse2(p0, p1),
+			average_blocks_sse2(p0 + 16, p1 + 16),
+			average_blocks_sse2(p0 + 32, p1 + 32),
+			average_blocks_sse2(p0 + 48, p1 + 48) };
+		__m128i u, v;
+
+		u = _mm_packs_epi32(
+			pixels_to_comp_sse2(blocks[0], blocks[1], u_coefs,
+				offset),
+			pixels_to_comp_sse2(blocks[2], blocks[3], u_coefs,
+				offset));
+		v = _mm_packs_epi32(
+			pixels_to_comp_sse2(blocks[0], blocks[1], v_coefs,
+				offset),
+			pixels_to_comp_sse2(blocks[2], blocks[3], v_coefs,
+				offset));
+
+		store_chroma_sse2(u_out, v_out, uv_step, x / 2,
+			_mm_packus_epi16(u, v));
+	}
+
+	convert_420_c(scaler, u_out, v_out, uv_step, rgb0, rgb1, x);
+}
+
+/* sums the taps of one output pixel, four taps at a time.  the shuffle
+ * widens source pixels k, k + 1 into the low lane and k + 2, k + 3 into
+ * the high lane, with the channels of the two pixels of a lane
+ * interleaved so that madd yields a * c0 + b * c1 per channel. */
+TARGET_AVX2 static inline __m256i hscale_pixel_avx2(const uint8_t* p,
+	const int16_t* coefs, uint32_t taps)
+{
+	const __m256i interleave = _mm256_setr_epi8(
+		0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1,
+		8, -1, 12, -1, 9, -1, 13, -1, 10, -1, 14, -1, 11, -1, 15, -1);
+	const __m256i pair_idx = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+	__m256i sum = _mm256_setzero_si256();
+	uint32_t k = 0;
+
+	for (; k + 4 <= taps; k += 4) {
+		__m256i px = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+			(const __m128i*)(p + (size_t)k * 4)));
+		__m256i c = _mm256_permutevar8x32_epi32(
+			_mm256_castsi128_si256(_mm_loadl_epi64(
+				(const __m128i*)(coefs + k))), pair_idx);
+
+		px = _mm256_shuffle_epi8(px, interleave);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(px, c));
+	}
+
+	/* two taps left, the high lane only sees zeros */
+	if (k < taps) {
+		__m256i px = _mm256_broadcastsi128_si256(_mm_loadl_epi64(
+			(const __m128i*)(p + (size_t)k * 4)));
+
+		px = _mm256_shuffle_epi8(px, interleave);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(px,
+			_mm256_set1_epi32(coef_pair(coefs + k))));
+	}
+
+	return sum;
+}
+
+TARGET_AVX2 static void hscale_avx2(int16_t* dst, const uint8_t* src,
+	const struct scale_filter* filter, uint32_t start)
+{
+	const __m256i round =
+		_mm256_set1_epi32(1 << (FILTER_BITS - INTER_BITS - 1));
+	const uint32_t taps = filter->taps;
+	const int16_t* coefs = filter->coefs + (size_t)start * taps;
+	uint32_t x = start;
+
+	for (; x + 2 <= filter->count; x += 2) {
+		__m256i a = hscale_pixel_avx2(
+			src + (size_t)filter->pos[x] * 4, coefs, taps);
+		__m256i b = hscale_pixel_avx2(
+			src + (size_t)filter->pos[x + 1] * 4, coefs + taps,
+			taps);
+
+		/* add up the lanes of each pixel, a in the low lane */
+		a = _mm256_add_epi32(_mm256_permute2x128_si256(a, b, 0x20),
+			_mm256_permute2x128_si256(a, b, 0x31));
+		a = _mm256_add_epi32(a, round);
+		a = _mm256_srai_epi32(a, FILTER_BITS - INTER_BITS);
+		a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, a), 0x08);
+		_mm_storeu_si128((__m128i*)(dst + (size_t)x * 4),
+			_mm256_castsi256_si128(a));
+
+		coefs += taps * 2;
+	}
+
+	hscale_sse2(dst, src, filter, x);
+}
+
+TARGET_AVX2 static void vscale_avx2(uint8_t* dst, const int16_t* const* rows,
+	const int16_t* coefs, uint32_t taps,
+	size_t start, size_t count)
+{
+	const __m256i round =
+		_mm256_set1_epi32(1 << (FILTER_BITS + INTER_BITS - 1));
+	size_t i = start;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i lo = round;
+		__m256i hi = round;
+
+		for (uint32_t k = 0; k < taps; k += 2) {
+			__m256i a = _mm256_loadu_si256(
+				(const __m256i*)(rows[k] + i));
+			__m256i b = _mm256_loadu_si256(
+				(const __m256i*)(rows[k + 1] + i));
+			__m256i c = _mm256_set1_epi32(coef_pair(coefs + k));
+
+			lo = _mm256_add_epi32(lo, _mm256_madd_epi16(
+				_mm256_unpacklo_epi16(a, b), c));
+			hi = _mm256_add_epi32(hi, _mm256_madd_epi16(
+				_mm256_unpackhi_epi16(a, b), c));
+		}
+
+		/* unpack/pack work per 128-bit lane, so the packed result
+		 * only needs its two middle quadwords swapped */
+		lo = _mm256_srai_epi32(lo, FILTER_BITS + INTER_BITS);
+		hi = _mm256_srai_epi32(hi, FILTER_BITS + INTER_BITS);
+		lo = _mm256_packs_epi32(lo, hi);
+		lo = _mm256_packus_epi16(lo, lo);
+		lo = _mm256_permute4x64_epi64(lo, 0xD8);
+		_mm_storeu_si128((__m128i*)(dst + i),
+			_mm256_castsi256_si128(lo));
+	}
+
+	vscale_sse2(dst, rows, coefs, taps, i, count);
+}
+
+TARGET_AVX2 static inline __m256i load_pixel_coefs_avx2(
+	const int16_t coefs[4])
+{
+	return _mm256_broadcastq_epi64(
+		_mm_loadl_epi64((const __m128i*)coefs));
+}
+
+/* lo and hi hold 16-bit pixels 0-1 | 4-5 and 2-3 | 6-7, hadd works per
+ * lane and gives the components of pixels 0-3 | 4-7 */
+TARGET_AVX2 static inline __m256i pixels_to_comp_avx2(__m256i lo,
+	__m256i hi, __m256i coefs, __m256i offset)
+{
+	__m256i sum = _mm256_hadd_epi32(_mm256_madd_epi16(lo, coefs),
+		_mm256_madd_epi16(hi, coefs));
+
+	return _mm256_srai_epi32(_mm256_add_epi32(sum, offset), 15);
+}
+
+/* packs the components of pixels 0-7 and 8-15 into 16 bytes.  packs works
+ * per lane and leaves the groups of four in the order 0 2 1 3. */
+TARGET_AVX2 static inline __m128i pack_comp_avx2(__m256i a, __m256i b)
+{
+	const __m256i c = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+		0xD8);
+
+	return _mm_packus_epi16(_mm256_castsi256_si128(c),
+		_mm256_extracti128_si256(c, 1));
+}
+
+TARGET_AVX2 static void convert_y_avx2(const struct video_scaler* scaler,
+	uint8_t* y_out, const uint8_t* rgb, uint32_t start)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i coefs = load_pixel_coefs_avx2(scaler->y_coefs);
+	const __m256i offset = _mm256_set1_epi32(scaler->y_offset);
+	uint32_t x = start;
+
+	for (; x + 16 <= scaler->dst.width; x += 16) {
+		const __m256i* p = (const __m256i*)(rgb + (size_t)x * 4);
+		const __m256i p0 = _mm256_loadu_si256(p);
+		const __m256i p1 = _mm256_loadu_si256(p + 1);
+
+		_mm_storeu_si128((__m128i*)(y_out + x), pack_comp_avx2(
+			pixels_to_comp_avx2(_mm256_unpacklo_epi8(p0, zero),
+				_mm256_unpackhi_epi8(p0, zero), coefs,
+				offset),
+			pixels_to_comp_avx2(_mm256_unpacklo_epi8(p1, zero),
+				_mm256_unpackhi_epi8(p1, zero), coefs,
+				offset)));
+	}
+
+	convert_y_sse2(scaler, y_out, rgb, x);
+}
+
+TARGET_AVX2 static void convert_444_avx2(const struct video_scaler* scaler,
+	uint8_t* const planes[3], const uint8_t* rgb, uint32_t start)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i coefs[3] = { load_pixel_coefs_avx2(scaler->y_coefs),
+				  load_pixel_coefs_avx2(scaler->u_coefs),
+				  load_pixel_coefs_avx2(scaler->v_coefs) };
+	const __m256i y_offset = _mm256_set1_epi32(scaler->y_offset);
+	const __m256i uv_offset = _mm256_set1_epi32(scaler->uv_offset);
+	uint32_t x = start;
+
+	for (; x + 16 <= scaler->dst.width; x += 16) {
+		const __m256i* p = (const __m256i*)(rgb + (size_t)x * 4);
+		const __m256i p0 = _mm256_loadu_si256(p);
+		const __m256i p1 = _mm256_loadu_si256(p + 1);
+		const __m256i px[4] = { _mm256_unpacklo_epi8(p0, zero),
+				       _mm256_unpackhi_epi8(p0, zero),
+				       _mm256_unpacklo_epi8(p1, zero),
+				       _mm256_unpackhi_epi8(p1, zero) };
+
+		for (size_t i = 0; i < 3; i++) {
+			const __m256i offset = i ? uv_offset : y_offset;
+
+			_mm_storeu_si128((__m128i*)(planes[i] + x),
+				pack_comp_avx2(
+					pixels_to_comp_avx2(px[0], px[1],
+						coefs[i], offset),
+					pixels_to_comp_avx2(px[2], px[3],
+						coefs[i], offset)));
+		}
+	}
+
+	convert_444_sse2(scaler, planes, rgb, x);
+}
+
+/* averages the 2x2 blocks of 8 pixels of two rows, giving 16-bit blocks
+ * 0-1 | 2-3 */
+TARGET_AVX2 static inline __m256i average_blocks_avx2(const uint8_t* rgb0,
+	const uint8_t* rgb1)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i r0 = _mm256_loadu_si256((const __m256i*)rgb0);
+	const __m256i r1 = _mm256_loadu_si256((const __m256i*)rgb1);
+	__m256i a = _mm256_add_epi16(_mm256_unpacklo_epi8(r0, zero),
+		_mm256_unpacklo_epi8(r1, zero));
+	__m256i b = _mm256_add_epi16(_mm256_unpackhi_epi8(r0, zero),
+		_mm256_unpackhi_epi8(r1, zero));
+
+	a = _mm256_add_epi16(_mm256_unpacklo_epi64(a, b),
+		_mm256_unpackhi_epi64(a, b));
+	return _mm256_srli_epi16(_mm256_add_epi16(a, _mm256_set1_epi16(2)),
+		2);
+}
+
+TARGET_AVX2 static void convert_420_avx2(const struct video_scaler* scaler,
+	uint8_t* u_out, uint8_t* v_out, size_t uv_step,
+	const uint8_t* rgb0, const uint8_t* rgb1, uint32_t start)
+{
+	/* blocks come out as 0 1 4 5 | 2 3 6 7, and the u and v dwords are
+	 * gathered in order once packed to 16 bits */
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256i u_coefs = load_pixel_coefs_avx2(scaler->u_coefs);
+	const __m256i v_coefs = load_pixel_coefs_avx2(scaler->v_coefs);
+	const __m256i offset = _mm256_set1_epi32(scaler->uv_offset);
+	uint32_t x = start;
+
+	for (; x + 16 <= scaler->dst.width; x += 16) {
+		const uint8_t* p0 = rgb0 + (size_t)x * 4;
+		const uint8_t* p1 = rgb1 + (size_t)x * 4;
+		const __m256i lo = average_blocks_avx2(p0, p1);
+		const __m256i hi = average_blocks_avx2(p0 + 32, p1 + 32);
+		__m256i uv;
+
+		uv = _mm256_packs_epi32(
+			pixels_to_comp_avx2(lo, hi, u_coefs, offset),
+			pixels_to_comp_avx2(lo, hi, v_coefs, offset));
+		uv = _mm256_permutevar8x32_epi32(uv, order);
+
+		store_chroma_sse2(u_out, v_out, uv_step, x / 2,
+			_mm_packus_epi16(_mm256_castsi256_si128(uv),
+				_mm256_extracti128_si256(uv, 1)));
+	}
+
+	convert_420_sse2(scaler, u_out, v_out, uv_step, rgb0, rgb1, x);
+}
+
+static const struct scaler_kernels kernels_sse2 = {
+	"SSE2", hscale_sse2, vscale_sse2, convert_y_sse2, convert_444_sse2,
+	convert_420_sse2 };
+static const struct scaler_kernels kernels_avx2 = {
+	"AVX2", hscale_avx2, vscale_avx2, convert_y_avx2, convert_444_avx2,
+	convert_420_avx2 };
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* NEON kernels */
+
+#ifdef SCALER_NEON
+static void hscale_neon(int16_t* dst, const uint8_t* src,
+	const struct scale_filter* filter, uint32_t start)
+{
+	const int32x4_t round =
+		vdupq_n_s32(1 << (FILTER_BITS - INTER_BITS - 1));
+	const int16_t* coefs = filter->coefs + (size_t)start * filter->taps;
+
+	for (uint32_t x = start; x < filter->count; x++) {
+		const uint8_t* p = src + (size_t)filter->pos[x] * 4;
+		int32x4_t sum = round;
+
+		for (uint32_t k = 0; k < filter->taps; k += 2) {
+			const int16x8_t px = vreinterpretq_s16_u16(
+				vmovl_u8(vld1_u8(p + (size_t)k * 4)));
+
+			sum = vmlal_n_s16(sum, vget_low_s16(px), coefs[k]);
+			sum = vmlal_n_s16(sum, vget_high_s16(px),
+				coefs[k + 1]);
+		}
+
+		vst1_s16(dst + (size_t)x * 4, vqmovn_s32(
+			vshrq_n_s32(sum, FILTER_BITS - INTER_BITS)));
+
+		coefs += filter->taps;
+	}
+}
+
+static void vscale_neon(uint8_t* dst, const int16_t* const* rows,
+	const int16_t* coefs, uint32_t taps, size_t start,
+	size_t count)
+{
+	const int32x4_t round = vdupq_n_s32(1 << (FILTER_BITS + INTER_BITS - 1));
+	size_t i = start;
+
+	for (; i + 8 <= count; i += 8) {
+		int32x4_t lo = round;
+		int32x4_t hi = round;
+
+		for (uint32_t k = 0; k < taps; k++) {
+			int16x8_t r = vld1q_s16(rows[k] + i);
+			lo = vmlal_n_s16(lo, vget_low_s16(r), coefs[k]);
+			hi = vmlal_n_s16(hi, vget_high_s16(r), coefs[k]);
+		}
+
+		lo = vshrq_n_s32(lo, FILTER_BITS + INTER_BITS);
+		hi = vshrq_n_s32(hi, FILTER_BITS + INTER_BITS);
+		vst1_u8(dst + i, vqmovun_s16(vcombine_s16(vqmovn_s32(lo),
+			vqmovn_s32(hi))));
+	}
+
+	vscale_c(dst, rows, coefs, taps, i, count);
+}
+
+static inline int16x8_t widen_neon(uint8x8_t val)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(val));
+}
+
+/* c0-c2 hold the channels of 8 pixels, deinterleaved */
+static inline uint8x8_t pixels_to_comp_neon(int16x8_t c0, int16x8_t c1,
+	int16x8_t c2, const int16_t coefs[4], int32_t offset)
+{
+	int32x4_t lo = vdupq_n_s32(offset);
+	int32x4_t hi = lo;
+
+	lo = vmlal_n_s16(lo, vget_low_s16(c0), coefs[0]);
+	hi = vmlal_n_s16(hi, vget_high_s16(c0), coefs[0]);
+	lo = vmlal_n_s16(lo, vget_low_s16(c1), coefs[1]);
+	hi = vmlal_n_s16(hi, vget_high_s16(c1), coefs[1]);
+	lo = vmlal_n_s16(lo, vget_low_s16(c2), coefs[2]);
+	hi = vmlal_n_s16(hi, vget_high_s16(c2), coefs[2]);
+
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, 15)),
+		vqmovn_s32(vshrq_n_s32(hi, 15))));
+}
+
+static void convert_y_neon(const struct video_scaler* scaler,
+	uint8_t* y_out, const uint8_t* rgb, uint32_t start)
+{
+	uint32_t x = start;
+
+	for (; x + 8 <= scaler->dst.width; x += 8) {
+		const uint8x8x4_t px = vld4_u8(rgb + (size_t)x * 4);
+
+		vst1_u8(y_out + x, pixels_to_comp_neon(widen_neon(px.val[0]),
+			widen_neon(px.val[1]), widen_neon(px.val[2]),
+			scaler->y_coefs, scaler->y_offset));
+	}
+
+	convert_y_c(scaler, y_out, rgb, x);
+}
+
+static void convert_444_neon(const struct video_scaler* scaler,
+	uint8_t* const planes[3], const uint8_t* rgb, uint32_t start)
+{
+	uint32_t x = start;
+
+	for (; x + 8 <= scaler->dst.width; x += 8) {
+		const uint8x8x4_t px = vld4_u8(rgb + (size_t)x * 4);
+		const int16x8_t c0 = widen_neon(px.val[0]);
+		const int16x8_t c1 = widen_neon(px.val[1]);
+		const int16x8_t c2 = widen_neon(px.val[2]);
+
+		vst1_u8(planes[0] + x, pixels_to_comp_neon(c0, c1, c2,
+			scaler->y_coefs, scaler->y_offset));
+		vst1_u8(planes[1] + x, pixels_to_comp_neon(c0, c1, c2,
+			scaler->u_coefs, scaler->uv_offset));
+		vst1_u8(planes[2] + x, pixels_to_comp_neon(c0, c1, c2,
+			scaler->v_coefs, scaler->uv_offset));
+	}
+
+	convert_444_c(scaler, planes, rgb, x);
+}
+
+static void convert_420_neon(const struct video_scaler* scaler,
+	uint8_t* u_out, uint8_t* v_out, size_t uv_step,
+	const uint8_t* rgb0, const uint8_t* rgb1, uint32_t start)
+{
+	uint32_t x = start;
+
+	for (; x + 16 <= scaler->dst.width; x += 16) {
+		const uint8x16x4_t a = vld4q_u8(rgb0 + (size_t)x * 4);
+		const uint8x16x4_t b = vld4q_u8(rgb1 + (size_t)x * 4);
+		int16x8_t c[3];
+		uint8x8x2_t uv;
+
+		/* pairwise adds sum up the pixels of a block in each row,
+		 * the rounding shift gives (sum + 2) >> 2 */
+		for (size_t i = 0; i < 3; i++)
+			c[i] = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(
+				vpaddlq_u8(a.val[i]), b.val[i]), 2));
+
+		uv.val[0] = pixels_to_comp_neon(c[0], c[1], c[2],
+			scaler->u_coefs, scaler->uv_offset);
+		uv.val[1] = pixels_to_comp_neon(c[0], c[1], c[2],
+			scaler->v_coefs, scaler->uv_offset);
+
+		if (uv_step == 2) {
+			vst2_u8(u_out + x, uv);
+		} else {
+			vst1_u8(u_out + x / 2, uv.val[0]);
+			vst1_u8(v_out + x / 2, uv.val[1]);
+		}
+	}
+
+	convert_420_c(scaler, u_out, v_out, uv_step, rgb0, rgb1, x);
+}
+
+static const struct scaler_kernels kernels_neon = {
+	"NEON", hscale_neon, vscale_neon, convert_y_neon, convert_444_neon,
+	convert_420_neon };
+#endif
+
+static const struct scaler_kernels* select_kernels(void)
+{
+	uint32_t features = os_get_cpu_features();
+
+#if defined(SCALER_X86)
+	if (features & OS_CPU_AVX2)
+		return &kernels_avx2;
+	if (features & OS_CPU_SSE2)
+		return &kernels_sse2;
+#elif defined(SCALER_NEON)
+	if (features & OS_CPU_NEON)
+		return &kernels_neon;
+#endif
+
+	UNUSED_PARAMETER(features);
+	return &kernels_c;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool packed_rgb_format(enum video_format format)
+{
+	return format == VIDEO_FORMAT_BGRA || format == VIDEO_FORMAT_BGRX ||
+		format == VIDEO_FORMAT_RGBA;
+}
+
+static inline bool same_channel_order(enum video_format a, enum video_format b)
+{
+	return (a == VIDEO_FORMAT_RGBA) == (b == VIDEO_FORMAT_RGBA);
+}
+
+static bool supported_conversion(const struct video_scale_info* dst,
+	const struct video_scale_info* src)
+{
+	if (!packed_rgb_format(src->format))
+		return false;
+
+	switch (dst->format) {
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I444:
+		return true;
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_RGBA:
+		return same_channel_order(dst->format, src->format);
+	default:
+		return false;
+	}
+}
+
+static void init_context(struct video_scaler* scaler,
+	struct scale_context* ctx)
+{
+	const size_t row_size = (size_t)scaler->dst.width * 4;
+	const uint32_t taps = scaler->vfilter.taps;
+
+	/* the rows needed for one output row are always a contiguous run
+	 * of vfilter.taps source rows, so a ring of that size suffices */
+	ctx->ring = bzalloc(sizeof(struct scale_row) * taps);
+	for (uint32_t i = 0; i < taps; i++)
+		ctx->ring[i].data = bmalloc(row_size * sizeof(int16_t));
+
+	ctx->row_ptrs = bzalloc(sizeof(int16_t*) * taps);
+	ctx->rgb[0] = bmalloc(row_size);
+	ctx->rgb[1] = bmalloc(row_size);
+
+	ctx->padded = scaler->hfilter.taps > scaler->src.width ?
+		bzalloc((size_t)scaler->hfilter.taps * 4) : NULL;
+}
+
+static void free_context(struct video_scaler* scaler,
+	struct scale_context* ctx)
+{
+	if (ctx->ring) {
+		for (uint32_t i = 0; i < scaler->vfilter.taps; i++)
+			bfree(ctx->ring[i].data);
+		bfree(ctx->ring);
+	}
+
+	bfree(ctx->row_ptrs);
+	bfree(ctx->rgb[0]);
+	bfree(ctx->rgb[1]);
+	bfree(ctx->padded);
+}
+
+static void set_num_contexts(struct video_scaler* scaler, uint32_t count)
+{
+	for (uint32_t i = count; i < scaler->num_contexts; i++)
+		free_context(scaler, &scaler->contexts[i]);
+
+	if (!count) {
+		bfree(scaler->contexts);
+		scaler->contexts = NULL;
+		scaler->num_contexts = 0;
+		return;
+	}
+
+	scaler->contexts = brealloc(scaler->contexts,
+		sizeof(struct scale_context) * count);
+
+	for (uint32_t i = scaler->num_contexts; i < count; i++)
+		init_context(scaler, &scaler->contexts[i]);
+
+	scaler->num_contexts = count;
+}
+
+int video_scaler_create(video_scaler_t** scaler_out,
+	const struct video_scale_info* dst,
+	const struct video_scale_info* src,
+	enum video_scale_type type)
+{
+	struct video_scaler* scaler;
+
+	if (!scaler_out || !dst || !src)
+		return VIDEO_SCALER_FAILED;
+	if (!supported_conversion(dst, src))
+		return VIDEO_SCALER_BAD_CONVERSION;
+
+	scaler = bzalloc(sizeof(struct video_scaler));
+	scaler->src = *src;
+	scaler->dst = *dst;
+	scaler->kernels = select_kernels();
+
+	if (!init_filter(&scaler->hfilter, type, src->width, dst->width) ||
+		!init_filter(&scaler->vfilter, type, src->height,
+			dst->height)) {
+		video_scaler_destroy(scaler);
+		return VIDEO_SCALER_FAILED;
+	}
+
+	set_num_contexts(scaler, 1);
+
+	init_yuv_coefs(scaler);
+
+	blog(LOG_DEBUG,
+		"video_scaler_create: %ux%u %s -> %ux%u %s, %u/%u taps, "
+		"%s kernels",
+		src->width, src->height, get_video_format_name(src->format),
+		dst->width, dst->height, get_video_format_name(dst->format),
+		scaler->hfilter.taps, scaler->vfilter.taps,
+		scaler->kernels->name);
+
+	*scaler_out = scaler;
+	return VIDEO_SCALER_SUCCESS;
+}
+
+void video_scaler_destroy(video_scaler_t* scaler)
+{
+	if (!scaler)
+		return;
+
+	set_num_contexts(scaler, 0);
+	free_filter(&scaler->hfilter);
+	free_filter(&scaler->vfilter);
+	bfree(scaler);
+}
+
+static void scale_row(struct video_scaler* scaler, struct scale_context* ctx,
+	uint8_t* rgb, uint32_t y, const uint8_t* input, uint32_t in_linesize)
+{
+	const uint32_t taps = scaler->vfilter.taps;
+	const int32_t first = scaler->vfilter.pos[y];
+	const int32_t last_row = (int32_t)scaler->src.height - 1;
+
+	for (uint32_t k = 0; k < taps; k++) {
+		/* rows past the bottom edge have zero coefficients */
+		const int32_t src_row = first + (int32_t)k < last_row ?
+			first + (int32_t)k : last_row;
+		struct scale_row* row = &ctx->ring[(uint32_t)src_row % taps];
+
+		if (row->src_row != src_row) {
+			const uint8_t* src = input +
+				(size_t)src_row * in_linesize;
+
+			if (ctx->padded) {
+				memcpy(ctx->padded, src,
+					(size_t)scaler->src.width * 4);
+				src = ctx->padded;
+			}
+
+			scaler->kernels->hscale(row->data, src,
+				&scaler->hfilter, 0);
+			row->src_row = src_row;
+		}
+
+		ctx->row_ptrs[k] = row->data;
+	}
+
+	scaler->kernels->vscale(rgb, ctx->row_ptrs,
+		scaler->vfilter.coefs + (size_t)y * taps, taps, 0,
+		(size_t)scaler->dst.width * 4);
+}
+
+struct scale_job {
+	struct video_scaler* scaler;
+	uint8_t* const* output;
+	const uint32_t* out_linesize;
+	const uint8_t* input;
+	uint32_t in_linesize;
+	uint8_t* rgb_out;
+	uint32_t rgb_linesize;
+};
+
+static void scale_slice(void* param, uint32_t slice, uint32_t start_y,
+	uint32_t end_y)
+{
+	struct scale_job* job = param;
+	struct video_scaler* scaler = job->scaler;
+	struct scale_context* ctx = &scaler->contexts[slice];
+	const enum video_format format = scaler->dst.format;
+	uint8_t* const* output = job->output;
+	const uint32_t* out_linesize = job->out_linesize;
+
+	for (uint32_t i = 0; i < scaler->vfilter.taps; i++)
+		ctx->ring[i].src_row = -1;
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		uint8_t* rgb = ctx->rgb[y & 1];
+		uint8_t* y_row = output[0] + (size_t)y * out_linesize[0];
+
+		scale_row(scaler, ctx, rgb, y, job->input, job->in_linesize);
+
+		if (job->rgb_out)
+			memcpy(job->rgb_out + (size_t)y * job->rgb_linesize,
+				rgb, (size_t)scaler->dst.width * 4);
+
+		if (packed_rgb_format(format)) {
+			memcpy(y_row, rgb, (size_t)scaler->dst.width * 4);
+
+		}
+		else if (format == VIDEO_FORMAT_I444) {
+			uint8_t* planes[3] = {
+				y_row, output[1] + (size_t)y * out_linesize[1],
+				output[2] + (size_t)y * out_linesize[2] };
+			scaler->kernels->convert_444(scaler, planes, rgb, 0);
+
+		}
+		else {
+			scaler->kernels->convert_y(scaler, y_row, rgb, 0);
+
+			if ((y & 1) == 0 && y + 1 < scaler->dst.height)
+				continue;
+
+			const uint8_t* rgb0 = ctx->rgb[0];
+			const uint8_t* rgb1 = (y & 1) ? ctx->rgb[1] : rgb0;
+			const size_t cy = y / 2;
+
+			if (format == VIDEO_FORMAT_NV12) {
+				uint8_t* uv = output[1] + cy * out_linesize[1];
+				scaler->kernels->convert_420(scaler, uv,
+					uv + 1, 2, rgb0, rgb1, 0);
+			}
+			else {
+				scaler->kernels->convert_420(scaler,
+					output[1] + cy * out_linesize[1],
+					output[2] + cy * out_linesize[2], 1,
+					rgb0, rgb1, 0);
+			}
+		}
+	}
+}
+
+void video_scaler_set_slice_pool(video_scaler_t* scaler,
+	video_slice_pool_t* pool)
+{
+	if (!scaler)
+		return;
+
+	scaler->pool = pool;
+	set_num_contexts(scaler, video_slice_pool_max_slices(pool));
+}
+
+bool video_scaler_scale(video_scaler_t* scaler, uint8_t* output[],
+	const uint32_t out_linesize[],
+	const uint8_t* const input[],
+	const uint32_t in_linesize[])
+{
+	return video_scaler_scale_with_rgb(scaler, output, out_linesize,
+		input, in_linesize, NULL, 0);
+}
+
+bool video_scaler_scale_with_rgb(video_scaler_t* scaler, uint8_t* output[],
+	const uint32_t out_linesize[],
+	const uint8_t* const input[],
+	const uint32_t in_linesize[],
+	uint8_t* rgb, uint32_t rgb_linesize)
+{
+	struct scale_job job;
+	size_t frame_size;
+
+	if (!scaler)
+		return false;
+
+	job.scaler = scaler;
+	job.output = output;
+	job.out_linesize = out_linesize;
+	job.input = input[0];
+	job.in_linesize = in_linesize[0];
+	job.rgb_out = rgb;
+	job.rgb_linesize = rgb_linesize;
+
+	/* slices start on even rows so 4:2:0 chroma rows are never split */
+	frame_size = (size_t)scaler->dst.width * scaler->dst.height * 4;
+	video_slice_pool_run(scaler->pool, scaler->dst.height, 2, frame_size,
+		scale_slice, &job);
+	return true;
+}
@@ -19,6 +19,7 @@
 
 #include "../util/c99defs.h"
 #include "video-io.h"
+#include "video-slice.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,11 +38,24 @@ extern "C" {
         enum video_scale_type type);
     EXPORT void video_scaler_destroy(video_scaler_t* scaler);
 
+    /* splits video_scaler_scale across the threads of pool (may be NULL).
+     * must not be called while the scaler is in use. */
+    EXPORT void video_scaler_set_slice_pool(video_scaler_t* scaler,
+        video_slice_pool_t* pool);
+
     EXPORT bool video_scaler_scale(video_scaler_t* scaler, uint8_t* output[],
         const uint32_t out_linesize[],
         const uint8_t* const input[],
         const uint32_t in_linesize[]);
 
+    /* like video_scaler_scale, but also stores the scaled frame in the
+     * source's packed RGB format in rgb (destination size) before it is
+     * converted, so it can be the source of a further, smaller scaler */
+    EXPORT bool video_scaler_scale_with_rgb(video_scaler_t* scaler,
+        uint8_t* output[], const uint32_t out_linesize[],
+        const uint8_t* const input[], const uint32_t in_linesize[],
+        uint8_t* rgb, uint32_t rgb_linesize);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,101 @@
+#include "../util/bmem.h"
+#include "../util/task-pool.h"
+#include "video-slice.h"
+
+/* below this many bytes per slice, waking a worker costs more than the
+ * work it takes off the calling thread */
+#define MIN_SLICE_SIZE (256 * 1024)
+
+/* slices are run as the tasks of a task pool, which already spreads them
+ * over the threads and lets the caller take part */
+struct video_slice_pool {
+	task_pool_t* tasks;
+};
+
+/* one run, kept on the stack of the caller so that runs share no state */
+struct slice_job {
+	video_slice_cb callback;
+	void* param;
+	uint32_t height;
+	uint32_t rows_per_slice;
+};
+
+static void run_slice(void* param, size_t index)
+{
+	struct slice_job* job = param;
+	uint32_t slice = (uint32_t)index;
+	uint32_t start_y = slice * job->rows_per_slice;
+	uint32_t end_y = start_y + job->rows_per_slice;
+
+	if (end_y > job->height)
+		end_y = job->height;
+
+	job->callback(job->param, slice, start_y, end_y);
+}
+
+video_slice_pool_t* video_slice_pool_create(uint32_t threads)
+{
+	struct video_slice_pool* pool;
+	task_pool_t* tasks;
+
+	tasks = task_pool_create(threads, "video-io: slice thread");
+	if (!tasks)
+		return NULL;
+
+	pool = bzalloc(sizeof(struct video_slice_pool));
+	pool->tasks = tasks;
+	return pool;
+}
+
+void video_slice_pool_destroy(video_slice_pool_t* pool)
+{
+	if (!pool)
+		return;
+
+	task_pool_destroy(pool->tasks);
+	bfree(pool);
+}
+
+uint32_t video_slice_pool_max_slices(const video_slice_pool_t* pool)
+{
+	return pool ? task_pool_get_threads(pool->tasks) : 1;
+}
+
+static inline uint32_t align_rows(uint32_t rows, uint32_t align)
+{
+	return (rows + align - 1) / align * align;
+}
+
+void video_slice_pool_run(video_slice_pool_t* pool, uint32_t height,
+	uint32_t row_align, size_t frame_size,
+	video_slice_cb callback, void* param)
+{
+	struct slice_job job;
+	size_t max_slices;
+	uint32_t slices;
+
+	if (!height)
+		return;
+	if (!row_align)
+		row_align = 1;
+
+	max_slices = frame_size / MIN_SLICE_SIZE;
+	if (!pool || max_slices < 2 || height < row_align * 2) {
+		callback(param, 0, 0, height);
+		return;
+	}
+
+	/* at most one slice per thread, so that slice indices stay below
+	 * video_slice_pool_max_slices() */
+	if (max_slices > task_pool_get_threads(pool->tasks))
+		max_slices = task_pool_get_threads(pool->tasks);
+
+	job.callback = callback;
+	job.param = param;
+	job.height = height;
+	job.rows_per_slice = align_rows((height + (uint32_t)max_slices - 1) /
+		(uint32_t)max_slices, row_align);
+	slices = (height + job.rows_per_slice - 1) / job.rows_per_slice;
+
+	task_pool_run(pool->tasks, slices, run_slice, &job);
+}
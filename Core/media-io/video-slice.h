@@ -0,0 +1,61 @@
+/******************************************************************************
+	Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/*
+	 * Runs per-row video work (conversion, scaling, copying) on a small
+	 * pool of worker threads by splitting the frame into horizontal slices.
+	 * The calling thread processes slices too, and the call returns once
+	 * every slice is done.  Frames too small to benefit are processed
+	 * directly on the calling thread.
+	 */
+
+	struct video_slice_pool;
+	typedef struct video_slice_pool video_slice_pool_t;
+
+	/* slice is in [0, video_slice_pool_max_slices()) and is unique among
+	 * the slices of one run, so it can index per-slice scratch state */
+	typedef void (*video_slice_cb)(void* param, uint32_t slice,
+		uint32_t start_y, uint32_t end_y);
+
+	/* threads: total number of threads doing the work, including the
+	 * caller.  0 picks a count based on the number of CPU cores. */
+	EXPORT video_slice_pool_t* video_slice_pool_create(uint32_t threads);
+	EXPORT void video_slice_pool_destroy(video_slice_pool_t* pool);
+
+	EXPORT uint32_t video_slice_pool_max_slices(const video_slice_pool_t* pool);
+
+	/*
+	 * Calls callback for row slices covering [0, height).  Slice boundaries
+	 * are multiples of row_align (e.g. 2 for 4:2:0 output), and frame_size
+	 * is the approximate number of bytes touched, used to decide how many
+	 * slices are worth it.  pool may be NULL.
+	 */
+	EXPORT void video_slice_pool_run(video_slice_pool_t* pool, uint32_t height,
+		uint32_t row_align, size_t frame_size,
+		video_slice_cb callback, void* param);
+
+#ifdef __cplusplus
+}
+#endif
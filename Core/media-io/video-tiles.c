@@ -0,0 +1,628 @@
+#include <string.h>
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "video-damage.h"
+#include "video-tiles.h"
+
+/*
+ * Packet layout, little endian:
+ *
+ *   u32 magic, u8 format, u8 version, u16 tile size, u32 width, u32 height,
+ *   u64 timestamp, u32 number of changed tiles,
+ *   tile map: one bit per tile, row by row, lowest bit first,
+ *   then for each changed tile in map order: u8 mode, u32 size, payload.
+ *
+ * A tile is the concatenation of its rows in every plane.  Packed tiles
+ * store each row as a filter byte (0: difference to the row above, 1:
+ * difference to the previous sample in the row) followed by the residuals,
+ * and run-length code the result: token n < 0x80 is followed by n + 1
+ * literal bytes, 0x80 <= n < 0xFF stands for n - 0x7F zeros, and 0xFF is
+ * followed by a u16 count of zeros.  Flat areas and unchanged rows of text
+ * come out as long zero runs.  Tiles that do not get smaller are stored
+ * raw.
+ */
+
+#define TILE_MAGIC 0x4C495456 /* "VTIL" */
+#define TILE_VERSION 1
+#define HEADER_SIZE 32
+
+#define TILE_MODE_PACKED 0
+#define TILE_MODE_RAW 1
+
+#define FILTER_UP 0
+#define FILTER_LEFT 1
+
+#define MIN_ZERO_RUN 3
+#define MAX_SHORT_RUN 127
+#define MAX_LONG_RUN 0xFFFF
+#define MAX_LITERALS 128
+
+struct tile_layout {
+	struct video_damage_plane planes[MAX_AV_PLANES];
+	size_t num_planes;
+	uint32_t tile_size;
+	uint32_t cols;
+	uint32_t rows;
+	size_t max_tile_size; /* raw bytes of a full tile */
+	size_t max_rows;      /* rows of a full tile over all planes */
+};
+
+struct video_tile_encoder {
+	struct video_tile_info info;
+	struct tile_layout layout;
+	video_damage_t* damage;
+	bool send_full;
+
+	uint8_t* residuals;
+	uint8_t* packed;
+	DARRAY(uint8_t) packet;
+};
+
+static bool init_layout(struct tile_layout* layout, enum video_format format,
+	uint32_t width, uint32_t height, uint32_t tile_size)
+{
+	layout->num_planes = video_damage_get_layout(format, width, height,
+		tile_size, layout->planes);
+	if (!layout->num_planes)
+		return false;
+
+	layout->tile_size = tile_size;
+	layout->cols = (width + tile_size - 1) / tile_size;
+	layout->rows = (height + tile_size - 1) / tile_size;
+	layout->max_tile_size = 0;
+	layout->max_rows = 0;
+
+	for (size_t p = 0; p < layout->num_planes; p++) {
+		const struct video_damage_plane* plane = &layout->planes[p];
+		layout->max_tile_size +=
+			(size_t)plane->tile_bytes * plane->tile_rows;
+		layout->max_rows += plane->tile_rows;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void put_u16(uint8_t* out, uint16_t val)
+{
+	out[0] = (uint8_t)val;
+	out[1] = (uint8_t)(val >> 8);
+}
+
+static inline void put_u32(uint8_t* out, uint32_t val)
+{
+	put_u16(out, (uint16_t)val);
+	put_u16(out + 2, (uint16_t)(val >> 16));
+}
+
+static inline void put_u64(uint8_t* out, uint64_t val)
+{
+	put_u32(out, (uint32_t)val);
+	put_u32(out + 4, (uint32_t)(val >> 32));
+}
+
+static inline uint16_t get_u16(const uint8_t* in)
+{
+	return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t* in)
+{
+	return get_u16(in) | ((uint32_t)get_u16(in + 2) << 16);
+}
+
+static inline uint64_t get_u64(const uint8_t* in)
+{
+	return get_u32(in) | ((uint64_t)get_u32(in + 4) << 32);
+}
+
+static inline uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* the rectangle of a plane covered by a tile, in bytes and rows */
+static inline void get_tile_rect(const struct video_damage_plane* plane,
+	uint32_t tx, uint32_t ty, uint32_t* x, uint32_t* y, uint32_t* width,
+	uint32_t* height)
+{
+	*x = tx * plane->tile_bytes;
+	*y = ty * plane->tile_rows;
+	*width = min_uint32(plane->tile_bytes, plane->row_bytes - *x);
+	*height = min_uint32(plane->tile_rows, plane->rows - *y);
+}
+
+/* ------------------------------------------------------------------------- */
+/* tile codec */
+
+/* writes the filter byte and residuals of a row, choosing whichever filter
+ * leaves more zeros */
+static uint8_t* filter_row(uint8_t* out, const uint8_t* row,
+	const uint8_t* above, uint32_t width, uint32_t step)
+{
+	uint8_t* up = out + 1;
+	uint32_t up_zeros = 0;
+	uint32_t left_zeros = 0;
+
+	if (above) {
+		for (uint32_t i = 0; i < width; i++) {
+			up[i] = (uint8_t)(row[i] - above[i]);
+			up_zeros += !up[i];
+		}
+
+		for (uint32_t i = 0; i < width; i++) {
+			uint8_t prev = i >= step ? row[i - step] : 0;
+			left_zeros += row[i] == prev;
+		}
+
+		if (up_zeros >= left_zeros) {
+			out[0] = FILTER_UP;
+			return up + width;
+		}
+	}
+
+	out[0] = FILTER_LEFT;
+	for (uint32_t i = 0; i < width; i++)
+		up[i] = (uint8_t)(row[i] - (i >= step ? row[i - step] : 0));
+	return up + width;
+}
+
+static inline uint8_t* put_literals(uint8_t* out, const uint8_t* in,
+	size_t count)
+{
+	while (count) {
+		size_t n = count < MAX_LITERALS ? count : MAX_LITERALS;
+
+		*(out++) = (uint8_t)(n - 1);
+		memcpy(out, in, n);
+		out += n;
+		in += n;
+		count -= n;
+	}
+
+	return out;
+}
+
+static inline uint8_t* put_zeros(uint8_t* out, size_t count)
+{
+	while (count) {
+		size_t n;
+
+		if (count <= MAX_SHORT_RUN) {
+			*(out++) = (uint8_t)(0x7F + count);
+			break;
+		}
+
+		n = count < MAX_LONG_RUN ? count : MAX_LONG_RUN;
+		*(out++) = 0xFF;
+		put_u16(out, (uint16_t)n);
+		out += 2;
+		count -= n;
+	}
+
+	return out;
+}
+
+/* out needs room for size + size / MAX_LITERALS + 1 bytes */
+static size_t rle_encode(uint8_t* out, const uint8_t* in, size_t size)
+{
+	uint8_t* start = out;
+	size_t literals = 0;
+	size_t i = 0;
+
+	while (i < size) {
+		size_t run = 0;
+
+		if (in[i]) {
+			i++;
+			continue;
+		}
+
+		while (i + run < size && !in[i + run])
+			run++;
+
+		if (run >= MIN_ZERO_RUN) {
+			out = put_literals(out, in + literals, i - literals);
+			out = put_zeros(out, run);
+			literals = i + run;
+		}
+
+		i += run;
+	}
+
+	out = put_literals(out, in + literals, size - literals);
+	return (size_t)(out - start);
+}
+
+static bool rle_decode(uint8_t* out, size_t size, const uint8_t* in,
+	size_t in_size)
+{
+	const uint8_t* end = in + in_size;
+	uint8_t* out_end = out + size;
+
+	while (in < end) {
+		uint8_t token = *(in++);
+		size_t n;
+
+		if (token < 0x80) {
+			n = (size_t)token + 1;
+			if ((size_t)(end - in) < n ||
+				(size_t)(out_end - out) < n)
+				return false;
+			memcpy(out, in, n);
+			in += n;
+		}
+		else {
+			if (token == 0xFF) {
+				if (end - in < 2)
+					return false;
+				n = get_u16(in);
+				in += 2;
+			}
+			else {
+				n = (size_t)token - 0x7F;
+			}
+
+			if ((size_t)(out_end - out) < n)
+				return false;
+			memset(out, 0, n);
+		}
+
+		out += n;
+	}
+
+	return out == out_end;
+}
+
+static void pack_tile(struct video_tile_encoder* encoder,
+	const struct video_data* frame, uint32_t tx, uint32_t ty)
+{
+	const struct tile_layout* layout = &encoder->layout;
+	uint8_t* residuals = encoder->residuals;
+	uint8_t* out = residuals;
+	size_t raw_size = 0;
+	size_t packed_size;
+	uint8_t header[5];
+
+	for (size_t p = 0; p < layout->num_planes; p++) {
+		const struct video_damage_plane* plane = &layout->planes[p];
+		const uint32_t linesize = frame->linesize[p];
+		uint32_t x, y, width, height;
+
+		get_tile_rect(plane, tx, ty, &x, &y, &width, &height);
+
+		for (uint32_t row = 0; row < height; row++) {
+			const uint8_t* data = frame->data[p] +
+				(size_t)(y + row) * linesize + x;
+			const uint8_t* above = row ? data - linesize : NULL;
+
+			out = filter_row(out, data, above, width,
+				plane->pixel_bytes);
+		}
+
+		raw_size += (size_t)width * height;
+	}
+
+	packed_size = rle_encode(encoder->packed, residuals,
+		(size_t)(out - residuals));
+
+	if (packed_size < raw_size) {
+		header[0] = TILE_MODE_PACKED;
+		put_u32(header + 1, (uint32_t)packed_size);
+		da_push_back_array(encoder->packet, header, sizeof(header));
+		da_push_back_array(encoder->packet, encoder->packed,
+			packed_size);
+		return;
+	}
+
+	header[0] = TILE_MODE_RAW;
+	put_u32(header + 1, (uint32_t)raw_size);
+	da_push_back_array(encoder->packet, header, sizeof(header));
+
+	for (size_t p = 0; p < layout->num_planes; p++) {
+		const struct video_damage_plane* plane = &layout->planes[p];
+		uint32_t x, y, width, height;
+
+		get_tile_rect(plane, tx, ty, &x, &y, &width, &height);
+
+		for (uint32_t row = 0; row < height; row++)
+			da_push_back_array(encoder->packet, frame->data[p] +
+				(size_t)(y + row) * frame->linesize[p] + x,
+				width);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+video_tile_encoder_t* video_tile_encoder_create(
+	const struct video_tile_info* info)
+{
+	struct video_tile_encoder* encoder;
+	size_t residual_size;
+
+	if (!info)
+		return NULL;
+
+	encoder = bzalloc(sizeof(struct video_tile_encoder));
+	encoder->info = *info;
+	if (!encoder->info.tile_size)
+		encoder->info.tile_size = 64;
+	if (encoder->info.full_threshold <= 0.0f)
+		encoder->info.full_threshold = 0.5f;
+
+	if (!init_layout(&encoder->layout, info->format, info->width,
+		info->height, encoder->info.tile_size) ||
+		encoder->info.tile_size > 0xFFFF) {
+		blog(LOG_ERROR, "video_tile_encoder_create: unsupported "
+			"format or tile size");
+		bfree(encoder);
+		return NULL;
+	}
+
+	encoder->damage = video_damage_create(info->format, info->width,
+		info->height, encoder->info.tile_size);
+
+	residual_size = encoder->layout.max_tile_size +
+		encoder->layout.max_rows;
+	encoder->residuals = bmalloc(residual_size);
+	encoder->packed = bmalloc(residual_size + residual_size /
+		MAX_LITERALS + 1);
+	encoder->send_full = true;
+	da_init(encoder->packet);
+	return encoder;
+}
+
+void video_tile_encoder_destroy(video_tile_encoder_t* encoder)
+{
+	if (!encoder)
+		return;
+
+	video_damage_destroy(encoder->damage);
+	bfree(encoder->residuals);
+	bfree(encoder->packed);
+	da_free(encoder->packet);
+	bfree(encoder);
+}
+
+void video_tile_encoder_reset(video_tile_encoder_t* encoder)
+{
+	if (encoder)
+		encoder->send_full = true;
+}
+
+static void write_header(struct video_tile_encoder* encoder,
+	uint64_t timestamp, uint32_t changed)
+{
+	const struct tile_layout* layout = &encoder->layout;
+	const size_t map_size = ((size_t)layout->cols * layout->rows + 7) / 8;
+	uint8_t* header;
+
+	da_resize(encoder->packet, HEADER_SIZE + map_size);
+	header = encoder->packet.array;
+	memset(header, 0, HEADER_SIZE + map_size);
+
+	put_u32(header, TILE_MAGIC);
+	header[4] = (uint8_t)encoder->info.format;
+	header[5] = TILE_VERSION;
+	put_u16(header + 6, (uint16_t)layout->tile_size);
+	put_u32(header + 8, encoder->info.width);
+	put_u32(header + 12, encoder->info.height);
+	put_u64(header + 16, timestamp);
+	put_u32(header + 24, changed);
+}
+
+bool video_tile_encode(video_tile_encoder_t* encoder,
+	const struct video_data* frame, struct video_tile_packet* packet)
+{
+	const struct tile_layout* layout;
+	const uint8_t* map;
+	uint32_t total;
+	uint32_t changed;
+
+	if (!encoder || !frame || !packet || !encoder->damage)
+		return false;
+
+	layout = &encoder->layout;
+	total = layout->cols * layout->rows;
+	memset(packet, 0, sizeof(*packet));
+	packet->total_tiles = total;
+
+	/* the receiver already has this frame */
+	if (frame->repeat && !encoder->send_full) {
+		write_header(encoder, frame->timestamp, 0);
+		packet->data = encoder->packet.array;
+		packet->size = encoder->packet.num;
+		return true;
+	}
+
+	changed = video_damage_update(encoder->damage, frame, NULL);
+	map = video_damage_get_map(encoder->damage, NULL, NULL);
+
+	if (encoder->send_full ||
+		(float)changed > encoder->info.full_threshold * (float)total) {
+		encoder->send_full = false;
+		packet->changed_tiles = changed;
+		packet->full = true;
+		return true;
+	}
+
+	write_header(encoder, frame->timestamp, changed);
+
+	for (uint32_t i = 0; i < total; i++) {
+		if (!map[i])
+			continue;
+
+		encoder->packet.array[HEADER_SIZE + i / 8] |=
+			(uint8_t)(1 << (i % 8));
+		pack_tile(encoder, frame, i % layout->cols, i / layout->cols);
+	}
+
+	packet->data = encoder->packet.array;
+	packet->size = encoder->packet.num;
+	packet->changed_tiles = changed;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* receiver */
+
+static bool unpack_tile(const struct tile_layout* layout, uint8_t mode,
+	const uint8_t* data, size_t size, uint8_t* residuals,
+	struct video_frame* frame, uint32_t tx, uint32_t ty)
+{
+	const uint8_t* in = data;
+	size_t expected = 0;
+
+	if (mode != TILE_MODE_RAW && mode != TILE_MODE_PACKED)
+		return false;
+
+	for (size_t p = 0; p < layout->num_planes; p++) {
+		uint32_t x, y, width, height;
+
+		get_tile_rect(&layout->planes[p], tx, ty, &x, &y, &width,
+			&height);
+		expected += (size_t)(mode == TILE_MODE_RAW ? width :
+			width + 1) * height;
+	}
+
+	if (mode == TILE_MODE_RAW) {
+		if (size != expected)
+			return false;
+	}
+	else {
+		if (!rle_decode(residuals, expected, data, size))
+			return false;
+		in = residuals;
+	}
+
+	for (size_t p = 0; p < layout->num_planes; p++) {
+		const struct video_damage_plane* plane = &layout->planes[p];
+		const uint32_t linesize = frame->linesize[p];
+		const uint32_t step = plane->pixel_bytes;
+		uint32_t x, y, width, height;
+
+		if (!frame->data[p])
+			return false;
+
+		get_tile_rect(plane, tx, ty, &x, &y, &width, &height);
+
+		for (uint32_t row = 0; row < height; row++) {
+			uint8_t* out = frame->data[p] +
+				(size_t)(y + row) * linesize + x;
+			uint8_t filter;
+
+			if (mode == TILE_MODE_RAW) {
+				memcpy(out, in, width);
+				in += width;
+				continue;
+			}
+
+			filter = *(in++);
+			if (filter == FILTER_UP && row) {
+				const uint8_t* above = out - linesize;
+				for (uint32_t i = 0; i < width; i++)
+					out[i] = (uint8_t)(in[i] + above[i]);
+			}
+			else if (filter == FILTER_LEFT) {
+				for (uint32_t i = 0; i < width; i++) {
+					uint8_t prev = i >= step ?
+						out[i - step] : 0;
+					out[i] = (uint8_t)(in[i] + prev);
+				}
+			}
+			else {
+				return false;
+			}
+
+			in += width;
+		}
+	}
+
+	return true;
+}
+
+/* the packet is only trusted as far as it agrees with what the receiver
+ * expects, which its frame was allocated for */
+static bool header_matches(const struct video_tile_info* info,
+	const uint8_t* data)
+{
+	const uint32_t tile_size = info->tile_size ? info->tile_size : 64;
+
+	return get_u32(data) == TILE_MAGIC && data[5] == TILE_VERSION &&
+		data[4] == (uint8_t)info->format &&
+		get_u16(data + 6) == tile_size &&
+		get_u32(data + 8) == info->width &&
+		get_u32(data + 12) == info->height;
+}
+
+bool video_tile_decode(const struct video_tile_info* info,
+	const uint8_t* data, size_t size, struct video_frame* frame,
+	uint64_t* timestamp)
+{
+	struct tile_layout layout;
+	const uint8_t* map;
+	const uint8_t* in;
+	const uint8_t* end = data + size;
+	uint8_t* residuals;
+	uint32_t changed;
+	uint32_t total;
+	bool success = true;
+
+	if (!info || !data || !frame || size < HEADER_SIZE)
+		return false;
+	if (!header_matches(info, data))
+		return false;
+
+	if (!init_layout(&layout, info->format, info->width, info->height,
+		get_u16(data + 6)))
+		return false;
+
+	/* the tile map has to fit into the packet */
+	if (((uint64_t)layout.cols * layout.rows + 7) / 8 >
+		size - HEADER_SIZE)
+		return false;
+
+	total = layout.cols * layout.rows;
+	changed = get_u32(data + 24);
+	map = data + HEADER_SIZE;
+	in = map + (total + 7) / 8;
+	if (changed > total)
+		return false;
+
+	if (timestamp)
+		*timestamp = get_u64(data + 16);
+	if (!changed)
+		return true;
+
+	residuals = bmalloc(layout.max_tile_size + layout.max_rows);
+
+	for (uint32_t i = 0; i < total && success; i++) {
+		uint32_t tile_size;
+		uint8_t mode;
+
+		if (!(map[i / 8] & (1 << (i % 8))))
+			continue;
+
+		if (end - in < 5) {
+			success = false;
+			break;
+		}
+
+		mode = in[0];
+		tile_size = get_u32(in + 1);
+		in += 5;
+
+		if ((size_t)(end - in) < tile_size) {
+			success = false;
+			break;
+		}
+
+		success = unpack_tile(&layout, mode, in, tile_size, residuals,
+			frame, i % layout.cols, i / layout.cols);
+		in += tile_size;
+	}
+
+	bfree(residuals);
+	return success;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+	Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "video-io.h"
+#include "video-frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/*
+	 * Partial-update streaming: instead of encoding every frame, only the
+	 * tiles that changed since the previous frame are compressed, with a
+	 * lossless per-tile codec, and sent together with a map of the tiles.
+	 * The receiver patches them into its copy of the last frame.
+	 *
+	 * Meant to be fed from a raw video callback.  Repeats (see
+	 * video_output_set_input_repeat_events) cost nothing.  When more than
+	 * full_threshold of the tiles changed, e.g. during video playback or
+	 * scrolling, the packet is marked full and carries no tiles; the
+	 * caller then sends that frame through its regular encoder instead,
+	 * and the receiver replaces its frame with the decoded one.
+	 */
+
+	struct video_tile_encoder;
+	typedef struct video_tile_encoder video_tile_encoder_t;
+
+	struct video_tile_info {
+		enum video_format format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t tile_size;   /* multiple of 32, 0 for 64 */
+		float full_threshold; /* fraction of tiles, 0 for 0.5 */
+	};
+
+	struct video_tile_packet {
+		/* owned by the encoder, valid until the next encode */
+		const uint8_t* data;
+		size_t size;
+
+		uint32_t changed_tiles;
+		uint32_t total_tiles;
+
+		/* too many tiles changed, send the frame in full instead */
+		bool full;
+	};
+
+	EXPORT video_tile_encoder_t* video_tile_encoder_create(
+		const struct video_tile_info* info);
+	EXPORT void video_tile_encoder_destroy(video_tile_encoder_t* encoder);
+
+	/* makes the next frame full, e.g. when a receiver (re)connects */
+	EXPORT void video_tile_encoder_reset(video_tile_encoder_t* encoder);
+
+	/*
+	 * Compares the frame against the previous one and packs the tiles
+	 * that changed.  A packet without changed tiles still carries the
+	 * timestamp and should be sent.  Returns false on invalid input.
+	 */
+	EXPORT bool video_tile_encode(video_tile_encoder_t* encoder,
+		const struct video_data* frame,
+		struct video_tile_packet* packet);
+
+	/*
+	 * Receiver side: patches the tiles of a packet into frame, which
+	 * holds the previous frame in the format and size given by info,
+	 * the same as the encoder's.  Returns false if the packet is
+	 * malformed or its header does not match info, in which case the
+	 * receiver should ask for a full frame.
+	 */
+	EXPORT bool video_tile_decode(const struct video_tile_info* info,
+		const uint8_t* data, size_t size, struct video_frame* frame,
+		uint64_t* timestamp);
+
+#ifdef __cplusplus
+}
+#endif
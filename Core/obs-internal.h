@@ -24,6 +24,7 @@
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
+#include "util/task-pool.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
 
@@ -32,6 +33,7 @@
 
 //#include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
+#include "media-io/video-damage.h"
 //#include "media-io/audio-io.h"
 
 #include "obs.h"
@@ -39,6 +41,7 @@
 #include <caption/caption.h>
 
 #define NUM_TEXTURES 2
+#define MAX_TEXTURES 6
 #define NUM_CHANNELS 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
@@ -59,6 +62,16 @@ struct draw_callback {
 	void *param;
 };
 
+/* immutable copy of a callback array.  the graphics thread iterates the
+ * published copy without locking; replaced copies are retired and only freed
+ * once the graphics thread has passed a quiescent point. */
+struct obs_callback_list {
+	volatile long refs;
+	struct obs_callback_list *next_retired;
+	size_t num;
+	void *array;
+};
+
 /* ------------------------------------------------------------------------- */
 /* validity checks */
 
@@ -145,6 +158,33 @@ struct obs_view {
 extern bool obs_view_init(struct obs_view *view);
 extern void obs_view_free(struct obs_view *view);
 
+/*
+ * Render graph of a view, rebuilt every frame into the same arrays.  Each
+ * channel is a root node followed by the nodes it renders: its enabled
+ * filters and, for transitions, the sources being transitioned.  All of
+ * them are drawn from the origin of the view, so a root with no area
+ * inside the view, or covered by a later opaque root, is not rendered.
+ */
+struct obs_render_node {
+	obs_source_t *source; /* only valid while the graph is built */
+	size_t end;           /* index past the last node depending on it */
+	uint32_t cx;
+	uint32_t cy;
+	bool opaque;
+	bool culled;
+};
+
+struct obs_render_graph {
+	DARRAY(struct obs_render_node) nodes;
+	DARRAY(size_t) roots;
+	uint64_t culled_nodes; /* total over all frames */
+};
+
+extern void obs_view_render_culled(struct obs_view *view,
+				   struct obs_render_graph *graph,
+				   uint32_t cx, uint32_t cy);
+extern void obs_render_graph_free(struct obs_render_graph *graph);
+
 /* ------------------------------------------------------------------------- */
 /* displays */
 
@@ -184,22 +224,40 @@ struct obs_tex_frame {
 	bool released;
 };
 
+/* node of the graphics task queue, a lock-free intrusive multi-producer
+ * single-consumer queue: producers swap themselves in at tasks_head, the
+ * graphics thread pops from tasks_tail */
 struct obs_task_info {
+	struct obs_task_info *volatile next;
 	obs_task_t task;
 	void *param;
 };
 
+/* sources ticked in the same frame.  items with the same root, a source
+ * and its filters or all transitions, are ticked in order as one group,
+ * groups are ticked in parallel. */
+struct obs_tick_item {
+	struct obs_source *source;
+	struct obs_source *root;
+	size_t order;
+};
+
+struct obs_tick_group {
+	size_t first;
+	size_t count;
+};
+
 struct obs_core_video {
 	graphics_t *graphics;
-	gs_stagesurf_t *copy_surfaces[NUM_TEXTURES][NUM_CHANNELS];
+	gs_stagesurf_t *copy_surfaces[MAX_TEXTURES][NUM_CHANNELS];
 	gs_texture_t *render_texture;
 	gs_texture_t *output_texture;
 	gs_texture_t *convert_textures[NUM_CHANNELS];
 	bool texture_rendered;
-	bool textures_copied[NUM_TEXTURES];
+	bool textures_copied[MAX_TEXTURES];
 	bool texture_converted;
 	bool using_nv12_tex;
-	struct circlebuf vframe_info_buffer;
+	struct obs_vframe_info textures_info[MAX_TEXTURES];
 	struct circlebuf vframe_info_buffer_gpu;
 	gs_effect_t *default_effect;
 	gs_effect_t *default_rect_effect;
@@ -214,7 +272,30 @@ struct obs_core_video {
 	gs_effect_t *premultiplied_alpha_effect;
 	gs_samplerstate_t *point_sampler;
 	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
+
+	/* in map-through mode, surfaces whose mapping was queued straight to
+	 * the video output stay mapped until the output releases them */
+	bool map_through;
+	gs_stagesurf_t *held_surfaces[MAX_TEXTURES][NUM_CHANNELS];
+	volatile bool surfaces_held[MAX_TEXTURES];
 	int cur_texture;
+	int last_texture;
+
+	/* readback ring: frames are downloaded num_textures - 1 frames after
+	 * they were staged.  with readback_stall_ns set, the ring is deepened
+	 * when mapping keeps blocking for longer than that. */
+	int num_textures;
+	uint64_t readback_stall_ns;
+	uint32_t readback_stalls;
+	uint32_t readback_window;
+
+	/* damage tracking of downloaded raw frames, the tracker is created
+	 * and destroyed by the graphics thread */
+	bool skip_unchanged_frames;
+	video_damage_t *damage;
+	uint32_t unchanged_frames;
+	uint32_t hashed_frames;
+	uint64_t damage_hash_ns;
 	long raw_active;
 	long gpu_encoder_active;
 	pthread_mutex_t gpu_encoder_mutex;
@@ -227,8 +308,54 @@ struct obs_core_video {
 	bool gpu_encode_thread_initialized;
 	volatile bool gpu_encode_stop;
 
+	/* pipelined tick: the graphics thread starts ticking the next frame
+	 * on tick_thread once it has rendered the sources of the current one,
+	 * and waits for it before the next frame */
+	bool pipelined_tick;
+	pthread_t tick_thread;
+	bool tick_thread_initialized;
+	os_sem_t *tick_start;
+	os_sem_t *tick_done;
+	volatile bool tick_stop;
+	bool tick_pending;
+	uint64_t tick_time;
+	uint64_t tick_last_time;
+	uint64_t tick_start_ns;
+
+	/* dynamic render scale: while render_scale_step is nonzero the scene
+	 * is rendered at render_width x render_height into scaled_texture and
+	 * stretched into render_texture.  the graphics thread owns these. */
+	bool dynamic_render_scale;
+	float min_render_scale;
+	uint32_t render_scale_step;
+	uint32_t render_width;
+	uint32_t render_height;
+	gs_texture_t *scaled_texture;
+	uint64_t render_frame_time_ns;
+	uint32_t render_scale_hold;
+	uint32_t render_scale_calm;
+
+	/* idle mode: with nothing consuming frames the graphics thread waits
+	 * on idle_event for up to idle_interval_ns between frames */
+	uint64_t idle_interval_ns;
+	os_event_t *idle_event;
+
+	/* parallel tick, the pool and lists are used by whichever thread
+	 * ticks the sources */
+	uint32_t tick_threads;
+	task_pool_t *tick_pool;
+	DARRAY(struct obs_tick_item) tick_items;
+	DARRAY(struct obs_tick_group) tick_groups;
+	float tick_seconds;
+
+	/* render culling of the main view, graphics thread only */
+	bool render_culling;
+	struct obs_render_graph render_graph;
+
 	uint64_t video_time;
 	uint64_t video_frame_interval_ns;
+	uint64_t pacer_spin_ns;
+	uint64_t pacer_timer_slack_ns;
 	uint64_t video_avg_frame_time_ns;
 	double video_fps;
 	video_t *video;
@@ -237,6 +364,11 @@ struct obs_core_video {
 	uint32_t lagged_frames;
 	bool thread_initialized;
 
+	/* incremented by the graphics thread each time it passes a point where
+	 * it holds no published callback list, signaling quiescent_event */
+	volatile long quiescent_count;
+	os_event_t *quiescent_event;
+
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
 	bool conversion_needed;
@@ -262,10 +394,26 @@ struct obs_core_video {
 
 	struct obs_video_info ovi;
 
-	pthread_mutex_t task_mutex;
-	struct circlebuf tasks;
+	struct obs_task_info *volatile tasks_head;
+	struct obs_task_info *tasks_tail;
+	struct obs_task_info tasks_stub;
+	volatile long tasks_pending;
+	uint64_t task_budget_ns;
+	uint64_t deferred_tasks;
 };
 
+/* safe to call from any thread */
+static inline void obs_task_queue_push(struct obs_core_video *video,
+				       struct obs_task_info *info)
+{
+	struct obs_task_info *prev;
+
+	info->next = NULL;
+	prev = os_atomic_exchange_ptr((void *volatile *)&video->tasks_head,
+				      info);
+	os_atomic_store_ptr_release((void *volatile *)&prev->next, info);
+}
+
 struct audio_monitor;
 
 /* user sources, output channels, and displays */
@@ -287,6 +435,12 @@ struct obs_core_data {
 	DARRAY(struct draw_callback) draw_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
 
+	/* published copies of the arrays above, swapped under
+	 * draw_callbacks_mutex and read by the graphics thread without it */
+	struct obs_callback_list *volatile draw_callbacks_list;
+	struct obs_callback_list *volatile tick_callbacks_list;
+	struct obs_callback_list *retired_callbacks;
+
 	struct obs_view main_view;
 
 	long long unnamed_index;
@@ -377,10 +531,20 @@ struct obs_graphics_context {
 	bool raw_was_active;
 	bool was_active;
 	const char *video_thread_name;
+
+	/* how late the last frame's sleep woke up, recorded into the next
+	 * frame's profiler root */
+	uint64_t wake_error_ns;
+	bool wake_error_valid;
 };
 
 extern void *obs_graphics_thread(void *param);
 extern bool obs_graphics_thread_loop(struct obs_graphics_context *context);
+
+extern void obs_callback_list_release(struct obs_callback_list *list);
+extern void obs_reclaim_callback_lists(void);
+extern void obs_publish_callback_lists(void);
+extern void obs_free_callback_lists(void);
 #ifdef __APPLE__
 extern void *obs_graphics_thread_autorelease(void *param);
 extern bool
@@ -388,11 +552,22 @@ obs_graphics_thread_loop_autorelease(struct obs_graphics_context *context);
 #endif
 
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
+extern bool obs_init_copy_surfaces(const struct obs_video_info *ovi,
+				   int texture);
 
 extern bool audio_callback(void *param, uint64_t start_ts_in,
 			   uint64_t end_ts_in, uint64_t *out_ts,
 			   uint32_t mixers, struct audio_output_data *mixes);
 
+/* wakes the graphics thread from idle mode, to be called after raw_active
+ * or gpu_encoder_active is incremented and after the video output is
+ * stopped */
+static inline void obs_video_wake(struct obs_core_video *video)
+{
+	if (video->idle_event)
+		os_event_signal(video->idle_event);
+}
+
 extern void
 start_raw_video(video_t *video, const struct video_scale_info *conversion,
 		void (*callback)(void *param, struct video_data *frame),
@@ -500,18 +675,89 @@ struct caption_cb_info {
 	void *param;
 };
 
+/* ------------------------------------------------------------------------- */
+/* async frame queue */
+
+#define ASYNC_QUEUE_SIZE 8
+#define ASYNC_POOL_SIZE (ASYNC_QUEUE_SIZE + 4)
+
+/*
+ * Lock-free hand-off of async video frames from the thread outputting them
+ * to the graphics thread, so neither waits on the other.  Frames come from
+ * a per-source pool that only the producer allocates from, grown on demand
+ * up to ASYNC_POOL_SIZE frames and reused afterwards; the graphics thread
+ * hands frames back through a second ring once it is done with them.
+ *
+ * Buffered frames are queued in order, and a new frame is dropped while
+ * ASYNC_QUEUE_SIZE frames are waiting.  Unbuffered sources only keep the
+ * newest frame: the producer swaps it in, and the frame it replaces, if
+ * the graphics thread has not taken it yet, is dropped.
+ *
+ * Sources get a queue once obs_source_output_video and async_tick move
+ * from async_frames to it; until then nothing uses it.
+ */
+struct obs_async_queue {
+	/* producer to graphics thread, the indices count up to twice the
+	 * size like the video output's frame ring */
+	volatile long write_idx;
+	volatile long read_idx;
+	struct obs_source_frame *frames[ASYNC_QUEUE_SIZE];
+
+	/* newest unbuffered frame */
+	struct obs_source_frame *volatile latest;
+
+	/* graphics thread back to producer */
+	volatile long free_write_idx;
+	volatile long free_read_idx;
+	struct obs_source_frame *free_frames[ASYNC_POOL_SIZE];
+
+	/* producer only: frames allocated, and a frame that came back from
+	 * a failed push */
+	size_t num_frames;
+	struct obs_source_frame *spare;
+
+	volatile long dropped_frames;
+};
+
+/* producer side, not thread safe with other producers of the same queue */
+extern struct obs_source_frame *
+obs_async_queue_get_frame(struct obs_async_queue *queue,
+			  enum video_format format, uint32_t width,
+			  uint32_t height);
+extern void obs_async_queue_push(struct obs_async_queue *queue,
+				 struct obs_source_frame *frame,
+				 bool unbuffered);
+
+/* graphics thread side */
+extern struct obs_source_frame *
+obs_async_queue_peek(struct obs_async_queue *queue);
+extern struct obs_source_frame *
+obs_async_queue_pop(struct obs_async_queue *queue);
+extern struct obs_source_frame *
+obs_async_queue_take_latest(struct obs_async_queue *queue);
+extern void obs_async_queue_release(struct obs_async_queue *queue,
+				    struct obs_source_frame *frame,
+				    bool dropped);
+
+/* any thread */
+extern long
+obs_async_queue_get_dropped_frames(const struct obs_async_queue *queue);
+
+/* once neither side uses the queue anymore */
+extern void obs_async_queue_free(struct obs_async_queue *queue);
+
 struct obs_source {
 	struct obs_context_data context;
-	struct obs_source_info info;
-	struct obs_weak_source *control;
 
-	/* general exposed flags that can be set for the source */
-	uint32_t flags;
-	uint32_t default_flags;
-	uint32_t last_obs_ver;
-
-	/* indicates ownership of the info.id buffer */
-	bool owns_info_id;
+	/* ------------------------------------------------------------- */
+	/* state the graphics thread reads or writes for every source on
+	 * every tick.  it sits between the end of context, where the list
+	 * of sources is linked, and the type and flags at the start of info,
+	 * so ticking a source touches a few adjacent cache lines instead of
+	 * lines spread over the whole structure.  keep cold state out. */
+	struct obs_weak_source *control;
+	struct obs_source *filter_parent;
+	gs_texrender_t *filter_texrender;
 
 	/* signals to call the source update in the video thread */
 	long defer_update_count;
@@ -522,14 +768,28 @@ struct obs_source {
 	/* ensures activate/deactivate are only called once */
 	volatile long activate_refs;
 
+	bool active;
+	bool showing;
+	bool async_rendered;
+	bool deinterlace_rendered;
+
+	/* ------------------------------------------------------------- */
+
+	struct obs_source_info info;
+
+	/* general exposed flags that can be set for the source */
+	uint32_t flags;
+	uint32_t default_flags;
+	uint32_t last_obs_ver;
+
+	/* indicates ownership of the info.id buffer */
+	bool owns_info_id;
+
 	/* used to indicate that the source has been removed and all
 	 * references to it should be released (not exactly how I would prefer
 	 * to handle things but it's the best option) */
 	bool removed;
 
-	bool active;
-	bool showing;
-
 	/* used to temporarily disable sources if needed */
 	bool enabled;
 
@@ -542,7 +802,6 @@ struct obs_source {
 	uint64_t next_audio_sys_ts_min;
 	uint64_t last_frame_ts;
 	uint64_t last_sys_timestamp;
-	bool async_rendered;
 
 	/* audio */
 	bool audio_failed;
@@ -616,14 +875,12 @@ struct obs_source {
 	uint32_t deinterlace_half_duration;
 	enum obs_deinterlace_mode deinterlace_mode;
 	bool deinterlace_top_first;
-	bool deinterlace_rendered;
 
-	/* filters */
-	struct obs_source *filter_parent;
+	/* filters (filter_parent and filter_texrender are with the tick
+	 * state above) */
 	struct obs_source *filter_target;
 	DARRAY(struct obs_source *) filters;
 	pthread_mutex_t filter_mutex;
-	gs_texrender_t *filter_texrender;
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 
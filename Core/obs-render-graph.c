@@ -0,0 +1,191 @@
+#include "obs.h"
+#include "obs-internal.h"
+
+static size_t add_source_nodes(struct obs_render_graph* graph,
+	obs_source_t* source);
+
+static inline struct obs_render_node* get_node(
+	struct obs_render_graph* graph, size_t idx)
+{
+	return graph->nodes.array + idx;
+}
+
+static size_t add_node(struct obs_render_graph* graph, obs_source_t* source)
+{
+	struct obs_render_node* node = da_push_back_new(graph->nodes);
+
+	node->source = source;
+	return graph->nodes.num - 1;
+}
+
+/* returns true if the source has enabled filters, which may change any
+ * pixel of it */
+static bool add_filter_nodes(struct obs_render_graph* graph,
+	obs_source_t* source)
+{
+	bool filtered = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t* filter = source->filters.array[i];
+
+		if (filter->enabled) {
+			get_node(graph, add_node(graph, filter))->end =
+				graph->nodes.num;
+			filtered = true;
+		}
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+	return filtered;
+}
+
+/* a transition that is not transitioning only draws its first source, so
+ * it is opaque if that source is and fills it without being scaled */
+static bool add_transition_nodes(struct obs_render_graph* graph,
+	obs_source_t* transition, size_t parent_idx)
+{
+	obs_source_t* sources[2];
+	bool transitioning;
+	size_t first = 0;
+
+	pthread_mutex_lock(&transition->transition_mutex);
+	transitioning = transition->transitioning_video;
+	for (size_t i = 0; i < 2; i++)
+		sources[i] = obs_source_get_ref(
+			transition->transition_sources[i]);
+	pthread_mutex_unlock(&transition->transition_mutex);
+
+	for (size_t i = 0; i < 2; i++) {
+		if (!sources[i])
+			continue;
+
+		if (i == 0 || transitioning) {
+			size_t idx = add_source_nodes(graph, sources[i]);
+			if (i == 0)
+				first = idx;
+		}
+		obs_source_release(sources[i]);
+	}
+
+	if (transitioning || !sources[0])
+		return false;
+
+	const struct obs_render_node* node = get_node(graph, first);
+	const struct obs_render_node* parent = get_node(graph, parent_idx);
+	return node->opaque && node->cx == parent->cx &&
+		node->cy == parent->cy;
+}
+
+/* adds the node of a source followed by the nodes it renders, and returns
+ * its index */
+static size_t add_source_nodes(struct obs_render_graph* graph,
+	obs_source_t* source)
+{
+	size_t idx = add_node(graph, source);
+	uint32_t cx = obs_source_get_width(source);
+	uint32_t cy = obs_source_get_height(source);
+	bool opaque;
+
+	get_node(graph, idx)->cx = cx;
+	get_node(graph, idx)->cy = cy;
+
+	if (add_filter_nodes(graph, source)) {
+		opaque = false;
+		if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+			add_transition_nodes(graph, source, idx);
+
+	} else if (source->info.type == OBS_SOURCE_TYPE_TRANSITION) {
+		opaque = add_transition_nodes(graph, source, idx);
+
+	} else {
+		opaque = (source->info.output_flags & OBS_SOURCE_OPAQUE) != 0;
+	}
+
+	struct obs_render_node* node = get_node(graph, idx);
+	node->end = graph->nodes.num;
+	node->opaque = opaque;
+	node->culled = false;
+	return idx;
+}
+
+/* a root is culled if none of it is inside the view, or if a root drawn
+ * after it is opaque and at least as large as its visible part */
+static void cull_roots(struct obs_render_graph* graph, uint32_t cx,
+	uint32_t cy)
+{
+	for (size_t i = graph->roots.num; i > 0; i--) {
+		struct obs_render_node* root =
+			get_node(graph, graph->roots.array[i - 1]);
+		uint32_t visible_cx = root->cx < cx ? root->cx : cx;
+		uint32_t visible_cy = root->cy < cy ? root->cy : cy;
+
+		root->culled = !visible_cx || !visible_cy;
+
+		for (size_t j = i; !root->culled && j < graph->roots.num;
+			j++) {
+			const struct obs_render_node* above =
+				get_node(graph, graph->roots.array[j]);
+
+			root->culled = above->opaque &&
+				above->cx >= visible_cx &&
+				above->cy >= visible_cy;
+		}
+	}
+}
+
+/* renders the channels of the view like obs_view_render, minus the ones
+ * that cannot be seen in a cx x cy view */
+void obs_view_render_culled(struct obs_view* view,
+	struct obs_render_graph* graph, uint32_t cx, uint32_t cy)
+{
+	size_t culled = 0;
+
+	if (!view)
+		return;
+
+	da_resize(graph->nodes, 0);
+	da_resize(graph->roots, 0);
+
+	pthread_mutex_lock(&view->channels_mutex);
+
+	for (size_t i = 0; i < MAX_CHANNELS; i++) {
+		obs_source_t* source = view->channels[i];
+		size_t root;
+
+		if (!source)
+			continue;
+
+		if (source->removed) {
+			obs_source_release(source);
+			view->channels[i] = NULL;
+			continue;
+		}
+
+		root = add_source_nodes(graph, source);
+		da_push_back(graph->roots, &root);
+	}
+
+	cull_roots(graph, cx, cy);
+
+	for (size_t i = 0; i < graph->roots.num; i++) {
+		size_t idx = graph->roots.array[i];
+		struct obs_render_node* root = get_node(graph, idx);
+
+		if (root->culled)
+			culled += root->end - idx;
+		else
+			obs_source_video_render(root->source);
+	}
+
+	pthread_mutex_unlock(&view->channels_mutex);
+
+	graph->culled_nodes += culled;
+}
+
+void obs_render_graph_free(struct obs_render_graph* graph)
+{
+	da_free(graph->nodes);
+	da_free(graph->roots);
+}
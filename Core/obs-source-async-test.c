@@ -0,0 +1,160 @@
+/*
+ * Standalone stress test of the async frame queue of obs-source-async.c: a
+ * producer thread outputs FRAME_COUNT frames, changing their size now and
+ * then, while the main thread takes them like the graphics thread would.
+ * Buffered and unbuffered delivery are both checked for frames arriving in
+ * order and intact, every frame being either delivered or counted as
+ * dropped, and the pool staying within ASYNC_POOL_SIZE frames.
+ *
+ * It includes obs-source-async.c to get at the queue, so it only needs
+ * libobs for frame allocation.  Build it with the thread or address
+ * sanitizer, e.g.:
+ *
+ *   cc -O1 -g -fsanitize=thread obs-source-async-test.c -lobs -lpthread \
+ *      -o obs-source-async-test
+ *
+ * Returns 0 if all checks pass.
+ */
+
+#include <stdio.h>
+#include "obs-source-async.c"
+
+#define FRAME_COUNT 200000
+#define FRAME_HEIGHT 16
+
+struct queue_test {
+	struct obs_async_queue queue;
+	bool unbuffered;
+	volatile bool done;
+	long produced;
+};
+
+static inline uint32_t frame_width(uint32_t i)
+{
+	return (i / 50000) % 2 ? 64 : 32;
+}
+
+static void* produce_frames(void* param)
+{
+	struct queue_test* test = param;
+
+	for (uint32_t i = 1; i <= FRAME_COUNT; i++) {
+		const uint32_t width = frame_width(i);
+		struct obs_source_frame* frame = obs_async_queue_get_frame(
+			&test->queue, VIDEO_FORMAT_NV12, width, FRAME_HEIGHT);
+
+		if (!frame)
+			continue;
+
+		frame->timestamp = i;
+		memset(frame->data[0], i & 0xFF,
+			(size_t)frame->linesize[0] * FRAME_HEIGHT);
+
+		obs_async_queue_push(&test->queue, frame, test->unbuffered);
+		test->produced++;
+
+		/* let the consumer in on single core machines too */
+		if (i % 8 == 0)
+			os_sleep_ms(0);
+	}
+
+	os_atomic_set_bool(&test->done, true);
+	return NULL;
+}
+
+static inline struct obs_source_frame* take_frame(struct queue_test* test)
+{
+	return test->unbuffered ? obs_async_queue_take_latest(&test->queue)
+				: obs_async_queue_pop(&test->queue);
+}
+
+static bool frame_intact(const struct obs_source_frame* frame)
+{
+	const size_t size = (size_t)frame->linesize[0] * FRAME_HEIGHT;
+	const uint8_t val = (uint8_t)(frame->timestamp & 0xFF);
+
+	return frame->width == frame_width((uint32_t)frame->timestamp) &&
+		frame->data[0][0] == val && frame->data[0][size - 1] == val;
+}
+
+static int run_test(bool unbuffered)
+{
+	struct queue_test test = {0};
+	struct obs_source_frame* held = NULL;
+	uint64_t last = 0;
+	long delivered = 0;
+	long dropped;
+	int failed = 0;
+	pthread_t thread;
+
+	test.unbuffered = unbuffered;
+
+	if (pthread_create(&thread, NULL, produce_frames, &test) != 0) {
+		printf("could not create the producer thread\n");
+		return 1;
+	}
+
+	for (;;) {
+		/* read done first so nothing pushed before it is missed */
+		bool done = os_atomic_load_bool(&test.done);
+		struct obs_source_frame* frame = take_frame(&test);
+
+		if (!frame) {
+			if (done)
+				break;
+			os_sleep_ms(0);
+			continue;
+		}
+
+		if (frame->timestamp <= last) {
+			printf("frame %llu after frame %llu\n",
+				(unsigned long long)frame->timestamp,
+				(unsigned long long)last);
+			failed++;
+		}
+		if (!frame_intact(frame)) {
+			printf("frame %llu is torn\n",
+				(unsigned long long)frame->timestamp);
+			failed++;
+		}
+
+		last = frame->timestamp;
+		delivered++;
+
+		/* keep a frame like the graphics thread keeps the frame it
+		 * is showing */
+		obs_async_queue_release(&test.queue, held, false);
+		held = frame;
+	}
+
+	pthread_join(thread, NULL);
+	obs_async_queue_release(&test.queue, held, false);
+
+	dropped = obs_async_queue_get_dropped_frames(&test.queue);
+	if (delivered + dropped != test.produced) {
+		printf("%ld delivered and %ld dropped of %ld frames\n",
+			delivered, dropped, test.produced);
+		failed++;
+	}
+	if (test.queue.num_frames > ASYNC_POOL_SIZE) {
+		printf("%zu frames allocated\n", test.queue.num_frames);
+		failed++;
+	}
+
+	printf("%s: %ld delivered, %ld dropped: %s\n",
+		unbuffered ? "unbuffered" : "buffered", delivered, dropped,
+		failed ? "FAILED" : "ok");
+
+	obs_async_queue_free(&test.queue);
+	return failed;
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed += run_test(false);
+	failed += run_test(true);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+#include "obs.h"
+#include "obs-internal.h"
+
+static inline size_t ring_slot(long idx, size_t size)
+{
+	return (size_t)idx % size;
+}
+
+static inline long ring_next(long idx, size_t size)
+{
+	return (size_t)idx + 1 == size * 2 ? 0 : idx + 1;
+}
+
+static inline size_t ring_pending(long write_idx, long read_idx, size_t size)
+{
+	const size_t range = size * 2;
+	return ((size_t)write_idx + range - (size_t)read_idx) % range;
+}
+
+static inline bool frame_matches(const struct obs_source_frame* frame,
+	enum video_format format, uint32_t width, uint32_t height)
+{
+	return frame->format == format && frame->width == width &&
+		frame->height == height;
+}
+
+static inline void destroy_pool_frame(struct obs_async_queue* queue,
+	struct obs_source_frame* frame)
+{
+	obs_source_frame_destroy(frame);
+	queue->num_frames--;
+}
+
+/* ------------------------------------------------------------------------- */
+/* producer */
+
+static struct obs_source_frame* pop_free_frame(struct obs_async_queue* queue)
+{
+	long read_idx = queue->free_read_idx;
+	struct obs_source_frame* frame;
+
+	if (read_idx == os_atomic_load_long_acquire(&queue->free_write_idx))
+		return NULL;
+
+	frame = queue->free_frames[ring_slot(read_idx, ASYNC_POOL_SIZE)];
+	os_atomic_store_long_release(&queue->free_read_idx,
+		ring_next(read_idx, ASYNC_POOL_SIZE));
+	return frame;
+}
+
+/* returns a frame of the pool to fill, NULL if every frame is in use, in
+ * which case the frame should be dropped.  frames of another format or
+ * size are freed as they come back. */
+struct obs_source_frame* obs_async_queue_get_frame(
+	struct obs_async_queue* queue, enum video_format format,
+	uint32_t width, uint32_t height)
+{
+	struct obs_source_frame* frame = queue->spare;
+
+	queue->spare = NULL;
+
+	do {
+		if (frame) {
+			if (frame_matches(frame, format, width, height))
+				goto found;
+			destroy_pool_frame(queue, frame);
+		}
+	} while ((frame = pop_free_frame(queue)) != NULL);
+
+	if (queue->num_frames == ASYNC_POOL_SIZE) {
+		os_atomic_inc_long(&queue->dropped_frames);
+		return NULL;
+	}
+
+	frame = obs_source_frame_create(format, width, height);
+	queue->num_frames++;
+
+found:
+	frame->refs = 0;
+	frame->prev_frame = false;
+	return frame;
+}
+
+static inline void keep_spare(struct obs_async_queue* queue,
+	struct obs_source_frame* frame)
+{
+	if (queue->spare)
+		destroy_pool_frame(queue, queue->spare);
+	queue->spare = frame;
+}
+
+void obs_async_queue_push(struct obs_async_queue* queue,
+	struct obs_source_frame* frame, bool unbuffered)
+{
+	long write_idx = queue->write_idx;
+	long read_idx;
+
+	if (unbuffered) {
+		struct obs_source_frame* replaced = os_atomic_exchange_ptr(
+			(void* volatile*)&queue->latest, frame);
+
+		if (replaced) {
+			os_atomic_inc_long(&queue->dropped_frames);
+			keep_spare(queue, replaced);
+		}
+		return;
+	}
+
+	read_idx = os_atomic_load_long_acquire(&queue->read_idx);
+	if (ring_pending(write_idx, read_idx, ASYNC_QUEUE_SIZE) ==
+		ASYNC_QUEUE_SIZE) {
+		os_atomic_inc_long(&queue->dropped_frames);
+		keep_spare(queue, frame);
+		return;
+	}
+
+	queue->frames[ring_slot(write_idx, ASYNC_QUEUE_SIZE)] = frame;
+	os_atomic_store_long_release(&queue->write_idx,
+		ring_next(write_idx, ASYNC_QUEUE_SIZE));
+}
+
+/* ------------------------------------------------------------------------- */
+/* graphics thread */
+
+/* oldest buffered frame, left in the queue */
+struct obs_source_frame* obs_async_queue_peek(struct obs_async_queue* queue)
+{
+	long read_idx = queue->read_idx;
+
+	if (read_idx == os_atomic_load_long_acquire(&queue->write_idx))
+		return NULL;
+
+	return queue->frames[ring_slot(read_idx, ASYNC_QUEUE_SIZE)];
+}
+
+struct obs_source_frame* obs_async_queue_pop(struct obs_async_queue* queue)
+{
+	struct obs_source_frame* frame = obs_async_queue_peek(queue);
+
+	if (frame)
+		os_atomic_store_long_release(&queue->read_idx,
+			ring_next(queue->read_idx, ASYNC_QUEUE_SIZE));
+	return frame;
+}
+
+struct obs_source_frame* obs_async_queue_take_latest(
+	struct obs_async_queue* queue)
+{
+	return os_atomic_exchange_ptr((void* volatile*)&queue->latest, NULL);
+}
+
+/* hands a frame back to the producer, dropped if it was skipped without
+ * being rendered.  the free ring holds every frame of the pool, so it
+ * cannot overflow. */
+void obs_async_queue_release(struct obs_async_queue* queue,
+	struct obs_source_frame* frame, bool dropped)
+{
+	long write_idx = queue->free_write_idx;
+
+	if (!frame)
+		return;
+	if (dropped)
+		os_atomic_inc_long(&queue->dropped_frames);
+
+	queue->free_frames[ring_slot(write_idx, ASYNC_POOL_SIZE)] = frame;
+	os_atomic_store_long_release(&queue->free_write_idx,
+		ring_next(write_idx, ASYNC_POOL_SIZE));
+}
+
+/* frames dropped since the queue was created, safe to call from any
+ * thread */
+long obs_async_queue_get_dropped_frames(const struct obs_async_queue* queue)
+{
+	return os_atomic_load_long(&queue->dropped_frames);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void obs_async_queue_free(struct obs_async_queue* queue)
+{
+	struct obs_source_frame* frame;
+
+	while ((frame = obs_async_queue_pop(queue)) != NULL)
+		obs_source_frame_destroy(frame);
+	while ((frame = pop_free_frame(queue)) != NULL)
+		obs_source_frame_destroy(frame);
+
+	obs_source_frame_destroy(obs_async_queue_take_latest(queue));
+	obs_source_frame_destroy(queue->spare);
+
+	memset(queue, 0, sizeof(*queue));
+}
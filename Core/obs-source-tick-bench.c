@@ -0,0 +1,214 @@
+/*
+ * Standalone benchmark of the per-frame source walk: links SOURCE_COUNT
+ * sources scattered over the heap into a list like obs_core_data does,
+ * then snapshots and ticks them the way tick_sources does, once with the
+ * caches flushed before each frame and once without.  Reports the time
+ * per source and how many cache lines of struct obs_source the tick
+ * touches, so building it against two versions of obs-internal.h compares
+ * their layouts.
+ *
+ * The sources are bare structs without a type implementation, so
+ * obs_source_video_tick only does the checks every source pays for.  It
+ * includes obs-internal.h and needs libobs, e.g.:
+ *
+ *   cc -O2 -I. obs-source-tick-bench.c -lobs -o obs-source-tick-bench
+ *
+ * Pass the number of sources as the first argument, 10000 by default.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "obs-internal.h"
+
+#define SOURCE_COUNT 10000
+#define FRAME_COUNT 50
+#define FLUSH_SIZE (64 * 1024 * 1024)
+#define LINE_SIZE 64
+
+struct tick_field {
+	const char* name;
+	size_t offset;
+	size_t size;
+};
+
+#define TICK_FIELD(field)                                                \
+	{#field, offsetof(struct obs_source, field),                     \
+		sizeof(((struct obs_source*)NULL)->field)}
+
+/* what snapshot_tick_sources and obs_source_video_tick read or write for
+ * every source */
+static const struct tick_field tick_fields[] = {
+	TICK_FIELD(context.data),
+	TICK_FIELD(context.next),
+	TICK_FIELD(control),
+	TICK_FIELD(info.type),
+	TICK_FIELD(info.output_flags),
+	TICK_FIELD(info.video_tick),
+	TICK_FIELD(defer_update_count),
+	TICK_FIELD(filter_parent),
+	TICK_FIELD(filter_texrender),
+	TICK_FIELD(show_refs),
+	TICK_FIELD(showing),
+	TICK_FIELD(activate_refs),
+	TICK_FIELD(active),
+	TICK_FIELD(async_rendered),
+	TICK_FIELD(deinterlace_rendered),
+};
+
+#define NUM_TICK_FIELDS (sizeof(tick_fields) / sizeof(tick_fields[0]))
+
+static size_t count_tick_lines(void)
+{
+	const size_t num_lines =
+		(sizeof(struct obs_source) + LINE_SIZE - 1) / LINE_SIZE;
+	bool* touched = bzalloc(num_lines);
+	size_t count = 0;
+
+	for (size_t i = 0; i < NUM_TICK_FIELDS; i++) {
+		const size_t first = tick_fields[i].offset / LINE_SIZE;
+		const size_t last = (tick_fields[i].offset +
+			tick_fields[i].size - 1) / LINE_SIZE;
+
+		for (size_t line = first; line <= last; line++)
+			touched[line] = true;
+	}
+
+	for (size_t i = 0; i < num_lines; i++)
+		count += touched[i];
+
+	bfree(touched);
+	return count;
+}
+
+struct bench_sources {
+	struct obs_source** sources;
+	void** fillers;
+	struct obs_source* first;
+	size_t count;
+};
+
+static uint32_t rand_state = 1;
+
+static inline uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 16;
+}
+
+/* every source is followed by an allocation of random size, like the
+ * other objects a real scene allocates, and the list is linked in random
+ * order so that walking it does not walk memory in order */
+static void create_sources(struct bench_sources* bs, size_t count)
+{
+	bs->sources = bzalloc(sizeof(struct obs_source*) * count);
+	bs->fillers = bzalloc(sizeof(void*) * count);
+	bs->count = count;
+
+	for (size_t i = 0; i < count; i++) {
+		struct obs_source* source = bzalloc(sizeof(struct obs_source));
+
+		source->info.type = OBS_SOURCE_TYPE_INPUT;
+		if (i % 2) {
+			source->show_refs = 1;
+			source->showing = true;
+		}
+
+		bs->sources[i] = source;
+		bs->fillers[i] = bzalloc(64 + next_rand() % 4096);
+	}
+
+	for (size_t i = count - 1; i > 0; i--) {
+		size_t j = next_rand() % (i + 1);
+		struct obs_source* temp = bs->sources[i];
+		bs->sources[i] = bs->sources[j];
+		bs->sources[j] = temp;
+	}
+
+	for (size_t i = 0; i + 1 < count; i++)
+		bs->sources[i]->context.next = &bs->sources[i + 1]->context;
+	bs->first = bs->sources[0];
+}
+
+static void free_sources(struct bench_sources* bs)
+{
+	for (size_t i = 0; i < bs->count; i++) {
+		bfree(bs->sources[i]);
+		bfree(bs->fillers[i]);
+	}
+
+	bfree(bs->sources);
+	bfree(bs->fillers);
+}
+
+/* snapshots the list, then ticks every source of the snapshot */
+static void tick_frame(const struct bench_sources* bs,
+	struct obs_source** snapshot)
+{
+	struct obs_source* source = bs->first;
+	size_t num = 0;
+
+	while (source) {
+		snapshot[num++] = source;
+		source = (struct obs_source*)source->context.next;
+	}
+
+	for (size_t i = 0; i < num; i++)
+		obs_source_video_tick(snapshot[i], 1.0f / 60.0f);
+}
+
+/* returns nanoseconds per source */
+static double run_frames(const struct bench_sources* bs, uint8_t* flush)
+{
+	struct obs_source** snapshot =
+		bmalloc(sizeof(struct obs_source*) * bs->count);
+	uint64_t total = 0;
+
+	for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+		uint64_t start;
+
+		if (flush)
+			memset(flush, (int)frame, FLUSH_SIZE);
+
+		start = os_gettime_ns();
+		tick_frame(bs, snapshot);
+		total += os_gettime_ns() - start;
+	}
+
+	bfree(snapshot);
+	return (double)total / FRAME_COUNT / (double)bs->count;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : SOURCE_COUNT;
+	struct bench_sources bs = {0};
+	uint8_t* flush;
+	double flushed;
+	double unflushed;
+
+	if (count < 2) {
+		printf("at least 2 sources are needed\n");
+		return 1;
+	}
+
+	flush = bmalloc(FLUSH_SIZE);
+	create_sources(&bs, count);
+
+	/* warm up */
+	run_frames(&bs, NULL);
+
+	flushed = run_frames(&bs, flush);
+	unflushed = run_frames(&bs, NULL);
+
+	printf("struct obs_source: %zu bytes, %zu of its %d byte lines "
+		"touched per tick\n", sizeof(struct obs_source),
+		count_tick_lines(), LINE_SIZE);
+	printf("%zu sources: %.1f ns per source with flushed caches, "
+		"%.1f ns without flushing\n", count, flushed, unflushed);
+
+	free_sources(&bs);
+	bfree(flush);
+	return 0;
+}
@@ -191,6 +191,13 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CEA_708 (1 << 14)
 
+/**
+ * Source draws every pixel of its width and height fully opaque, so that
+ * anything drawn below it in that area is hidden.  Only taken into account
+ * while the source has no enabled filters.
+ */
+#define OBS_SOURCE_OPAQUE (1 << 15)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
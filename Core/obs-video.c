@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include <time.h>
 #include <stdlib.h>
 
@@ -12,11 +13,121 @@
 #include <windows.h>
 #endif
 
+extern THREAD_LOCAL bool is_graphics_thread;
 
-static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
+/* set on threads that tick sources outside of the graphics thread, see
+ * obs_queue_task */
+THREAD_LOCAL bool is_tick_thread = false;
+
+/* takes a reference to every source, sources_mutex is only held for
+ * this */
+static void snapshot_tick_sources(struct obs_core_video* video)
 {
 	struct obs_core_data* data = &obs->data;
 	struct obs_source* source;
+
+	da_resize(video->tick_items, 0);
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	source = data->first_source;
+	while (source) {
+		struct obs_source* cur_source = obs_source_get_ref(source);
+		source = (struct obs_source*)source->context.next;
+
+		if (cur_source) {
+			struct obs_tick_item* item =
+				da_push_back_new(video->tick_items);
+			item->source = cur_source;
+			item->order = video->tick_items.num - 1;
+		}
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+}
+
+static int compare_tick_items(const void* a, const void* b)
+{
+	const struct obs_tick_item* item_a = a;
+	const struct obs_tick_item* item_b = b;
+	uintptr_t root_a = (uintptr_t)item_a->root;
+	uintptr_t root_b = (uintptr_t)item_b->root;
+
+	if (root_a != root_b)
+		return root_a < root_b ? -1 : 1;
+	if (item_a->order != item_b->order)
+		return item_a->order < item_b->order ? -1 : 1;
+	return 0;
+}
+
+static inline bool is_transition(const struct obs_source* source)
+{
+	return source && source->info.type == OBS_SOURCE_TYPE_TRANSITION;
+}
+
+/* filters are ticked in order with the source they filter.  transitions
+ * change the sources they use when ticked, so they and their filters get a
+ * NULL root, which sorts first, and are ticked before the groups.  returns
+ * the number of those. */
+static size_t group_tick_sources(struct obs_core_video* video)
+{
+	struct obs_tick_item* items = video->tick_items.array;
+	const size_t num = video->tick_items.num;
+	size_t serial = 0;
+
+	for (size_t i = 0; i < num; i++) {
+		struct obs_source* source = items[i].source;
+
+		if (source->info.type == OBS_SOURCE_TYPE_FILTER &&
+			source->filter_parent)
+			source = source->filter_parent;
+
+		items[i].root = is_transition(source) ? NULL : source;
+		if (!items[i].root)
+			serial++;
+	}
+
+	qsort(items, num, sizeof(*items), compare_tick_items);
+
+	da_resize(video->tick_groups, 0);
+
+	for (size_t i = serial; i < num; i++) {
+		struct obs_tick_group* group;
+
+		if (i > serial && items[i].root == items[i - 1].root) {
+			group = da_end(video->tick_groups);
+			group->count++;
+			continue;
+		}
+
+		group = da_push_back_new(video->tick_groups);
+		group->first = i;
+		group->count = 1;
+	}
+
+	return serial;
+}
+
+static void tick_group(void* param, size_t index)
+{
+	struct obs_core_video* video = param;
+	const struct obs_tick_group* group = video->tick_groups.array + index;
+	const struct obs_tick_item* items = video->tick_items.array;
+
+	/* workers must not wait for the graphics thread, which waits for
+	 * them in task_pool_run.  the calling thread ticks groups too, and
+	 * may be the graphics thread. */
+	if (!is_graphics_thread)
+		is_tick_thread = true;
+
+	for (size_t i = group->first; i < group->first + group->count; i++)
+		obs_source_video_tick(items[i].source, video->tick_seconds);
+}
+
+
+static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
+{
+	struct obs_core_video* video = &obs->video;
 	uint64_t delta_time;
 	float seconds;
 
@@ -30,37 +141,88 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	/* ------------------------------------- */
 	/* call tick callbacks                   */
 
-	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	struct obs_callback_list* ticks = os_atomic_load_ptr_acquire(
+		(void* const volatile*)&obs->data.tick_callbacks_list);
 
-	for (size_t i = obs->data.tick_callbacks.num; i > 0; i--) {
+	for (size_t i = ticks ? ticks->num : 0; i > 0; i--) {
 		struct tick_callback* callback;
-		callback = obs->data.tick_callbacks.array + (i - 1);
+		callback = (struct tick_callback*)ticks->array + (i - 1);
 		callback->tick(callback->param, seconds);
 	}
 
-	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
-
 	/* ------------------------------------- */
 	/* call the tick function of each source */
 
-	pthread_mutex_lock(&data->sources_mutex);
+	snapshot_tick_sources(video);
 
-	source = data->first_source;
-	while (source) {
-		struct obs_source* cur_source = obs_source_get_ref(source);
-		source = (struct obs_source*)source->context.next;
+	if (video->tick_pool && video->tick_items.num > 1) {
+		size_t serial = group_tick_sources(video);
 
-		if (cur_source) {
-			obs_source_video_tick(cur_source, seconds);
-			obs_source_release(cur_source);
-		}
-	}
+		for (size_t i = 0; i < serial; i++)
+			obs_source_video_tick(video->tick_items.array[i].source,
+				seconds);
 
-	pthread_mutex_unlock(&data->sources_mutex);
+		video->tick_seconds = seconds;
+		task_pool_run(video->tick_pool, video->tick_groups.num,
+			tick_group, video);
+	}
+	else {
+		for (size_t i = 0; i < video->tick_items.num; i++)
+			obs_source_video_tick(video->tick_items.array[i].source,
+				seconds);
+	}
 
 	return cur_time;
 }
 
+/* drops the references taken by snapshot_tick_sources.  releasing the last
+ * one destroys the source, which must not happen on the tick thread while
+ * the graphics thread waits for it, so this runs on the graphics thread once
+ * the tick is done */
+static void release_tick_sources(struct obs_core_video* video)
+{
+	for (size_t i = 0; i < video->tick_items.num; i++)
+		obs_source_release(video->tick_items.array[i].source);
+
+	da_resize(video->tick_items, 0);
+}
+
+static const char* tick_sources_wait_name = "tick_sources wait";
+static const char* tick_sources_latency_name = "tick_sources latency";
+
+/* with a pipelined tick, hands the tick of the next frame to the tick
+ * thread.  called once the sources of the current frame are rendered. */
+static inline void start_next_tick(struct obs_core_video* video)
+{
+	if (!video->tick_thread_initialized || video->tick_pending)
+		return;
+
+	video->tick_time = video->video_time + video->video_frame_interval_ns;
+	video->tick_start_ns = os_gettime_ns();
+	video->tick_pending = true;
+	os_sem_post(video->tick_start);
+}
+
+/* waits for the tick started during the previous frame, returns false if
+ * there was none and the sources still have to be ticked */
+static inline bool finish_tick(struct obs_core_video* video,
+	uint64_t* last_time)
+{
+	if (!video->tick_pending)
+		return false;
+
+	profile_start(tick_sources_wait_name);
+	os_sem_wait(video->tick_done);
+	profile_end(tick_sources_wait_name);
+
+	profile_add_time(tick_sources_latency_name,
+		os_gettime_ns() - video->tick_start_ns);
+
+	video->tick_pending = false;
+	*last_time = video->tick_last_time;
+	return true;
+}
+
 /* in obs-display.c */
 extern void render_display(struct obs_display* display);
 
@@ -106,6 +268,173 @@ static inline void unmap_last_surface(struct obs_core_video* video)
 	}
 }
 
+/* unmaps the surfaces of a texture handed to the video output by
+ * map_through_frame once the output is done with them.  with wait set,
+ * blocks until then, because the surfaces are about to be staged into. */
+static inline void unmap_held_surfaces(struct obs_core_video* video,
+	int texture, bool wait)
+{
+	gs_stagesurf_t** surfaces = video->held_surfaces[texture];
+	volatile bool* held = &video->surfaces_held[texture];
+
+	if (!surfaces[0])
+		return;
+
+	if (os_atomic_load_bool(held)) {
+		if (!wait)
+			return;
+
+		while (os_atomic_load_bool(held))
+			os_sleep_ms(1);
+	}
+
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		if (surfaces[c]) {
+			gs_stagesurface_unmap(surfaces[c]);
+			surfaces[c] = NULL;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* dynamic render scale                                                       */
+
+#define RENDER_SCALE_STEP 0.1f
+
+/* scale down above this share of the frame interval, up below the other */
+#define RENDER_SCALE_DOWN_LOAD 85
+#define RENDER_SCALE_UP_LOAD 60
+
+/* frames to let the frame time settle after a change, and frames below
+ * RENDER_SCALE_UP_LOAD before scaling back up */
+#define RENDER_SCALE_HOLD_FRAMES 8
+#define RENDER_SCALE_UP_FRAMES 60
+
+static void set_render_scale(struct obs_core_video* video, uint32_t step)
+{
+	const float scale = 1.0f - RENDER_SCALE_STEP * (float)step;
+	uint32_t width = (uint32_t)((float)video->base_width * scale);
+	uint32_t height = (uint32_t)((float)video->base_height * scale);
+
+	video->render_scale_step = step;
+	video->render_width = width > 2 ? width & ~1 : 2;
+	video->render_height = height > 2 ? height & ~1 : 2;
+	video->render_scale_hold = RENDER_SCALE_HOLD_FRAMES;
+	video->render_scale_calm = 0;
+
+	blog(LOG_DEBUG, "Render scale set to %d%% (%ux%u)",
+		(int)(scale * 100.0f + 0.5f), video->render_width,
+		video->render_height);
+}
+
+/* steps the render scale down when frames come close to the interval or
+ * lag, and back up with hysteresis once they have had headroom for a
+ * while */
+static void update_render_scale(struct obs_core_video* video,
+	uint64_t frame_time_ns, bool lagged)
+{
+	const uint64_t interval = video->video_frame_interval_ns;
+	const uint32_t max_step = (uint32_t)(
+		(1.0f - video->min_render_scale) / RENDER_SCALE_STEP + 0.01f);
+	uint32_t step = video->render_scale_step;
+	uint64_t avg;
+
+	if (!video->dynamic_render_scale)
+		return;
+
+	/* moving average over roughly eight frames */
+	avg = video->render_frame_time_ns;
+	avg = avg ? avg - avg / 8 + frame_time_ns / 8 : frame_time_ns;
+	video->render_frame_time_ns = avg;
+
+	if (video->render_scale_hold) {
+		video->render_scale_hold--;
+		return;
+	}
+
+	if (lagged || avg * 100 > interval * RENDER_SCALE_DOWN_LOAD) {
+		video->render_scale_calm = 0;
+		if (step < max_step)
+			set_render_scale(video, step + 1);
+	}
+	else if (avg * 100 < interval * RENDER_SCALE_UP_LOAD) {
+		if (step && ++video->render_scale_calm >=
+			RENDER_SCALE_UP_FRAMES)
+			set_render_scale(video, step - 1);
+	}
+	else {
+		video->render_scale_calm = 0;
+	}
+}
+
+/* the scaled scene is rendered into the corner of a texture of the base
+ * size, so that changing the scale does not reallocate anything */
+static inline bool scaled_rendering(struct obs_core_video* video)
+{
+	if (!video->render_scale_step)
+		return false;
+	if (video->scaled_texture)
+		return true;
+
+	video->scaled_texture = gs_texture_create(video->base_width,
+		video->base_height,
+		gs_texture_get_color_format(video->render_texture), 1, NULL,
+		GS_RENDER_TARGET);
+	if (video->scaled_texture)
+		return true;
+
+	blog(LOG_WARNING, "Failed to create the scaled render texture, "
+		"disabling dynamic render scale");
+	video->dynamic_render_scale = false;
+	video->render_scale_step = 0;
+	return false;
+}
+
+/* the projection stays in base coordinates, only the viewport shrinks */
+static inline void set_scaled_render_size(struct obs_core_video* video)
+{
+	gs_enable_depth_test(false);
+	gs_set_cull_mode(GS_NEITHER);
+
+	gs_ortho(0.0f, (float)video->base_width, 0.0f,
+		(float)video->base_height, -100.0f, 100.0f);
+	gs_set_viewport(0, 0, video->render_width, video->render_height);
+}
+
+static inline void stretch_scaled_texture(struct obs_core_video* video)
+{
+	gs_effect_t* effect = video->default_effect;
+	gs_technique_t* tech = gs_effect_get_technique(effect, "Draw");
+	gs_eparam_t* image = gs_effect_get_param_by_name(effect, "image");
+	size_t passes;
+
+	gs_set_render_target(video->render_texture, NULL);
+	set_render_size(video->base_width, video->base_height);
+
+	gs_enable_blending(false);
+	gs_effect_set_texture(image, video->scaled_texture);
+
+	gs_matrix_push();
+	gs_matrix_identity();
+	gs_matrix_scale3f(
+		(float)video->base_width / (float)video->render_width,
+		(float)video->base_height / (float)video->render_height, 1.0f);
+
+	passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite_subregion(video->scaled_texture, 0, 0, 0,
+			video->render_width, video->render_height);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+
+	gs_matrix_pop();
+	gs_enable_blending(true);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static const char* render_main_texture_name = "render_main_texture";
 static inline void render_main_texture(struct obs_core_video* video)
 {
@@ -113,27 +442,39 @@ static inline void render_main_texture(struct obs_core_video* video)
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_MAIN_TEXTURE,
 		render_main_texture_name);
 
+	const bool scaled = scaled_rendering(video);
 	struct vec4 clear_color;
 	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
 
-	gs_set_render_target(video->render_texture, NULL);
+	gs_set_render_target(scaled ? video->scaled_texture :
+		video->render_texture, NULL);
 	gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
 
-	set_render_size(video->base_width, video->base_height);
+	if (scaled)
+		set_scaled_render_size(video);
+	else
+		set_render_size(video->base_width, video->base_height);
 
-	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	struct obs_callback_list* draws = os_atomic_load_ptr_acquire(
+		(void* const volatile*)&obs->data.draw_callbacks_list);
 
-	for (size_t i = obs->data.draw_callbacks.num; i > 0; i--) {
+	for (size_t i = draws ? draws->num : 0; i > 0; i--) {
 		struct draw_callback* callback;
-		callback = obs->data.draw_callbacks.array + (i - 1);
+		callback = (struct draw_callback*)draws->array + (i - 1);
 
 		callback->draw(callback->param, video->base_width,
 			video->base_height);
 	}
 
-	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+	if (video->render_culling)
+		obs_view_render_culled(&obs->data.main_view,
+			&video->render_graph, video->base_width,
+			video->base_height);
+	else
+		obs_view_render(&obs->data.main_view);
 
-	obs_view_render(&obs->data.main_view);
+	if (scaled)
+		stretch_scaled_texture(video);
 
 	video->texture_rendered = true;
 
@@ -218,6 +559,9 @@ static inline void render_video(struct obs_core_video* video, bool raw_active,
 
 	render_main_texture(video);
 
+	/* the sources are not read again this frame */
+	start_next_tick(video);
+
 	if (raw_active || gpu_active) {
 		gs_texture_t* texture = render_output_texture(video);
 
@@ -236,8 +580,10 @@ static inline void render_video(struct obs_core_video* video, bool raw_active,
 		}
 #endif
 
-		if (raw_active)
+		if (raw_active) {
+			unmap_held_surfaces(video, cur_texture, true);
 			stage_output_texture(video, cur_texture);
+		}
 	}
 
 	gs_set_render_target(NULL, NULL);
@@ -246,35 +592,222 @@ static inline void render_video(struct obs_core_video* video, bool raw_active,
 	gs_end_scene();
 }
 
-static inline void copy_rgbx_frame(struct video_frame* output,
-	const struct video_data* input,
-	const struct video_output_info* info)
+struct plane_copy {
+	uint8_t* out;
+	const uint8_t* in;
+	uint32_t out_linesize;
+	uint32_t in_linesize;
+	size_t width;
+	uint32_t shift;
+};
+
+struct frame_copy {
+	struct plane_copy planes[MAX_AV_PLANES];
+	size_t num_planes;
+	uint32_t height;
+};
+
+static inline void copy_plane_rows(const struct plane_copy* plane,
+	uint32_t start_y, uint32_t end_y)
 {
-	uint8_t* in_ptr = input->data[0];
-	uint8_t* out_ptr = output->data[0];
+	const uint8_t* in_ptr = plane->in + (size_t)start_y * plane->in_linesize;
+	uint8_t* out_ptr = plane->out + (size_t)start_y * plane->out_linesize;
 
 	/* if the line sizes match, do a single copy */
-	if (input->linesize[0] == output->linesize[0]) {
+	if (plane->in_linesize == plane->out_linesize) {
 		memcpy(out_ptr, in_ptr,
-			(size_t)input->linesize[0] * (size_t)info->height);
+			(size_t)plane->in_linesize * (end_y - start_y));
 	}
 	else {
-		const size_t copy_size = (size_t)info->width * 4;
-		for (size_t y = 0; y < info->height; y++) {
-			memcpy(out_ptr, in_ptr, copy_size);
-			in_ptr += input->linesize[0];
-			out_ptr += output->linesize[0];
+		for (uint32_t y = start_y; y < end_y; y++) {
+			memcpy(out_ptr, in_ptr, plane->width);
+			in_ptr += plane->in_linesize;
+			out_ptr += plane->out_linesize;
 		}
 	}
 }
 
+static void copy_frame_slice(void* param, uint32_t slice, uint32_t start_y,
+	uint32_t end_y)
+{
+	const struct frame_copy* copy = param;
+
+	for (size_t i = 0; i < copy->num_planes; i++) {
+		const struct plane_copy* plane = &copy->planes[i];
+		const uint32_t round = (1 << plane->shift) - 1;
+
+		copy_plane_rows(plane, start_y >> plane->shift,
+			(end_y + round) >> plane->shift);
+	}
+
+	UNUSED_PARAMETER(slice);
+}
+
+static inline void add_plane_copy(struct frame_copy* copy,
+	struct video_frame* output, const struct video_data* input,
+	size_t plane, size_t width, uint32_t shift)
+{
+	struct plane_copy* dst = &copy->planes[copy->num_planes++];
+
+	dst->out = output->data[plane];
+	dst->in = input->data[plane];
+	dst->out_linesize = output->linesize[plane];
+	dst->in_linesize = input->linesize[plane];
+	dst->width = width;
+	dst->shift = shift;
+}
+
+/* copies the planes row-slice by row-slice on the video output's slice
+ * pool; slices start on even rows so subsampled planes split cleanly */
+static inline void run_frame_copy(struct obs_core_video* video,
+	const struct frame_copy* copy)
+{
+	size_t frame_size = 0;
+
+	for (size_t i = 0; i < copy->num_planes; i++)
+		frame_size += copy->planes[i].width *
+			(copy->height >> copy->planes[i].shift);
+
+	video_slice_pool_run(video_output_get_slice_pool(video->video),
+		copy->height, 2, frame_size, copy_frame_slice,
+		(void*)copy);
+}
+
+static inline void set_gpu_converted_data(struct obs_core_video* video,
+	struct video_frame* output, const struct video_data* input,
+	const struct video_output_info* info)
+{
+	const size_t width = info->width;
+	const size_t chroma_width = (width + 1) / 2;
+	struct frame_copy copy = { .height = info->height };
+
+	switch (info->format) {
+	case VIDEO_FORMAT_I420:
+		add_plane_copy(&copy, output, input, 0, width, 0);
+		add_plane_copy(&copy, output, input, 1, chroma_width, 1);
+		add_plane_copy(&copy, output, input, 2, chroma_width, 1);
+		break;
+	case VIDEO_FORMAT_NV12:
+		add_plane_copy(&copy, output, input, 0, width, 0);
+		add_plane_copy(&copy, output, input, 1, chroma_width * 2, 1);
+		break;
+	case VIDEO_FORMAT_I444:
+		add_plane_copy(&copy, output, input, 0, width, 0);
+		add_plane_copy(&copy, output, input, 1, width, 0);
+		add_plane_copy(&copy, output, input, 2, width, 0);
+		break;
+	default:
+		add_plane_copy(&copy, output, input, 0, width * 4, 0);
+		break;
+	}
+
+	run_frame_copy(video, &copy);
+}
+
+static inline void copy_rgbx_frame(struct obs_core_video* video,
+	struct video_frame* output, const struct video_data* input,
+	const struct video_output_info* info)
+{
+	struct frame_copy copy = { .height = info->height };
+
+	add_plane_copy(&copy, output, input, 0, (size_t)info->width * 4, 0);
+	run_frame_copy(video, &copy);
+}
+
+static void release_held_surfaces(void* param)
+{
+	os_atomic_set_bool((volatile bool*)param, false);
+}
+
+/* queues the mapped surfaces of a texture to the video output as they are,
+ * saving the copy into the frame cache */
+static inline bool map_through_frame(struct obs_core_video* video,
+	struct video_data* input_frame, int count, int texture)
+{
+	volatile bool* held = &video->surfaces_held[texture];
+
+	os_atomic_set_bool(held, true);
+
+	if (!video_output_submit_frame(video->video, input_frame, count,
+		release_held_surfaces, (void*)held)) {
+		os_atomic_set_bool(held, false);
+		return false;
+	}
+
+	/* keep unmap_last_surface away from them */
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		video->held_surfaces[texture][c] = video->mapped_surfaces[c];
+		video->mapped_surfaces[c] = NULL;
+	}
+
+	return true;
+}
+
+/* damage tiles, in output pixels */
+#define DAMAGE_TILE_SIZE 64
+
+static const char* damage_hash_name = "damage_hash";
+
+/* hashes the downloaded frame and returns true if it is identical to the
+ * previous one */
+static bool frame_unchanged(struct obs_core_video* video,
+	const struct video_data* frame)
+{
+	const struct video_output_info* info;
+	uint64_t start;
+	uint32_t changed;
+
+	if (!video->skip_unchanged_frames)
+		return false;
+
+	/* without GPU conversion, the RGBA frame is downloaded as is */
+	if (!video->damage) {
+		info = video_output_get_info(video->video);
+		video->damage = video_damage_create(video->gpu_conversion ?
+			info->format : VIDEO_FORMAT_RGBA,
+			info->width, info->height, DAMAGE_TILE_SIZE);
+
+		if (!video->damage) {
+			blog(LOG_WARNING, "Damage tracking is not supported "
+				"for this output, disabling it");
+			video->skip_unchanged_frames = false;
+			return false;
+		}
+	}
+
+	profile_start(damage_hash_name);
+	start = os_gettime_ns();
+
+	changed = video_damage_update(video->damage, frame,
+		video_output_get_slice_pool(video->video));
+
+	video->damage_hash_ns += os_gettime_ns() - start;
+	video->hashed_frames++;
+	profile_end(damage_hash_name);
+
+	return changed == 0;
+}
+
 static inline void output_video_data(struct obs_core_video* video,
-	struct video_data* input_frame, int count)
+	struct video_data* input_frame, int count, int texture)
 {
 	const struct video_output_info* info;
 	struct video_frame output_frame;
 	bool locked;
 
+	if (video->map_through &&
+		map_through_frame(video, input_frame, count, texture))
+		return;
+
+	/* only frames copied into the cache can be repeated, so frames that
+	 * were mapped through are not hashed */
+	if (frame_unchanged(video, input_frame) &&
+		video_output_repeat_frame(video->video, count,
+			input_frame->timestamp)) {
+		video->unchanged_frames += count;
+		return;
+	}
+
 	info = video_output_get_info(video->video);
 
 	locked = video_output_lock_frame(video->video, &output_frame, count,
@@ -285,23 +818,28 @@ static inline void output_video_data(struct obs_core_video* video,
 				input_frame, info);
 		}
 		else {
-			copy_rgbx_frame(&output_frame, input_frame, info);
+			copy_rgbx_frame(video, &output_frame, input_frame,
+				info);
 		}
 
 		video_output_unlock_frame(video->video);
 	}
 }
 
-static inline void video_sleep(struct obs_core_video* video, bool raw_active,
+/* returns true and sets wake_error if it slept until the next frame */
+static inline bool video_sleep(struct obs_core_video* video, bool raw_active,
 	const bool gpu_active, uint64_t* p_time,
-	uint64_t interval_ns)
+	uint64_t interval_ns, uint64_t* wake_error)
 {
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
+	bool slept;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	slept = os_sleepto_ns_spin(t, video->pacer_spin_ns);
+	if (slept) {
+		*wake_error = os_gettime_ns() - t;
 		*p_time = t;
 		count = 1;
 	}
@@ -317,11 +855,135 @@ static inline void video_sleep(struct obs_core_video* video, bool raw_active,
 	vframe_info.count = count;
 
 	if (raw_active)
-		circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
-			sizeof(vframe_info));
+		video->textures_info[video->last_texture] = vframe_info;
 	if (gpu_active)
 		circlebuf_push_back(&video->vframe_info_buffer_gpu,
 			&vframe_info, sizeof(vframe_info));
+
+	return slept;
+}
+
+/* nothing consumes frames, so the idle interval passes between frames
+ * unless a consumer starts.  frames in between are skipped rather than
+ * lagged, and video_time stays on the frame grid so that timestamps carry
+ * on seamlessly once frames are output again. */
+static inline bool idle_mode(struct obs_core_video* video, bool active)
+{
+	return !active && video->idle_event &&
+		video->idle_interval_ns > video->video_frame_interval_ns;
+}
+
+static inline void idle_sleep(struct obs_core_video* video, uint64_t* p_time,
+	uint64_t interval_ns)
+{
+	uint64_t cur_time = *p_time;
+	uint64_t t;
+
+	os_event_timedwait(video->idle_event,
+		(unsigned long)(video->idle_interval_ns / 1000000));
+
+	t = os_gettime_ns();
+	t = cur_time + ((t - cur_time) / interval_ns + 1) * interval_ns;
+	os_sleepto_ns_spin(t, video->pacer_spin_ns);
+
+	*p_time = t;
+}
+
+/* maps the staged surfaces of a texture, blocking until the GPU copy into
+ * them has completed */
+static inline bool download_frame(struct obs_core_video* video,
+	int texture, struct video_data* frame)
+{
+	if (!video->textures_copied[texture])
+		return false;
+
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		gs_stagesurf_t* surface = video->copy_surfaces[texture][c];
+		if (!surface)
+			continue;
+
+		if (!gs_stagesurface_map(surface, &frame->data[c],
+			&frame->linesize[c]))
+			return false;
+
+		video->mapped_surfaces[c] = surface;
+	}
+
+	return true;
+}
+
+/* adaptive readback: this many maps blocking for longer than
+ * readback_stall_ns within the window deepen the ring by a frame */
+#define READBACK_STALLS_TO_DEEPEN 3
+#define READBACK_STALL_WINDOW 60
+
+static inline void check_readback_stall(struct obs_core_video* video,
+	uint64_t map_time)
+{
+	if (!video->readback_stall_ns ||
+		video->num_textures == MAX_TEXTURES)
+		return;
+
+	if (map_time > video->readback_stall_ns)
+		video->readback_stalls++;
+
+	if (++video->readback_window == READBACK_STALL_WINDOW) {
+		if (video->readback_stalls < READBACK_STALLS_TO_DEEPEN)
+			video->readback_stalls = 0;
+		video->readback_window = 0;
+	}
+}
+
+/* adds an empty slot to the ring right after the one about to be rendered
+ * into, making it the next to be downloaded.  that download finds nothing,
+ * which is the one frame of latency being added; every staged frame is
+ * still downloaded in order afterwards.  slots are not moved while the
+ * video output holds any of their surfaces, so this waits for those. */
+static void deepen_readback(struct obs_core_video* video)
+{
+	const int num = video->num_textures;
+	const int slot = video->cur_texture + 1;
+	gs_stagesurf_t* surfaces[NUM_CHANNELS];
+
+	for (int i = 0; i < num; i++) {
+		if (os_atomic_load_bool(&video->surfaces_held[i]))
+			return;
+	}
+
+	video->readback_stalls = 0;
+	video->readback_window = 0;
+
+	memset(video->copy_surfaces[num], 0, sizeof(video->copy_surfaces[num]));
+	if (!obs_init_copy_surfaces(&video->ovi, num)) {
+		for (int c = 0; c < NUM_CHANNELS; c++)
+			gs_stagesurface_destroy(video->copy_surfaces[num][c]);
+		memset(video->copy_surfaces[num], 0,
+			sizeof(video->copy_surfaces[num]));
+
+		blog(LOG_WARNING, "Failed to create readback surfaces, "
+			"disabling adaptive readback");
+		video->readback_stall_ns = 0;
+		return;
+	}
+
+	memcpy(surfaces, video->copy_surfaces[num], sizeof(surfaces));
+
+	for (int i = num; i > slot; i--) {
+		memcpy(video->copy_surfaces[i], video->copy_surfaces[i - 1],
+			sizeof(video->copy_surfaces[i]));
+		video->textures_copied[i] = video->textures_copied[i - 1];
+		video->textures_info[i] = video->textures_info[i - 1];
+	}
+
+	memcpy(video->copy_surfaces[slot], surfaces, sizeof(surfaces));
+	video->textures_copied[slot] = false;
+	video->num_textures = num + 1;
+
+	blog(LOG_INFO, "Readback kept stalling for more than %" PRIu64 " ns, "
+		"readback depth increased to %d (+%d frame%s of latency)",
+		video->readback_stall_ns, video->num_textures,
+		video->num_textures - NUM_TEXTURES,
+		video->num_textures - NUM_TEXTURES == 1 ? "" : "s");
 }
 
 static const char* output_frame_gs_context_name = "gs_context(video->graphics)";
@@ -332,9 +994,8 @@ static const char* output_frame_output_video_data_name = "output_video_data";
 static inline void output_frame(bool raw_active, const bool gpu_active)
 {
 	struct obs_core_video *video = &obs->video;
-	int cur_texture = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
-		: cur_texture - 1;
+	int cur_texture;
+	int prev_texture;
 	struct video_data frame;
 	bool frame_ready = 0;
 
@@ -343,6 +1004,17 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	for (int i = 0; i < video->num_textures; i++)
+		unmap_held_surfaces(video, i, false);
+
+	if (video->readback_stalls >= READBACK_STALLS_TO_DEEPEN)
+		deepen_readback(video);
+
+	/* stage into the current slot and download the oldest one */
+	cur_texture = video->cur_texture;
+	prev_texture = (cur_texture + 1) % video->num_textures;
+	video->last_texture = cur_texture;
+
 	profile_start(output_frame_render_video_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_RENDER_VIDEO,
 		output_frame_render_video_name);
@@ -351,9 +1023,15 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	profile_end(output_frame_render_video_name);
 
 	if (raw_active) {
+		const bool copied = video->textures_copied[prev_texture];
+		uint64_t map_start = os_gettime_ns();
+
 		profile_start(output_frame_download_frame_name);
 		frame_ready = download_frame(video, prev_texture, &frame);
 		profile_end(output_frame_download_frame_name);
+
+		if (copied)
+			check_readback_stall(video, os_gettime_ns() - map_start);
 	}
 
 	profile_start(output_frame_gs_flush_name);
@@ -364,17 +1042,17 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	profile_end(output_frame_gs_context_name);
 
 	if (raw_active && frame_ready) {
-		struct obs_vframe_info vframe_info;
-		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
-			sizeof(vframe_info));
+		struct obs_vframe_info vframe_info =
+			video->textures_info[prev_texture];
 
 		frame.timestamp = vframe_info.timestamp;
 		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
+		output_video_data(video, &frame, vframe_info.count,
+			prev_texture);
 		profile_end(output_frame_output_video_data_name);
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	if (++video->cur_texture == video->num_textures)
 		video->cur_texture = 0;
 }
 
@@ -385,7 +1063,6 @@ static void clear_base_frame_data(void)
 	struct obs_core_video* video = &obs->video;
 	video->texture_rendered = false;
 	video->texture_converted = false;
-	circlebuf_free(&video->vframe_info_buffer);
 	video->cur_texture = 0;
 }
 
@@ -393,7 +1070,12 @@ static void clear_raw_frame_data(void)
 {
 	struct obs_core_video* video = &obs->video;
 	memset(video->textures_copied, 0, sizeof(video->textures_copied));
-	circlebuf_free(&video->vframe_info_buffer);
+	video->readback_stalls = 0;
+	video->readback_window = 0;
+
+	/* the output may have been reset since */
+	video_damage_destroy(video->damage);
+	video->damage = NULL;
 }
 
 
@@ -483,6 +1165,10 @@ static void uninit_winrt_state(struct winrt_state* winrt)
 static const char* tick_sources_name = "tick_sources";
 static const char* render_displays_name = "render_displays";
 static const char* output_frame_name = "output_frame";
+static const char* wake_error_name = "video_sleep wake-up error";
+
+static void execute_graphics_tasks(void);
+
 bool obs_graphics_thread_loop(struct obs_graphics_context* context)
 {
 	/* defer loop break to clean up sources */
@@ -491,6 +1177,7 @@ bool obs_graphics_thread_loop(struct obs_graphics_context* context)
 	uint64_t frame_start = os_gettime_ns();
 	uint64_t frame_time_ns;
 	bool raw_active = obs->video.raw_active > 0;
+	bool ticked;
 
 #pragma region 
 	const bool gpu_active = obs->video.gpu_encoder_active > 0;
@@ -513,14 +1200,29 @@ bool obs_graphics_thread_loop(struct obs_graphics_context* context)
 
 	profile_start(context->video_thread_name);
 
+	if (context->wake_error_valid)
+		profile_add_time(wake_error_name, context->wake_error_ns);
+
+	/* the tick thread may still be iterating the tick callbacks */
+	ticked = finish_tick(&obs->video, &context->last_time);
+
+	/* nothing from the previous frame still references a callback list */
+	obs_reclaim_callback_lists();
+
 	gs_enter_context(obs->video.graphics);
 	gs_begin_frame();
 	gs_leave_context();
 
-	profile_start(tick_sources_name);
-	context->last_time =
-		tick_sources(obs->video.video_time, context->last_time);
-	profile_end(tick_sources_name);
+	if (!ticked) {
+		profile_start(tick_sources_name);
+		context->last_time = tick_sources(obs->video.video_time,
+			context->last_time);
+		profile_end(tick_sources_name);
+	}
+
+	release_tick_sources(&obs->video);
+
+	obs->video.tick_last_time = context->last_time;
 
 	execute_graphics_tasks();
 
@@ -534,6 +1236,8 @@ bool obs_graphics_thread_loop(struct obs_graphics_context* context)
 	output_frame(raw_active, gpu_active);
 	profile_end(output_frame_name);
 
+	/* note that displays render sources as well, with a pipelined tick
+	 * they have to be rendered before the next tick is started */
 	profile_start(render_displays_name);
 	//render_displays();
 	profile_end(render_displays_name);
@@ -544,8 +1248,19 @@ bool obs_graphics_thread_loop(struct obs_graphics_context* context)
 
 	profile_reenable_thread();
 
-	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
-		context->interval);
+	if (idle_mode(&obs->video, active) && !stop_requested) {
+		idle_sleep(&obs->video, &obs->video.video_time,
+			context->interval);
+		context->wake_error_valid = false;
+	}
+	else {
+		context->wake_error_valid = video_sleep(&obs->video,
+			raw_active, gpu_active, &obs->video.video_time,
+			context->interval, &context->wake_error_ns);
+
+		update_render_scale(&obs->video, frame_time_ns,
+			!context->wake_error_valid);
+	}
 
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
@@ -566,7 +1281,86 @@ bool obs_graphics_thread_loop(struct obs_graphics_context* context)
 
 	return !stop_requested;
 }
-extern THREAD_LOCAL bool is_graphics_thread;
+static const char* tick_thread_name = "obs_tick_thread";
+
+static void* tick_thread(void* param)
+{
+	struct obs_core_video* video = param;
+
+	os_set_thread_name("libobs: tick thread");
+
+	is_tick_thread = true;
+
+	profile_register_root(tick_thread_name,
+		video->video_frame_interval_ns);
+
+	for (;;) {
+		os_sem_wait(video->tick_start);
+		if (video->tick_stop)
+			break;
+
+		profile_start(tick_thread_name);
+		profile_start(tick_sources_name);
+		video->tick_last_time = tick_sources(video->tick_time,
+			video->tick_last_time);
+		profile_end(tick_sources_name);
+		profile_end(tick_thread_name);
+
+		profile_reenable_thread();
+
+		os_sem_post(video->tick_done);
+	}
+
+	return NULL;
+}
+
+static void init_tick_thread(struct obs_core_video* video)
+{
+	video->tick_pending = false;
+	video->tick_stop = false;
+
+	if (!video->pipelined_tick)
+		return;
+
+	if (os_sem_init(&video->tick_start, 0) != 0)
+		goto fail;
+	if (os_sem_init(&video->tick_done, 0) != 0)
+		goto fail;
+	if (pthread_create(&video->tick_thread, NULL, tick_thread, video) != 0)
+		goto fail;
+
+	video->tick_thread_initialized = true;
+	return;
+
+fail:
+	blog(LOG_WARNING, "Failed to create the tick thread, ticking sources "
+		"on the graphics thread");
+	os_sem_destroy(video->tick_start);
+	os_sem_destroy(video->tick_done);
+	video->tick_start = NULL;
+	video->tick_done = NULL;
+}
+
+static void stop_tick_thread(struct obs_core_video* video)
+{
+	if (!video->tick_thread_initialized)
+		return;
+
+	if (video->tick_pending) {
+		os_sem_wait(video->tick_done);
+		video->tick_pending = false;
+	}
+
+	video->tick_stop = true;
+	os_sem_post(video->tick_start);
+	pthread_join(video->tick_thread, NULL);
+	video->tick_thread_initialized = false;
+
+	os_sem_destroy(video->tick_start);
+	os_sem_destroy(video->tick_done);
+	video->tick_start = NULL;
+	video->tick_done = NULL;
+}
 
 void* obs_graphics_thread(void* param)
 {
@@ -599,8 +1393,44 @@ void* obs_graphics_thread(void* param)
 	context.raw_was_active = false;
 	context.was_active = false;
 	context.video_thread_name = video_thread_name;
+	context.wake_error_ns = 0;
+	context.wake_error_valid = false;
+
+	if (obs->video.pacer_timer_slack_ns &&
+		!os_set_thread_timer_slack(obs->video.pacer_timer_slack_ns))
+		blog(LOG_DEBUG, "Timer slack not supported, ignoring");
+
+	if (obs->video.tick_threads > 1)
+		obs->video.tick_pool = task_pool_create(
+			obs->video.tick_threads, "libobs: tick worker");
+
+	obs_publish_callback_lists();
+	init_tick_thread(&obs->video);
 	while (obs_graphics_thread_loop(&context));//ϻȡ֡
 
+	stop_tick_thread(&obs->video);
+	release_tick_sources(&obs->video);
+	obs_free_callback_lists();
+
+	/* release threads waiting for a frame that will not come */
+	os_event_signal(obs->video.quiescent_event);
+
+	task_pool_destroy(obs->video.tick_pool);
+	obs->video.tick_pool = NULL;
+	da_free(obs->video.tick_items);
+	da_free(obs->video.tick_groups);
+	obs_render_graph_free(&obs->video.render_graph);
+
+	video_damage_destroy(obs->video.damage);
+	obs->video.damage = NULL;
+
+	if (obs->video.scaled_texture) {
+		gs_enter_context(obs->video.graphics);
+		gs_texture_destroy(obs->video.scaled_texture);
+		gs_leave_context();
+		obs->video.scaled_texture = NULL;
+	}
+
 	uninit_winrt_state(&winrt);
 
 	UNUSED_PARAMETER(param);
@@ -608,19 +1438,68 @@ void* obs_graphics_thread(void* param)
 }
 
 
+/* returns NULL if the queue is empty, or if a producer is halfway through
+ * pushing, in which case the task is picked up on a later call */
+static struct obs_task_info* pop_graphics_task(struct obs_core_video* video)
+{
+	struct obs_task_info* tail = video->tasks_tail;
+	struct obs_task_info* next = os_atomic_load_ptr_acquire(
+		(void* const volatile*)&tail->next);
+
+	if (tail == &video->tasks_stub) {
+		if (!next)
+			return NULL;
+
+		video->tasks_tail = tail = next;
+		next = os_atomic_load_ptr_acquire(
+			(void* const volatile*)&tail->next);
+	}
+
+	if (next) {
+		video->tasks_tail = next;
+		return tail;
+	}
+
+	if (tail != os_atomic_load_ptr_acquire(
+		(void* const volatile*)&video->tasks_head))
+		return NULL;
+
+	obs_task_queue_push(video, &video->tasks_stub);
+
+	next = os_atomic_load_ptr_acquire((void* const volatile*)&tail->next);
+	if (next) {
+		video->tasks_tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+/* producers never wait on the graphics thread: tasks are pushed lock-free
+ * and run here without any lock held.  once task_budget_ns is used up the
+ * remaining tasks are left for the next frame, and counted in
+ * deferred_tasks. */
 static void execute_graphics_tasks(void)
 {
 	struct obs_core_video* video = &obs->video;
-	bool tasks_remaining = true;
-
-	while (tasks_remaining) {
-		pthread_mutex_lock(&video->task_mutex);
-		if (video->tasks.size) {
-			struct obs_task_info info;
-			circlebuf_pop_front(&video->tasks, &info, sizeof(info));
-			info.task(info.param);
-		}
-		tasks_remaining = !!video->tasks.size;
-		pthread_mutex_unlock(&video->task_mutex);
+	const uint64_t budget = video->task_budget_ns;
+	const uint64_t start = budget ? os_gettime_ns() : 0;
+	struct obs_task_info* info;
+	bool over_budget = false;
+	long deferred;
+
+	while (!over_budget && (info = pop_graphics_task(video)) != NULL) {
+		os_atomic_dec_long(&video->tasks_pending);
+		info->task(info->param);
+		bfree(info);
+
+		over_budget = budget && os_gettime_ns() - start >= budget;
 	}
+
+	if (!over_budget)
+		return;
+
+	deferred = os_atomic_load_long(&video->tasks_pending);
+	if (deferred > 0)
+		video->deferred_tasks += (uint64_t)deferred;
 }
@@ -19,6 +19,99 @@ void start_raw_video(video_t* v, const struct video_scale_info* conversion,
 	struct obs_core_video* video = &obs->video;
 	os_atomic_inc_long(&video->raw_active);
 	video_output_connect(v, conversion, callback, param);
+	obs_video_wake(video);
+}
+
+static inline int get_readback_depth(const struct obs_video_info *ovi)
+{
+	if (!ovi->readback_depth)
+		return NUM_TEXTURES;
+	if (ovi->readback_depth < NUM_TEXTURES)
+		return NUM_TEXTURES;
+	if (ovi->readback_depth > MAX_TEXTURES)
+		return MAX_TEXTURES;
+	return (int)ovi->readback_depth;
+}
+
+static inline float get_min_render_scale(const struct obs_video_info *ovi)
+{
+	if (ovi->min_render_scale <= 0.0f)
+		return 0.5f;
+	if (ovi->min_render_scale < 0.25f)
+		return 0.25f;
+	if (ovi->min_render_scale > 1.0f)
+		return 1.0f;
+	return ovi->min_render_scale;
+}
+
+static inline void create_stagesurf(gs_stagesurf_t **surface,
+	uint32_t width, uint32_t height, enum gs_color_format format)
+{
+	*surface = gs_stagesurface_create(width, height, format);
+}
+
+/* creates the staging surfaces of one slot of the readback ring, in the
+ * layout stage_output_texture copies into */
+bool obs_init_copy_surfaces(const struct obs_video_info *ovi, int texture)
+{
+	struct obs_core_video *video = &obs->video;
+	gs_stagesurf_t **surfaces = video->copy_surfaces[texture];
+	const uint32_t width = ovi->output_width;
+	const uint32_t height = ovi->output_height;
+	int channels = 1;
+
+#ifdef _WIN32
+	if (video->using_nv12_tex) {
+		surfaces[0] = gs_stagesurface_create_nv12(width, height);
+		return surfaces[0] != NULL;
+	}
+#endif
+
+	if (!video->gpu_conversion) {
+		create_stagesurf(&surfaces[0], width, height, GS_RGBA);
+		return surfaces[0] != NULL;
+	}
+
+	switch (ovi->output_format) {
+	case VIDEO_FORMAT_I420:
+		create_stagesurf(&surfaces[0], width, height, GS_R8);
+		create_stagesurf(&surfaces[1], width / 2, height / 2, GS_R8);
+		create_stagesurf(&surfaces[2], width / 2, height / 2, GS_R8);
+		channels = 3;
+		break;
+	case VIDEO_FORMAT_NV12:
+		create_stagesurf(&surfaces[0], width, height, GS_R8);
+		create_stagesurf(&surfaces[1], width / 2, height / 2, GS_R8G8);
+		channels = 2;
+		break;
+	case VIDEO_FORMAT_I444:
+		create_stagesurf(&surfaces[0], width, height, GS_R8);
+		create_stagesurf(&surfaces[1], width, height, GS_R8);
+		create_stagesurf(&surfaces[2], width, height, GS_R8);
+		channels = 3;
+		break;
+	default:
+		create_stagesurf(&surfaces[0], width, height, GS_RGBA);
+		break;
+	}
+
+	for (int c = 0; c < channels; c++) {
+		if (!surfaces[c])
+			return false;
+	}
+
+	return true;
+}
+
+/* tasks still queued from before a video reset are kept */
+static inline void init_task_queue(struct obs_core_video *video)
+{
+	if (video->tasks_head)
+		return;
+
+	video->tasks_stub.next = NULL;
+	video->tasks_head = &video->tasks_stub;
+	video->tasks_tail = &video->tasks_stub;
 }
 
 static int obs_init_video(struct obs_video_info *ovi)
@@ -29,11 +122,30 @@ static int obs_init_video(struct obs_video_info *ovi)
 	int errorcode;
 
 	make_video_info(&vi, ovi);
+	vi.conversion_threads = ovi->conversion_threads;
+	vi.buffer_pages = ovi->buffer_pages;
 	video->base_width = ovi->base_width;
 	video->base_height = ovi->base_height;
 	video->output_width = ovi->output_width;
 	video->output_height = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
+	video->map_through = ovi->map_through;
+	video->pacer_spin_ns = ovi->pacer_spin_ns;
+	video->pacer_timer_slack_ns = ovi->pacer_timer_slack_ns;
+	video->task_budget_ns = ovi->task_budget_ns;
+	video->num_textures = get_readback_depth(ovi);
+	video->readback_stall_ns = ovi->readback_stall_ns;
+	video->readback_stalls = 0;
+	video->readback_window = 0;
+	video->skip_unchanged_frames = ovi->skip_unchanged_frames;
+	video->pipelined_tick = ovi->pipelined_tick;
+	video->dynamic_render_scale = ovi->dynamic_render_scale;
+	video->min_render_scale = get_min_render_scale(ovi);
+	video->render_scale_step = 0;
+	video->render_frame_time_ns = 0;
+	video->idle_interval_ns = (uint64_t)ovi->idle_interval_ms * 1000000;
+	video->tick_threads = ovi->tick_threads;
+	video->render_culling = ovi->render_culling;
 	video->scale_type = ovi->scale_type;
 
 	set_video_matrix(video, ovi);
@@ -66,8 +178,13 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->gpu_encoder_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
-	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
+	if (!video->idle_event &&
+		os_event_init(&video->idle_event, OS_EVENT_TYPE_AUTO) != 0)
 		return OBS_VIDEO_FAIL;
+	if (!video->quiescent_event &&
+		os_event_init(&video->quiescent_event, OS_EVENT_TYPE_AUTO) != 0)
+		return OBS_VIDEO_FAIL;
+	init_task_queue(video);
 
 	errorcode = pthread_create(&video->video_thread, NULL,
 		obs_graphics_thread, obs);
@@ -87,11 +204,30 @@ static int new_initvideo(struct obs_video_info  *ovi)
 	int errorcode;
 
 	make_video_info(&vi, ovi);
+	vi.conversion_threads = ovi->conversion_threads;
+	vi.buffer_pages = ovi->buffer_pages;
 	video->base_width = ovi->base_width;
 	video->base_height = ovi->base_height;
 	video->output_width = ovi->output_width;
 	video->output_height = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
+	video->map_through = ovi->map_through;
+	video->pacer_spin_ns = ovi->pacer_spin_ns;
+	video->pacer_timer_slack_ns = ovi->pacer_timer_slack_ns;
+	video->task_budget_ns = ovi->task_budget_ns;
+	video->num_textures = get_readback_depth(ovi);
+	video->readback_stall_ns = ovi->readback_stall_ns;
+	video->readback_stalls = 0;
+	video->readback_window = 0;
+	video->skip_unchanged_frames = ovi->skip_unchanged_frames;
+	video->pipelined_tick = ovi->pipelined_tick;
+	video->dynamic_render_scale = ovi->dynamic_render_scale;
+	video->min_render_scale = get_min_render_scale(ovi);
+	video->render_scale_step = 0;
+	video->render_frame_time_ns = 0;
+	video->idle_interval_ns = (uint64_t)ovi->idle_interval_ms * 1000000;
+	video->tick_threads = ovi->tick_threads;
+	video->render_culling = ovi->render_culling;
 	video->scale_type = ovi->scale_type;
 	set_video_matrix(video, ovi);
 
@@ -125,8 +261,13 @@ static int new_initvideo(struct obs_video_info  *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->gpu_encoder_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
-	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
+	if (!video->idle_event &&
+		os_event_init(&video->idle_event, OS_EVENT_TYPE_AUTO) != 0)
+		return OBS_VIDEO_FAIL;
+	if (!video->quiescent_event &&
+		os_event_init(&video->quiescent_event, OS_EVENT_TYPE_AUTO) != 0)
 		return OBS_VIDEO_FAIL;
+	init_task_queue(video);
 
 	errorcode = pthread_create(&video->video_thread, NULL,
 		obs_graphics_thread, obs);
@@ -211,3 +352,325 @@ int obs_reset_video(struct obs_video_info *ovi)
 
 	return obs_init_video(ovi);
 }
+
+uint32_t obs_get_readback_added_latency(void)
+{
+	return obs ? (uint32_t)(obs->video.num_textures - NUM_TEXTURES) : 0;
+}
+
+float obs_get_render_scale(void)
+{
+	if (!obs || !obs->video.render_scale_step)
+		return 1.0f;
+
+	return (float)obs->video.render_width / (float)obs->video.base_width;
+}
+
+uint32_t obs_get_unchanged_frames(void)
+{
+	return obs ? obs->video.unchanged_frames : 0;
+}
+
+uint64_t obs_get_average_damage_hash_ns(void)
+{
+	struct obs_core_video *video;
+
+	if (!obs)
+		return 0;
+
+	video = &obs->video;
+	return video->hashed_frames
+		       ? video->damage_hash_ns / video->hashed_frames
+		       : 0;
+}
+
+uint64_t obs_get_deferred_graphics_tasks(void)
+{
+	return obs ? obs->video.deferred_tasks : 0;
+}
+
+uint64_t obs_get_culled_render_nodes(void)
+{
+	return obs ? obs->video.render_graph.culled_nodes : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* tick/draw callback lists */
+
+extern THREAD_LOCAL bool is_graphics_thread;
+extern THREAD_LOCAL bool is_tick_thread;
+
+static struct obs_callback_list *callback_list_create(const void *array,
+	size_t num, size_t element_size)
+{
+	struct obs_callback_list *list;
+
+	list = bmalloc(sizeof(*list) + num * element_size);
+	list->refs = 1;
+	list->next_retired = NULL;
+	list->num = num;
+	list->array = list + 1;
+	if (num)
+		memcpy(list->array, array, num * element_size);
+	return list;
+}
+
+void obs_callback_list_release(struct obs_callback_list *list)
+{
+	if (list && os_atomic_dec_long(&list->refs) == 0)
+		bfree(list);
+}
+
+/* swaps in a copy of the callback array, draw_callbacks_mutex must be held */
+static void publish_callbacks(struct obs_callback_list *volatile *list,
+	const void *array, size_t num, size_t element_size)
+{
+	struct obs_callback_list *old = *list;
+
+	os_atomic_store_ptr_release((void *volatile *)list,
+		callback_list_create(array, num, element_size));
+
+	if (old) {
+		old->next_retired = obs->data.retired_callbacks;
+		obs->data.retired_callbacks = old;
+	}
+}
+
+/* called by the graphics thread at the start of each frame, where it holds
+ * no published list.  never blocks the graphics thread: if a writer holds the
+ * mutex, the retired lists are simply freed on a later frame. */
+void obs_reclaim_callback_lists(void)
+{
+	struct obs_callback_list *retired;
+
+	os_atomic_inc_long(&obs->video.quiescent_count);
+	os_event_signal(obs->video.quiescent_event);
+
+	if (!obs->data.retired_callbacks)
+		return;
+	if (pthread_mutex_trylock(&obs->data.draw_callbacks_mutex) != 0)
+		return;
+
+	retired = obs->data.retired_callbacks;
+	obs->data.retired_callbacks = NULL;
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+
+	while (retired) {
+		struct obs_callback_list *next = retired->next_retired;
+		obs_callback_list_release(retired);
+		retired = next;
+	}
+}
+
+/* called by the graphics thread before its first frame, to publish the
+ * callbacks that were added while no graphics thread was running */
+void obs_publish_callback_lists(void)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->draw_callbacks_mutex);
+	if (!data->draw_callbacks_list)
+		publish_callbacks(&data->draw_callbacks_list,
+			data->draw_callbacks.array, data->draw_callbacks.num,
+			sizeof(struct draw_callback));
+	if (!data->tick_callbacks_list)
+		publish_callbacks(&data->tick_callbacks_list,
+			data->tick_callbacks.array, data->tick_callbacks.num,
+			sizeof(struct tick_callback));
+	pthread_mutex_unlock(&data->draw_callbacks_mutex);
+}
+
+/* called by the graphics thread when it exits, after which nothing holds a
+ * published list */
+void obs_free_callback_lists(void)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->draw_callbacks_mutex);
+
+	obs_callback_list_release(data->draw_callbacks_list);
+	obs_callback_list_release(data->tick_callbacks_list);
+	data->draw_callbacks_list = NULL;
+	data->tick_callbacks_list = NULL;
+
+	while (data->retired_callbacks) {
+		struct obs_callback_list *next =
+			data->retired_callbacks->next_retired;
+		obs_callback_list_release(data->retired_callbacks);
+		data->retired_callbacks = next;
+	}
+
+	pthread_mutex_unlock(&data->draw_callbacks_mutex);
+}
+
+/* after a callback is removed the graphics thread may still be iterating a
+ * list that contains it, so wait until it has finished the current frame
+ * before the caller is allowed to free the callback's data.  the event only
+ * wakes one waiter, which passes the wakeup on to the next one.
+ *
+ * ticks do not wait: the graphics thread only gets to the next frame once
+ * they are done.  the retired list is still freed on that frame, but the
+ * callback may be called once more in the meantime. */
+static void wait_for_graphics_quiescent(void)
+{
+	long start;
+
+	if (is_graphics_thread || is_tick_thread ||
+		!obs->video.thread_initialized)
+		return;
+
+	start = os_atomic_load_long(&obs->video.quiescent_count);
+
+	/* an idle graphics thread would otherwise only get to its next frame
+	 * after the idle interval */
+	obs_video_wake(&obs->video);
+
+	while (os_atomic_load_long(&obs->video.quiescent_count) == start) {
+		if (!obs->video.thread_initialized ||
+			video_output_stopped(obs->video.video))
+			break;
+		os_event_wait(obs->video.quiescent_event);
+	}
+
+	os_event_signal(obs->video.quiescent_event);
+}
+
+void obs_add_tick_callback(void (*tick)(void *param, float seconds),
+	void *param)
+{
+	if (!obs)
+		return;
+
+	struct tick_callback data = {tick, param};
+
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	da_push_back(obs->data.tick_callbacks, &data);
+	publish_callbacks(&obs->data.tick_callbacks_list,
+		obs->data.tick_callbacks.array, obs->data.tick_callbacks.num,
+		sizeof(struct tick_callback));
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+}
+
+void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
+	void *param)
+{
+	if (!obs)
+		return;
+
+	struct tick_callback data = {tick, param};
+
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	da_erase_item(obs->data.tick_callbacks, &data);
+	publish_callbacks(&obs->data.tick_callbacks_list,
+		obs->data.tick_callbacks.array, obs->data.tick_callbacks.num,
+		sizeof(struct tick_callback));
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+
+	wait_for_graphics_quiescent();
+}
+
+void obs_add_main_render_callback(void (*draw)(void *param, uint32_t cx,
+	uint32_t cy),
+	void *param)
+{
+	if (!obs)
+		return;
+
+	struct draw_callback data = {draw, param};
+
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	da_push_back(obs->data.draw_callbacks, &data);
+	publish_callbacks(&obs->data.draw_callbacks_list,
+		obs->data.draw_callbacks.array, obs->data.draw_callbacks.num,
+		sizeof(struct draw_callback));
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+}
+
+void obs_remove_main_render_callback(
+	void (*draw)(void *param, uint32_t cx, uint32_t cy), void *param)
+{
+	if (!obs)
+		return;
+
+	struct draw_callback data = {draw, param};
+
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	da_erase_item(obs->data.draw_callbacks, &data);
+	publish_callbacks(&obs->data.draw_callbacks_list,
+		obs->data.draw_callbacks.array, obs->data.draw_callbacks.num,
+		sizeof(struct draw_callback));
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+
+	wait_for_graphics_quiescent();
+}
+
+/* ------------------------------------------------------------------------- */
+/* tasks */
+
+struct task_wait_info {
+	obs_task_t task;
+	void *param;
+	os_event_t *event;
+};
+
+static void task_wait_callback(void *param)
+{
+	struct task_wait_info *info = param;
+	info->task(info->param);
+	os_event_signal(info->event);
+}
+
+void obs_queue_task(enum obs_task_type type, obs_task_t task, void *param,
+	bool wait)
+{
+	if (!obs)
+		return;
+
+	if (type == OBS_TASK_UI) {
+		if (obs->ui_task_handler)
+			obs->ui_task_handler(task, param, wait);
+		else
+			blog(LOG_ERROR, "UI task could not be queued, "
+					"there's no UI task handler!");
+		return;
+	}
+
+	if (is_graphics_thread) {
+		task(param);
+
+	} else if (wait && is_tick_thread) {
+		/* the graphics thread only runs tasks once the tick is done,
+		 * but does not hold the graphics context while waiting for
+		 * it, so run the task here with the context held */
+		obs_enter_graphics();
+		task(param);
+		obs_leave_graphics();
+
+	} else if (wait) {
+		struct task_wait_info info = {
+			.task = task,
+			.param = param,
+		};
+
+		os_event_init(&info.event, OS_EVENT_TYPE_MANUAL);
+		obs_queue_task(type, task_wait_callback, &info, false);
+		os_event_wait(info.event);
+		os_event_destroy(info.event);
+
+	} else {
+		struct obs_task_info *info = bmalloc(sizeof(*info));
+		info->task = task;
+		info->param = param;
+
+		os_atomic_inc_long(&obs->video.tasks_pending);
+		obs_task_queue_push(&obs->video, info);
+	}
+}
+
+void obs_set_ui_task_handler(obs_task_handler_t handler)
+{
+	if (!obs)
+		return;
+
+	obs->ui_task_handler = handler;
+}
@@ -177,6 +177,111 @@ struct obs_video_info {
 	enum video_range_type range;      /**< YUV range (if YUV) */
 
 	enum obs_scale_type scale_type; /**< How to scale if scaling */
+
+	/**
+	 * Threads used to split raw frame conversion and copying into row
+	 * slices (0 for automatic, 1 to disable)
+	 */
+	uint32_t conversion_threads;
+
+	/**
+	 * Hand mapped staging surfaces to raw outputs without copying them
+	 * when their layout matches.  Raw video consumers must then not hold
+	 * on to frames for longer than a frame interval.
+	 */
+	bool map_through;
+
+	/** Page type backing raw frame buffers */
+	enum video_buffer_pages buffer_pages;
+
+	/**
+	 * Frame pacing: the graphics thread sleeps until this long before
+	 * each frame is due and busy-waits the rest (0 to only sleep)
+	 */
+	uint32_t pacer_spin_ns;
+
+	/** Timer slack for the graphics thread where supported (0 to keep
+	 * the system default) */
+	uint32_t pacer_timer_slack_ns;
+
+	/**
+	 * Time the graphics thread may spend on queued graphics tasks per
+	 * frame, the rest run on the next frame (0 for no limit)
+	 */
+	uint32_t task_budget_ns;
+
+	/**
+	 * Depth of the GPU readback ring, 2 to 6 (0 for the default of 2).
+	 * Raw frames are read back depth - 1 frames after they are rendered,
+	 * so every frame past two adds a frame of latency but gives slow
+	 * GPUs longer to finish the copy before it is mapped.
+	 */
+	uint32_t readback_depth;
+
+	/**
+	 * Adaptive readback: when mapping a frame repeatedly blocks for
+	 * longer than this, the ring is deepened by a frame, up to 6 (0 to
+	 * keep the depth fixed)
+	 */
+	uint32_t readback_stall_ns;
+
+	/**
+	 * Damage tracking: raw frames are hashed in tiles after readback, and
+	 * a frame identical to the previous one is handed to raw outputs as
+	 * a repeat, without copying or converting it again.  Frames handed
+	 * through with map_through are not repeated.
+	 */
+	bool skip_unchanged_frames;
+
+	/**
+	 * Pipelined tick: sources are ticked for the next frame on a separate
+	 * thread while the graphics thread reads back and outputs the current
+	 * one, taking the tick off the critical path of each frame.  In
+	 * exchange sources are rendered with the state of one frame interval
+	 * earlier, e.g. async frames arrive a frame later.  The profiler
+	 * records the added latency as "tick_sources latency" and the time
+	 * the graphics thread waited for a tick as "tick_sources wait".
+	 */
+	bool pipelined_tick;
+
+	/**
+	 * Dynamic render scale: when frames take close to the frame interval,
+	 * or frames are lagged, the scene is rendered at a lower resolution in
+	 * steps of 10% and stretched back to the base resolution, and raised
+	 * again once frames have had headroom for a while.  The base and
+	 * output resolutions stay the same.
+	 */
+	bool dynamic_render_scale;
+
+	/** Lowest render scale, 0 for 0.5 */
+	float min_render_scale;
+
+	/**
+	 * Idle mode: while no raw output or GPU encoder is active, sources
+	 * are ticked and rendered only once per this interval instead of
+	 * every frame (0 to always run at the frame rate).  Starting an
+	 * output wakes the graphics thread up for the next frame, and video
+	 * timestamps stay on the frame grid.
+	 */
+	uint32_t idle_interval_ms;
+
+	/**
+	 * Threads ticking sources, including the one running the frame (0
+	 * or 1 to tick them one after another).  Sources are ticked in
+	 * parallel, apart from filters, which are ticked in order with their
+	 * parent, and transitions, which are ticked one after another before
+	 * the other sources.  The video_tick callbacks of sources must then
+	 * be safe to call concurrently for different sources.
+	 */
+	uint32_t tick_threads;
+
+	/**
+	 * Render culling: channels of the main view that have no area inside
+	 * the base resolution, or that are covered by a later channel whose
+	 * source is flagged OBS_SOURCE_OPAQUE, are not rendered, see
+	 * obs_get_culled_render_nodes.
+	 */
+	bool render_culling;
 };
 
 /**
@@ -732,6 +837,14 @@ EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
+
+/**
+ * The remove functions wait until the graphics thread no longer calls the
+ * callback.  When called from a source's video_tick or a tick callback,
+ * which may run on another thread than the graphics thread (see
+ * obs_video_info::pipelined_tick and tick_threads), they cannot wait, and
+ * the callback may still be called once after they return.
+ */
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
 				     void *param);
 
@@ -756,6 +869,28 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/** Returns the frames of latency the readback ring adds to raw video beyond
+ * the default depth */
+EXPORT uint32_t obs_get_readback_added_latency(void);
+
+/** Returns the raw frames output as repeats because they were unchanged */
+EXPORT uint32_t obs_get_unchanged_frames(void);
+
+/** Returns the average time spent hashing a raw frame for damage tracking */
+EXPORT uint64_t obs_get_average_damage_hash_ns(void);
+
+/** Returns the scale the scene is currently rendered at, see
+ * obs_video_info::dynamic_render_scale */
+EXPORT float obs_get_render_scale(void);
+
+/** Returns how many times a graphics task was left for a later frame because
+ * the frame's task budget was used up, see obs_video_info::task_budget_ns */
+EXPORT uint64_t obs_get_deferred_graphics_tasks(void);
+
+/** Returns the sources, filters and transitioned sources that were not
+ * rendered because of obs_video_info::render_culling, summed over frames */
+EXPORT uint64_t obs_get_culled_render_nodes(void);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -769,6 +904,13 @@ enum obs_task_type {
 	OBS_TASK_GRAPHICS,
 };
 
+/**
+ * Queues a task to run on the UI or graphics thread.  Graphics tasks queued
+ * from the graphics thread run immediately.  Ticks may run on other threads
+ * (see obs_video_info::pipelined_tick and tick_threads) while the graphics
+ * thread waits for them, so graphics tasks that a tick waits for run
+ * immediately too, inside obs_enter_graphics/obs_leave_graphics.
+ */
 EXPORT void obs_queue_task(enum obs_task_type type, obs_task_t task,
 			   void *param, bool wait);
 
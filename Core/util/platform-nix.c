@@ -27,6 +27,10 @@
 #include <glob.h>
 #include <time.h>
 #include <signal.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
 
 #include "obsconfig.h"
 
@@ -170,6 +174,60 @@ bool os_sleepto_ns(uint64_t time_target)
 	return true;
 }
 
+static inline void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ volatile("yield");
+#endif
+}
+
+bool os_sleepto_ns_spin(uint64_t time_target, uint64_t spin_ns)
+{
+	uint64_t current = os_gettime_ns();
+	if (time_target < current)
+		return false;
+
+	if (time_target - current > spin_ns) {
+		uint64_t wake = time_target - spin_ns;
+
+#if defined(__APPLE__)
+		os_sleepto_ns(wake);
+#else
+		/* os_gettime_ns is CLOCK_MONOTONIC, so the deadline can be
+		 * passed to the kernel as-is and is not pushed back by time
+		 * spent between reading the clock and going to sleep */
+		struct timespec ts;
+		ts.tv_sec = (time_t)(wake / 1000000000);
+		ts.tv_nsec = (long)(wake % 1000000000);
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+				       NULL) == EINTR)
+			;
+#endif
+	}
+
+	while (os_gettime_ns() < time_target)
+		cpu_relax();
+
+	return true;
+}
+
+bool os_set_thread_timer_slack(uint64_t slack_ns)
+{
+#ifdef __linux__
+	/* 0 would reset to the default slack rather than disable it */
+	if (!slack_ns)
+		slack_ns = 1;
+	return prctl(PR_SET_TIMERSLACK, (unsigned long)slack_ns, 0, 0, 0) ==
+	       0;
+#else
+	UNUSED_PARAMETER(slack_ns);
+	return false;
+#endif
+}
+
 void os_sleep_ms(uint32_t duration)
 {
 	usleep(duration * 1000);
@@ -1009,3 +1067,56 @@ uint64_t os_get_free_disk_space(const char *dir)
 
 	return (uint64_t)info.f_frsize * (uint64_t)info.f_bavail;
 }
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static inline size_t round_pages(size_t size, size_t page_size)
+{
+	return (size + page_size - 1) & ~(page_size - 1);
+}
+
+void *os_alloc_pages(size_t *size, enum os_page_type type)
+{
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t alloc_size;
+	void *ptr;
+
+#ifdef MAP_HUGETLB
+	if (type == OS_PAGES_HUGE_EXPLICIT) {
+		alloc_size = round_pages(*size, HUGE_PAGE_SIZE);
+		ptr = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) {
+			*size = alloc_size;
+			return ptr;
+		}
+		type = OS_PAGES_HUGE;
+	}
+#endif
+
+	/* transparent huge pages only back 2MB-aligned ranges, so round
+	 * anything large enough to benefit up to a multiple of it */
+	if (type != OS_PAGES_NORMAL && *size >= HUGE_PAGE_SIZE)
+		alloc_size = round_pages(*size, HUGE_PAGE_SIZE);
+	else
+		alloc_size = round_pages(*size, page_size);
+
+	ptr = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+#ifdef MADV_HUGEPAGE
+	if (type != OS_PAGES_NORMAL && alloc_size >= HUGE_PAGE_SIZE)
+		madvise(ptr, alloc_size, MADV_HUGEPAGE);
+#endif
+
+	*size = alloc_size;
+	return ptr;
+}
+
+void os_free_pages(void *ptr, size_t size)
+{
+	if (ptr)
+		munmap(ptr, size);
+}
@@ -215,6 +215,35 @@ bool os_sleepto_ns(uint64_t time_target)
 	}
 }
 
+bool os_sleepto_ns_spin(uint64_t time_target, uint64_t spin_ns)
+{
+	uint64_t t = os_gettime_ns();
+	uint64_t milliseconds;
+
+	if (t >= time_target)
+		return false;
+
+	/* Sleep can overshoot by up to a timer tick, so it only covers the
+	 * part of the wait that ends at least a millisecond before the spin
+	 * tail */
+	if (time_target - t > spin_ns) {
+		milliseconds = (time_target - t - spin_ns) / 1000000;
+		if (milliseconds > 1)
+			Sleep((DWORD)(milliseconds - 1));
+	}
+
+	while (os_gettime_ns() < time_target)
+		YieldProcessor();
+
+	return true;
+}
+
+bool os_set_thread_timer_slack(uint64_t slack_ns)
+{
+	UNUSED_PARAMETER(slack_ns);
+	return false;
+}
+
 void os_sleep_ms(uint32_t duration)
 {
 	/* windows 8+ appears to have decreased sleep precision */
@@ -1174,3 +1203,51 @@ uint64_t os_get_free_disk_space(const char *dir)
 
 	return success ? free.QuadPart : 0;
 }
+
+static inline size_t round_pages(size_t size, size_t page_size)
+{
+	return (size + page_size - 1) & ~(page_size - 1);
+}
+
+void *os_alloc_pages(size_t *size, enum os_page_type type)
+{
+	SYSTEM_INFO info;
+	size_t alloc_size;
+	void *ptr;
+
+	/* large pages require SeLockMemoryPrivilege; without it the
+	 * allocation simply fails and normal pages are used instead.  there
+	 * is no transparent huge page equivalent, so OS_PAGES_HUGE maps to
+	 * normal pages here. */
+	if (type == OS_PAGES_HUGE_EXPLICIT) {
+		size_t large_size = GetLargePageMinimum();
+
+		if (large_size) {
+			alloc_size = round_pages(*size, large_size);
+			ptr = VirtualAlloc(NULL, alloc_size,
+					   MEM_COMMIT | MEM_RESERVE |
+						   MEM_LARGE_PAGES,
+					   PAGE_READWRITE);
+			if (ptr) {
+				*size = alloc_size;
+				return ptr;
+			}
+		}
+	}
+
+	GetSystemInfo(&info);
+	alloc_size = round_pages(*size, info.dwPageSize);
+	ptr = VirtualAlloc(NULL, alloc_size, MEM_COMMIT | MEM_RESERVE,
+			   PAGE_READWRITE);
+	if (ptr)
+		*size = alloc_size;
+	return ptr;
+}
+
+void os_free_pages(void *ptr, size_t size)
+{
+	if (ptr)
+		VirtualFree(ptr, 0, MEM_RELEASE);
+
+	UNUSED_PARAMETER(size);
+}
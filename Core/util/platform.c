@@ -25,8 +25,18 @@
 #include "bmem.h"
 #include "utf8.h"
 #include "dstr.h"
+#include "threading.h"
+#include "simde/simde-arch.h"
 #include "obs.h"
 
+#if defined(SIMDE_ARCH_X86) || defined(SIMDE_ARCH_AMD64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -803,3 +813,89 @@ char *os_generate_formatted_filename(const char *extension, bool space,
 
 	return sf.array;
 }
+
+#if defined(SIMDE_ARCH_X86) || defined(SIMDE_ARCH_AMD64)
+static inline void get_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int *)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t detect_cpu_features(void)
+{
+	uint32_t features = 0;
+	uint32_t max_leaf;
+	uint32_t regs[4];
+	bool avx_usable;
+
+	get_cpuid(0, 0, regs);
+	max_leaf = regs[0];
+
+	get_cpuid(1, 0, regs);
+	if (regs[3] & (1 << 26))
+		features |= OS_CPU_SSE2;
+	if (regs[2] & (1 << 9))
+		features |= OS_CPU_SSSE3;
+	if (regs[2] & (1 << 19))
+		features |= OS_CPU_SSE41;
+
+	/* the OS also has to save the upper halves of the ymm registers */
+	avx_usable = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) &&
+		     (get_xcr0() & 6) == 6;
+
+	if (avx_usable && max_leaf >= 7) {
+		get_cpuid(7, 0, regs);
+		if (regs[1] & (1 << 5))
+			features |= OS_CPU_AVX2;
+	}
+
+	return features;
+}
+#elif defined(SIMDE_ARCH_ARM_NEON)
+static uint32_t detect_cpu_features(void)
+{
+	return OS_CPU_NEON;
+}
+#else
+static uint32_t detect_cpu_features(void)
+{
+	return 0;
+}
+#endif
+
+void os_prefault_pages(void *ptr, size_t size)
+{
+	volatile uint8_t *bytes = ptr;
+
+	for (size_t i = 0; i < size; i += 4096)
+		bytes[i] = 0;
+	if (size)
+		bytes[size - 1] = 0;
+}
+
+uint32_t os_get_cpu_features(void)
+{
+	static volatile long features = -1;
+	long val = os_atomic_load_long(&features);
+
+	if (val == -1) {
+		val = (long)detect_cpu_features();
+		os_atomic_set_long(&features, val);
+	}
+
+	return (uint32_t)val;
+}
@@ -102,10 +102,46 @@ EXPORT void os_end_high_performance(os_performance_token_t *);
  * Returns false if already at or past target time.
  */
 EXPORT bool os_sleepto_ns(uint64_t time_target);
+
+/* like os_sleepto_ns, but sleeps against an absolute deadline where the OS
+ * supports it, and busy-waits the last spin_ns before the target to hide
+ * scheduler wake-up latency */
+EXPORT bool os_sleepto_ns_spin(uint64_t time_target, uint64_t spin_ns);
+
+/* sets how late the OS may wake the calling thread from timed sleeps to
+ * batch wake-ups.  returns false where this is not supported. */
+EXPORT bool os_set_thread_timer_slack(uint64_t slack_ns);
 EXPORT void os_sleep_ms(uint32_t duration);
 
 EXPORT uint64_t os_gettime_ns(void);
 
+/* SIMD extensions usable by the current CPU and OS, for picking optimized
+ * code paths at runtime */
+#define OS_CPU_SSE2 (1 << 0)
+#define OS_CPU_SSSE3 (1 << 1)
+#define OS_CPU_SSE41 (1 << 2)
+#define OS_CPU_AVX2 (1 << 3)
+#define OS_CPU_NEON (1 << 4)
+
+EXPORT uint32_t os_get_cpu_features(void);
+
+/* Page-granular memory for large, long-lived buffers such as video frames.
+ * size is rounded up to the page size actually used and must be passed back
+ * unchanged to os_free_pages. */
+enum os_page_type {
+	OS_PAGES_NORMAL,
+	/* transparent huge pages where the OS supports them */
+	OS_PAGES_HUGE,
+	/* reserved huge pages, falling back to OS_PAGES_HUGE */
+	OS_PAGES_HUGE_EXPLICIT,
+};
+
+EXPORT void *os_alloc_pages(size_t *size, enum os_page_type type);
+EXPORT void os_free_pages(void *ptr, size_t size);
+
+/* touches every page so the first real use does not take page faults */
+EXPORT void os_prefault_pages(void *ptr, size_t size);
+
 EXPORT int os_get_config_path(char *dst, size_t size, const char *name);
 EXPORT char *os_get_config_path_ptr(const char *name);
 
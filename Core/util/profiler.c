@@ -439,6 +439,33 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+void profile_add_time(const char *name, uint64_t time_delta)
+{
+	uint64_t end = os_gettime_ns();
+	if (!thread_enabled)
+		return;
+
+	profile_call *parent = thread_context;
+	if (!parent) {
+		blog(LOG_ERROR, "Called profile add time with no active "
+				"profile");
+		return;
+	}
+
+	profile_call call = {
+		.name = name,
+		.start_time = end - time_delta,
+		.end_time = end,
+		.parent = parent,
+	};
+#ifdef TRACK_OVERHEAD
+	call.overhead_start = call.start_time;
+	call.overhead_end = end;
+#endif
+
+	da_push_back(parent->children, &call);
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry *)second)->time_delta -
@@ -22,6 +22,11 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* records a measurement taken elsewhere as a call of time_delta ns made
+ * from the active call on this thread, e.g. timer wake-up errors, so that
+ * it shows up with a histogram like any profiled call */
+EXPORT void profile_add_time(const char *name, uint64_t time_delta);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
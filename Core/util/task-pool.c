@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2013 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bmem.h"
+#include "platform.h"
+#include "threading.h"
+#include "task-pool.h"
+
+#define MAX_POOL_THREADS 16
+#define CACHE_LINE_SIZE 64
+
+/* the tasks of one thread.  next is claimed with an atomic increment by
+ * the owner and by thieves alike, and may run past end. */
+struct task_range {
+	volatile long next;
+	long end;
+	uint8_t pad[CACHE_LINE_SIZE - 2 * sizeof(long)];
+};
+
+struct task_worker {
+	struct task_pool *pool;
+	uint32_t index;
+};
+
+struct task_pool {
+	pthread_t threads[MAX_POOL_THREADS];
+	struct task_worker workers[MAX_POOL_THREADS];
+	uint32_t num_workers;
+	uint32_t num_threads;
+	char *name;
+
+	os_sem_t *start;
+	os_event_t *done;
+	pthread_mutex_t run_mutex;
+	bool stop;
+
+	/* current batch, written before the workers are started */
+	task_pool_cb callback;
+	void *param;
+	uint32_t num_ranges;
+	struct task_range ranges[MAX_POOL_THREADS + 1];
+
+	/* tasks left to run plus workers still inside the batch.  a worker
+	 * leaving the batch is counted as well, so that no worker can still
+	 * be looking at it once it has ended. */
+	volatile long pending;
+};
+
+/* runs the tasks of range self, then steals from the others.  returns true
+ * if the last pending task was run. */
+static bool process_tasks(struct task_pool *pool, uint32_t self)
+{
+	bool finished = false;
+
+	for (uint32_t i = 0; i < pool->num_ranges; i++) {
+		struct task_range *range =
+			&pool->ranges[(self + i) % pool->num_ranges];
+		long index;
+
+		while ((index = os_atomic_inc_long(&range->next) - 1) <
+		       range->end) {
+			pool->callback(pool->param, (size_t)index);
+			finished = os_atomic_dec_long(&pool->pending) == 0;
+		}
+	}
+
+	return finished;
+}
+
+static void *task_thread(void *param)
+{
+	struct task_worker *worker = param;
+	struct task_pool *pool = worker->pool;
+
+	os_set_thread_name(pool->name);
+
+	while (os_sem_wait(pool->start) == 0) {
+		if (pool->stop)
+			break;
+
+		process_tasks(pool, worker->index);
+
+		if (os_atomic_dec_long(&pool->pending) == 0)
+			os_event_signal(pool->done);
+	}
+
+	return NULL;
+}
+
+task_pool_t *task_pool_create(uint32_t threads, const char *name)
+{
+	struct task_pool *pool;
+
+	if (!threads) {
+		int cores = os_get_physical_cores();
+		threads = cores > 0 ? (uint32_t)cores : 1;
+	}
+	if (threads > MAX_POOL_THREADS + 1)
+		threads = MAX_POOL_THREADS + 1;
+	if (threads <= 1)
+		return NULL;
+
+	pool = bzalloc(sizeof(struct task_pool));
+	pool->name = bstrdup(name ? name : "task pool thread");
+
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail0;
+	if (os_sem_init(&pool->start, 0) != 0)
+		goto fail1;
+	if (os_event_init(&pool->done, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail2;
+
+	for (uint32_t i = 0; i < threads - 1; i++) {
+		struct task_worker *worker = &pool->workers[i];
+
+		worker->pool = pool;
+		worker->index = i + 1;
+
+		if (pthread_create(&pool->threads[i], NULL, task_thread,
+				   worker) != 0)
+			break;
+		pool->num_workers++;
+	}
+
+	if (!pool->num_workers) {
+		task_pool_destroy(pool);
+		return NULL;
+	}
+
+	pool->num_threads = pool->num_workers + 1;
+	return pool;
+
+fail2:
+	os_sem_destroy(pool->start);
+fail1:
+	pthread_mutex_destroy(&pool->run_mutex);
+fail0:
+	bfree(pool->name);
+	bfree(pool);
+	return NULL;
+}
+
+void task_pool_destroy(task_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	pool->stop = true;
+	for (uint32_t i = 0; i < pool->num_workers; i++)
+		os_sem_post(pool->start);
+	for (uint32_t i = 0; i < pool->num_workers; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	os_event_destroy(pool->done);
+	os_sem_destroy(pool->start);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool->name);
+	bfree(pool);
+}
+
+uint32_t task_pool_get_threads(const task_pool_t *pool)
+{
+	return pool ? pool->num_threads : 1;
+}
+
+void task_pool_run(task_pool_t *pool, size_t count, task_pool_cb callback,
+		   void *param)
+{
+	uint32_t ranges;
+	uint32_t workers;
+
+	if (!count)
+		return;
+
+	if (!pool || count == 1) {
+		for (size_t i = 0; i < count; i++)
+			callback(param, i);
+		return;
+	}
+
+	ranges = count < pool->num_threads ? (uint32_t)count
+					   : pool->num_threads;
+	workers = ranges - 1;
+
+	pthread_mutex_lock(&pool->run_mutex);
+
+	pool->callback = callback;
+	pool->param = param;
+	pool->num_ranges = ranges;
+
+	for (uint32_t i = 0; i < ranges; i++) {
+		pool->ranges[i].next = (long)(count * i / ranges);
+		pool->ranges[i].end = (long)(count * (i + 1) / ranges);
+	}
+
+	os_atomic_set_long(&pool->pending, (long)(count + workers));
+
+	for (uint32_t i = 0; i < workers; i++)
+		os_sem_post(pool->start);
+
+	/* the workers are still counted, so unless there were none the last
+	 * of them signals done */
+	if (!process_tasks(pool, 0))
+		os_event_wait(pool->done);
+
+	pthread_mutex_unlock(&pool->run_mutex);
+}
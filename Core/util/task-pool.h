@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2013 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Runs a batch of independent tasks of uneven cost on a pool of worker
+ * threads.  Every thread starts on its own share of the tasks and, once
+ * done, steals the remaining tasks of the others one at a time, so a few
+ * slow tasks do not hold up the batch.  The calling thread takes part, and
+ * the call returns once every task is done.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct task_pool;
+typedef struct task_pool task_pool_t;
+
+typedef void (*task_pool_cb)(void *param, size_t index);
+
+/* threads: total number of threads doing the work, including the caller.
+ * 0 picks a count based on the number of CPU cores.  returns NULL if that
+ * comes down to a single thread. */
+EXPORT task_pool_t *task_pool_create(uint32_t threads, const char *name);
+EXPORT void task_pool_destroy(task_pool_t *pool);
+
+EXPORT uint32_t task_pool_get_threads(const task_pool_t *pool);
+
+/* calls callback for every index in [0, count).  pool may be NULL, in
+ * which case the tasks run on the calling thread in order.  one batch runs
+ * at a time, concurrent calls wait for each other. */
+EXPORT void task_pool_run(task_pool_t *pool, size_t count,
+			  task_pool_cb callback, void *param);
+
+#ifdef __cplusplus
+}
+#endif
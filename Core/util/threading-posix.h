@@ -36,12 +36,37 @@ static inline long os_atomic_load_long(const volatile long *ptr)
 	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
 }
 
+static inline long os_atomic_load_long_acquire(const volatile long *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void os_atomic_store_long_release(volatile long *ptr, long val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
 static inline bool os_atomic_compare_swap_long(volatile long *val, long old_val,
 					       long new_val)
 {
 	return __sync_bool_compare_and_swap(val, old_val, new_val);
 }
 
+static inline void *os_atomic_load_ptr_acquire(void *const volatile *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void os_atomic_store_ptr_release(void *volatile *ptr, void *val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
+static inline void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_ACQ_REL);
+}
+
 static inline bool os_atomic_set_bool(volatile bool *ptr, bool val)
 {
 	return __sync_lock_test_and_set(ptr, val);
@@ -38,12 +38,62 @@ static inline long os_atomic_load_long(const volatile long *ptr)
 	return (long)_InterlockedOr((volatile long *)ptr, 0);
 }
 
+/* plain aligned loads/stores are already acquire/release on x86, so only the
+ * compiler needs to be kept from reordering around them */
+static inline long os_atomic_load_long_acquire(const volatile long *ptr)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	long val = *ptr;
+	_ReadWriteBarrier();
+	return val;
+#else
+	return os_atomic_load_long(ptr);
+#endif
+}
+
+static inline void os_atomic_store_long_release(volatile long *ptr, long val)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	_ReadWriteBarrier();
+	*ptr = val;
+#else
+	os_atomic_set_long(ptr, val);
+#endif
+}
+
 static inline bool os_atomic_compare_swap_long(volatile long *val, long old_val,
 					       long new_val)
 {
 	return _InterlockedCompareExchange(val, new_val, old_val) == old_val;
 }
 
+static inline void *os_atomic_load_ptr_acquire(void *const volatile *ptr)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	void *val = *ptr;
+	_ReadWriteBarrier();
+	return val;
+#else
+	return _InterlockedCompareExchangePointer((void *volatile *)ptr, NULL,
+						  NULL);
+#endif
+}
+
+static inline void os_atomic_store_ptr_release(void *volatile *ptr, void *val)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	_ReadWriteBarrier();
+	*ptr = val;
+#else
+	_InterlockedExchangePointer(ptr, val);
+#endif
+}
+
+static inline void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return _InterlockedExchangePointer(ptr, val);
+}
+
 static inline bool os_atomic_set_bool(volatile bool *ptr, bool val)
 {
 	return !!_InterlockedExchange8((volatile char *)ptr, (char)val);
@@ -0,0 +1,266 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include "gl-subsystem.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+struct gl_platform {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface pbuffer;
+};
+
+static const EGLint config_attribs[] = {EGL_SURFACE_TYPE,
+					EGL_PBUFFER_BIT,
+					EGL_RENDERABLE_TYPE,
+					EGL_OPENGL_BIT,
+					EGL_RED_SIZE,
+					8,
+					EGL_GREEN_SIZE,
+					8,
+					EGL_BLUE_SIZE,
+					8,
+					EGL_ALPHA_SIZE,
+					8,
+					EGL_NONE};
+
+static const EGLint context_attribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+					 3,
+					 EGL_CONTEXT_MINOR_VERSION,
+					 3,
+					 EGL_CONTEXT_OPENGL_PROFILE_MASK,
+					 EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+					 EGL_NONE};
+
+static const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1,
+					 EGL_NONE};
+
+static const char *get_egl_error_string(void)
+{
+	switch (eglGetError()) {
+	case EGL_SUCCESS:
+		return "EGL_SUCCESS";
+	case EGL_NOT_INITIALIZED:
+		return "EGL_NOT_INITIALIZED";
+	case EGL_BAD_ACCESS:
+		return "EGL_BAD_ACCESS";
+	case EGL_BAD_ALLOC:
+		return "EGL_BAD_ALLOC";
+	case EGL_BAD_ATTRIBUTE:
+		return "EGL_BAD_ATTRIBUTE";
+	case EGL_BAD_CONTEXT:
+		return "EGL_BAD_CONTEXT";
+	case EGL_BAD_CONFIG:
+		return "EGL_BAD_CONFIG";
+	case EGL_BAD_DISPLAY:
+		return "EGL_BAD_DISPLAY";
+	case EGL_BAD_SURFACE:
+		return "EGL_BAD_SURFACE";
+	case EGL_BAD_MATCH:
+		return "EGL_BAD_MATCH";
+	case EGL_BAD_PARAMETER:
+		return "EGL_BAD_PARAMETER";
+	default:
+		return "Unknown";
+	}
+}
+
+static bool has_extension(const char *extensions, const char *name)
+{
+	const size_t len = strlen(name);
+	const char *pos = extensions;
+
+	while (pos && (pos = strstr(pos, name)) != NULL) {
+		if ((pos == extensions || pos[-1] == ' ') &&
+		    (pos[len] == ' ' || pos[len] == '\0'))
+			return true;
+		pos += len;
+	}
+
+	return false;
+}
+
+/* prefers the surfaceless platform, which needs neither a window system nor
+ * a render node */
+static EGLDisplay get_display(void)
+{
+	const char *client_exts = eglQueryString(EGL_NO_DISPLAY,
+						 EGL_EXTENSIONS);
+
+	if (has_extension(client_exts, "EGL_MESA_platform_surfaceless") &&
+	    has_extension(client_exts, "EGL_EXT_platform_base")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+				"eglGetPlatformDisplayEXT");
+
+		if (get_platform_display) {
+			EGLDisplay display = get_platform_display(
+				EGL_PLATFORM_SURFACELESS_MESA,
+				EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static bool gl_context_create(struct gl_platform *plat)
+{
+	EGLint major, minor, num_configs = 0;
+	EGLConfig config;
+
+	plat->display = get_display();
+	if (plat->display == EGL_NO_DISPLAY) {
+		blog(LOG_ERROR, "Failed to get EGL display");
+		return false;
+	}
+
+	if (!eglInitialize(plat->display, &major, &minor)) {
+		blog(LOG_ERROR, "Failed to initialize EGL: %s",
+		     get_egl_error_string());
+		return false;
+	}
+
+	blog(LOG_INFO, "Initialized EGL %d.%d (%s)", major, minor,
+	     eglQueryString(plat->display, EGL_VENDOR));
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		blog(LOG_ERROR, "Failed to bind the OpenGL API: %s",
+		     get_egl_error_string());
+		return false;
+	}
+
+	if (!eglChooseConfig(plat->display, config_attribs, &config, 1,
+			     &num_configs) ||
+	    !num_configs) {
+		blog(LOG_ERROR, "Failed to find a suitable EGL config: %s",
+		     get_egl_error_string());
+		return false;
+	}
+
+	plat->context = eglCreateContext(plat->display, config, EGL_NO_CONTEXT,
+					 context_attribs);
+	if (plat->context == EGL_NO_CONTEXT) {
+		blog(LOG_ERROR, "Failed to create OpenGL 3.3 context: %s",
+		     get_egl_error_string());
+		return false;
+	}
+
+	/* rendering always goes to framebuffer objects, the pbuffer only
+	 * exists for drivers that cannot make a context current without a
+	 * surface */
+	plat->pbuffer = EGL_NO_SURFACE;
+	if (!has_extension(eglQueryString(plat->display, EGL_EXTENSIONS),
+			   "EGL_KHR_surfaceless_context")) {
+		plat->pbuffer = eglCreatePbufferSurface(plat->display, config,
+							pbuffer_attribs);
+		if (plat->pbuffer == EGL_NO_SURFACE) {
+			blog(LOG_ERROR, "Failed to create pbuffer: %s",
+			     get_egl_error_string());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void gl_context_destroy(struct gl_platform *plat)
+{
+	if (plat->display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(plat->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		       EGL_NO_CONTEXT);
+	if (plat->pbuffer != EGL_NO_SURFACE)
+		eglDestroySurface(plat->display, plat->pbuffer);
+	if (plat->context != EGL_NO_CONTEXT)
+		eglDestroyContext(plat->display, plat->context);
+	eglTerminate(plat->display);
+}
+
+struct gl_platform *gl_platform_create(gs_device_t *device, uint32_t adapter)
+{
+	struct gl_platform *plat = bzalloc(sizeof(struct gl_platform));
+
+	plat->display = EGL_NO_DISPLAY;
+	plat->context = EGL_NO_CONTEXT;
+	plat->pbuffer = EGL_NO_SURFACE;
+
+	if (!gl_context_create(plat))
+		goto fail;
+
+	if (!eglMakeCurrent(plat->display, plat->pbuffer, plat->pbuffer,
+			    plat->context)) {
+		blog(LOG_ERROR, "Failed to make context current: %s",
+		     get_egl_error_string());
+		goto fail;
+	}
+
+	gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+	if (!GLAD_GL_VERSION_3_3) {
+		blog(LOG_ERROR, "OpenGL 3.3 is not supported");
+		goto fail;
+	}
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(adapter);
+	return plat;
+
+fail:
+	blog(LOG_ERROR, "gl_platform_create failed");
+	gl_context_destroy(plat);
+	bfree(plat);
+	return NULL;
+}
+
+void gl_platform_destroy(struct gl_platform *plat)
+{
+	if (!plat)
+		return;
+
+	gl_context_destroy(plat);
+	bfree(plat);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	struct gl_platform *plat = device->plat;
+
+	if (!eglMakeCurrent(plat->display, plat->pbuffer, plat->pbuffer,
+			    plat->context))
+		blog(LOG_ERROR, "device_enter_context (GL) failed: %s",
+		     get_egl_error_string());
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	struct gl_platform *plat = device->plat;
+
+	if (!eglMakeCurrent(plat->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			    EGL_NO_CONTEXT))
+		blog(LOG_ERROR, "device_leave_context (GL) failed: %s",
+		     get_egl_error_string());
+}
+
+void *device_get_device_obj(gs_device_t *device)
+{
+	return device->plat->context;
+}
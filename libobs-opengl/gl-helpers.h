@@ -0,0 +1,247 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/base.h>
+
+static inline const char *gl_error_to_str(GLenum errorcode)
+{
+	switch (errorcode) {
+	case GL_INVALID_ENUM:
+		return "GL_INVALID_ENUM";
+	case GL_INVALID_VALUE:
+		return "GL_INVALID_VALUE";
+	case GL_INVALID_OPERATION:
+		return "GL_INVALID_OPERATION";
+	case GL_INVALID_FRAMEBUFFER_OPERATION:
+		return "GL_INVALID_FRAMEBUFFER_OPERATION";
+	case GL_OUT_OF_MEMORY:
+		return "GL_OUT_OF_MEMORY";
+	default:
+		return "Unknown";
+	}
+}
+
+/* logs and clears pending errors, returns false if there were any */
+static inline bool gl_success(const char *funcname)
+{
+	GLenum errorcode = glGetError();
+	int attempts = 8;
+
+	if (errorcode == GL_NO_ERROR)
+		return true;
+
+	do {
+		blog(LOG_ERROR, "%s failed, glGetError returned %s(0x%X)",
+		     funcname, gl_error_to_str(errorcode), errorcode);
+		errorcode = glGetError();
+	} while (errorcode != GL_NO_ERROR && --attempts);
+
+	return false;
+}
+
+static inline bool gl_bind_buffer(GLenum target, GLuint buffer)
+{
+	glBindBuffer(target, buffer);
+	return gl_success("glBindBuffer");
+}
+
+static inline bool gl_bind_texture(GLenum target, GLuint texture)
+{
+	glBindTexture(target, texture);
+	return gl_success("glBindTexture");
+}
+
+static inline bool gl_bind_framebuffer(GLenum target, GLuint fbo)
+{
+	glBindFramebuffer(target, fbo);
+	return gl_success("glBindFramebuffer");
+}
+
+static inline bool gl_active_texture(GLenum texture_unit)
+{
+	glActiveTexture(texture_unit);
+	return gl_success("glActiveTexture");
+}
+
+static inline bool gl_enable(GLenum capability)
+{
+	glEnable(capability);
+	return gl_success("glEnable");
+}
+
+static inline bool gl_disable(GLenum capability)
+{
+	glDisable(capability);
+	return gl_success("glDisable");
+}
+
+static inline GLenum convert_gs_format(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:
+	case GS_R16:
+	case GS_R16F:
+	case GS_R32F:
+		return GL_RED;
+	case GS_R8G8:
+	case GS_RG16F:
+	case GS_RG32F:
+		return GL_RG;
+	case GS_RGBA:
+	case GS_R10G10B10A2:
+	case GS_RGBA16:
+	case GS_RGBA16F:
+	case GS_RGBA32F:
+		return GL_RGBA;
+	case GS_BGRX:
+	case GS_BGRA:
+		return GL_BGRA;
+	default:
+		return 0;
+	}
+}
+
+static inline GLenum convert_gs_internal_format(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:
+		return GL_R8;
+	case GS_R8G8:
+		return GL_RG8;
+	case GS_RGBA:
+	case GS_BGRX:
+	case GS_BGRA:
+		return GL_RGBA8;
+	case GS_R10G10B10A2:
+		return GL_RGB10_A2;
+	case GS_RGBA16:
+		return GL_RGBA16;
+	case GS_R16:
+		return GL_R16;
+	case GS_RGBA16F:
+		return GL_RGBA16F;
+	case GS_RGBA32F:
+		return GL_RGBA32F;
+	case GS_RG16F:
+		return GL_RG16F;
+	case GS_RG32F:
+		return GL_RG32F;
+	case GS_R16F:
+		return GL_R16F;
+	case GS_R32F:
+		return GL_R32F;
+	default:
+		return 0;
+	}
+}
+
+static inline GLenum get_gl_format_type(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_R10G10B10A2:
+		return GL_UNSIGNED_INT_2_10_10_10_REV;
+	case GS_RGBA16:
+	case GS_R16:
+		return GL_UNSIGNED_SHORT;
+	case GS_RGBA16F:
+	case GS_RG16F:
+	case GS_R16F:
+		return GL_HALF_FLOAT;
+	case GS_RGBA32F:
+	case GS_RG32F:
+	case GS_R32F:
+		return GL_FLOAT;
+	default:
+		return GL_UNSIGNED_BYTE;
+	}
+}
+
+static inline GLenum convert_gs_blend_type(enum gs_blend_type type)
+{
+	switch (type) {
+	case GS_BLEND_ZERO:
+		return GL_ZERO;
+	case GS_BLEND_ONE:
+		return GL_ONE;
+	case GS_BLEND_SRCCOLOR:
+		return GL_SRC_COLOR;
+	case GS_BLEND_INVSRCCOLOR:
+		return GL_ONE_MINUS_SRC_COLOR;
+	case GS_BLEND_SRCALPHA:
+		return GL_SRC_ALPHA;
+	case GS_BLEND_INVSRCALPHA:
+		return GL_ONE_MINUS_SRC_ALPHA;
+	case GS_BLEND_DSTCOLOR:
+		return GL_DST_COLOR;
+	case GS_BLEND_INVDSTCOLOR:
+		return GL_ONE_MINUS_DST_COLOR;
+	case GS_BLEND_DSTALPHA:
+		return GL_DST_ALPHA;
+	case GS_BLEND_INVDSTALPHA:
+		return GL_ONE_MINUS_DST_ALPHA;
+	case GS_BLEND_SRCALPHASAT:
+		return GL_SRC_ALPHA_SATURATE;
+	}
+
+	return GL_ONE;
+}
+
+static inline GLint convert_address_mode(enum gs_address_mode mode)
+{
+	switch (mode) {
+	case GS_ADDRESS_WRAP:
+		return GL_REPEAT;
+	case GS_ADDRESS_CLAMP:
+		return GL_CLAMP_TO_EDGE;
+	case GS_ADDRESS_MIRROR:
+		return GL_MIRRORED_REPEAT;
+	case GS_ADDRESS_BORDER:
+		return GL_CLAMP_TO_BORDER;
+	case GS_ADDRESS_MIRRORONCE:
+		return GL_MIRROR_CLAMP_EXT;
+	}
+
+	return GL_REPEAT;
+}
+
+static inline bool is_point_filter(enum gs_sample_filter filter)
+{
+	return filter == GS_FILTER_POINT ||
+	       filter == GS_FILTER_MIN_MAG_POINT_MIP_LINEAR;
+}
+
+static inline GLenum convert_gs_topology(enum gs_draw_mode mode)
+{
+	switch (mode) {
+	case GS_POINTS:
+		return GL_POINTS;
+	case GS_LINES:
+		return GL_LINES;
+	case GS_LINESTRIP:
+		return GL_LINE_STRIP;
+	case GS_TRIS:
+		return GL_TRIANGLES;
+	case GS_TRISTRIP:
+		return GL_TRIANGLE_STRIP;
+	}
+
+	return GL_POINTS;
+}
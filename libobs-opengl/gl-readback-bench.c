@@ -0,0 +1,179 @@
+/*
+ * Standalone benchmark of stage surface readback: renders frames into a
+ * 1920x1080 RGBA render target and copies every one of them to system
+ * memory, through a ring of stage surfaces mapped a few frames after they
+ * were staged like obs-video.c does, through a single stage surface mapped
+ * right away, and through a synchronous glReadPixels into system memory,
+ * which is what reading back without a pixel pack buffer amounts to.
+ * Reports MB/s and how often a map had to wait for the GPU.
+ *
+ * It creates the device itself through EGL, so it also runs on surfaceless
+ * Mesa (e.g. llvmpipe).  Build it with the backend sources, e.g.:
+ *
+ *   cc -O2 -I../Core -I../Core/deps/glad/include gl-readback-bench.c \
+ *      gl-egl.c gl-shader.c gl-stagesurf.c gl-subsystem.c gl-texture.c \
+ *      ../Core/deps/glad/src/glad.c -lobs -lEGL -ldl \
+ *      -o gl-readback-bench
+ *
+ * Pass the ring depth as the first argument, 3 by default.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include "gl-subsystem.h"
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define FRAME_COUNT 240
+#define MAX_DEPTH 8
+
+struct readback_stats {
+	double mb_per_sec;
+	uint64_t waits;
+};
+
+/* a different clear color every frame, so every frame is new GPU work */
+static void render_frame(gs_device_t *device, uint32_t frame)
+{
+	struct vec4 color;
+
+	vec4_set(&color, (float)(frame % 256) / 255.0f, 0.25f, 0.5f, 1.0f);
+	device_clear(device, GS_CLEAR_COLOR, &color, 0.0f, 0);
+}
+
+static inline void copy_surface(gs_stagesurf_t *surf, uint8_t *cpu)
+{
+	uint8_t *data;
+	uint32_t linesize;
+
+	if (gs_stagesurface_map(surf, &data, &linesize)) {
+		memcpy(cpu, data, (size_t)linesize * BENCH_HEIGHT);
+		gs_stagesurface_unmap(surf);
+	}
+}
+
+static inline double get_mb_per_sec(uint64_t start)
+{
+	const double seconds =
+		(double)(os_gettime_ns() - start) / 1000000000.0;
+	return (double)FRAME_COUNT * BENCH_WIDTH * BENCH_HEIGHT * 4 /
+	       (1024.0 * 1024.0) / seconds;
+}
+
+/* frame n is staged into surfaces[n % depth] and mapped depth - 1 frames
+ * later, a depth of 1 maps every frame right after staging it */
+static struct readback_stats bench_stage_ring(gs_device_t *device,
+					      gs_texture_t *target,
+					      uint8_t *cpu, uint32_t depth)
+{
+	gs_stagesurf_t *surfaces[MAX_DEPTH];
+	struct readback_stats stats;
+	uint64_t waits = device->readback_waits;
+	uint64_t start;
+
+	for (uint32_t i = 0; i < depth; i++)
+		surfaces[i] = device_stagesurface_create(device, BENCH_WIDTH,
+							 BENCH_HEIGHT, GS_RGBA);
+
+	start = os_gettime_ns();
+
+	for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+		render_frame(device, i);
+		device_stage_texture(device, surfaces[i % depth], target);
+		device_flush(device);
+
+		if (i + 1 >= depth)
+			copy_surface(surfaces[(i + 1) % depth], cpu);
+	}
+
+	/* the last frames are still in the ring */
+	for (uint32_t i = FRAME_COUNT; i < FRAME_COUNT + depth - 1; i++)
+		copy_surface(surfaces[(i + 1) % depth], cpu);
+
+	stats.mb_per_sec = get_mb_per_sec(start);
+	stats.waits = device->readback_waits - waits;
+
+	for (uint32_t i = 0; i < depth; i++)
+		gs_stagesurface_destroy(surfaces[i]);
+
+	return stats;
+}
+
+static struct readback_stats bench_read_pixels(gs_device_t *device,
+					       gs_texture_t *target,
+					       uint8_t *cpu)
+{
+	struct readback_stats stats = {0};
+	uint64_t start = os_gettime_ns();
+
+	for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+		render_frame(device, i);
+
+		gl_texture_bind_fbo(target, GL_READ_FRAMEBUFFER);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glReadPixels(0, 0, BENCH_WIDTH, BENCH_HEIGHT, GL_RGBA,
+			     GL_UNSIGNED_BYTE, cpu);
+		gl_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+
+		/* every frame waits for the GPU */
+		stats.waits++;
+	}
+
+	stats.mb_per_sec = get_mb_per_sec(start);
+	return stats;
+}
+
+static void print_stats(const char *name, struct readback_stats stats)
+{
+	printf("%-26s %9.1f MB/s, %3" PRIu64 " of %d maps waited\n", name,
+	       stats.mb_per_sec, stats.waits, FRAME_COUNT);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t depth = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 3;
+	gs_device_t *device;
+	gs_texture_t *target;
+	char name[64];
+	uint8_t *cpu;
+
+	if (depth < 2 || depth > MAX_DEPTH) {
+		printf("ring depth must be 2 to %d\n", MAX_DEPTH);
+		return 1;
+	}
+
+	if (device_create(&device, 0) != GS_SUCCESS) {
+		printf("could not create the GL device\n");
+		return 1;
+	}
+
+	device_enter_context(device);
+
+	target = device_texture_create(device, BENCH_WIDTH, BENCH_HEIGHT,
+				       GS_RGBA, 1, NULL, GS_RENDER_TARGET);
+	device_set_render_target(device, target, NULL);
+	device_set_viewport(device, 0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+
+	cpu = bmalloc((size_t)BENCH_WIDTH * BENCH_HEIGHT * 4);
+
+	printf("%d %dx%d RGBA frames read back\n", FRAME_COUNT, BENCH_WIDTH,
+	       BENCH_HEIGHT);
+
+	snprintf(name, sizeof(name), "stage ring, depth %u:", depth);
+	print_stats(name, bench_stage_ring(device, target, cpu, depth));
+	print_stats("stage and map at once:",
+		    bench_stage_ring(device, target, cpu, 1));
+	print_stats("synchronous glReadPixels:",
+		    bench_read_pixels(device, target, cpu));
+
+	bfree(cpu);
+	gs_texture_destroy(target);
+	device_leave_context(device);
+	device_destroy(device);
+	return 0;
+}
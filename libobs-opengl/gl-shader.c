@@ -0,0 +1,689 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <ctype.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include "gl-subsystem.h"
+
+/* pixel shader entry points the built-in programs stand in for */
+static const struct {
+	const char *entry;
+	enum gl_program_type program;
+} programs[] = {
+	{"PSDrawBare", GL_PROGRAM_DRAW},
+	{"PSDrawOpaque", GL_PROGRAM_DRAW_OPAQUE},
+	{"PSDrawAlphaDivide", GL_PROGRAM_ALPHA_DIVIDE},
+	{"PSSolid", GL_PROGRAM_SOLID},
+	{"PS_Y", GL_PROGRAM_CONVERT_Y},
+	{"PS_UV_Wide", GL_PROGRAM_CONVERT_UV},
+	{"PS_U_Wide", GL_PROGRAM_CONVERT_U},
+	{"PS_V_Wide", GL_PROGRAM_CONVERT_V},
+	{"PS_U", GL_PROGRAM_CONVERT_U_FULL},
+	{"PS_V", GL_PROGRAM_CONVERT_V_FULL},
+};
+
+static const struct {
+	const char *name;
+	enum gs_shader_param_type type;
+} param_types[] = {
+	{"bool", GS_SHADER_PARAM_BOOL},
+	{"float", GS_SHADER_PARAM_FLOAT},
+	{"float2", GS_SHADER_PARAM_VEC2},
+	{"float3", GS_SHADER_PARAM_VEC3},
+	{"float4", GS_SHADER_PARAM_VEC4},
+	{"int", GS_SHADER_PARAM_INT},
+	{"int2", GS_SHADER_PARAM_INT2},
+	{"int3", GS_SHADER_PARAM_INT3},
+	{"int4", GS_SHADER_PARAM_INT4},
+	{"float4x4", GS_SHADER_PARAM_MATRIX4X4},
+	{"texture2d", GS_SHADER_PARAM_TEXTURE},
+	{"texture_rect", GS_SHADER_PARAM_TEXTURE},
+};
+
+static const char *skip_space(const char *str)
+{
+	while (*str && isspace((unsigned char)*str))
+		str++;
+	return str;
+}
+
+static inline bool is_ident_char(char ch)
+{
+	return isalnum((unsigned char)ch) || ch == '_';
+}
+
+/* copies the identifier at str into name, returns the end of it */
+static const char *get_ident(const char *str, struct dstr *name)
+{
+	const char *end;
+
+	str = skip_space(str);
+	end = str;
+	while (is_ident_char(*end))
+		end++;
+
+	dstr_ncopy(name, str, end - str);
+	return end;
+}
+
+/* finds str as a whole word in shader */
+static const char *find_word(const char *shader, const char *str)
+{
+	const size_t len = strlen(str);
+	const char *pos = shader;
+
+	while ((pos = strstr(pos, str)) != NULL) {
+		const bool start = pos == shader || !is_ident_char(pos[-1]);
+		const bool end = !is_ident_char(pos[len]);
+		if (start && end)
+			return pos;
+		pos += len;
+	}
+
+	return NULL;
+}
+
+static enum gs_shader_param_type get_param_type(const char *type)
+{
+	for (size_t i = 0; i < sizeof(param_types) / sizeof(param_types[0]);
+	     i++) {
+		if (strcmp(param_types[i].name, type) == 0)
+			return param_types[i].type;
+	}
+
+	return GS_SHADER_PARAM_UNKNOWN;
+}
+
+static void parse_params(gs_shader_t *shader, const char *str)
+{
+	struct dstr type = {0};
+	struct dstr name = {0};
+
+	while ((str = find_word(str, "uniform")) != NULL) {
+		struct gs_shader_param *param;
+
+		str = get_ident(str + 7, &type);
+		str = get_ident(str, &name);
+		if (dstr_is_empty(&name))
+			continue;
+
+		param = da_push_back_new(shader->params);
+		dstr_copy_dstr(&param->name, &name);
+		param->type = get_param_type(type.array);
+		param->shader = shader;
+	}
+
+	dstr_free(&type);
+	dstr_free(&name);
+}
+
+static enum gs_sample_filter get_filter(const char *value)
+{
+	if (astrcmpi(value, "Point") == 0)
+		return GS_FILTER_POINT;
+	if (astrcmpi(value, "Anisotropy") == 0)
+		return GS_FILTER_ANISOTROPIC;
+	if (astrcmpi(value, "MIN_MAG_POINT_MIP_LINEAR") == 0)
+		return GS_FILTER_MIN_MAG_POINT_MIP_LINEAR;
+	return GS_FILTER_LINEAR;
+}
+
+/* sampler states declared by the effect decide how textures are filtered,
+ * the first one found is used for all of them */
+static void parse_filter(gs_shader_t *shader, const char *str)
+{
+	struct dstr value = {0};
+	const char *block_end;
+
+	shader->filter = GS_FILTER_LINEAR;
+
+	str = find_word(str, "sampler_state");
+	if (!str)
+		return;
+
+	block_end = strchr(str, '}');
+	str = find_word(str, "Filter");
+	if (!str || (block_end && str > block_end))
+		return;
+
+	str = skip_space(str + 6);
+	if (*str != '=')
+		return;
+
+	get_ident(str + 1, &value);
+	if (value.array)
+		shader->filter = get_filter(value.array);
+	dstr_free(&value);
+}
+
+static enum gl_program_type find_program(const char *entry)
+{
+	for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+		if (strcmp(programs[i].entry, entry) == 0)
+			return programs[i].program;
+	}
+
+	return (enum gl_program_type) - 1;
+}
+
+/* the effect parser wraps the pass function in a main() that returns its
+ * result, which is what names the program */
+static enum gl_program_type parse_program(const char *str, const char *file)
+{
+	struct dstr entry = {0};
+	enum gl_program_type program = (enum gl_program_type) - 1;
+	const char *main_func = find_word(str, "main");
+	const char *ret = main_func ? find_word(main_func, "return") : NULL;
+
+	if (ret) {
+		get_ident(ret + 6, &entry);
+		if (entry.array)
+			program = find_program(entry.array);
+	}
+
+	if ((int)program == -1) {
+		for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]);
+		     i++) {
+			if (find_word(str, programs[i].entry)) {
+				program = programs[i].program;
+				break;
+			}
+		}
+	}
+
+	if ((int)program == -1) {
+		blog(LOG_WARNING,
+		     "GL: no built-in program for pixel shader "
+		     "'%s' (%s), drawing it as a textured quad",
+		     entry.array ? entry.array : "", file ? file : "");
+		program = GL_PROGRAM_DRAW;
+	}
+
+	dstr_free(&entry);
+	return program;
+}
+
+static gs_shader_t *shader_create(gs_device_t *device,
+				  enum gs_shader_type type, const char *str,
+				  const char *file)
+{
+	struct gs_shader *shader = bzalloc(sizeof(struct gs_shader));
+
+	shader->device = device;
+	shader->type = type;
+
+	parse_params(shader, str);
+	parse_filter(shader, str);
+
+	if (type == GS_SHADER_PIXEL)
+		shader->program = parse_program(str, file);
+
+	shader->viewproj = gl_shader_param(shader, "ViewProj");
+	shader->world = gl_shader_param(shader, "World");
+	return shader;
+}
+
+gs_shader_t *device_vertexshader_create(gs_device_t *device,
+					const char *shader, const char *file,
+					char **error_string)
+{
+	if (error_string)
+		*error_string = NULL;
+	return shader_create(device, GS_SHADER_VERTEX, shader, file);
+}
+
+gs_shader_t *device_pixelshader_create(gs_device_t *device,
+				       const char *shader, const char *file,
+				       char **error_string)
+{
+	if (error_string)
+		*error_string = NULL;
+	return shader_create(device, GS_SHADER_PIXEL, shader, file);
+}
+
+void gs_shader_destroy(gs_shader_t *shader)
+{
+	if (!shader)
+		return;
+
+	if (shader->device->cur_vertex_shader == shader)
+		shader->device->cur_vertex_shader = NULL;
+	if (shader->device->cur_pixel_shader == shader)
+		shader->device->cur_pixel_shader = NULL;
+
+	for (size_t i = 0; i < shader->params.num; i++) {
+		struct gs_shader_param *param = shader->params.array + i;
+		dstr_free(&param->name);
+		da_free(param->cur_value);
+		da_free(param->def_value);
+	}
+
+	da_free(shader->params);
+	bfree(shader);
+}
+
+int gs_shader_get_num_params(const gs_shader_t *shader)
+{
+	return (int)shader->params.num;
+}
+
+gs_sparam_t *gs_shader_get_param_by_idx(gs_shader_t *shader, uint32_t param)
+{
+	if (param >= shader->params.num)
+		return NULL;
+	return shader->params.array + param;
+}
+
+gs_sparam_t *gs_shader_get_param_by_name(gs_shader_t *shader, const char *name)
+{
+	return gl_shader_param(shader, name);
+}
+
+gs_sparam_t *gs_shader_get_viewproj_matrix(const gs_shader_t *shader)
+{
+	return shader->viewproj;
+}
+
+gs_sparam_t *gs_shader_get_world_matrix(const gs_shader_t *shader)
+{
+	return shader->world;
+}
+
+void gs_shader_get_param_info(const gs_sparam_t *param,
+			      struct gs_shader_param_info *info)
+{
+	if (!param)
+		return;
+
+	info->name = param->name.array;
+	info->type = param->type;
+}
+
+static inline void set_value(gs_sparam_t *param, const void *data,
+			     size_t size)
+{
+	da_copy_array(param->cur_value, data, size);
+}
+
+void gs_shader_set_bool(gs_sparam_t *param, bool val)
+{
+	int b_val = (int)val;
+	set_value(param, &b_val, sizeof(int));
+}
+
+void gs_shader_set_float(gs_sparam_t *param, float val)
+{
+	set_value(param, &val, sizeof(float));
+}
+
+void gs_shader_set_int(gs_sparam_t *param, int val)
+{
+	set_value(param, &val, sizeof(int));
+}
+
+void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
+{
+	struct matrix4 mat;
+	matrix4_from_matrix3(&mat, val);
+	set_value(param, &mat, sizeof(mat));
+}
+
+void gs_shader_set_matrix4(gs_sparam_t *param, const struct matrix4 *val)
+{
+	set_value(param, val, sizeof(*val));
+}
+
+void gs_shader_set_vec2(gs_sparam_t *param, const struct vec2 *val)
+{
+	set_value(param, val, sizeof(float) * 2);
+}
+
+void gs_shader_set_vec3(gs_sparam_t *param, const struct vec3 *val)
+{
+	set_value(param, val, sizeof(float) * 3);
+}
+
+void gs_shader_set_vec4(gs_sparam_t *param, const struct vec4 *val)
+{
+	set_value(param, val, sizeof(*val));
+}
+
+void gs_shader_set_texture(gs_sparam_t *param, gs_texture_t *val)
+{
+	param->texture = val;
+}
+
+void gs_shader_set_val(gs_sparam_t *param, const void *val, size_t size)
+{
+	if (param->type == GS_SHADER_PARAM_TEXTURE) {
+		gs_texture_t *tex;
+		memcpy(&tex, val, sizeof(tex));
+		param->texture = tex;
+		return;
+	}
+
+	set_value(param, val, size);
+}
+
+void gs_shader_set_default(gs_sparam_t *param)
+{
+	if (param->def_value.num)
+		da_copy(param->cur_value, param->def_value);
+	else
+		da_resize(param->cur_value, 0);
+}
+
+void gs_shader_set_next_sampler(gs_sparam_t *param, gs_samplerstate_t *sampler)
+{
+	param->next_sampler = sampler;
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct gs_shader_param *gl_shader_param(const gs_shader_t *shader,
+					const char *name)
+{
+	if (!shader)
+		return NULL;
+
+	for (size_t i = 0; i < shader->params.num; i++) {
+		struct gs_shader_param *param = shader->params.array + i;
+		if (strcmp(param->name.array, name) == 0)
+			return param;
+	}
+
+	return NULL;
+}
+
+static gs_texture_t *get_texture(const gs_shader_t *shader, const char *name)
+{
+	struct gs_shader_param *param = gl_shader_param(shader, name);
+	return param ? param->texture : NULL;
+}
+
+/* missing components read as zero */
+static void get_vec4(const gs_shader_t *shader, const char *name,
+		     struct vec4 *val)
+{
+	struct gs_shader_param *param = gl_shader_param(shader, name);
+	size_t size;
+
+	vec4_zero(val);
+	if (!param)
+		return;
+
+	size = param->cur_value.num;
+	if (size > sizeof(float) * 4)
+		size = sizeof(float) * 4;
+	memcpy(val->ptr, param->cur_value.array, size);
+}
+
+static enum gs_sample_filter get_texture_filter(const gs_shader_t *shader,
+						 const char *name)
+{
+	struct gs_shader_param *param = gl_shader_param(shader, name);
+
+	if (param && param->next_sampler)
+		return param->next_sampler->info.filter;
+	return shader->filter;
+}
+
+/* ------------------------------------------------------------------------- */
+/* built-in programs */
+
+/* without a vertex buffer, vertex ids 0-2 make a triangle covering the
+ * viewport, as the conversion passes expect.  Every position is flipped
+ * vertically, see gl-subsystem.h. */
+static const char *vertex_shader =
+	"#version 330\n"
+	"uniform mat4 ViewProj;\n"
+	"uniform bool fullscreen;\n"
+	"layout(location = 0) in vec3 pos;\n"
+	"layout(location = 1) in vec2 uv_in;\n"
+	"out vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"\tvec4 p;\n"
+	"\tif (fullscreen) {\n"
+	"\t\tp.x = gl_VertexID == 1 ? 3.0 : -1.0;\n"
+	"\t\tp.y = gl_VertexID == 2 ? -3.0 : 1.0;\n"
+	"\t\tp.zw = vec2(0.0, 1.0);\n"
+	"\t\tuv = vec2(p.x + 1.0, 1.0 - p.y) * 0.5;\n"
+	"\t} else {\n"
+	"\t\tp = ViewProj * vec4(pos, 1.0);\n"
+	"\t\tuv = uv_in;\n"
+	"\t}\n"
+	"\tgl_Position = vec4(p.x, -p.y, p.z, p.w);\n"
+	"}\n";
+
+static const char *pixel_shader_header =
+	"#version 330\n"
+	"uniform sampler2D image;\n"
+	"uniform vec4 color;\n"
+	"uniform vec4 color_vec0;\n"
+	"uniform vec4 color_vec1;\n"
+	"uniform vec4 color_vec2;\n"
+	"in vec2 uv;\n"
+	"out vec4 frag;\n"
+	"void main()\n"
+	"{\n";
+
+static const char *pixel_shader_bodies[GL_PROGRAM_COUNT] = {
+	[GL_PROGRAM_DRAW] = "\tfrag = texture(image, uv);\n",
+	[GL_PROGRAM_DRAW_OPAQUE] =
+		"\tfrag = vec4(texture(image, uv).rgb, 1.0);\n",
+	[GL_PROGRAM_ALPHA_DIVIDE] =
+		"\tvec4 rgba = texture(image, uv);\n"
+		"\tif (rgba.a > 0.0)\n"
+		"\t\trgba.rgb /= rgba.a;\n"
+		"\tfrag = rgba;\n",
+	[GL_PROGRAM_SOLID] = "\tfrag = color;\n",
+	[GL_PROGRAM_CONVERT_Y] =
+		"\tvec3 rgb = texture(image, uv).rgb;\n"
+		"\tfrag = vec4(dot(color_vec0.xyz, rgb) + color_vec0.w, "
+		"0.0, 0.0, 1.0);\n",
+	[GL_PROGRAM_CONVERT_UV] =
+		"\tvec3 rgb = texture(image, uv).rgb;\n"
+		"\tfrag = vec4(dot(color_vec1.xyz, rgb) + color_vec1.w, "
+		"dot(color_vec2.xyz, rgb) + color_vec2.w, 0.0, 1.0);\n",
+	[GL_PROGRAM_CONVERT_U] =
+		"\tvec3 rgb = texture(image, uv).rgb;\n"
+		"\tfrag = vec4(dot(color_vec1.xyz, rgb) + color_vec1.w, "
+		"0.0, 0.0, 1.0);\n",
+	[GL_PROGRAM_CONVERT_V] =
+		"\tvec3 rgb = texture(image, uv).rgb;\n"
+		"\tfrag = vec4(dot(color_vec2.xyz, rgb) + color_vec2.w, "
+		"0.0, 0.0, 1.0);\n",
+	[GL_PROGRAM_CONVERT_U_FULL] =
+		"\tvec3 rgb = texture(image, uv).rgb;\n"
+		"\tfrag = vec4(dot(color_vec1.xyz, rgb) + color_vec1.w, "
+		"0.0, 0.0, 1.0);\n",
+	[GL_PROGRAM_CONVERT_V_FULL] =
+		"\tvec3 rgb = texture(image, uv).rgb;\n"
+		"\tfrag = vec4(dot(color_vec2.xyz, rgb) + color_vec2.w, "
+		"0.0, 0.0, 1.0);\n",
+};
+
+static const char *color_vec_names[] = {"color_vec0", "color_vec1",
+					"color_vec2"};
+
+static GLuint compile_shader(GLenum type, const char *source)
+{
+	GLuint obj = glCreateShader(type);
+	GLint compiled = 0;
+
+	glShaderSource(obj, 1, &source, NULL);
+	glCompileShader(obj);
+	glGetShaderiv(obj, GL_COMPILE_STATUS, &compiled);
+
+	if (!compiled) {
+		char log[1024] = {0};
+		glGetShaderInfoLog(obj, sizeof(log) - 1, NULL, log);
+		blog(LOG_ERROR, "Failed to compile built-in shader:\n%s\n%s",
+		     source, log);
+		glDeleteShader(obj);
+		return 0;
+	}
+
+	return obj;
+}
+
+static bool link_program(struct gl_program *program,
+			 enum gl_program_type type)
+{
+	struct dstr source = {0};
+	GLuint vs, ps;
+	GLint linked = 0;
+
+	dstr_copy(&source, pixel_shader_header);
+	dstr_cat(&source, pixel_shader_bodies[type]);
+	dstr_cat(&source, "}\n");
+
+	vs = compile_shader(GL_VERTEX_SHADER, vertex_shader);
+	ps = compile_shader(GL_FRAGMENT_SHADER, source.array);
+	dstr_free(&source);
+
+	if (!vs || !ps) {
+		glDeleteShader(vs);
+		glDeleteShader(ps);
+		return false;
+	}
+
+	program->obj = glCreateProgram();
+	glAttachShader(program->obj, vs);
+	glAttachShader(program->obj, ps);
+	glLinkProgram(program->obj);
+	glDeleteShader(vs);
+	glDeleteShader(ps);
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[1024] = {0};
+		glGetProgramInfoLog(program->obj, sizeof(log) - 1, NULL, log);
+		blog(LOG_ERROR, "Failed to link built-in program %d: %s",
+		     (int)type, log);
+		glDeleteProgram(program->obj);
+		program->obj = 0;
+		return false;
+	}
+
+	program->viewproj = glGetUniformLocation(program->obj, "ViewProj");
+	program->fullscreen = glGetUniformLocation(program->obj, "fullscreen");
+	program->image = glGetUniformLocation(program->obj, "image");
+	program->color = glGetUniformLocation(program->obj, "color");
+	for (size_t i = 0; i < 3; i++)
+		program->color_vec[i] =
+			glGetUniformLocation(program->obj, color_vec_names[i]);
+	return gl_success("link_program");
+}
+
+/* programs are linked the first time they are drawn with */
+struct gl_program *gl_get_program(gs_device_t *device,
+				  enum gl_program_type type)
+{
+	struct gl_program *program = &device->programs[type];
+
+	if (!program->obj && !link_program(program, type))
+		return NULL;
+
+	return program;
+}
+
+void gl_free_programs(gs_device_t *device)
+{
+	for (size_t i = 0; i < GL_PROGRAM_COUNT; i++) {
+		if (device->programs[i].obj)
+			glDeleteProgram(device->programs[i].obj);
+	}
+
+	memset(device->programs, 0, sizeof(device->programs));
+}
+
+static GLuint get_sampler(gs_device_t *device, const gs_shader_t *ps)
+{
+	struct gs_shader_param *param = gl_shader_param(ps, "image");
+
+	switch (ps->program) {
+	case GL_PROGRAM_CONVERT_Y:
+	case GL_PROGRAM_CONVERT_U_FULL:
+	case GL_PROGRAM_CONVERT_V_FULL:
+		return device->point_sampler;
+
+	/* half resolution chroma is taken from the center of each 2x2
+	 * block, where bilinear filtering averages the block */
+	case GL_PROGRAM_CONVERT_UV:
+	case GL_PROGRAM_CONVERT_U:
+	case GL_PROGRAM_CONVERT_V:
+		return device->linear_sampler;
+
+	default:
+		break;
+	}
+
+	if (param && param->next_sampler)
+		return param->next_sampler->sampler;
+	if (device->cur_samplers[0])
+		return device->cur_samplers[0]->sampler;
+
+	return is_point_filter(get_texture_filter(ps, "image"))
+		       ? device->point_sampler
+		       : device->linear_sampler;
+}
+
+bool gl_load_program(gs_device_t *device, const struct matrix4 *viewproj,
+		     bool fullscreen)
+{
+	const gs_shader_t *ps = device->cur_pixel_shader;
+	struct gl_program *program;
+	gs_texture_t *image;
+	struct vec4 val;
+
+	if (!ps) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	program = gl_get_program(device, ps->program);
+	if (!program)
+		return false;
+
+	glUseProgram(program->obj);
+	if (!gl_success("glUseProgram"))
+		return false;
+
+	glUniformMatrix4fv(program->viewproj, 1, GL_FALSE, viewproj->x.ptr);
+	glUniform1i(program->fullscreen, fullscreen);
+
+	get_vec4(ps, "color", &val);
+	glUniform4fv(program->color, 1, val.ptr);
+	for (size_t i = 0; i < 3; i++) {
+		get_vec4(ps, color_vec_names[i], &val);
+		glUniform4fv(program->color_vec[i], 1, val.ptr);
+	}
+
+	image = get_texture(ps, "image");
+	if (!image)
+		image = device->cur_textures[0];
+
+	gl_active_texture(GL_TEXTURE0);
+	gl_bind_texture(GL_TEXTURE_2D, image ? image->texture : 0);
+	glBindSampler(0, get_sampler(device, ps));
+	glUniform1i(program->image, 0);
+
+	return gl_success("gl_load_program");
+}
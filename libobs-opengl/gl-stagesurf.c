@@ -0,0 +1,238 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include "gl-subsystem.h"
+
+/* how long a map waits for an outstanding copy before giving up */
+#define STAGE_WAIT_TIMEOUT_NS 1000000000ULL
+
+static bool create_pack_buffer(struct gs_stage_surface *surf)
+{
+	glGenBuffers(1, &surf->pack_buffer);
+	if (!gl_success("glGenBuffers"))
+		return false;
+
+	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, surf->pack_buffer))
+		return false;
+
+	glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)surf->size, NULL,
+		     GL_STREAM_READ);
+	if (!gl_success("glBufferData"))
+		return false;
+
+	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+					   uint32_t height,
+					   enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf;
+
+	if (!convert_gs_format(color_format)) {
+		blog(LOG_ERROR, "device_stagesurface_create (GL): "
+				"unsupported color format %d",
+		     (int)color_format);
+		return NULL;
+	}
+
+	surf = bzalloc(sizeof(struct gs_stage_surface));
+	surf->device = device;
+	surf->format = color_format;
+	surf->width = width;
+	surf->height = height;
+	surf->gl_format = convert_gs_format(color_format);
+	surf->gl_type = get_gl_format_type(color_format);
+	surf->bytes_per_pixel = gs_get_format_bpp(color_format) / 8;
+	surf->size = (size_t)width * height * surf->bytes_per_pixel;
+
+	if (!create_pack_buffer(surf)) {
+		blog(LOG_ERROR, "device_stagesurface_create (GL) failed");
+		gs_stagesurface_destroy(surf);
+		return NULL;
+	}
+
+	return surf;
+}
+
+static inline void release_fence(struct gs_stage_surface *surf)
+{
+	if (surf->fence) {
+		glDeleteSync(surf->fence);
+		surf->fence = NULL;
+	}
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf)
+		return;
+
+	release_fence(stagesurf);
+	if (stagesurf->pack_buffer)
+		glDeleteBuffers(1, &stagesurf->pack_buffer);
+
+	bfree(stagesurf);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format
+gs_stagesurface_get_color_format(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+static inline bool can_stage(struct gs_stage_surface *dst, gs_texture_t *src)
+{
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		return false;
+	}
+
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		return false;
+	}
+
+	if (src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "Source and destination must have the same "
+				"dimensions");
+		return false;
+	}
+
+	return true;
+}
+
+/* only queues the copy into the pack buffer, the fence marks when it is
+ * done */
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+			  gs_texture_t *src)
+{
+	if (!can_stage(dst, src))
+		goto failed;
+
+	if (!gl_texture_bind_fbo(src, GL_READ_FRAMEBUFFER))
+		goto failed;
+	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, dst->pack_buffer))
+		goto failed;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, dst->width, dst->height, dst->gl_format,
+		     dst->gl_type, 0);
+	if (!gl_success("glReadPixels"))
+		goto failed;
+
+	release_fence(dst);
+	dst->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!gl_success("glFenceSync"))
+		goto failed;
+
+	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	gl_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+	UNUSED_PARAMETER(device);
+	return;
+
+failed:
+	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	gl_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+	blog(LOG_ERROR, "device_stage_texture (GL) failed");
+}
+
+/* returns false if the copy did not finish in time.  A signaled fence means
+ * the map below does not synchronize with the GPU at all. */
+static bool wait_for_copy(struct gs_stage_surface *surf)
+{
+	gs_device_t *device = surf->device;
+	uint64_t start;
+	GLenum status;
+
+	if (!surf->fence)
+		return true;
+
+	status = glClientWaitSync(surf->fence, 0, 0);
+	if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+		release_fence(surf);
+		return true;
+	}
+
+	start = os_gettime_ns();
+	status = glClientWaitSync(surf->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				  STAGE_WAIT_TIMEOUT_NS);
+
+	device->readback_waits++;
+	device->readback_wait_ns += os_gettime_ns() - start;
+
+	if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+		blog(LOG_WARNING, "gs_stagesurface_map (GL): copy did not "
+				  "finish in time");
+		return false;
+	}
+
+	release_fence(surf);
+	return true;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+			 uint32_t *linesize)
+{
+	gs_device_t *device = stagesurf->device;
+
+	if (!wait_for_copy(stagesurf))
+		return false;
+
+	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
+		return false;
+
+	*data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+				 (GLsizeiptr)stagesurf->size, GL_MAP_READ_BIT);
+	if (!gl_success("glMapBufferRange") || !*data) {
+		gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		return false;
+	}
+
+	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	device->readback_maps++;
+	device->readback_bytes += stagesurf->size;
+
+	*linesize = stagesurf->bytes_per_pixel * stagesurf->width;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
+		return;
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	gl_success("glUnmapBuffer");
+
+	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
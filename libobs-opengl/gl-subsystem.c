@@ -0,0 +1,1009 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <util/bmem.h>
+#include <graphics/vec3.h>
+#include "gl-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "OpenGL";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_OPENGL;
+}
+
+bool device_enum_adapters(bool (*callback)(void *param, const char *name,
+					   uint32_t id),
+			  void *param)
+{
+	callback(param, "Default", 0);
+	return true;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_OPENGL";
+}
+
+static GLuint create_sampler(GLint filter)
+{
+	GLuint sampler;
+
+	glGenSamplers(1, &sampler);
+	glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, filter);
+	glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, filter);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return sampler;
+}
+
+static bool gl_init_device(gs_device_t *device)
+{
+	glGenVertexArrays(1, &device->empty_vao);
+	if (!gl_success("glGenVertexArrays"))
+		return false;
+
+	device->point_sampler = create_sampler(GL_NEAREST);
+	device->linear_sampler = create_sampler(GL_LINEAR);
+	if (!gl_success("glGenSamplers"))
+		return false;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	device->cur_cull_mode = GS_NEITHER;
+	matrix4_identity(&device->cur_proj);
+	return gl_success("gl_init_device");
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+	int errorcode = GS_ERROR_FAIL;
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing OpenGL (headless)...");
+
+	device->plat = gl_platform_create(device, adapter);
+	if (!device->plat)
+		goto fail;
+
+	blog(LOG_INFO, "Loading up OpenGL on adapter %s %s",
+	     glGetString(GL_VENDOR), glGetString(GL_RENDERER));
+	blog(LOG_INFO,
+	     "OpenGL loaded successfully, version %s, shading "
+	     "language %s",
+	     glGetString(GL_VERSION),
+	     glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+	if (!gl_init_device(device)) {
+		errorcode = GS_ERROR_NOT_SUPPORTED;
+		goto fail;
+	}
+
+	device_leave_context(device);
+
+	*p_device = device;
+	return GS_SUCCESS;
+
+fail:
+	blog(LOG_ERROR, "device_create (GL) failed");
+	if (device->plat)
+		gl_platform_destroy(device->plat);
+	bfree(device);
+
+	*p_device = NULL;
+	return errorcode;
+}
+
+static void log_readback_stats(const gs_device_t *device)
+{
+	if (!device->readback_maps)
+		return;
+
+	blog(LOG_INFO,
+	     "GL readback: %" PRIu64 " frames (%" PRIu64 " MB) mapped, "
+	     "%" PRIu64 " waited on the GPU for %.2f ms on average",
+	     device->readback_maps, device->readback_bytes / (1024 * 1024),
+	     device->readback_waits,
+	     device->readback_waits ? (double)device->readback_wait_ns /
+					      (double)device->readback_waits /
+					      1000000.0
+				    : 0.0);
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	log_readback_stats(device);
+
+	gl_free_programs(device);
+	if (device->point_sampler)
+		glDeleteSamplers(1, &device->point_sampler);
+	if (device->linear_sampler)
+		glDeleteSamplers(1, &device->linear_sampler);
+	if (device->empty_vao)
+		glDeleteVertexArrays(1, &device->empty_vao);
+
+	da_free(device->proj_stack);
+	gl_platform_destroy(device->plat);
+	bfree(device);
+}
+
+/* ------------------------------------------------------------------------- */
+/* swap chains have no window, the back buffer is a plain render target */
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+					const struct gs_init_data *data)
+{
+	struct gs_swap_chain *swap;
+	enum gs_color_format format = data->format;
+
+	if (!convert_gs_internal_format(format))
+		format = GS_BGRA;
+
+	swap = bzalloc(sizeof(struct gs_swap_chain));
+	swap->device = device;
+	swap->info = *data;
+	swap->target = device_texture_create(device, data->cx, data->cy,
+					     format, 1, NULL,
+					     GS_RENDER_TARGET);
+	if (!swap->target) {
+		blog(LOG_ERROR, "device_swapchain_create (GL) failed");
+		bfree(swap);
+		return NULL;
+	}
+
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	gs_texture_destroy(swapchain->target);
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	gs_swapchain_t *swap = device->cur_swap;
+	enum gs_color_format format;
+	bool was_target;
+
+	if (!swap) {
+		blog(LOG_WARNING, "device_resize (GL): No active swap");
+		return;
+	}
+
+	format = swap->target->format;
+	was_target = device->cur_render_target == swap->target;
+
+	gs_texture_destroy(swap->target);
+	swap->info.cx = cx;
+	swap->info.cy = cy;
+	swap->target = device_texture_create(device, cx, cy, format, 1, NULL,
+					     GS_RENDER_TARGET);
+
+	if (was_target)
+		device_set_render_target(device, NULL, NULL);
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		blog(LOG_ERROR, "device_get_size (GL): No active swap");
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cx;
+	} else {
+		blog(LOG_ERROR, "device_get_width (GL): No active swap");
+		return 0;
+	}
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cy;
+	} else {
+		blog(LOG_ERROR, "device_get_height (GL): No active swap");
+		return 0;
+	}
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+	device_set_render_target(device, NULL, NULL);
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+bool device_nv12_available(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* vertex and index buffers */
+
+static bool upload_vertices(gs_vertbuffer_t *vb, const struct gs_vb_data *data)
+{
+	const GLenum usage = vb->dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+
+	if (!gl_bind_buffer(GL_ARRAY_BUFFER, vb->vertex_buffer))
+		return false;
+	glBufferData(GL_ARRAY_BUFFER, sizeof(struct vec3) * data->num,
+		     data->points, usage);
+
+	if (vb->uv_buffer) {
+		if (!gl_bind_buffer(GL_ARRAY_BUFFER, vb->uv_buffer))
+			return false;
+		glBufferData(GL_ARRAY_BUFFER,
+			     sizeof(float) * vb->uv_width * data->num,
+			     data->tvarray[0].array, usage);
+	}
+
+	gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+	return gl_success("glBufferData");
+}
+
+/* attribute 0 is the position, attribute 1 the first texture coordinate,
+ * which is all the built-in programs read */
+static bool create_vertex_array(gs_vertbuffer_t *vb)
+{
+	glGenVertexArrays(1, &vb->vao);
+	glGenBuffers(1, &vb->vertex_buffer);
+	if (vb->data->num_tex && vb->data->tvarray[0].array) {
+		vb->uv_width = vb->data->tvarray[0].width;
+		glGenBuffers(1, &vb->uv_buffer);
+	}
+	if (!gl_success("glGenBuffers"))
+		return false;
+
+	if (!upload_vertices(vb, vb->data))
+		return false;
+
+	glBindVertexArray(vb->vao);
+
+	gl_bind_buffer(GL_ARRAY_BUFFER, vb->vertex_buffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct vec3),
+			      NULL);
+	glEnableVertexAttribArray(0);
+
+	if (vb->uv_buffer) {
+		gl_bind_buffer(GL_ARRAY_BUFFER, vb->uv_buffer);
+		glVertexAttribPointer(1, (GLint)vb->uv_width, GL_FLOAT,
+				      GL_FALSE, 0, NULL);
+		glEnableVertexAttribArray(1);
+	}
+
+	glBindVertexArray(0);
+	gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+	return gl_success("glVertexAttribPointer");
+}
+
+static struct gs_vb_data *dup_vb_data(const struct gs_vb_data *data)
+{
+	struct gs_vb_data *dup = gs_vbdata_create();
+
+	dup->num = data->num;
+	dup->points = bmemdup(data->points, sizeof(struct vec3) * data->num);
+	dup->num_tex = data->num_tex;
+
+	if (data->num_tex) {
+		dup->tvarray = bzalloc(sizeof(struct gs_tvertarray) *
+				       data->num_tex);
+
+		for (size_t i = 0; i < data->num_tex; i++) {
+			const struct gs_tvertarray *tv = data->tvarray + i;
+
+			dup->tvarray[i].width = tv->width;
+			dup->tvarray[i].array = bmemdup(
+				tv->array, sizeof(float) * tv->width * data->num);
+		}
+	}
+
+	return dup;
+}
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+					    struct gs_vb_data *data,
+					    uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+
+	vb->device = device;
+	vb->data = (flags & GS_DUP_BUFFER) != 0 ? dup_vb_data(data) : data;
+	vb->num = data->num;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+
+	if (!create_vertex_array(vb)) {
+		blog(LOG_ERROR, "device_vertexbuffer_create (GL) failed");
+		gs_vertexbuffer_destroy(vb);
+		return NULL;
+	}
+
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer)
+{
+	if (!vertbuffer)
+		return;
+
+	if (vertbuffer->device->cur_vertex_buffer == vertbuffer)
+		vertbuffer->device->cur_vertex_buffer = NULL;
+
+	if (vertbuffer->vertex_buffer)
+		glDeleteBuffers(1, &vertbuffer->vertex_buffer);
+	if (vertbuffer->uv_buffer)
+		glDeleteBuffers(1, &vertbuffer->uv_buffer);
+	if (vertbuffer->vao)
+		glDeleteVertexArrays(1, &vertbuffer->vao);
+
+	gs_vbdata_destroy(vertbuffer->data);
+	bfree(vertbuffer);
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer)
+{
+	gs_vertexbuffer_flush_direct(vertbuffer, vertbuffer->data);
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vertbuffer,
+				  const struct gs_vb_data *data)
+{
+	if (!vertbuffer->dynamic) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (GL): "
+				"vertex buffer is not dynamic");
+		return;
+	}
+
+	if (!data) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (GL): no data");
+		return;
+	}
+
+	if (!upload_vertices(vertbuffer, data))
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (GL) failed");
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vertbuffer)
+{
+	return vertbuffer->data;
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+					    enum gs_index_type type,
+					    void *indices, size_t num,
+					    uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	const size_t width = type == GS_UNSIGNED_LONG ? sizeof(uint32_t)
+						      : sizeof(uint16_t);
+
+	ib->device = device;
+	ib->type = type;
+	ib->gl_type = type == GS_UNSIGNED_LONG ? GL_UNSIGNED_INT
+					       : GL_UNSIGNED_SHORT;
+	ib->data = (flags & GS_DUP_BUFFER) != 0 ? bmemdup(indices, width * num)
+						: indices;
+	ib->num = num;
+	ib->width = width;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+
+	glGenBuffers(1, &ib->buffer);
+	if (!gl_success("glGenBuffers") ||
+	    !gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ib->buffer))
+		goto fail;
+
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, width * num, indices,
+		     ib->dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if (!gl_success("glBufferData"))
+		goto fail;
+
+	return ib;
+
+fail:
+	blog(LOG_ERROR, "device_indexbuffer_create (GL) failed");
+	gs_indexbuffer_destroy(ib);
+	return NULL;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *indexbuffer)
+{
+	if (!indexbuffer)
+		return;
+
+	if (indexbuffer->device->cur_index_buffer == indexbuffer)
+		indexbuffer->device->cur_index_buffer = NULL;
+
+	if (indexbuffer->buffer)
+		glDeleteBuffers(1, &indexbuffer->buffer);
+
+	bfree(indexbuffer->data);
+	bfree(indexbuffer);
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *indexbuffer,
+				 const void *data)
+{
+	if (!indexbuffer->dynamic || !data)
+		return;
+
+	if (!gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer->buffer))
+		return;
+
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0,
+			indexbuffer->width * indexbuffer->num, data);
+	gl_success("glBufferSubData");
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *indexbuffer)
+{
+	gs_indexbuffer_flush_direct(indexbuffer, indexbuffer->data);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->type;
+}
+
+/* ------------------------------------------------------------------------- */
+/* timers */
+
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	struct gs_timer *timer = bzalloc(sizeof(struct gs_timer));
+
+	timer->device = device;
+	glGenQueries(2, timer->queries);
+	if (!gl_success("glGenQueries")) {
+		bfree(timer);
+		return NULL;
+	}
+
+	return timer;
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	struct gs_timer_range *range = bzalloc(sizeof(struct gs_timer_range));
+	range->device = device;
+	return range;
+}
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	if (!timer)
+		return;
+
+	glDeleteQueries(2, timer->queries);
+	bfree(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	glQueryCounter(timer->queries[0], GL_TIMESTAMP);
+	gl_success("glQueryCounter");
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	glQueryCounter(timer->queries[1], GL_TIMESTAMP);
+	gl_success("glQueryCounter");
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	GLint available = 0;
+	GLuint64 begin, end;
+
+	glGetQueryObjectiv(timer->queries[1], GL_QUERY_RESULT_AVAILABLE,
+			   &available);
+	if (!available)
+		return false;
+
+	glGetQueryObjectui64v(timer->queries[0], GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(timer->queries[1], GL_QUERY_RESULT, &end);
+	*ticks = end - begin;
+	return gl_success("glGetQueryObjectui64v");
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	bfree(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+			     uint64_t *frequency)
+{
+	UNUSED_PARAMETER(range);
+	*disjoint = false;
+	*frequency = 1000000000;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* state */
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vertbuffer)
+{
+	device->cur_vertex_buffer = vertbuffer;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *indexbuffer)
+{
+	device->cur_index_buffer = indexbuffer;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit < 0 || unit >= GL_MAX_TEXTURES)
+		return;
+
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+			      gs_samplerstate_t *samplerstate, int unit)
+{
+	if (unit < 0 || unit >= GL_MAX_TEXTURES)
+		return;
+
+	device->cur_samplers[unit] = samplerstate;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d, int unit)
+{
+	UNUSED_PARAMETER(b_3d);
+	device_load_samplerstate(device, NULL, unit);
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "device_load_vertexshader (GL): "
+				"Specified shader is not a vertex shader");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "device_load_pixelshader (GL): "
+				"Specified shader is not a pixel shader");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	if (device->cur_swap &&
+	    device->cur_render_target == device->cur_swap->target)
+		return NULL;
+
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+			      gs_zstencil_t *zstencil)
+{
+	if (tex && !tex->is_render_target) {
+		blog(LOG_ERROR, "device_set_render_target (GL): "
+				"texture is not a render target");
+		return;
+	}
+
+	if (!tex && device->cur_swap)
+		tex = device->cur_swap->target;
+
+	device->cur_render_target = tex;
+	device->cur_zstencil = zstencil;
+
+	if (tex)
+		gl_texture_bind_fbo(tex, GL_DRAW_FRAMEBUFFER);
+	else
+		gl_bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+				   int side, gs_zstencil_t *zstencil)
+{
+	blog(LOG_ERROR, "device_set_cube_render_target (GL): "
+			"cube textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(cubetex);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(zstencil);
+}
+
+void device_begin_frame(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < GL_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		 uint32_t start_vert, uint32_t num_verts)
+{
+	gs_vertbuffer_t *vb = device->cur_vertex_buffer;
+	gs_indexbuffer_t *ib = device->cur_index_buffer;
+	GLenum topology = convert_gs_topology(draw_mode);
+	struct matrix4 view, viewproj;
+
+	if (!device->cur_render_target) {
+		blog(LOG_ERROR, "device_draw (GL): No render target");
+		goto fail;
+	}
+
+	gs_matrix_get(&view);
+	matrix4_mul(&viewproj, &view, &device->cur_proj);
+
+	if (!gl_load_program(device, &viewproj, vb == NULL))
+		goto fail;
+
+	if (!vb) {
+		glBindVertexArray(device->empty_vao);
+		glDrawArrays(topology, 0, num_verts ? num_verts : 3);
+	} else if (ib) {
+		if (!num_verts)
+			num_verts = (uint32_t)ib->num;
+
+		glBindVertexArray(vb->vao);
+		gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ib->buffer);
+		glDrawElements(topology, num_verts, ib->gl_type,
+			       (const void *)(ib->width * start_vert));
+	} else {
+		if (!num_verts)
+			num_verts = (uint32_t)(vb->num - start_vert);
+
+		glBindVertexArray(vb->vao);
+		glDrawArrays(topology, start_vert, num_verts);
+	}
+
+	glBindVertexArray(0);
+	if (!gl_success("glDrawArrays"))
+		goto fail;
+
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_draw (GL) failed");
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		  const struct vec4 *color, float depth, uint8_t stencil)
+{
+	if ((clear_flags & GS_CLEAR_COLOR) != 0) {
+		glClearColor(color->x, color->y, color->z, color->w);
+		glClear(GL_COLOR_BUFFER_BIT);
+		gl_success("glClear");
+	}
+
+	/* depth and stencil buffers are never attached */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_flush(gs_device_t *device)
+{
+	glFlush();
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	if (device->cur_cull_mode == mode)
+		return;
+
+	device->cur_cull_mode = mode;
+
+	if (mode == GS_BACK) {
+		gl_enable(GL_CULL_FACE);
+		glCullFace(GL_BACK);
+	} else if (mode == GS_FRONT) {
+		gl_enable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+	} else {
+		gl_disable(GL_CULL_FACE);
+	}
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	if (enable)
+		gl_enable(GL_BLEND);
+	else
+		gl_disable(GL_BLEND);
+
+	UNUSED_PARAMETER(device);
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green, bool blue,
+			 bool alpha)
+{
+	glColorMask(red, green, blue, alpha);
+	UNUSED_PARAMETER(device);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+			   enum gs_blend_type dest)
+{
+	device_blend_function_separate(device, src, dest, src, dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+				    enum gs_blend_type src_c,
+				    enum gs_blend_type dest_c,
+				    enum gs_blend_type src_a,
+				    enum gs_blend_type dest_a)
+{
+	glBlendFuncSeparate(convert_gs_blend_type(src_c),
+			    convert_gs_blend_type(dest_c),
+			    convert_gs_blend_type(src_a),
+			    convert_gs_blend_type(dest_a));
+	gl_success("glBlendFuncSeparate");
+	UNUSED_PARAMETER(device);
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+			     enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		       enum gs_stencil_op_type fail,
+		       enum gs_stencil_op_type zfail,
+		       enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+/* with the flipped projection, GL's bottom-left origin lines up with row 0
+ * of the render target, so viewports and scissors are used as given */
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+			 int height)
+{
+	glViewport(x, y, width, height);
+	if (!gl_success("glViewport"))
+		blog(LOG_ERROR, "device_set_viewport (GL) failed");
+
+	device->cur_viewport.x = x;
+	device->cur_viewport.y = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	UNUSED_PARAMETER(device);
+
+	if (rect != NULL) {
+		glScissor(rect->x, rect->y, rect->cx, rect->cy);
+		if (gl_success("glScissor") && gl_enable(GL_SCISSOR_TEST))
+			return;
+
+	} else if (gl_disable(GL_SCISSOR_TEST)) {
+		return;
+	}
+
+	blog(LOG_ERROR, "device_set_scissor_rect (GL) failed");
+}
+
+void device_ortho(gs_device_t *device, float left, float right, float top,
+		  float bottom, float zNear, float zFar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = zFar - zNear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = 2.0f / rml;
+	dst->t.x = (left + right) / -rml;
+
+	dst->y.y = 2.0f / -bmt;
+	dst->t.y = (bottom + top) / bmt;
+
+	dst->z.z = -2.0f / fmn;
+	dst->t.z = (zFar + zNear) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right, float top,
+		    float bottom, float zNear, float zFar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float tmb = top - bottom;
+	float nmf = zNear - zFar;
+	float nearx2 = 2.0f * zNear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = nearx2 / rml;
+	dst->z.x = (left + right) / rml;
+
+	dst->y.y = nearx2 / tmb;
+	dst->z.y = (bottom + top) / tmb;
+
+	dst->z.z = (zFar + zNear) / nmf;
+	dst->t.z = 2.0f * (zNear * zFar) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void device_debug_marker_begin(gs_device_t *device, const char *markername,
+			       const float color[4])
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(markername);
+	UNUSED_PARAMETER(color);
+}
+
+void device_debug_marker_end(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
@@ -0,0 +1,230 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+/*
+ * Headless OpenGL 3.3 core implementation of the graphics subsystem.
+ *
+ * The context is created through EGL without a window (surfaceless when the
+ * driver supports it, otherwise on a 1x1 pbuffer), so it runs on servers and
+ * CI machines with Mesa llvmpipe.  Swap chains are plain render targets.
+ *
+ * Effect shaders are not translated to GLSL.  Like the software renderer,
+ * each pixel shader is mapped by its entry point to one of a set of built-in
+ * GLSL programs covering the default, opaque, solid and format conversion
+ * effects.
+ *
+ * Render targets are drawn with y flipped, so that row 0 of every texture is
+ * the top of the image as with Direct3D, and viewport, scissor, readback and
+ * sampling all use the same top-left origin.
+ */
+
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+#include <glad/glad.h>
+
+#include "gl-helpers.h"
+
+#define GL_MAX_TEXTURES 8
+
+struct gl_platform;
+
+struct gs_texture {
+	gs_device_t *device;
+	enum gs_color_format format;
+	GLenum gl_format;
+	GLenum gl_internal_format;
+	GLenum gl_type;
+	GLuint texture;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes_per_pixel;
+	bool is_render_target;
+	bool is_dynamic;
+
+	GLuint unpack_buffer;
+	GLuint fbo;
+};
+
+/* readback goes through a pixel pack buffer: staging only queues the copy
+ * and a fence, mapping checks the fence so a map never blocks on a copy
+ * that has already completed */
+struct gs_stage_surface {
+	gs_device_t *device;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes_per_pixel;
+	GLenum gl_format;
+	GLenum gl_type;
+	size_t size;
+
+	GLuint pack_buffer;
+	GLsync fence;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t *device;
+	uint32_t width;
+	uint32_t height;
+	enum gs_zstencil_format format;
+};
+
+struct gs_sampler_state {
+	gs_device_t *device;
+	struct gs_sampler_info info;
+	GLuint sampler;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t *device;
+	struct gs_vb_data *data;
+	size_t num;
+	bool dynamic;
+
+	GLuint vao;
+	GLuint vertex_buffer;
+	GLuint uv_buffer;
+	size_t uv_width;
+};
+
+struct gs_index_buffer {
+	gs_device_t *device;
+	enum gs_index_type type;
+	GLenum gl_type;
+	void *data;
+	size_t num;
+	size_t width;
+	bool dynamic;
+
+	GLuint buffer;
+};
+
+struct gs_timer {
+	gs_device_t *device;
+	GLuint queries[2];
+};
+
+struct gs_timer_range {
+	gs_device_t *device;
+};
+
+struct gs_swap_chain {
+	gs_device_t *device;
+	struct gs_init_data info;
+	gs_texture_t *target;
+};
+
+/* built-in pixel programs, see gl-shader.c for the entry points they are
+ * selected by */
+enum gl_program_type {
+	GL_PROGRAM_DRAW,
+	GL_PROGRAM_DRAW_OPAQUE,
+	GL_PROGRAM_ALPHA_DIVIDE,
+	GL_PROGRAM_SOLID,
+	GL_PROGRAM_CONVERT_Y,
+	GL_PROGRAM_CONVERT_UV,
+	GL_PROGRAM_CONVERT_U,
+	GL_PROGRAM_CONVERT_V,
+	GL_PROGRAM_CONVERT_U_FULL,
+	GL_PROGRAM_CONVERT_V_FULL,
+
+	GL_PROGRAM_COUNT
+};
+
+struct gl_program {
+	GLuint obj;
+	GLint viewproj;
+	GLint fullscreen;
+	GLint image;
+	GLint color;
+	GLint color_vec[3];
+};
+
+struct gs_shader_param {
+	struct dstr name;
+	enum gs_shader_param_type type;
+	gs_shader_t *shader;
+
+	DARRAY(uint8_t) cur_value;
+	DARRAY(uint8_t) def_value;
+	gs_texture_t *texture;
+	gs_samplerstate_t *next_sampler;
+};
+
+struct gs_shader {
+	gs_device_t *device;
+	enum gs_shader_type type;
+	enum gl_program_type program;
+	enum gs_sample_filter filter;
+
+	DARRAY(struct gs_shader_param) params;
+	struct gs_shader_param *viewproj;
+	struct gs_shader_param *world;
+};
+
+struct gs_device {
+	struct gl_platform *plat;
+
+	gs_swapchain_t *cur_swap;
+	gs_texture_t *cur_render_target;
+	gs_zstencil_t *cur_zstencil;
+	gs_vertbuffer_t *cur_vertex_buffer;
+	gs_indexbuffer_t *cur_index_buffer;
+	gs_texture_t *cur_textures[GL_MAX_TEXTURES];
+	gs_samplerstate_t *cur_samplers[GL_MAX_TEXTURES];
+	gs_shader_t *cur_vertex_shader;
+	gs_shader_t *cur_pixel_shader;
+
+	enum gs_cull_mode cur_cull_mode;
+	struct gs_rect cur_viewport;
+
+	struct gl_program programs[GL_PROGRAM_COUNT];
+	GLuint point_sampler;
+	GLuint linear_sampler;
+	GLuint empty_vao;
+
+	struct matrix4 cur_proj;
+	DARRAY(struct matrix4) proj_stack;
+
+	/* readback statistics, logged when the device is destroyed */
+	uint64_t readback_bytes;
+	uint64_t readback_maps;
+	uint64_t readback_waits;
+	uint64_t readback_wait_ns;
+};
+
+/* gl-egl.c */
+extern struct gl_platform *gl_platform_create(gs_device_t *device,
+					      uint32_t adapter);
+extern void gl_platform_destroy(struct gl_platform *platform);
+
+/* gl-texture.c */
+extern bool gl_texture_bind_fbo(gs_texture_t *tex, GLenum target);
+
+/* gl-shader.c */
+extern struct gs_shader_param *gl_shader_param(const gs_shader_t *shader,
+					       const char *name);
+extern struct gl_program *gl_get_program(gs_device_t *device,
+					  enum gl_program_type type);
+extern void gl_free_programs(gs_device_t *device);
+extern bool gl_load_program(gs_device_t *device, const struct matrix4 *viewproj,
+			    bool fullscreen);
@@ -0,0 +1,468 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include "gl-subsystem.h"
+
+static bool upload_texture(gs_texture_t *tex, const uint8_t *data)
+{
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex->texture))
+		return false;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, tex->gl_internal_format, tex->width,
+		     tex->height, 0, tex->gl_format, tex->gl_type, data);
+	if (!gl_success("glTexImage2D"))
+		return false;
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	return gl_success("glTexParameteri");
+}
+
+static bool create_unpack_buffer(gs_texture_t *tex)
+{
+	const GLsizeiptr size =
+		(GLsizeiptr)tex->width * tex->height * tex->bytes_per_pixel;
+
+	glGenBuffers(1, &tex->unpack_buffer);
+	if (!gl_success("glGenBuffers"))
+		return false;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex->unpack_buffer))
+		return false;
+
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return gl_success("glBufferData");
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+				    uint32_t height,
+				    enum gs_color_format color_format,
+				    uint32_t levels, const uint8_t **data,
+				    uint32_t flags)
+{
+	struct gs_texture *tex;
+
+	if (!convert_gs_internal_format(color_format)) {
+		blog(LOG_ERROR, "device_texture_create (GL): "
+				"unsupported color format %d",
+		     (int)color_format);
+		return NULL;
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture));
+	tex->device = device;
+	tex->format = color_format;
+	tex->gl_format = convert_gs_format(color_format);
+	tex->gl_internal_format = convert_gs_internal_format(color_format);
+	tex->gl_type = get_gl_format_type(color_format);
+	tex->width = width;
+	tex->height = height;
+	tex->bytes_per_pixel = gs_get_format_bpp(color_format) / 8;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->is_dynamic = (flags & GS_DYNAMIC) != 0;
+
+	glGenTextures(1, &tex->texture);
+	if (!gl_success("glGenTextures"))
+		goto fail;
+
+	/* only the base level is created, mipmaps are never sampled */
+	if (!upload_texture(tex, data ? data[0] : NULL))
+		goto fail;
+
+	if (tex->is_dynamic && !create_unpack_buffer(tex))
+		goto fail;
+
+	UNUSED_PARAMETER(levels);
+	return tex;
+
+fail:
+	gs_texture_destroy(tex);
+	blog(LOG_ERROR, "device_texture_create (GL) failed");
+	return NULL;
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+					enum gs_color_format color_format,
+					uint32_t levels, const uint8_t **data,
+					uint32_t flags)
+{
+	blog(LOG_ERROR, "device_cubetexture_create (GL): "
+			"cube textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(size);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+				       uint32_t height, uint32_t depth,
+				       enum gs_color_format color_format,
+				       uint32_t levels,
+				       const uint8_t *const *data,
+				       uint32_t flags)
+{
+	blog(LOG_ERROR, "device_voltexture_create (GL): "
+			"volume textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	UNUSED_PARAMETER(texture);
+	return GS_TEXTURE_2D;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	gs_device_t *device;
+
+	if (!tex)
+		return;
+
+	device = tex->device;
+	for (size_t i = 0; i < GL_MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+
+	if (tex->fbo)
+		glDeleteFramebuffers(1, &tex->fbo);
+	if (tex->unpack_buffer)
+		glDeleteBuffers(1, &tex->unpack_buffer);
+	if (tex->texture)
+		glDeleteTextures(1, &tex->texture);
+
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (!tex->is_dynamic) {
+		blog(LOG_ERROR, "gs_texture_map (GL): texture is not dynamic");
+		return false;
+	}
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex->unpack_buffer))
+		return false;
+
+	*ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+				(GLsizeiptr)tex->width * tex->height *
+					tex->bytes_per_pixel,
+				GL_MAP_WRITE_BIT |
+					GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!gl_success("glMapBufferRange") || !*ptr) {
+		gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
+	}
+
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	*linesize = tex->width * tex->bytes_per_pixel;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex->unpack_buffer))
+		return;
+
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	if (gl_success("glUnmapBuffer") &&
+	    gl_bind_texture(GL_TEXTURE_2D, tex->texture)) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tex->width,
+				tex->height, tex->gl_format, tex->gl_type, 0);
+		gl_success("glTexSubImage2D");
+		gl_bind_texture(GL_TEXTURE_2D, 0);
+	}
+
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return &tex->texture;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	gs_texture_destroy(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+	return 0;
+}
+
+enum gs_color_format
+gs_cubetexture_get_color_format(const gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+	return GS_UNKNOWN;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	gs_texture_destroy(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format
+gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* every texture that is drawn to or read from gets its own framebuffer
+ * object the first time it is needed */
+bool gl_texture_bind_fbo(gs_texture_t *tex, GLenum target)
+{
+	if (!tex->fbo) {
+		glGenFramebuffers(1, &tex->fbo);
+		if (!gl_success("glGenFramebuffers"))
+			return false;
+
+		if (!gl_bind_framebuffer(target, tex->fbo))
+			return false;
+
+		glFramebufferTexture2D(target, GL_COLOR_ATTACHMENT0,
+				       GL_TEXTURE_2D, tex->texture, 0);
+		if (!gl_success("glFramebufferTexture2D"))
+			return false;
+
+		if (glCheckFramebufferStatus(target) !=
+		    GL_FRAMEBUFFER_COMPLETE) {
+			blog(LOG_ERROR, "gl_texture_bind_fbo: framebuffer is "
+					"incomplete");
+			return false;
+		}
+
+		return true;
+	}
+
+	return gl_bind_framebuffer(target, tex->fbo);
+}
+
+void device_copy_texture_region(gs_device_t *device, gs_texture_t *dst,
+				uint32_t dst_x, uint32_t dst_y,
+				gs_texture_t *src, uint32_t src_x,
+				uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	uint32_t nw, nh;
+
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_copy_texture_region (GL): "
+				"NULL texture");
+		return;
+	}
+
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (GL): "
+				"Source and destination formats do not match");
+		return;
+	}
+
+	nw = src_w ? src_w : src->width - src_x;
+	nh = src_h ? src_h : src->height - src_y;
+
+	if (dst->width - dst_x < nw || dst->height - dst_y < nh) {
+		blog(LOG_ERROR, "device_copy_texture_region (GL): "
+				"Destination texture region is not big "
+				"enough to hold the source region");
+		return;
+	}
+
+	if (!gl_texture_bind_fbo(src, GL_READ_FRAMEBUFFER))
+		goto fail;
+	if (!gl_bind_texture(GL_TEXTURE_2D, dst->texture))
+		goto fail;
+
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, dst_x, dst_y, src_x, src_y, nw,
+			    nh);
+	if (!gl_success("glCopyTexSubImage2D"))
+		goto fail;
+
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	gl_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	gl_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+	blog(LOG_ERROR, "device_copy_texture_region (GL) failed");
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+			 gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+				      uint32_t height,
+				      enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs =
+		bzalloc(sizeof(struct gs_zstencil_buffer));
+
+	/* depth and stencil tests are never enabled */
+	zs->device = device;
+	zs->width = width;
+	zs->height = height;
+	zs->format = format;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zstencil)
+{
+	bfree(zstencil);
+}
+
+static inline GLint get_min_filter(enum gs_sample_filter filter)
+{
+	switch (filter) {
+	case GS_FILTER_POINT:
+	case GS_FILTER_MIN_MAG_POINT_MIP_LINEAR:
+	case GS_FILTER_MIN_POINT_MAG_LINEAR_MIP_POINT:
+	case GS_FILTER_MIN_POINT_MAG_MIP_LINEAR:
+		return GL_NEAREST;
+	default:
+		return GL_LINEAR;
+	}
+}
+
+static inline GLint get_mag_filter(enum gs_sample_filter filter)
+{
+	switch (filter) {
+	case GS_FILTER_POINT:
+	case GS_FILTER_MIN_MAG_POINT_MIP_LINEAR:
+	case GS_FILTER_MIN_LINEAR_MAG_MIP_POINT:
+	case GS_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR:
+		return GL_NEAREST;
+	default:
+		return GL_LINEAR;
+	}
+}
+
+gs_samplerstate_t *
+device_samplerstate_create(gs_device_t *device,
+			   const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler =
+		bzalloc(sizeof(struct gs_sampler_state));
+
+	sampler->device = device;
+	sampler->info = *info;
+
+	glGenSamplers(1, &sampler->sampler);
+	if (!gl_success("glGenSamplers")) {
+		bfree(sampler);
+		return NULL;
+	}
+
+	glSamplerParameteri(sampler->sampler, GL_TEXTURE_MIN_FILTER,
+			    get_min_filter(info->filter));
+	glSamplerParameteri(sampler->sampler, GL_TEXTURE_MAG_FILTER,
+			    get_mag_filter(info->filter));
+	glSamplerParameteri(sampler->sampler, GL_TEXTURE_WRAP_S,
+			    convert_address_mode(info->address_u));
+	glSamplerParameteri(sampler->sampler, GL_TEXTURE_WRAP_T,
+			    convert_address_mode(info->address_v));
+	gl_success("glSamplerParameteri");
+	return sampler;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	if (!samplerstate)
+		return;
+
+	for (size_t i = 0; i < GL_MAX_TEXTURES; i++) {
+		if (samplerstate->device->cur_samplers[i] == samplerstate)
+			samplerstate->device->cur_samplers[i] = NULL;
+	}
+
+	glDeleteSamplers(1, &samplerstate->sampler);
+	bfree(samplerstate);
+}
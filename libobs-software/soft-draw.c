@@ -0,0 +1,796 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <util/base.h>
+#include <graphics/vec3.h>
+#include <graphics/vec2.h>
+#include "soft-subsystem.h"
+
+struct draw_context {
+	gs_texture_t *target;
+	enum soft_program program;
+	gs_texture_t *image;
+	enum gs_sample_filter filter;
+	struct vec4 color;
+	struct vec4 color_vec[3];
+
+	struct soft_blend_state blend;
+	__m128 write_mask;
+	bool write_all;
+
+	/* clip rectangle in pixels, exclusive at the right and bottom */
+	int min_x, min_y, max_x, max_y;
+};
+
+struct raster_vert {
+	float x, y;
+	float inv_w;
+	float u, v;
+};
+
+/* ------------------------------------------------------------------------- */
+/* pixel programs */
+
+static inline float dot3(const struct vec4 *v, const struct vec4 *rgb)
+{
+	return v->x * rgb->x + v->y * rgb->y + v->z * rgb->z + v->w;
+}
+
+static inline void shade(const struct draw_context *ctx, float u, float v,
+			 struct vec4 *out)
+{
+	struct vec4 rgb;
+
+	switch (ctx->program) {
+	case SOFT_PROGRAM_SOLID:
+		*out = ctx->color;
+		return;
+	default:
+		break;
+	}
+
+	if (!ctx->image) {
+		vec4_zero(out);
+		return;
+	}
+
+	switch (ctx->program) {
+	case SOFT_PROGRAM_DRAW:
+		soft_sample(ctx->image, ctx->filter, u, v, out);
+		break;
+
+	case SOFT_PROGRAM_DRAW_OPAQUE:
+		soft_sample(ctx->image, ctx->filter, u, v, out);
+		out->w = 1.0f;
+		break;
+
+	case SOFT_PROGRAM_ALPHA_DIVIDE:
+		soft_sample(ctx->image, ctx->filter, u, v, out);
+		if (out->w > 0.0f) {
+			const float w = out->w;
+			out->m = _mm_mul_ps(out->m, _mm_set1_ps(1.0f / w));
+			out->w = w;
+		}
+		break;
+
+	/* the conversion passes read full resolution sources with point
+	 * sampling; half resolution chroma is taken from the center of each
+	 * 2x2 block, where bilinear filtering averages the block */
+	case SOFT_PROGRAM_CONVERT_Y:
+		soft_sample(ctx->image, GS_FILTER_POINT, u, v, &rgb);
+		vec4_set(out, dot3(&ctx->color_vec[0], &rgb), 0.0f, 0.0f,
+			 1.0f);
+		break;
+
+	case SOFT_PROGRAM_CONVERT_UV:
+		soft_sample(ctx->image, GS_FILTER_LINEAR, u, v, &rgb);
+		vec4_set(out, dot3(&ctx->color_vec[1], &rgb),
+			 dot3(&ctx->color_vec[2], &rgb), 0.0f, 1.0f);
+		break;
+
+	case SOFT_PROGRAM_CONVERT_U:
+	case SOFT_PROGRAM_CONVERT_U_FULL:
+		soft_sample(ctx->image,
+			    ctx->program == SOFT_PROGRAM_CONVERT_U
+				    ? GS_FILTER_LINEAR
+				    : GS_FILTER_POINT,
+			    u, v, &rgb);
+		vec4_set(out, dot3(&ctx->color_vec[1], &rgb), 0.0f, 0.0f,
+			 1.0f);
+		break;
+
+	case SOFT_PROGRAM_CONVERT_V:
+	case SOFT_PROGRAM_CONVERT_V_FULL:
+		soft_sample(ctx->image,
+			    ctx->program == SOFT_PROGRAM_CONVERT_V
+				    ? GS_FILTER_LINEAR
+				    : GS_FILTER_POINT,
+			    u, v, &rgb);
+		vec4_set(out, dot3(&ctx->color_vec[2], &rgb), 0.0f, 0.0f,
+			 1.0f);
+		break;
+
+	default:
+		vec4_zero(out);
+		break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* output merger */
+
+static inline __m128 blend_factor(enum gs_blend_type type, __m128 src,
+				  __m128 dst)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 src_a = _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3));
+	const __m128 dst_a = _mm_shuffle_ps(dst, dst, _MM_SHUFFLE(3, 3, 3, 3));
+
+	switch (type) {
+	case GS_BLEND_ZERO:
+		return _mm_setzero_ps();
+	case GS_BLEND_ONE:
+		return one;
+	case GS_BLEND_SRCCOLOR:
+		return src;
+	case GS_BLEND_INVSRCCOLOR:
+		return _mm_sub_ps(one, src);
+	case GS_BLEND_SRCALPHA:
+		return src_a;
+	case GS_BLEND_INVSRCALPHA:
+		return _mm_sub_ps(one, src_a);
+	case GS_BLEND_DSTCOLOR:
+		return dst;
+	case GS_BLEND_INVDSTCOLOR:
+		return _mm_sub_ps(one, dst);
+	case GS_BLEND_DSTALPHA:
+		return dst_a;
+	case GS_BLEND_INVDSTALPHA:
+		return _mm_sub_ps(one, dst_a);
+	case GS_BLEND_SRCALPHASAT:
+		return _mm_min_ps(src_a, _mm_sub_ps(one, dst_a));
+	}
+
+	return one;
+}
+
+static inline __m128 select_alpha(__m128 color, __m128 alpha)
+{
+	const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+	return _mm_or_ps(_mm_andnot_ps(mask, color), _mm_and_ps(mask, alpha));
+}
+
+static inline __m128 blend(const struct soft_blend_state *state, __m128 src,
+			   __m128 dst)
+{
+	__m128 src_f = select_alpha(blend_factor(state->src_c, src, dst),
+				    blend_factor(state->src_a, src, dst));
+	__m128 dst_f = select_alpha(blend_factor(state->dest_c, src, dst),
+				    blend_factor(state->dest_a, src, dst));
+
+	return _mm_add_ps(_mm_mul_ps(src, src_f), _mm_mul_ps(dst, dst_f));
+}
+
+static inline uint32_t pack_rgba8(__m128 color)
+{
+	__m128i px;
+
+	color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()),
+			   _mm_set1_ps(1.0f));
+	color = _mm_add_ps(_mm_mul_ps(color, _mm_set1_ps(255.0f)),
+			   _mm_set1_ps(0.5f));
+
+	px = _mm_cvttps_epi32(color);
+	px = _mm_packs_epi32(px, px);
+	px = _mm_packus_epi16(px, px);
+	return (uint32_t)_mm_cvtsi128_si32(px);
+}
+
+static inline __m128 swap_rb(__m128 color)
+{
+	return _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+static void write_pixel(const struct draw_context *ctx, int x, int y,
+			__m128 color)
+{
+	gs_texture_t *target = ctx->target;
+	uint8_t *p = target->data + (size_t)y * target->linesize +
+		     (size_t)x * target->bpp;
+	uint32_t packed;
+
+	if (ctx->blend.enabled || !ctx->write_all) {
+		struct vec4 dst;
+		soft_read_pixel(target, (uint32_t)x, (uint32_t)y, &dst);
+
+		if (ctx->blend.enabled)
+			color = blend(&ctx->blend, color, dst.m);
+		if (!ctx->write_all)
+			color = _mm_or_ps(
+				_mm_and_ps(ctx->write_mask, color),
+				_mm_andnot_ps(ctx->write_mask, dst.m));
+	}
+
+	switch (target->format) {
+	case GS_RGBA:
+		packed = pack_rgba8(color);
+		memcpy(p, &packed, 4);
+		break;
+	case GS_BGRA:
+	case GS_BGRX:
+		packed = pack_rgba8(swap_rb(color));
+		memcpy(p, &packed, 4);
+		break;
+	case GS_R8G8:
+		packed = pack_rgba8(color);
+		p[0] = (uint8_t)packed;
+		p[1] = (uint8_t)(packed >> 8);
+		break;
+	case GS_R8:
+		p[0] = (uint8_t)pack_rgba8(color);
+		break;
+	case GS_A8:
+		p[0] = (uint8_t)(pack_rgba8(color) >> 24);
+		break;
+	default:
+		break;
+	}
+}
+
+void soft_clear_color(gs_texture_t *target, const struct gs_rect *rect,
+		      const struct vec4 *color)
+{
+	uint32_t packed;
+	uint8_t px[4];
+
+	switch (target->format) {
+	case GS_BGRA:
+	case GS_BGRX:
+		packed = pack_rgba8(swap_rb(color->m));
+		break;
+	case GS_A8:
+		packed = pack_rgba8(color->m) >> 24;
+		break;
+	default:
+		packed = pack_rgba8(color->m);
+		break;
+	}
+	memcpy(px, &packed, 4);
+
+	for (int y = rect->y; y < rect->y + rect->cy; y++) {
+		uint8_t *row = target->data + (size_t)y * target->linesize +
+			       (size_t)rect->x * target->bpp;
+
+		if (target->bpp == 1) {
+			memset(row, px[0], (size_t)rect->cx);
+			continue;
+		}
+
+		for (int x = 0; x < rect->cx; x++) {
+			memcpy(row, px, target->bpp);
+			row += target->bpp;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* 1:1 texel spans */
+
+static inline __m128i div_255(__m128i val)
+{
+	val = _mm_add_epi16(val, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(val, _mm_srli_epi16(val, 8)), 8);
+}
+
+/* blends two unpacked pixels, src * (a, a, a, 1) or src * 1 for
+ * premultiplied sources, plus dst * (1 - a) */
+static inline __m128i blend_over_epi16(__m128i src, __m128i dst,
+				       bool premultiplied)
+{
+	const __m128i full = _mm_set1_epi16(255);
+	__m128i a = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i src_f;
+
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+
+	if (premultiplied) {
+		src_f = full;
+	} else {
+		const __m128i alpha_lanes =
+			_mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		src_f = _mm_or_si128(_mm_andnot_si128(alpha_lanes, a),
+				     _mm_and_si128(alpha_lanes, full));
+	}
+
+	src = div_255(_mm_mullo_epi16(src, src_f));
+	dst = div_255(_mm_mullo_epi16(dst, _mm_sub_epi16(full, a)));
+	return _mm_adds_epu16(src, dst);
+}
+
+static void blend_span_rgba8(uint8_t *dst, const uint8_t *src, int count,
+			     bool premultiplied)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	for (; x + 4 <= count; x += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + x * 4));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + x * 4));
+		__m128i lo = blend_over_epi16(_mm_unpacklo_epi8(s, zero),
+					      _mm_unpacklo_epi8(d, zero),
+					      premultiplied);
+		__m128i hi = blend_over_epi16(_mm_unpackhi_epi8(s, zero),
+					      _mm_unpackhi_epi8(d, zero),
+					      premultiplied);
+
+		_mm_storeu_si128((__m128i *)(dst + x * 4),
+				 _mm_packus_epi16(lo, hi));
+	}
+
+	for (; x < count; x++) {
+		__m128i s = _mm_cvtsi32_si128(*(const int *)(src + x * 4));
+		__m128i d = _mm_cvtsi32_si128(*(const int *)(dst + x * 4));
+		__m128i px = blend_over_epi16(_mm_unpacklo_epi8(s, zero),
+					      _mm_unpacklo_epi8(d, zero),
+					      premultiplied);
+
+		*(int *)(dst + x * 4) =
+			_mm_cvtsi128_si32(_mm_packus_epi16(px, px));
+	}
+}
+
+static inline bool is_blend(const struct soft_blend_state *state,
+			    enum gs_blend_type src_c, enum gs_blend_type dest_c,
+			    enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	return state->src_c == src_c && state->dest_c == dest_c &&
+	       state->src_a == src_a && state->dest_a == dest_a;
+}
+
+/* draws rows of texels straight onto the target when the quad maps texels
+ * to pixels one to one, returns false if the generic path is needed */
+static bool draw_texel_rect(const struct draw_context *ctx, int x0, int y0,
+			    int x1, int y1, int tex_x, int tex_y)
+{
+	const gs_texture_t *src = ctx->image;
+	gs_texture_t *dst = ctx->target;
+	const bool opaque = ctx->program == SOFT_PROGRAM_DRAW_OPAQUE;
+	bool copy = !ctx->blend.enabled ||
+		    is_blend(&ctx->blend, GS_BLEND_ONE, GS_BLEND_ZERO,
+			     GS_BLEND_ONE, GS_BLEND_ZERO);
+	bool premultiplied = false;
+
+	if (ctx->program != SOFT_PROGRAM_DRAW && !opaque)
+		return false;
+	if (!src || !ctx->write_all || src->format != dst->format)
+		return false;
+	if (src->format != GS_RGBA && src->format != GS_BGRA)
+		return false;
+
+	if (!copy) {
+		if (is_blend(&ctx->blend, GS_BLEND_ONE, GS_BLEND_INVSRCALPHA,
+			     GS_BLEND_ONE, GS_BLEND_INVSRCALPHA))
+			premultiplied = true;
+		else if (!is_blend(&ctx->blend, GS_BLEND_SRCALPHA,
+				   GS_BLEND_INVSRCALPHA, GS_BLEND_ONE,
+				   GS_BLEND_INVSRCALPHA))
+			return false;
+	}
+
+	/* blending an opaque source is a copy */
+	if (opaque)
+		copy = true;
+
+	if (tex_x < 0 || tex_y < 0 ||
+	    tex_x + (x1 - x0) > (int)src->width ||
+	    tex_y + (y1 - y0) > (int)src->height)
+		return false;
+
+	for (int y = y0; y < y1; y++) {
+		const uint8_t *in = src->data +
+				    (size_t)(tex_y + y - y0) * src->linesize +
+				    (size_t)tex_x * 4;
+		uint8_t *out = dst->data + (size_t)y * dst->linesize +
+			       (size_t)x0 * 4;
+		const int count = x1 - x0;
+
+		if (copy) {
+			memcpy(out, in, (size_t)count * 4);
+			if (opaque) {
+				for (int x = 0; x < count; x++)
+					out[x * 4 + 3] = 255;
+			}
+		} else {
+			blend_span_rgba8(out, in, count, premultiplied);
+		}
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* rasterization */
+
+static inline bool clip_rect(const struct draw_context *ctx, int *x0, int *y0,
+			     int *x1, int *y1)
+{
+	if (*x0 < ctx->min_x)
+		*x0 = ctx->min_x;
+	if (*y0 < ctx->min_y)
+		*y0 = ctx->min_y;
+	if (*x1 > ctx->max_x)
+		*x1 = ctx->max_x;
+	if (*y1 > ctx->max_y)
+		*y1 = ctx->max_y;
+	return *x0 < *x1 && *y0 < *y1;
+}
+
+/* an axis-aligned quad whose texture coordinates are linear in x and y,
+ * which is what sprites, texrender blits and conversion passes draw */
+static void draw_rect(const struct draw_context *ctx, float left, float top,
+		      float right, float bottom, float u0, float v0,
+		      float du_dx, float dv_dy)
+{
+	/* pixels whose centers are inside the rectangle */
+	int x0 = (int)ceilf(left - 0.5f);
+	int y0 = (int)ceilf(top - 0.5f);
+	int x1 = (int)ceilf(right - 0.5f);
+	int y1 = (int)ceilf(bottom - 0.5f);
+
+	if (!clip_rect(ctx, &x0, &y0, &x1, &y1))
+		return;
+
+	/* texel-exact: one texel per pixel and pixel centers landing on
+	 * texel centers */
+	if (ctx->image && ctx->program <= SOFT_PROGRAM_DRAW_OPAQUE) {
+		const float tw = (float)ctx->image->width;
+		const float th = (float)ctx->image->height;
+		const float tx = (u0 + ((float)x0 + 0.5f - left) * du_dx) * tw -
+				 0.5f;
+		const float ty = (v0 + ((float)y0 + 0.5f - top) * dv_dy) * th -
+				 0.5f;
+
+		if (fabsf(du_dx * tw - 1.0f) < 1e-4f &&
+		    fabsf(dv_dy * th - 1.0f) < 1e-4f &&
+		    fabsf(tx - roundf(tx)) < 1e-3f &&
+		    fabsf(ty - roundf(ty)) < 1e-3f &&
+		    draw_texel_rect(ctx, x0, y0, x1, y1, (int)roundf(tx),
+				    (int)roundf(ty)))
+			return;
+	}
+
+	for (int y = y0; y < y1; y++) {
+		const float v = v0 + ((float)y + 0.5f - top) * dv_dy;
+
+		for (int x = x0; x < x1; x++) {
+			const float u = u0 + ((float)x + 0.5f - left) * du_dx;
+			struct vec4 color;
+
+			shade(ctx, u, v, &color);
+			write_pixel(ctx, x, y, color.m);
+		}
+	}
+}
+
+static inline float edge(const struct raster_vert *a,
+			 const struct raster_vert *b, float x, float y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+/* top-left rule, so that pixels on an edge shared by two triangles are
+ * drawn once */
+static inline bool is_top_left(const struct raster_vert *a,
+			       const struct raster_vert *b)
+{
+	return (a->y == b->y && b->x > a->x) || b->y < a->y;
+}
+
+static void draw_triangle(const struct draw_context *ctx,
+			  const struct raster_vert *v0,
+			  const struct raster_vert *v1,
+			  const struct raster_vert *v2)
+{
+	float area = edge(v0, v1, v2->x, v2->y);
+	int x0, y0, x1, y1;
+
+	if (fabsf(area) < 1e-8f)
+		return;
+
+	/* culling is not implemented, so make the winding consistent */
+	if (area < 0.0f) {
+		const struct raster_vert *tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+	}
+
+	x0 = (int)floorf(fminf(v0->x, fminf(v1->x, v2->x)));
+	y0 = (int)floorf(fminf(v0->y, fminf(v1->y, v2->y)));
+	x1 = (int)ceilf(fmaxf(v0->x, fmaxf(v1->x, v2->x))) + 1;
+	y1 = (int)ceilf(fmaxf(v0->y, fmaxf(v1->y, v2->y))) + 1;
+
+	if (!clip_rect(ctx, &x0, &y0, &x1, &y1))
+		return;
+
+	const bool tl0 = is_top_left(v1, v2);
+	const bool tl1 = is_top_left(v2, v0);
+	const bool tl2 = is_top_left(v0, v1);
+
+	for (int y = y0; y < y1; y++) {
+		const float py = (float)y + 0.5f;
+
+		for (int x = x0; x < x1; x++) {
+			const float px = (float)x + 0.5f;
+			const float w0 = edge(v1, v2, px, py);
+			const float w1 = edge(v2, v0, px, py);
+			const float w2 = edge(v0, v1, px, py);
+			struct vec4 color;
+			float b0, b1, b2, inv_w;
+
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+			if ((w0 == 0.0f && !tl0) || (w1 == 0.0f && !tl1) ||
+			    (w2 == 0.0f && !tl2))
+				continue;
+
+			/* perspective correct interpolation */
+			b0 = w0 / area * v0->inv_w;
+			b1 = w1 / area * v1->inv_w;
+			b2 = w2 / area * v2->inv_w;
+			inv_w = 1.0f / (b0 + b1 + b2);
+
+			shade(ctx,
+			      (b0 * v0->u + b1 * v1->u + b2 * v2->u) * inv_w,
+			      (b0 * v0->v + b1 * v1->v + b2 * v2->v) * inv_w,
+			      &color);
+			write_pixel(ctx, x, y, color.m);
+		}
+	}
+}
+
+/* a tristrip of four vertices forming an axis-aligned rectangle */
+static bool draw_quad_as_rect(const struct draw_context *ctx,
+			      const struct raster_vert *v)
+{
+	const struct raster_vert *tl = &v[0];
+	const struct raster_vert *br = &v[3];
+
+	if (v[0].y != v[1].y || v[2].y != v[3].y || v[0].x != v[2].x ||
+	    v[1].x != v[3].x)
+		return false;
+	if (v[0].v != v[1].v || v[2].v != v[3].v || v[0].u != v[2].u ||
+	    v[1].u != v[3].u)
+		return false;
+	if (v[0].inv_w != 1.0f || v[1].inv_w != 1.0f || v[2].inv_w != 1.0f ||
+	    v[3].inv_w != 1.0f)
+		return false;
+
+	/* flipped sprites swap corners */
+	if (tl->x > br->x || tl->y > br->y) {
+		const float left = fminf(tl->x, br->x);
+		const float top = fminf(tl->y, br->y);
+		const float right = fmaxf(tl->x, br->x);
+		const float bottom = fmaxf(tl->y, br->y);
+		const float du_dx = (br->u - tl->u) / (br->x - tl->x);
+		const float dv_dy = (br->v - tl->v) / (br->y - tl->y);
+		const float u0 = tl->u + (left - tl->x) * du_dx;
+		const float v0 = tl->v + (top - tl->y) * dv_dy;
+
+		if (left == right || top == bottom)
+			return true;
+
+		draw_rect(ctx, left, top, right, bottom, u0, v0, du_dx, dv_dy);
+		return true;
+	}
+
+	if (tl->x == br->x || tl->y == br->y)
+		return true;
+
+	draw_rect(ctx, tl->x, tl->y, br->x, br->y, tl->u, tl->v,
+		  (br->u - tl->u) / (br->x - tl->x),
+		  (br->v - tl->v) / (br->y - tl->y));
+	return true;
+}
+
+static inline void transform_vert(const gs_device_t *device,
+				  const struct matrix4 *viewproj,
+				  const struct gs_vb_data *data, size_t idx,
+				  struct raster_vert *out)
+{
+	const struct vec3 *pos = data->points + idx;
+	const struct gs_rect *vp = &device->viewport;
+	struct vec4 clip;
+	float inv_w;
+
+	clip.m = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pos->x), viewproj->x.m),
+			   _mm_mul_ps(_mm_set1_ps(pos->y), viewproj->y.m)),
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pos->z), viewproj->z.m),
+			   viewproj->t.m));
+
+	inv_w = clip.w != 0.0f ? 1.0f / clip.w : 0.0f;
+	out->x = (clip.x * inv_w + 1.0f) * 0.5f * (float)vp->cx + (float)vp->x;
+	out->y = (1.0f - clip.y * inv_w) * 0.5f * (float)vp->cy + (float)vp->y;
+	out->inv_w = inv_w;
+
+	if (data->num_tex && data->tvarray[0].array) {
+		const struct vec2 *uv = data->tvarray[0].array;
+		out->u = uv[idx].x;
+		out->v = uv[idx].y;
+	} else {
+		out->u = out->v = 0.0f;
+	}
+}
+
+static inline size_t get_index(const gs_indexbuffer_t *ib, size_t i)
+{
+	if (!ib)
+		return i;
+	if (ib->type == GS_UNSIGNED_SHORT)
+		return ((const uint16_t *)ib->indices)[i];
+	return ((const uint32_t *)ib->indices)[i];
+}
+
+static void draw_vertices(const gs_device_t *device,
+			  const struct draw_context *ctx,
+			  enum gs_draw_mode draw_mode, uint32_t start_vert,
+			  uint32_t num_verts)
+{
+	const gs_vertbuffer_t *vb = device->cur_vertex_buffer;
+	const gs_indexbuffer_t *ib = device->cur_index_buffer;
+	const size_t available = ib ? ib->num : vb->data->num;
+	struct matrix4 view, viewproj;
+	struct raster_vert verts[4];
+
+	if (!num_verts)
+		num_verts = (uint32_t)(available - start_vert);
+	if ((size_t)start_vert + num_verts > available) {
+		blog(LOG_ERROR, "device_draw (software): "
+				"draw is out of bounds");
+		return;
+	}
+
+	gs_matrix_get(&view);
+	matrix4_mul(&viewproj, &view, &device->cur_proj);
+
+	if (draw_mode == GS_TRISTRIP && num_verts == 4) {
+		for (size_t i = 0; i < 4; i++)
+			transform_vert(device, &viewproj, vb->data,
+				       get_index(ib, start_vert + i),
+				       &verts[i]);
+		if (draw_quad_as_rect(ctx, verts))
+			return;
+	}
+
+	if (draw_mode == GS_TRIS) {
+		for (uint32_t i = 0; i + 3 <= num_verts; i += 3) {
+			for (size_t j = 0; j < 3; j++)
+				transform_vert(device, &viewproj, vb->data,
+					       get_index(ib, start_vert + i + j),
+					       &verts[j]);
+			draw_triangle(ctx, &verts[0], &verts[1], &verts[2]);
+		}
+
+	} else if (draw_mode == GS_TRISTRIP) {
+		if (num_verts < 3)
+			return;
+
+		transform_vert(device, &viewproj, vb->data,
+			       get_index(ib, start_vert), &verts[0]);
+		transform_vert(device, &viewproj, vb->data,
+			       get_index(ib, start_vert + 1), &verts[1]);
+
+		for (uint32_t i = 2; i < num_verts; i++) {
+			transform_vert(device, &viewproj, vb->data,
+				       get_index(ib, start_vert + i),
+				       &verts[2]);
+			draw_triangle(ctx, &verts[0], &verts[1], &verts[2]);
+			verts[0] = verts[1];
+			verts[1] = verts[2];
+		}
+
+	} else {
+		blog(LOG_DEBUG, "device_draw (software): points and lines "
+				"are not drawn");
+	}
+}
+
+static void init_context(const gs_device_t *device, struct draw_context *ctx)
+{
+	const gs_shader_t *ps = device->cur_pixel_shader;
+	gs_texture_t *target = device->cur_render_target;
+	const struct gs_rect *vp = &device->viewport;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->target = target;
+	ctx->program = ps->program;
+	ctx->image = soft_shader_texture(ps, "image");
+	if (!ctx->image)
+		ctx->image = device->cur_textures[0];
+	ctx->filter = soft_shader_filter(ps, "image");
+
+	soft_shader_vec4(ps, "color", &ctx->color);
+	soft_shader_vec4(ps, "color_vec0", &ctx->color_vec[0]);
+	soft_shader_vec4(ps, "color_vec1", &ctx->color_vec[1]);
+	soft_shader_vec4(ps, "color_vec2", &ctx->color_vec[2]);
+
+	ctx->blend = device->blend;
+	ctx->write_all = device->color_mask[0] && device->color_mask[1] &&
+			 device->color_mask[2] && device->color_mask[3];
+	ctx->write_mask = _mm_castsi128_ps(
+		_mm_set_epi32(device->color_mask[3] ? -1 : 0,
+			      device->color_mask[2] ? -1 : 0,
+			      device->color_mask[1] ? -1 : 0,
+			      device->color_mask[0] ? -1 : 0));
+
+	ctx->min_x = vp->x > 0 ? vp->x : 0;
+	ctx->min_y = vp->y > 0 ? vp->y : 0;
+	ctx->max_x = vp->x + vp->cx;
+	ctx->max_y = vp->y + vp->cy;
+	if (ctx->max_x > (int)target->width)
+		ctx->max_x = (int)target->width;
+	if (ctx->max_y > (int)target->height)
+		ctx->max_y = (int)target->height;
+
+	if (device->scissor_enabled) {
+		const struct gs_rect *sr = &device->scissor;
+		if (ctx->min_x < sr->x)
+			ctx->min_x = sr->x;
+		if (ctx->min_y < sr->y)
+			ctx->min_y = sr->y;
+		if (ctx->max_x > sr->x + sr->cx)
+			ctx->max_x = sr->x + sr->cx;
+		if (ctx->max_y > sr->y + sr->cy)
+			ctx->max_y = sr->y + sr->cy;
+	}
+}
+
+void soft_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+	       uint32_t start_vert, uint32_t num_verts)
+{
+	const struct gs_rect *vp = &device->viewport;
+	struct draw_context ctx;
+
+	if (!device->cur_render_target) {
+		blog(LOG_ERROR, "device_draw (software): no render target");
+		return;
+	}
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "device_draw (software): no pixel shader");
+		return;
+	}
+
+	init_context(device, &ctx);
+
+	/* without a vertex buffer the vertex shader generates a triangle
+	 * covering the viewport from the vertex ids, as the conversion passes
+	 * do */
+	if (!device->cur_vertex_buffer) {
+		if (vp->cx <= 0 || vp->cy <= 0)
+			return;
+
+		draw_rect(&ctx, (float)vp->x, (float)vp->y,
+			  (float)(vp->x + vp->cx), (float)(vp->y + vp->cy),
+			  0.0f, 0.0f, 1.0f / (float)vp->cx,
+			  1.0f / (float)vp->cy);
+		return;
+	}
+
+	draw_vertices(device, &ctx, draw_mode, start_vert, num_verts);
+}
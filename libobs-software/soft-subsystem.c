@@ -0,0 +1,750 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include "soft-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Software";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_SOFTWARE;
+}
+
+bool device_enum_adapters(bool (*callback)(void *param, const char *name,
+					   uint32_t id),
+			  void *param)
+{
+	callback(param, "Software Renderer", 0);
+	return true;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_SOFTWARE";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	gs_device_t *device = bzalloc(sizeof(gs_device_t));
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing software renderer...");
+
+	device->cull_mode = GS_NEITHER;
+	device->blend.enabled = true;
+	device->blend.src_c = GS_BLEND_SRCALPHA;
+	device->blend.dest_c = GS_BLEND_INVSRCALPHA;
+	device->blend.src_a = GS_BLEND_ONE;
+	device->blend.dest_a = GS_BLEND_INVSRCALPHA;
+	for (size_t i = 0; i < 4; i++)
+		device->color_mask[i] = true;
+	matrix4_identity(&device->cur_proj);
+
+	UNUSED_PARAMETER(adapter);
+	*p_device = device;
+	return GS_SUCCESS;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	da_free(device->proj_stack);
+	bfree(device);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void *device_get_device_obj(gs_device_t *device)
+{
+	return device;
+}
+
+/* ------------------------------------------------------------------------- */
+/* swap chains have no window, the back buffer is a plain render target */
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+					const struct gs_init_data *data)
+{
+	struct gs_swap_chain *swap;
+	enum gs_color_format format = data->format;
+
+	if (!soft_format_bpp(format))
+		format = GS_BGRA;
+
+	swap = bzalloc(sizeof(struct gs_swap_chain));
+	swap->device = device;
+	swap->info = *data;
+	swap->target = device_texture_create(device, data->cx, data->cy,
+					     format, 1, NULL,
+					     GS_RENDER_TARGET);
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	gs_texture_destroy(swapchain->target);
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	gs_swapchain_t *swap = device->cur_swap;
+	enum gs_color_format format;
+
+	if (!swap) {
+		blog(LOG_WARNING, "device_resize (software): "
+				  "No active swap");
+		return;
+	}
+
+	format = swap->target->format;
+	if (device->cur_render_target == swap->target)
+		device->cur_render_target = NULL;
+
+	gs_texture_destroy(swap->target);
+	swap->info.cx = cx;
+	swap->info.cy = cy;
+	swap->target = device_texture_create(device, cx, cy, format, 1, NULL,
+					     GS_RENDER_TARGET);
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		blog(LOG_ERROR, "device_get_size (software): No active swap");
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cx;
+	} else {
+		blog(LOG_ERROR, "device_get_width (software): No active swap");
+		return 0;
+	}
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cy;
+	} else {
+		blog(LOG_ERROR, "device_get_height (software): "
+				"No active swap");
+		return 0;
+	}
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+	device->cur_render_target = swapchain ? swapchain->target : NULL;
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+bool device_nv12_available(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* vertex and index buffers are kept in system memory and read at draw time */
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+					    struct gs_vb_data *data,
+					    uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+
+	vb->device = device;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+
+	if ((flags & GS_DUP_BUFFER) != 0) {
+		struct gs_vb_data *dup = gs_vbdata_create();
+
+		dup->num = data->num;
+		dup->points = bmemdup(data->points,
+				      sizeof(struct vec3) * data->num);
+		dup->num_tex = data->num_tex;
+		if (data->num_tex) {
+			dup->tvarray = bzalloc(sizeof(struct gs_tvertarray) *
+					       data->num_tex);
+			for (size_t i = 0; i < data->num_tex; i++) {
+				const struct gs_tvertarray *tv =
+					data->tvarray + i;
+
+				dup->tvarray[i].width = tv->width;
+				dup->tvarray[i].array = bmemdup(
+					tv->array,
+					sizeof(float) * tv->width * data->num);
+			}
+		}
+		data = dup;
+	}
+
+	vb->data = data;
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer)
+{
+	if (!vertbuffer)
+		return;
+
+	if (vertbuffer->device->cur_vertex_buffer == vertbuffer)
+		vertbuffer->device->cur_vertex_buffer = NULL;
+
+	gs_vbdata_destroy(vertbuffer->data);
+	bfree(vertbuffer);
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer)
+{
+	/* data is read in place when drawing */
+	UNUSED_PARAMETER(vertbuffer);
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vertbuffer,
+				  const struct gs_vb_data *data)
+{
+	struct gs_vb_data *dst = vertbuffer->data;
+
+	if (!vertbuffer->dynamic) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush_direct (software): "
+				"vertex buffer is not dynamic");
+		return;
+	}
+
+	if (data->points && dst->points != data->points)
+		memcpy(dst->points, data->points,
+		       sizeof(struct vec3) * dst->num);
+
+	for (size_t i = 0; i < dst->num_tex && i < data->num_tex; i++) {
+		const struct gs_tvertarray *tv = data->tvarray + i;
+
+		if (dst->tvarray[i].array != tv->array)
+			memcpy(dst->tvarray[i].array, tv->array,
+			       sizeof(float) * tv->width * dst->num);
+	}
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vertbuffer)
+{
+	return vertbuffer->data;
+}
+
+static inline size_t index_width(enum gs_index_type type)
+{
+	return type == GS_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+					    enum gs_index_type type,
+					    void *indices, size_t num,
+					    uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+
+	ib->device = device;
+	ib->type = type;
+	ib->num = num;
+	ib->width = index_width(type);
+	ib->indices = (flags & GS_DUP_BUFFER) != 0
+			      ? bmemdup(indices, ib->width * num)
+			      : indices;
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *indexbuffer)
+{
+	if (!indexbuffer)
+		return;
+
+	if (indexbuffer->device->cur_index_buffer == indexbuffer)
+		indexbuffer->device->cur_index_buffer = NULL;
+
+	bfree(indexbuffer->indices);
+	bfree(indexbuffer);
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *indexbuffer)
+{
+	UNUSED_PARAMETER(indexbuffer);
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *indexbuffer,
+				 const void *data)
+{
+	if (data != indexbuffer->indices)
+		memcpy(indexbuffer->indices, data,
+		       indexbuffer->width * indexbuffer->num);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->indices;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->type;
+}
+
+/* ------------------------------------------------------------------------- */
+/* drawing is synchronous, so timers simply read the clock */
+
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	struct gs_timer *timer = bzalloc(sizeof(struct gs_timer));
+	timer->device = device;
+	return timer;
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	struct gs_timer_range *range = bzalloc(sizeof(struct gs_timer_range));
+	range->device = device;
+	return range;
+}
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	bfree(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	timer->begin = os_gettime_ns();
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	timer->end = os_gettime_ns();
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	*ticks = timer->end - timer->begin;
+	return true;
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	bfree(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+			     uint64_t *frequency)
+{
+	UNUSED_PARAMETER(range);
+	*disjoint = false;
+	*frequency = 1000000000;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* state */
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vertbuffer)
+{
+	device->cur_vertex_buffer = vertbuffer;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *indexbuffer)
+{
+	device->cur_index_buffer = indexbuffer;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit < 0 || unit >= SOFT_MAX_TEXTURES)
+		return;
+
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+			      gs_samplerstate_t *samplerstate, int unit)
+{
+	if (unit < 0 || unit >= SOFT_MAX_TEXTURES)
+		return;
+
+	device->cur_samplers[unit] = samplerstate;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d, int unit)
+{
+	UNUSED_PARAMETER(b_3d);
+	device_load_samplerstate(device, NULL, unit);
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "device_load_vertexshader (software): "
+				"Specified shader is not a vertex shader");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "device_load_pixelshader (software): "
+				"Specified shader is not a pixel shader");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	if (device->cur_swap && device->cur_render_target ==
+					device->cur_swap->target)
+		return NULL;
+
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+			      gs_zstencil_t *zstencil)
+{
+	if (tex && !tex->is_render_target) {
+		blog(LOG_ERROR, "device_set_render_target (software): "
+				"texture is not a render target");
+		return;
+	}
+
+	if (!tex && device->cur_swap)
+		tex = device->cur_swap->target;
+
+	device->cur_render_target = tex;
+	device->cur_zstencil = zstencil;
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+				   int side, gs_zstencil_t *zstencil)
+{
+	blog(LOG_ERROR, "device_set_cube_render_target (software): "
+			"cube textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(cubetex);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(zstencil);
+}
+
+void device_begin_frame(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < SOFT_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		 uint32_t start_vert, uint32_t num_verts)
+{
+	soft_draw(device, draw_mode, start_vert, num_verts);
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		  const struct vec4 *color, float depth, uint8_t stencil)
+{
+	gs_texture_t *target = device->cur_render_target;
+
+	if (target && (clear_flags & GS_CLEAR_COLOR) != 0) {
+		struct gs_rect rect = {0, 0, (int)target->width,
+				       (int)target->height};
+		soft_clear_color(target, &rect, color);
+	}
+
+	/* depth and stencil buffers are never tested against */
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	device->blend.enabled = enable;
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green, bool blue,
+			 bool alpha)
+{
+	device->color_mask[0] = red;
+	device->color_mask[1] = green;
+	device->color_mask[2] = blue;
+	device->color_mask[3] = alpha;
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+			   enum gs_blend_type dest)
+{
+	device_blend_function_separate(device, src, dest, src, dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+				    enum gs_blend_type src_c,
+				    enum gs_blend_type dest_c,
+				    enum gs_blend_type src_a,
+				    enum gs_blend_type dest_a)
+{
+	device->blend.src_c = src_c;
+	device->blend.dest_c = dest_c;
+	device->blend.src_a = src_a;
+	device->blend.dest_a = dest_a;
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+			     enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		       enum gs_stencil_op_type fail,
+		       enum gs_stencil_op_type zfail,
+		       enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+			 int height)
+{
+	device->viewport.x = x;
+	device->viewport.y = y;
+	device->viewport.cx = width;
+	device->viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	device->scissor_enabled = rect != NULL;
+	if (rect)
+		device->scissor = *rect;
+}
+
+/* projections use the Direct3D clip space, z in [0, 1] */
+
+void device_ortho(gs_device_t *device, float left, float right, float top,
+		  float bottom, float zNear, float zFar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = zFar - zNear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = 2.0f / rml;
+	dst->t.x = (left + right) / -rml;
+
+	dst->y.y = 2.0f / -bmt;
+	dst->t.y = (bottom + top) / bmt;
+
+	dst->z.z = 1.0f / fmn;
+	dst->t.z = zNear / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right, float top,
+		    float bottom, float zNear, float zFar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = zFar - zNear;
+	float nearx2 = 2.0f * zNear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = nearx2 / rml;
+	dst->z.x = (left + right) / -rml;
+
+	dst->y.y = nearx2 / -bmt;
+	dst->z.y = (bottom + top) / bmt;
+
+	dst->z.z = zFar / fmn;
+	dst->t.z = (zNear * zFar) / -fmn;
+
+	dst->z.w = 1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void device_debug_marker_begin(gs_device_t *device, const char *markername,
+			       const float color[4])
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(markername);
+	UNUSED_PARAMETER(color);
+}
+
+void device_debug_marker_end(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
@@ -0,0 +1,192 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+/*
+ * CPU reference implementation of the graphics subsystem.
+ *
+ * Needs no GPU, window system or driver, so the whole frame loop can run on
+ * headless machines for benchmarks and regression tests.  Only 8-bit color
+ * formats are supported.  Shaders are not compiled: each pixel shader is
+ * mapped by its entry point to one of a small set of built-in programs
+ * covering the default, opaque, solid and format conversion effects, and
+ * vertex shaders are assumed to transform the position by ViewProj and pass
+ * the first texture coordinate through.
+ */
+
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+#include <graphics/vec4.h>
+
+#define SOFT_MAX_TEXTURES 8
+
+struct gs_texture {
+	gs_device_t *device;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t linesize;
+	uint8_t *data;
+	bool is_render_target;
+};
+
+struct gs_stage_surface {
+	gs_device_t *device;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t linesize;
+	uint8_t *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t *device;
+	uint32_t width;
+	uint32_t height;
+	enum gs_zstencil_format format;
+};
+
+struct gs_sampler_state {
+	gs_device_t *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t *device;
+	struct gs_vb_data *data;
+	bool dynamic;
+};
+
+struct gs_index_buffer {
+	gs_device_t *device;
+	enum gs_index_type type;
+	void *indices;
+	size_t num;
+	size_t width;
+};
+
+struct gs_timer {
+	gs_device_t *device;
+	uint64_t begin;
+	uint64_t end;
+};
+
+struct gs_timer_range {
+	gs_device_t *device;
+};
+
+struct gs_swap_chain {
+	gs_device_t *device;
+	struct gs_init_data info;
+	gs_texture_t *target;
+};
+
+/* built-in pixel programs, see soft-shader.c for the entry points they are
+ * selected by */
+enum soft_program {
+	SOFT_PROGRAM_DRAW,
+	SOFT_PROGRAM_DRAW_OPAQUE,
+	SOFT_PROGRAM_ALPHA_DIVIDE,
+	SOFT_PROGRAM_SOLID,
+	SOFT_PROGRAM_CONVERT_Y,
+	SOFT_PROGRAM_CONVERT_UV,
+	SOFT_PROGRAM_CONVERT_U,
+	SOFT_PROGRAM_CONVERT_V,
+	SOFT_PROGRAM_CONVERT_U_FULL,
+	SOFT_PROGRAM_CONVERT_V_FULL,
+};
+
+struct gs_shader_param {
+	struct dstr name;
+	enum gs_shader_param_type type;
+	gs_shader_t *shader;
+
+	DARRAY(uint8_t) cur_value;
+	DARRAY(uint8_t) def_value;
+	gs_texture_t *texture;
+	gs_samplerstate_t *next_sampler;
+};
+
+struct gs_shader {
+	gs_device_t *device;
+	enum gs_shader_type type;
+	enum soft_program program;
+	enum gs_sample_filter filter;
+
+	DARRAY(struct gs_shader_param) params;
+	struct gs_shader_param *viewproj;
+	struct gs_shader_param *world;
+};
+
+struct soft_blend_state {
+	bool enabled;
+	enum gs_blend_type src_c;
+	enum gs_blend_type dest_c;
+	enum gs_blend_type src_a;
+	enum gs_blend_type dest_a;
+};
+
+struct gs_device {
+	gs_swapchain_t *cur_swap;
+	gs_texture_t *cur_render_target;
+	gs_zstencil_t *cur_zstencil;
+	gs_vertbuffer_t *cur_vertex_buffer;
+	gs_indexbuffer_t *cur_index_buffer;
+	gs_texture_t *cur_textures[SOFT_MAX_TEXTURES];
+	gs_samplerstate_t *cur_samplers[SOFT_MAX_TEXTURES];
+	gs_shader_t *cur_vertex_shader;
+	gs_shader_t *cur_pixel_shader;
+
+	enum gs_cull_mode cull_mode;
+	struct soft_blend_state blend;
+	bool color_mask[4];
+	struct gs_rect viewport;
+	struct gs_rect scissor;
+	bool scissor_enabled;
+
+	struct matrix4 cur_proj;
+	DARRAY(struct matrix4) proj_stack;
+};
+
+/* soft-texture.c */
+extern uint32_t soft_format_bpp(enum gs_color_format format);
+extern void soft_read_pixel(const gs_texture_t *tex, uint32_t x, uint32_t y,
+			    struct vec4 *color);
+extern void soft_sample(const gs_texture_t *tex, enum gs_sample_filter filter,
+			float u, float v, struct vec4 *color);
+
+/* soft-shader.c */
+extern struct gs_shader_param *soft_shader_param(const gs_shader_t *shader,
+						 const char *name);
+extern gs_texture_t *soft_shader_texture(const gs_shader_t *shader,
+					 const char *name);
+extern void soft_shader_vec4(const gs_shader_t *shader, const char *name,
+			     struct vec4 *val);
+extern enum gs_sample_filter soft_shader_filter(const gs_shader_t *shader,
+						const char *name);
+
+/* soft-draw.c */
+extern void soft_clear_color(gs_texture_t *target, const struct gs_rect *rect,
+			     const struct vec4 *color);
+extern void soft_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		      uint32_t start_vert, uint32_t num_verts);
@@ -0,0 +1,509 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include "soft-subsystem.h"
+
+uint32_t soft_format_bpp(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:
+		return 1;
+	case GS_R8G8:
+		return 2;
+	case GS_RGBA:
+	case GS_BGRX:
+	case GS_BGRA:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static inline uint8_t *alloc_image(uint32_t linesize, uint32_t height)
+{
+	return bzalloc((size_t)linesize * height);
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+				    uint32_t height,
+				    enum gs_color_format color_format,
+				    uint32_t levels, const uint8_t **data,
+				    uint32_t flags)
+{
+	struct gs_texture *tex;
+	uint32_t bpp = soft_format_bpp(color_format);
+
+	if (!bpp) {
+		blog(LOG_ERROR, "device_texture_create (software): "
+				"unsupported color format %d",
+		     (int)color_format);
+		return NULL;
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture));
+	tex->device = device;
+	tex->format = color_format;
+	tex->width = width;
+	tex->height = height;
+	tex->bpp = bpp;
+	tex->linesize = width * bpp;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->data = alloc_image(tex->linesize, height);
+
+	/* only the base level is kept, mipmaps are never sampled */
+	if (data && data[0])
+		memcpy(tex->data, data[0], (size_t)tex->linesize * height);
+
+	UNUSED_PARAMETER(levels);
+	return tex;
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+					enum gs_color_format color_format,
+					uint32_t levels, const uint8_t **data,
+					uint32_t flags)
+{
+	blog(LOG_ERROR, "device_cubetexture_create (software): "
+			"cube textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(size);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+				       uint32_t height, uint32_t depth,
+				       enum gs_color_format color_format,
+				       uint32_t levels,
+				       const uint8_t *const *data,
+				       uint32_t flags)
+{
+	blog(LOG_ERROR, "device_voltexture_create (software): "
+			"volume textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	UNUSED_PARAMETER(texture);
+	return GS_TEXTURE_2D;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	*ptr = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+	return 0;
+}
+
+enum gs_color_format
+gs_cubetexture_get_color_format(const gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+	return GS_UNKNOWN;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format
+gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+					   uint32_t height,
+					   enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf;
+	uint32_t bpp = soft_format_bpp(color_format);
+
+	if (!bpp) {
+		blog(LOG_ERROR, "device_stagesurface_create (software): "
+				"unsupported color format %d",
+		     (int)color_format);
+		return NULL;
+	}
+
+	surf = bzalloc(sizeof(struct gs_stage_surface));
+	surf->device = device;
+	surf->format = color_format;
+	surf->width = width;
+	surf->height = height;
+	surf->bpp = bpp;
+	surf->linesize = width * bpp;
+	surf->data = alloc_image(surf->linesize, height);
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf)
+		return;
+
+	bfree(stagesurf->data);
+	bfree(stagesurf);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format
+gs_stagesurface_get_color_format(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+			 uint32_t *linesize)
+{
+	*data = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void copy_rows(uint8_t *dst, uint32_t dst_linesize,
+			     const uint8_t *src, uint32_t src_linesize,
+			     size_t row_size, uint32_t rows)
+{
+	if (dst_linesize == src_linesize && row_size == src_linesize) {
+		memcpy(dst, src, row_size * rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(dst, src, row_size);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+void device_copy_texture_region(gs_device_t *device, gs_texture_t *dst,
+				uint32_t dst_x, uint32_t dst_y,
+				gs_texture_t *src, uint32_t src_x,
+				uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	uint32_t w, h;
+
+	if (!dst || !src) {
+		blog(LOG_ERROR, "device_copy_texture_region (software): "
+				"null texture");
+		return;
+	}
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (software): "
+				"source and destination formats do not match");
+		return;
+	}
+	if (src_x >= src->width || src_y >= src->height ||
+	    dst_x >= dst->width || dst_y >= dst->height)
+		return;
+
+	w = src_w ? src_w : src->width - src_x;
+	h = src_h ? src_h : src->height - src_y;
+	if (w > src->width - src_x)
+		w = src->width - src_x;
+	if (h > src->height - src_y)
+		h = src->height - src_y;
+	if (w > dst->width - dst_x)
+		w = dst->width - dst_x;
+	if (h > dst->height - dst_y)
+		h = dst->height - dst_y;
+
+	copy_rows(dst->data + (size_t)dst_y * dst->linesize +
+			  (size_t)dst_x * dst->bpp,
+		  dst->linesize,
+		  src->data + (size_t)src_y * src->linesize +
+			  (size_t)src_x * src->bpp,
+		  src->linesize, (size_t)w * src->bpp, h);
+
+	UNUSED_PARAMETER(device);
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+			 gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+			  gs_texture_t *src)
+{
+	if (!dst || !src) {
+		blog(LOG_ERROR, "device_stage_texture (software): "
+				"null surface or texture");
+		return;
+	}
+	if (dst->format != src->format || dst->width != src->width ||
+	    dst->height != src->height) {
+		blog(LOG_ERROR, "device_stage_texture (software): "
+				"source and destination do not match");
+		return;
+	}
+
+	copy_rows(dst->data, dst->linesize, src->data, src->linesize,
+		  (size_t)src->linesize, src->height);
+
+	UNUSED_PARAMETER(device);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+				      uint32_t height,
+				      enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs = bzalloc(sizeof(*zs));
+
+	/* depth and stencil tests are not implemented, the buffer only
+	 * exists so that texrenders asking for one can be created */
+	zs->device = device;
+	zs->width = width;
+	zs->height = height;
+	zs->format = format;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zstencil)
+{
+	bfree(zstencil);
+}
+
+gs_samplerstate_t *
+device_samplerstate_create(gs_device_t *device,
+			   const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *ss = bzalloc(sizeof(*ss));
+	ss->device = device;
+	ss->info = *info;
+	return ss;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	bfree(samplerstate);
+}
+
+/* ------------------------------------------------------------------------- */
+/* sampling */
+
+static const float inv_255 = 1.0f / 255.0f;
+
+static inline __m128 unpack_rgba8(uint32_t packed)
+{
+	__m128i px = _mm_cvtsi32_si128((int)packed);
+	px = _mm_unpacklo_epi8(px, _mm_setzero_si128());
+	px = _mm_unpacklo_epi16(px, _mm_setzero_si128());
+	return _mm_mul_ps(_mm_cvtepi32_ps(px), _mm_set1_ps(inv_255));
+}
+
+void soft_read_pixel(const gs_texture_t *tex, uint32_t x, uint32_t y,
+		     struct vec4 *color)
+{
+	const uint8_t *p =
+		tex->data + (size_t)y * tex->linesize + (size_t)x * tex->bpp;
+	uint32_t packed;
+
+	switch (tex->format) {
+	case GS_RGBA:
+		memcpy(&packed, p, 4);
+		color->m = unpack_rgba8(packed);
+		break;
+	case GS_BGRA:
+	case GS_BGRX:
+		memcpy(&packed, p, 4);
+		color->m = _mm_shuffle_ps(unpack_rgba8(packed),
+					  unpack_rgba8(packed),
+					  _MM_SHUFFLE(3, 0, 1, 2));
+		if (tex->format == GS_BGRX)
+			color->w = 1.0f;
+		break;
+	case GS_R8G8:
+		vec4_set(color, p[0] * inv_255, p[1] * inv_255, 0.0f, 1.0f);
+		break;
+	case GS_R8:
+		vec4_set(color, p[0] * inv_255, 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_A8:
+		vec4_set(color, 0.0f, 0.0f, 0.0f, p[0] * inv_255);
+		break;
+	default:
+		vec4_zero(color);
+		break;
+	}
+}
+
+static inline uint32_t clamp_coord(int val, uint32_t size)
+{
+	if (val < 0)
+		return 0;
+	if ((uint32_t)val >= size)
+		return size - 1;
+	return (uint32_t)val;
+}
+
+static inline bool is_point_filter(enum gs_sample_filter filter)
+{
+	return filter == GS_FILTER_POINT ||
+	       filter == GS_FILTER_MIN_MAG_POINT_MIP_LINEAR;
+}
+
+/* samples with clamped addressing at normalized coordinates */
+void soft_sample(const gs_texture_t *tex, enum gs_sample_filter filter,
+		 float u, float v, struct vec4 *color)
+{
+	const float x = u * (float)tex->width;
+	const float y = v * (float)tex->height;
+
+	if (is_point_filter(filter)) {
+		soft_read_pixel(tex, clamp_coord((int)floorf(x), tex->width),
+				clamp_coord((int)floorf(y), tex->height),
+				color);
+		return;
+	}
+
+	const float fx = x - 0.5f;
+	const float fy = y - 0.5f;
+	const int x0 = (int)floorf(fx);
+	const int y0 = (int)floorf(fy);
+	const float ax = fx - (float)x0;
+	const float ay = fy - (float)y0;
+	const uint32_t cx0 = clamp_coord(x0, tex->width);
+	const uint32_t cx1 = clamp_coord(x0 + 1, tex->width);
+	const uint32_t cy0 = clamp_coord(y0, tex->height);
+	const uint32_t cy1 = clamp_coord(y0 + 1, tex->height);
+	struct vec4 c00, c10, c01, c11;
+	__m128 top, bottom;
+
+	soft_read_pixel(tex, cx0, cy0, &c00);
+	soft_read_pixel(tex, cx1, cy0, &c10);
+	soft_read_pixel(tex, cx0, cy1, &c01);
+	soft_read_pixel(tex, cx1, cy1, &c11);
+
+	top = _mm_add_ps(c00.m,
+			 _mm_mul_ps(_mm_sub_ps(c10.m, c00.m), _mm_set1_ps(ax)));
+	bottom = _mm_add_ps(c01.m, _mm_mul_ps(_mm_sub_ps(c11.m, c01.m),
+					      _mm_set1_ps(ax)));
+	color->m = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top),
+					      _mm_set1_ps(ay)));
+}